@@ -0,0 +1,294 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <time.h>
+#include <syslog.h>
+#include <pthread.h>
+#include <net/if.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <linux/if_ether.h>
+#include <linux/if_packet.h>
+#include "afpacket.h"
+
+static int g_fd = -1;
+static char *g_ring = NULL;
+static size_t g_ring_len = 0;
+static unsigned int g_head = 0;             // 下一个写入的帧槽位
+static unsigned char g_tmpl[AFP_HDR_LEN];   // 帧头模板, 每帧只改长度、标识与校验和
+static uint16_t g_ip_id = 0;
+static pthread_mutex_t g_mutex = PTHREAD_MUTEX_INITIALIZER;     // 保护 g_head 与帧填写
+
+static pthread_mutex_t g_kick_mutex = PTHREAD_MUTEX_INITIALIZER;
+static unsigned int g_pending = 0;          // 已入环但尚未触发的帧数
+static pthread_t g_kick_tid;
+static volatile int g_running = 0;
+static afp_stats_t g_stats;
+
+static struct tpacket2_hdr *frame_at(unsigned int idx) {
+    return (struct tpacket2_hdr *)(g_ring + (size_t)(idx % AFP_FRAME_NR) * AFP_FRAME_SIZE);
+}
+
+static uint16_t ip_checksum(const void *buf, size_t len) {
+    const uint16_t *p = buf;
+    uint32_t sum = 0;
+    for (; len > 1; len -= 2) sum += *p++;
+    if (len) sum += *(const uint8_t *)p;
+    while (sum >> 16) sum = (sum & 0xffff) + (sum >> 16);
+    return (uint16_t)~sum;
+}
+
+// 触发一次发送: 内核从当前位置起发出所有 SEND_REQUEST 状态的帧
+// 已有线程在触发时直接返回, 它退出前会再检查一次待发计数
+static void afp_kick(void) {
+    while (pthread_mutex_trylock(&g_kick_mutex) == 0) {
+        unsigned int seen;
+        do {
+            seen = __atomic_load_n(&g_pending, __ATOMIC_ACQUIRE);
+            if (seen == 0) break;
+            if (send(g_fd, NULL, 0, MSG_DONTWAIT) < 0 && errno != EAGAIN && errno != ENOBUFS) {
+                __atomic_add_fetch(&g_stats.errors, 1, __ATOMIC_RELAXED);
+            }
+            __atomic_add_fetch(&g_stats.kicks, 1, __ATOMIC_RELAXED);
+            __atomic_sub_fetch(&g_pending, seen, __ATOMIC_RELEASE);
+        } while (__atomic_load_n(&g_pending, __ATOMIC_ACQUIRE) != 0);
+        pthread_mutex_unlock(&g_kick_mutex);
+        if (__atomic_load_n(&g_pending, __ATOMIC_ACQUIRE) == 0) return;
+    }
+}
+
+void afp_flush(void) {
+    if (g_fd >= 0) afp_kick();
+}
+
+// 触发线程: 把零散入环的帧按周期合并成一次 send()
+static void *afp_kick_loop(void *arg) {
+    (void)arg;
+    struct timespec ts = {0, AFP_KICK_US * 1000};
+    while (g_running) {
+        nanosleep(&ts, NULL);
+        if (__atomic_load_n(&g_pending, __ATOMIC_ACQUIRE) > 0) afp_kick();
+    }
+    return NULL;
+}
+
+// 取得 g_head 处的空闲槽位, 调用时持有 g_mutex; 驱动拒绝的帧记为错误后复用
+// 环满时放开锁再等驱动释放槽位, 其它频道线程不必在锁上陪等; 重新加锁后 g_head 可能已被推进, 重新取槽位
+static struct tpacket2_hdr *wait_slot(void) {
+    int timed_out = 0;
+    while (1) {
+        struct tpacket2_hdr *hdr = frame_at(g_head);
+        uint32_t status = __atomic_load_n(&hdr->tp_status, __ATOMIC_ACQUIRE);
+        if (status == TP_STATUS_AVAILABLE) return hdr;
+        if (status & TP_STATUS_WRONG_FORMAT) {
+            __atomic_add_fetch(&g_stats.errors, 1, __ATOMIC_RELAXED);
+            __atomic_store_n(&hdr->tp_status, TP_STATUS_AVAILABLE, __ATOMIC_RELEASE);
+            return hdr;
+        }
+        if (timed_out) return NULL;
+        // 环满: 先把积压的帧交给驱动, 再等它释放槽位
+        __atomic_add_fetch(&g_stats.ring_full, 1, __ATOMIC_RELAXED);
+        pthread_mutex_unlock(&g_mutex);
+        afp_kick();
+        struct pollfd pfd = {g_fd, POLLOUT, 0};
+        timed_out = poll(&pfd, 1, AFP_WAIT_MS) <= 0;
+        pthread_mutex_lock(&g_mutex);
+    }
+}
+
+int afp_send(const void *data, size_t len) {
+    size_t frame_len = AFP_HDR_LEN + len;
+    size_t off = TPACKET2_HDRLEN - sizeof(struct sockaddr_ll);
+    if (g_fd < 0 || off + frame_len > AFP_FRAME_SIZE) {
+        __atomic_add_fetch(&g_stats.errors, 1, __ATOMIC_RELAXED);
+        return -1;
+    }
+
+    pthread_mutex_lock(&g_mutex);
+    struct tpacket2_hdr *hdr = wait_slot();
+    if (!hdr) {
+        pthread_mutex_unlock(&g_mutex);
+        __atomic_add_fetch(&g_stats.errors, 1, __ATOMIC_RELAXED);
+        return -1;
+    }
+    unsigned char *frame = (unsigned char *)hdr + off;
+    memcpy(frame, g_tmpl, AFP_HDR_LEN);
+    memcpy(frame + AFP_HDR_LEN, data, len);
+
+    // IPv4 总长度、标识、首部校验和; UDP 长度 (IPv4 下 UDP 校验和可为 0, 省去整包求和)
+    unsigned char *ip = frame + ETH_HLEN;
+    uint16_t v = htons((uint16_t)(frame_len - ETH_HLEN));
+    memcpy(ip + 2, &v, 2);
+    v = htons(g_ip_id++);
+    memcpy(ip + 4, &v, 2);
+    v = ip_checksum(ip, 20);
+    memcpy(ip + 10, &v, 2);
+    v = htons((uint16_t)(len + 8));
+    memcpy(ip + 24, &v, 2);
+
+    hdr->tp_len = (uint32_t)frame_len;
+    __atomic_store_n(&hdr->tp_status, TP_STATUS_SEND_REQUEST, __ATOMIC_RELEASE);
+    g_head++;
+    pthread_mutex_unlock(&g_mutex);
+
+    __atomic_add_fetch(&g_stats.frames, 1, __ATOMIC_RELAXED);
+    if (__atomic_add_fetch(&g_pending, 1, __ATOMIC_ACQ_REL) >= AFP_KICK_BATCH) afp_kick();
+    return 0;
+}
+
+// 填写帧头模板: 组播目的MAC 01:00:5e + 组地址低23位, 源MAC与源IP取自接口
+static int build_template(int fd, const char *ifname, in_addr_t src_ip,
+                          const struct sockaddr_in *dst, int ttl) {
+    struct ifreq ifr;
+    memset(&ifr, 0, sizeof(ifr));
+    snprintf(ifr.ifr_name, sizeof(ifr.ifr_name), "%s", ifname);
+    if (ioctl(fd, SIOCGIFHWADDR, &ifr) < 0) {
+        syslog(LOG_ERR, "读取接口 %s 的MAC地址失败: %s", ifname, strerror(errno));
+        return -1;
+    }
+    unsigned char src_mac[ETH_ALEN];
+    memcpy(src_mac, ifr.ifr_hwaddr.sa_data, ETH_ALEN);
+    if (src_ip == htonl(INADDR_ANY)) {
+        memset(&ifr, 0, sizeof(ifr));
+        snprintf(ifr.ifr_name, sizeof(ifr.ifr_name), "%s", ifname);
+        ifr.ifr_addr.sa_family = AF_INET;
+        if (ioctl(fd, SIOCGIFADDR, &ifr) < 0) {
+            syslog(LOG_ERR, "接口 %s 没有IPv4地址, 请用 -i 指定源地址", ifname);
+            return -1;
+        }
+        src_ip = ((struct sockaddr_in *)&ifr.ifr_addr)->sin_addr.s_addr;
+    }
+
+    uint32_t group = ntohl(dst->sin_addr.s_addr);
+    unsigned char *eth = g_tmpl;
+    eth[0] = 0x01;
+    eth[1] = 0x00;
+    eth[2] = 0x5e;
+    eth[3] = (group >> 16) & 0x7f;
+    eth[4] = (group >> 8) & 0xff;
+    eth[5] = group & 0xff;
+    memcpy(eth + 6, src_mac, ETH_ALEN);
+    eth[12] = ETH_P_IP >> 8;
+    eth[13] = ETH_P_IP & 0xff;
+
+    unsigned char *ip = g_tmpl + ETH_HLEN;
+    memset(ip, 0, 28);
+    ip[0] = 0x45;                       // IPv4, 首部20字节
+    ip[8] = (unsigned char)ttl;
+    ip[9] = IPPROTO_UDP;
+    memcpy(ip + 12, &src_ip, 4);
+    memcpy(ip + 16, &dst->sin_addr.s_addr, 4);
+
+    unsigned char *udp = ip + 20;
+    uint16_t port = dst->sin_port;      // 源端口与目的端口相同, 已是网络字节序
+    memcpy(udp, &port, 2);
+    memcpy(udp + 2, &port, 2);
+
+    char src_str[INET_ADDRSTRLEN];
+    inet_ntop(AF_INET, &src_ip, src_str, sizeof(src_str));
+    syslog(LOG_INFO, "AF_PACKET 发送: 接口 %s 源 %s %02x:%02x:%02x:%02x:%02x:%02x", ifname, src_str,
+           src_mac[0], src_mac[1], src_mac[2], src_mac[3], src_mac[4], src_mac[5]);
+    return 0;
+}
+
+// 打开发送环; src_ip 为 INADDR_ANY 时取接口地址
+int afp_open(const char *ifname, in_addr_t src_ip, const struct sockaddr_in *dst, int ttl) {
+    unsigned int ifindex = if_nametoindex(ifname);
+    if (ifindex == 0) {
+        syslog(LOG_ERR, "找不到网络接口 %s", ifname);
+        return -1;
+    }
+    // 协议号为 0: 只发送, 不接收任何帧
+    int fd = socket(AF_PACKET, SOCK_RAW | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        syslog(LOG_ERR, "创建AF_PACKET套接字失败: %s (需要 CAP_NET_RAW)", strerror(errno));
+        return -1;
+    }
+    if (build_template(fd, ifname, src_ip, dst, ttl) != 0) {
+        close(fd);
+        return -1;
+    }
+
+    int version = TPACKET_V2;
+    int one = 1;
+    struct tpacket_req req;
+    req.tp_block_size = AFP_BLOCK_SIZE;
+    req.tp_block_nr = AFP_BLOCK_NR;
+    req.tp_frame_size = AFP_FRAME_SIZE;
+    req.tp_frame_nr = AFP_FRAME_NR;
+    if (setsockopt(fd, SOL_PACKET, PACKET_VERSION, &version, sizeof(version)) < 0 ||
+        setsockopt(fd, SOL_PACKET, PACKET_TX_RING, &req, sizeof(req)) < 0) {
+        syslog(LOG_ERR, "设置PACKET_TX_RING失败: %s", strerror(errno));
+        close(fd);
+        return -1;
+    }
+    // 绕过 qdisc 直接交给驱动 (节拍由发送线程负责); 格式错误的帧丢弃而不是阻塞整个环
+    setsockopt(fd, SOL_PACKET, PACKET_QDISC_BYPASS, &one, sizeof(one));
+    setsockopt(fd, SOL_PACKET, PACKET_LOSS, &one, sizeof(one));
+
+    size_t ring_len = (size_t)AFP_BLOCK_SIZE * AFP_BLOCK_NR;
+    char *ring = mmap(NULL, ring_len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (ring == MAP_FAILED) {
+        syslog(LOG_ERR, "映射发送环失败: %s", strerror(errno));
+        close(fd);
+        return -1;
+    }
+
+    struct sockaddr_ll sll;
+    memset(&sll, 0, sizeof(sll));
+    sll.sll_family = AF_PACKET;
+    sll.sll_protocol = htons(ETH_P_IP);
+    sll.sll_ifindex = (int)ifindex;
+    if (bind(fd, (struct sockaddr *)&sll, sizeof(sll)) < 0) {
+        syslog(LOG_ERR, "绑定接口 %s 失败: %s", ifname, strerror(errno));
+        munmap(ring, ring_len);
+        close(fd);
+        return -1;
+    }
+
+    g_fd = fd;
+    g_ring = ring;
+    g_ring_len = ring_len;
+    g_head = 0;
+    g_running = 1;
+    if (pthread_create(&g_kick_tid, NULL, afp_kick_loop, NULL) != 0) {
+        g_running = 0;
+        afp_close();
+        return -1;
+    }
+    syslog(LOG_INFO, "AF_PACKET 发送环: %d 帧 x %d 字节", AFP_FRAME_NR, AFP_FRAME_SIZE);
+    return 0;
+}
+
+int afp_enabled(void) {
+    return g_fd >= 0;
+}
+
+void afp_get_stats(afp_stats_t *stats) {
+    stats->frames = __atomic_load_n(&g_stats.frames, __ATOMIC_RELAXED);
+    stats->kicks = __atomic_load_n(&g_stats.kicks, __ATOMIC_RELAXED);
+    stats->ring_full = __atomic_load_n(&g_stats.ring_full, __ATOMIC_RELAXED);
+    stats->errors = __atomic_load_n(&g_stats.errors, __ATOMIC_RELAXED);
+}
+
+void afp_close(void) {
+    if (g_running) {
+        g_running = 0;
+        pthread_join(g_kick_tid, NULL);
+    }
+    if (g_fd >= 0) afp_kick();
+    if (g_ring) {
+        munmap(g_ring, g_ring_len);
+        g_ring = NULL;
+    }
+    if (g_fd >= 0) {
+        close(g_fd);
+        g_fd = -1;
+    }
+}
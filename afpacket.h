@@ -0,0 +1,37 @@
+#ifndef __AFPACKET_H__
+#define __AFPACKET_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <netinet/in.h>
+
+// AF_PACKET 发送后端: 用户态拼好完整的 以太网/IPv4/UDP 组播帧, 写入 PACKET_MMAP 发送环,
+// 一次 send() 把环中所有待发帧交给网卡驱动, 绕过 UDP/IP 协议栈与 qdisc
+// 各频道线程只负责入环, 攒够 AFP_KICK_BATCH 帧立即触发, 否则由触发线程每 AFP_KICK_US 统一触发
+// 注意: 帧直接进网卡, 本机的组播接收者收不到, 测试请用 veth 对端或另一台主机
+#define AFP_FRAME_SIZE  2048                // 环中每帧槽位大小
+#define AFP_BLOCK_SIZE  (64 * 1024)
+#define AFP_BLOCK_NR    32                  // 共 1024 帧
+#define AFP_FRAME_NR    (AFP_BLOCK_SIZE / AFP_FRAME_SIZE * AFP_BLOCK_NR)
+#define AFP_WAIT_MS     10                  // 环满时等待驱动释放槽位的超时
+#define AFP_KICK_BATCH  32                  // 待发帧达到此数时由入环线程直接触发
+#define AFP_KICK_US     500                 // 触发线程的周期, 也是帧在环中的最长停留
+#define AFP_HDR_LEN     42                  // 以太网14 + IPv4 20 + UDP 8
+
+// 统计计数
+typedef struct afp_stats {
+    uint64_t frames;        // 写入环的帧数
+    uint64_t kicks;         // 触发发送的 send() 次数
+    uint64_t ring_full;     // 等待空闲槽位的次数
+    uint64_t errors;        // 超长、超时或驱动拒绝的帧
+} afp_stats_t;
+
+// 函数声明
+int afp_open(const char *ifname, in_addr_t src_ip, const struct sockaddr_in *dst, int ttl);
+int afp_enabled(void);
+int afp_send(const void *data, size_t len);     // 拼帧入环, 成功返回 0; 发送由批量触发完成
+void afp_flush(void);                           // 立即触发发送环中的待发帧
+void afp_get_stats(afp_stats_t *stats);
+void afp_close(void);
+
+#endif /* __AFPACKET_H__ */
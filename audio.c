@@ -0,0 +1,103 @@
+#include <stdio.h>
+#include <mpg123.h>
+#include <out123.h>
+#include "audio.h"
+
+static mpg123_handle *g_mh = NULL;   // 解码器(feed模式)
+static out123_handle *g_ao = NULL;   // 音频输出
+static int g_started = 0;            // 输出设备是否已按当前格式启动
+static unsigned char g_pcm[AUDIO_PCM_CHUNK];
+
+// 创建解码器并打开默认音频设备
+int audio_init(void) {
+    int err = MPG123_OK;
+    mpg123_init();
+    g_mh = mpg123_new(NULL, &err);
+    if (!g_mh) {
+        fprintf(stderr, "[AUDIO] 创建解码器失败: %s\n", mpg123_plain_strerror(err));
+        return -1;
+    }
+    mpg123_param(g_mh, MPG123_ADD_FLAGS, MPG123_QUIET, 0);
+    if (mpg123_open_feed(g_mh) != MPG123_OK) {
+        fprintf(stderr, "[AUDIO] 打开解码输入失败: %s\n", mpg123_strerror(g_mh));
+        audio_close();
+        return -1;
+    }
+
+    g_ao = out123_new();
+    if (!g_ao) {
+        fprintf(stderr, "[AUDIO] 创建音频输出失败\n");
+        audio_close();
+        return -1;
+    }
+    // 设备缓冲尽量小, 换台时 out123_drop 可立即清空
+    out123_param_float(g_ao, OUT123_DEVICEBUFFER, AUDIO_DEVICE_BUFFER);
+    if (out123_open(g_ao, NULL, NULL) != 0) {
+        fprintf(stderr, "[AUDIO] 打开音频设备失败: %s\n", out123_strerror(g_ao));
+        audio_close();
+        return -1;
+    }
+    printf("[AUDIO] 解码器与音频设备已就绪 (设备缓冲 %.0f ms)\n", AUDIO_DEVICE_BUFFER * 1000);
+    return 0;
+}
+
+// 送入MP3数据, 解码出的PCM同步写入音频设备
+void audio_feed(const void *data, size_t len) {
+    if (!g_mh || !g_ao) return;
+    if (mpg123_feed(g_mh, data, len) != MPG123_OK) {
+        fprintf(stderr, "[AUDIO] 送入数据失败: %s\n", mpg123_strerror(g_mh));
+        return;
+    }
+
+    while (1) {
+        size_t done = 0;
+        int ret = mpg123_read(g_mh, g_pcm, sizeof(g_pcm), &done);
+        if (ret == MPG123_NEW_FORMAT) {
+            long rate;
+            int channels, encoding;
+            mpg123_getformat(g_mh, &rate, &channels, &encoding);
+            if (g_started) out123_stop(g_ao);
+            g_started = (out123_start(g_ao, rate, channels, encoding) == 0);
+            if (!g_started) {
+                fprintf(stderr, "[AUDIO] 启动音频输出失败: %s\n", out123_strerror(g_ao));
+            } else {
+                printf("[AUDIO] 音频格式: %ld Hz, %d 声道\n", rate, channels);
+            }
+        }
+        if (done > 0 && g_started) {
+            out123_play(g_ao, g_pcm, done);
+        }
+        if (ret == MPG123_NEED_MORE || ret == MPG123_DONE) break;
+        if (ret == MPG123_ERR) {
+            fprintf(stderr, "[AUDIO] 解码错误: %s\n", mpg123_strerror(g_mh));
+            break;
+        }
+    }
+}
+
+// 换台时调用: 丢弃设备中待播PCM并重置解码器输入
+void audio_flush(void) {
+    if (!g_mh || !g_ao) return;
+    if (g_started) out123_drop(g_ao);
+    mpg123_close(g_mh);
+    mpg123_open_feed(g_mh);
+}
+
+// 释放解码器与音频设备
+void audio_close(void) {
+    if (g_ao) {
+        if (g_started) {
+            out123_drop(g_ao);
+            out123_stop(g_ao);
+        }
+        out123_close(g_ao);
+        out123_del(g_ao);
+        g_ao = NULL;
+    }
+    g_started = 0;
+    if (g_mh) {
+        mpg123_close(g_mh);
+        mpg123_delete(g_mh);
+        g_mh = NULL;
+    }
+}
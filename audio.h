@@ -0,0 +1,18 @@
+#ifndef __AUDIO_H__
+#define __AUDIO_H__
+
+#include <stddef.h>
+
+// 进程内MP3解码与PCM输出 (libmpg123 + libout123)
+// 编译客户端时需链接: -lmpg123 -lout123
+
+#define AUDIO_DEVICE_BUFFER 0.05    // 声卡缓冲时长(秒), 即换台后可闻的延迟上限
+#define AUDIO_PCM_CHUNK     16384   // 每次解码输出的PCM块大小(字节)
+
+// 函数声明
+int audio_init(void);                               // 创建解码器并打开默认音频设备
+void audio_feed(const void *data, size_t len);      // 送入MP3数据, 解码并写入音频设备
+void audio_flush(void);                             // 丢弃解码器与设备中尚未播放的数据
+void audio_close(void);                             // 释放解码器与音频设备
+
+#endif /* __AUDIO_H__ */
@@ -0,0 +1,629 @@
+// 回环组播基准测试工具
+// 生成可配置规模/码率的合成MP3媒体库, 以临时 MEDIA_LIB_PATH 启动服务器,
+// 在回环接口上接收组播, 统计包速率、码率精度、发送抖动、CPU与内存,
+// 结果以 JSON 输出便于多次运行之间对比.
+//
+// 编译: gcc -O2 -o bench bench.c -lpthread -lm
+// 示例: ./bench -s ./main -c 1,10,100,200 -k 128 -d 10 -o result.json
+//       ./bench -c 4 -x "-t"   对比内核节拍(SO_TXTIME)下的包间隔抖动
+//       ./bench -c 4 -r "-G 1:25 -d 20 -j 5 -s 7"   经损伤中继接收, 比较连续性与中断时长
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+#include <math.h>
+#include <ftw.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "server.h"
+
+#define BENCH_MAX_COUNTS   16
+#define BENCH_MAX_CHN      1024           // 统计用的频道ID上限
+#define BENCH_SAMPLE_RATE  48000          // 48kHz下各标准码率的帧长均为整数
+#define BENCH_FRAME_SAMPLES 1152          // MPEG-1 Layer III 每帧采样数
+#define BENCH_RECV_BUF     (64 * 1024)
+#define BENCH_MAX_SAMPLES  (1 << 20)      // 抖动样本上限
+
+// 基准参数
+typedef struct {
+    const char *server;       // 服务器可执行文件
+    const char *ifaddr;       // 回环接口地址
+    const char *out_path;     // JSON输出文件, NULL为标准输出
+    const char *extra_args;   // 透传给服务器的附加参数
+    const char *relay;        // 损伤中继可执行文件
+    const char *relay_args;   // 非 NULL 时经损伤中继接收, 参数透传给中继
+    int counts[BENCH_MAX_COUNTS];
+    int ncounts;
+    int files_per_chn;        // 每频道文件数
+    int file_seconds;         // 每个文件时长(秒)
+    int bitrate_kbps;         // 合成文件码率
+    int warmup;               // 预热秒数
+    int duration;             // 测量秒数
+} bench_opts_t;
+
+// 单频道接收统计
+typedef struct {
+    uint64_t packets;
+    uint64_t bytes;             // 数据报总字节数 (含包头)
+    uint64_t payload_bytes;     // 音频数据字节数 (不含包头, 不含FEC/目录包)
+    struct timespec last;
+    // 连续性: 按序列号统计丢包与重复/乱序, 按媒体时间估算播放中断
+    int have_seq;
+    uint32_t last_seq;          // 已收到的最大序列号
+    uint64_t seen;              // 位i: 序列号 last_seq-i 已收到
+    double last_media_us;       // last_seq 包的媒体时间
+    double step_us;             // 相邻包媒体时间差的平滑值(单包时长)
+    uint64_t lost;
+    uint64_t gaps;              // 丢包段数
+    uint64_t max_gap;           // 最长连续丢包数
+    uint64_t duplicates;
+    uint64_t reordered;         // 晚到但补上了缺口的包
+    double interrupt_us;        // 丢包段对应的媒体时长之和
+    double interrupt_max_us;
+} bench_chn_stat_t;
+
+// 一轮测量结果
+typedef struct {
+    int channels;
+    int channels_active;
+    uint64_t packets;
+    uint64_t bytes;
+    uint64_t payload_bytes;
+    double pps;
+    double egress_bps;          // 含包头的出口码率
+    double payload_bps;         // 音频数据码率, 与合成文件码率对比
+    double target_bps;
+    double accuracy;
+    double jitter_mean_us;
+    double jitter_stddev_us;
+    double jitter_p99_us;
+    double cpu_pct;
+    long rss_kb;
+    long hwm_kb;
+    int threads;
+    uint64_t lost;
+    uint64_t gaps;
+    uint64_t max_gap;
+    uint64_t duplicates;
+    uint64_t reordered;
+    double interrupt_ms;
+    double interrupt_max_ms;
+} bench_result_t;
+
+// 接收线程共享状态
+typedef struct {
+    int sockfd;
+    volatile int running;
+    volatile int measuring;
+    bench_chn_stat_t chn[BENCH_MAX_CHN];
+    double *dev_us;           // 相邻包间隔样本(微秒)
+    size_t ndev;
+} bench_recv_t;
+
+static double ts_diff_us(const struct timespec *a, const struct timespec *b) {
+    return (a->tv_sec - b->tv_sec) * 1e6 + (a->tv_nsec - b->tv_nsec) / 1e3;
+}
+
+// 写一个合成MP3文件: MPEG-1 Layer III, 48kHz, 立体声, 帧体全零(静音)
+static int write_synthetic_mp3(const char *path, int bitrate_kbps, int seconds) {
+    static const int br_table[] = {0, 32, 40, 48, 56, 64, 80, 96, 112, 128,
+                                   160, 192, 224, 256, 320};
+    int br_idx = -1;
+    for (int i = 1; i < (int)(sizeof(br_table) / sizeof(br_table[0])); i++) {
+        if (br_table[i] == bitrate_kbps) br_idx = i;
+    }
+    if (br_idx < 0) {
+        fprintf(stderr, "[BENCH] 不支持的码率: %d kbps\n", bitrate_kbps);
+        return -1;
+    }
+
+    int frame_len = 144 * bitrate_kbps * 1000 / BENCH_SAMPLE_RATE;
+    long nframes = (long)seconds * BENCH_SAMPLE_RATE / BENCH_FRAME_SAMPLES;
+    unsigned char *frame = calloc(1, frame_len);
+    if (!frame) return -1;
+    // 同步字 0xFFF, MPEG-1, Layer III, 无CRC; 码率索引; 采样率索引1(48kHz); 立体声
+    frame[0] = 0xFF;
+    frame[1] = 0xFB;
+    frame[2] = (unsigned char)((br_idx << 4) | (1 << 2));
+    frame[3] = 0x00;
+
+    FILE *fp = fopen(path, "wb");
+    if (!fp) {
+        fprintf(stderr, "[BENCH] 创建 %s 失败: %s\n", path, strerror(errno));
+        free(frame);
+        return -1;
+    }
+    for (long i = 0; i < nframes; i++) {
+        if (fwrite(frame, 1, frame_len, fp) != (size_t)frame_len) {
+            fclose(fp);
+            free(frame);
+            return -1;
+        }
+    }
+    free(frame);
+    return fclose(fp);
+}
+
+// 生成 nchn 个频道的合成媒体库
+static int build_library(const char *root, const bench_opts_t *o, int nchn) {
+    char path[PATH_MAX];
+    for (int c = 0; c < nchn; c++) {
+        snprintf(path, sizeof(path), "%s/chn%04d", root, c);
+        if (mkdir(path, 0755) < 0) return -1;
+        snprintf(path, sizeof(path), "%s/chn%04d/%s", root, c, CHN_DESCR_NAME);
+        FILE *fp = fopen(path, "w");
+        if (!fp) return -1;
+        fprintf(fp, "bench channel %d\n", c);
+        fclose(fp);
+        for (int f = 0; f < o->files_per_chn; f++) {
+            snprintf(path, sizeof(path), "%s/chn%04d/%03d.mp3", root, c, f);
+            if (write_synthetic_mp3(path, o->bitrate_kbps, o->file_seconds) < 0)
+                return -1;
+        }
+    }
+    return 0;
+}
+
+static int rm_entry(const char *path, const struct stat *st, int flag, struct FTW *ftw) {
+    (void)st; (void)flag; (void)ftw;
+    return remove(path);
+}
+
+static void remove_tree(const char *root) {
+    nftw(root, rm_entry, 16, FTW_DEPTH | FTW_PHYS);
+}
+
+// 启动服务器, 标准输出/错误重定向到 /dev/null
+static pid_t start_server(const bench_opts_t *o, const char *lib_path) {
+    pid_t pid = fork();
+    if (pid < 0) return -1;
+    if (pid == 0) {
+        int devnull = open("/dev/null", O_WRONLY);
+        if (devnull >= 0) {
+            dup2(devnull, STDOUT_FILENO);
+            dup2(devnull, STDERR_FILENO);
+            close(devnull);
+        }
+        setenv("MEDIA_LIB_PATH", lib_path, 1);
+
+        char *argv[64];
+        int argc = 0;
+        char *extra = o->extra_args ? strdup(o->extra_args) : NULL;
+        argv[argc++] = (char *)o->server;
+        argv[argc++] = "-i";
+        argv[argc++] = (char *)o->ifaddr;
+        for (char *tok = extra ? strtok(extra, " ") : NULL; tok && argc < 63;
+             tok = strtok(NULL, " ")) {
+            argv[argc++] = tok;
+        }
+        argv[argc] = NULL;
+        execv(o->server, argv);
+        _exit(127);
+    }
+    return pid;
+}
+
+// 启动损伤中继, 转发到 RELAY_GROUP:RELAY_PORT, 标准输出重定向到 /dev/null
+static pid_t start_relay(const bench_opts_t *o) {
+    pid_t pid = fork();
+    if (pid < 0) return -1;
+    if (pid == 0) {
+        int devnull = open("/dev/null", O_WRONLY);
+        if (devnull >= 0) {
+            dup2(devnull, STDOUT_FILENO);
+            close(devnull);
+        }
+        char group[64];
+        snprintf(group, sizeof(group), "%s:%d", RELAY_GROUP, RELAY_PORT);
+        char *argv[64];
+        int argc = 0;
+        char *extra = strdup(o->relay_args);
+        argv[argc++] = (char *)o->relay;
+        argv[argc++] = "-i";
+        argv[argc++] = (char *)o->ifaddr;
+        argv[argc++] = "-g";
+        argv[argc++] = group;
+        for (char *tok = extra ? strtok(extra, " ") : NULL; tok && argc < 63;
+             tok = strtok(NULL, " ")) {
+            argv[argc++] = tok;
+        }
+        argv[argc] = NULL;
+        execv(o->relay, argv);
+        _exit(127);
+    }
+    return pid;
+}
+
+// 读取 /proc/<pid>/stat 中的 utime+stime (时钟滴答)
+static long long proc_cpu_ticks(pid_t pid) {
+    char path[64], buf[1024];
+    snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+    FILE *fp = fopen(path, "r");
+    if (!fp) return -1;
+    size_t n = fread(buf, 1, sizeof(buf) - 1, fp);
+    fclose(fp);
+    buf[n] = '\0';
+    // comm 字段可能含空格, 从最后一个 ')' 之后开始解析
+    char *p = strrchr(buf, ')');
+    if (!p) return -1;
+    unsigned long long utime = 0, stime = 0;
+    if (sscanf(p + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %llu %llu",
+               &utime, &stime) != 2)
+        return -1;
+    return (long long)(utime + stime);
+}
+
+// 读取 /proc/<pid>/status 中的内存与线程数
+static void proc_mem(pid_t pid, bench_result_t *r) {
+    char path[64], line[256];
+    snprintf(path, sizeof(path), "/proc/%d/status", pid);
+    FILE *fp = fopen(path, "r");
+    if (!fp) return;
+    while (fgets(line, sizeof(line), fp)) {
+        sscanf(line, "VmRSS: %ld", &r->rss_kb);
+        sscanf(line, "VmHWM: %ld", &r->hwm_kb);
+        sscanf(line, "Threads: %d", &r->threads);
+    }
+    fclose(fp);
+}
+
+static int open_receiver(const char *ifaddr, const char *group, int port) {
+    int sockfd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (sockfd < 0) return -1;
+    int reuse = 1;
+    setsockopt(sockfd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    int rcvbuf = 32 * 1024 * 1024;
+    // 先按普通上限设置, 有 CAP_NET_ADMIN 时再突破 rmem_max
+    setsockopt(sockfd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    setsockopt(sockfd, SOL_SOCKET, SO_RCVBUFFORCE, &rcvbuf, sizeof(rcvbuf));
+
+    struct sockaddr_in addr = {0};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(port);
+    if (bind(sockfd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        close(sockfd);
+        return -1;
+    }
+
+    struct ip_mreq mreq;
+    mreq.imr_multiaddr.s_addr = inet_addr(group);
+    mreq.imr_interface.s_addr = inet_addr(ifaddr);
+    if (setsockopt(sockfd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) < 0) {
+        close(sockfd);
+        return -1;
+    }
+    struct timeval tv = {0, 200000};
+    setsockopt(sockfd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    return sockfd;
+}
+
+// 记录一个包的序列号与媒体时间
+static void track_continuity(bench_chn_stat_t *cs, const pkt_info_t *hdr) {
+    double media_us = (double)hdr->media_ts * 1e6 / hdr->sample_rate;
+    if (!cs->have_seq) {
+        cs->have_seq = 1;
+        cs->last_seq = hdr->seq_num;
+        cs->seen = 1;
+        cs->last_media_us = media_us;
+        return;
+    }
+    int32_t d = (int32_t)(hdr->seq_num - cs->last_seq);
+    if (d <= 0) {
+        // 落在窗口内: 已收到过是重复, 否则补上了之前记为丢失的缺口
+        uint32_t k = (uint32_t)-d;
+        if (k >= 64) {
+            cs->duplicates++;
+        } else if (cs->seen & (1ULL << k)) {
+            cs->duplicates++;
+        } else {
+            cs->seen |= 1ULL << k;
+            cs->lost--;
+            cs->reordered++;
+        }
+        return;
+    }
+    double step = media_us - cs->last_media_us;
+    if (d > 1) {
+        // 丢包段: 两端包的媒体时间差减去一个包的时长即为缺失的音频
+        cs->lost += (uint64_t)(d - 1);
+        cs->gaps++;
+        if ((uint64_t)(d - 1) > cs->max_gap) cs->max_gap = (uint64_t)(d - 1);
+        double missing = cs->step_us > 0 ? step - cs->step_us : step * (d - 1) / d;
+        if (missing > 0) {
+            cs->interrupt_us += missing;
+            if (missing > cs->interrupt_max_us) cs->interrupt_max_us = missing;
+        }
+    } else if (step > 0) {
+        cs->step_us = cs->step_us > 0 ? cs->step_us * 0.9 + step * 0.1 : step;
+    }
+    cs->seen = (d < 64 ? cs->seen << d : 0) | 1;
+    cs->last_seq = hdr->seq_num;
+    cs->last_media_us = media_us;
+}
+
+static void *recv_thread(void *arg) {
+    bench_recv_t *rx = arg;
+    char *buf = malloc(BENCH_RECV_BUF);
+    if (!buf) return NULL;
+
+    while (rx->running) {
+        ssize_t n = recv(rx->sockfd, buf, BENCH_RECV_BUF, 0);
+        pkt_info_t hdr;
+        if (n < 0 || !rx->measuring || proto_hdr_parse(buf, (size_t)n, &hdr) != 0) continue;
+
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        uint16_t chnid = hdr.channel_id;
+        if (chnid >= BENCH_MAX_CHN) continue;
+
+        bench_chn_stat_t *cs = &rx->chn[chnid];
+        if (cs->packets > 0 && rx->ndev < BENCH_MAX_SAMPLES) {
+            rx->dev_us[rx->ndev++] = ts_diff_us(&now, &cs->last);
+        }
+        cs->last = now;
+        cs->packets++;
+        cs->bytes += (uint64_t)n;
+        if (hdr.data_len > 0 && hdr.sample_rate > 0 && !(hdr.flags & (PKT_F_FEC | PKT_F_DIR))) {
+            cs->payload_bytes += hdr.data_len;
+            track_continuity(cs, &hdr);
+        }
+    }
+    free(buf);
+    return NULL;
+}
+
+static int cmp_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// 对单个频道数执行一轮测量
+static int run_one(const bench_opts_t *o, int nchn, bench_recv_t *rx, bench_result_t *r) {
+    char root[] = "/tmp/mcast_bench.XXXXXX";
+    if (!mkdtemp(root)) {
+        perror("[BENCH] mkdtemp");
+        return -1;
+    }
+    memset(r, 0, sizeof(*r));
+    r->channels = nchn;
+
+    if (build_library(root, o, nchn) < 0) {
+        fprintf(stderr, "[BENCH] 生成媒体库失败\n");
+        remove_tree(root);
+        return -1;
+    }
+
+    memset(rx->chn, 0, sizeof(rx->chn));
+    rx->ndev = 0;
+
+    pid_t relay_pid = o->relay_args ? start_relay(o) : 0;
+    if (relay_pid < 0) {
+        remove_tree(root);
+        return -1;
+    }
+    pid_t pid = start_server(o, root);
+    if (pid < 0) {
+        if (relay_pid > 0) kill(relay_pid, SIGTERM);
+        remove_tree(root);
+        return -1;
+    }
+    sleep(o->warmup);
+
+    long hz = sysconf(_SC_CLK_TCK);
+    long long cpu0 = proc_cpu_ticks(pid);
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    rx->measuring = 1;
+    sleep(o->duration);
+    rx->measuring = 0;
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    usleep(100000);  // 等待接收线程处理完在途数据包
+    long long cpu1 = proc_cpu_ticks(pid);
+    proc_mem(pid, r);
+
+    kill(pid, SIGTERM);
+    waitpid(pid, NULL, 0);
+    if (relay_pid > 0) {
+        kill(relay_pid, SIGTERM);
+        waitpid(relay_pid, NULL, 0);
+    }
+    remove_tree(root);
+
+    double secs = ts_diff_us(&t1, &t0) / 1e6;
+    for (int c = 0; c < BENCH_MAX_CHN; c++) {
+        if (rx->chn[c].packets == 0) continue;
+        r->channels_active++;
+        r->packets += rx->chn[c].packets;
+        r->bytes += rx->chn[c].bytes;
+        r->payload_bytes += rx->chn[c].payload_bytes;
+        r->lost += rx->chn[c].lost;
+        r->gaps += rx->chn[c].gaps;
+        r->duplicates += rx->chn[c].duplicates;
+        r->reordered += rx->chn[c].reordered;
+        r->interrupt_ms += rx->chn[c].interrupt_us / 1000.0;
+        if (rx->chn[c].max_gap > r->max_gap) r->max_gap = rx->chn[c].max_gap;
+        if (rx->chn[c].interrupt_max_us / 1000.0 > r->interrupt_max_ms) {
+            r->interrupt_max_ms = rx->chn[c].interrupt_max_us / 1000.0;
+        }
+    }
+    r->pps = r->packets / secs;
+    r->egress_bps = r->bytes * 8.0 / secs;
+    r->payload_bps = r->payload_bytes * 8.0 / secs;
+    r->target_bps = (double)nchn * o->bitrate_kbps * 1000.0;
+    r->accuracy = r->target_bps > 0 ? r->payload_bps / r->target_bps : 0;
+    if (cpu0 >= 0 && cpu1 >= 0) {
+        r->cpu_pct = (double)(cpu1 - cpu0) / hz / secs * 100.0;
+    }
+
+    // 抖动: 包间隔相对其均值的偏差
+    if (r->channels_active != nchn) {
+        fprintf(stderr, "[BENCH] 频道数 %d: 只有 %d 个频道有数据, 本轮无效\n", nchn, r->channels_active);
+    }
+    if (rx->ndev > 0) {
+        double sum = 0;
+        for (size_t i = 0; i < rx->ndev; i++) sum += rx->dev_us[i];
+        double mean = sum / rx->ndev, var = 0;
+        for (size_t i = 0; i < rx->ndev; i++) {
+            double d = rx->dev_us[i] - mean;
+            var += d * d;
+            rx->dev_us[i] = fabs(d);
+        }
+        qsort(rx->dev_us, rx->ndev, sizeof(double), cmp_double);
+        r->jitter_mean_us = mean;
+        r->jitter_stddev_us = sqrt(var / rx->ndev);
+        r->jitter_p99_us = rx->dev_us[(size_t)(rx->ndev * 0.99)];
+    }
+    return 0;
+}
+
+static void print_json(FILE *fp, const bench_opts_t *o, const bench_result_t *res, int n) {
+    time_t now = time(NULL);
+    fprintf(fp, "{\n  \"bench\": \"loopback_multicast\",\n  \"timestamp\": %ld,\n", (long)now);
+    fprintf(fp, "  \"params\": {\"server\": \"%s\", \"ifaddr\": \"%s\", \"files_per_channel\": %d, "
+                "\"file_seconds\": %d, \"bitrate_kbps\": %d, \"warmup_s\": %d, \"duration_s\": %d, "
+                "\"relay_args\": \"%s\"},\n",
+            o->server, o->ifaddr, o->files_per_chn, o->file_seconds, o->bitrate_kbps,
+            o->warmup, o->duration, o->relay_args ? o->relay_args : "");
+    fprintf(fp, "  \"runs\": [\n");
+    for (int i = 0; i < n; i++) {
+        const bench_result_t *r = &res[i];
+        fprintf(fp, "    {\"channels\": %d, \"channels_active\": %d, \"ok\": %s, \"packets\": %llu, "
+                    "\"bytes\": %llu, \"payload_bytes\": %llu, \"pps\": %.1f, \"egress_bps\": %.0f, "
+                    "\"payload_bps\": %.0f, \"target_bps\": %.0f, \"payload_accuracy\": %.4f, "
+                    "\"interval_us\": {\"mean\": %.1f, \"stddev\": %.1f, \"jitter_p99\": %.1f}, "
+                    "\"cpu_pct\": %.2f, \"cpu_pct_per_channel\": %.4f, "
+                    "\"rss_kb\": %ld, \"hwm_kb\": %ld, \"threads\": %d, "
+                    "\"continuity\": {\"lost\": %llu, \"loss_pct\": %.3f, \"gaps\": %llu, \"max_gap\": %llu, "
+                    "\"duplicates\": %llu, \"reordered\": %llu, \"interrupt_ms\": %.1f, "
+                    "\"interrupt_max_ms\": %.1f}}%s\n",
+                r->channels, r->channels_active, r->channels_active == r->channels ? "true" : "false",
+                (unsigned long long)r->packets, (unsigned long long)r->bytes,
+                (unsigned long long)r->payload_bytes, r->pps, r->egress_bps, r->payload_bps, r->target_bps,
+                r->accuracy, r->jitter_mean_us, r->jitter_stddev_us, r->jitter_p99_us,
+                r->cpu_pct, r->channels_active ? r->cpu_pct / r->channels_active : 0.0,
+                r->rss_kb, r->hwm_kb, r->threads, (unsigned long long)r->lost,
+                r->packets + r->lost ? r->lost * 100.0 / (r->packets + r->lost) : 0.0,
+                (unsigned long long)r->gaps, (unsigned long long)r->max_gap,
+                (unsigned long long)r->duplicates, (unsigned long long)r->reordered,
+                r->interrupt_ms, r->interrupt_max_ms, i + 1 < n ? "," : "");
+    }
+    fprintf(fp, "  ]\n}\n");
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "用法: %s [选项]\n"
+            "  -s 路径     服务器可执行文件 (默认 ./main)\n"
+            "  -c 列表     频道数列表, 逗号分隔 (默认 1,10,100,200; 不超过服务器上限 %d)\n"
+            "  -f 数量     每频道文件数 (默认 2)\n"
+            "  -l 秒       每文件时长 (默认 30)\n"
+            "  -k kbps     合成文件码率 (默认 128)\n"
+            "  -w 秒       预热时间 (默认 2)\n"
+            "  -d 秒       每轮测量时间 (默认 10)\n"
+            "  -i 地址     回环接口地址 (默认 127.0.0.1)\n"
+            "  -x 参数     透传给服务器的附加参数\n"
+            "  -r 参数     经损伤中继接收, 参数透传给中继 (如 \"-G 1:25 -s 7\")\n"
+            "  -R 路径     损伤中继可执行文件 (默认 ./relay)\n"
+            "  -o 文件     JSON输出文件 (默认标准输出)\n",
+            prog, MAXCHN_NR);
+}
+
+int main(int argc, char *argv[]) {
+    bench_opts_t o = {
+        .server = "./main",
+        .ifaddr = "127.0.0.1",
+        .counts = {1, 10, 100, MAXCHN_NR},
+        .ncounts = 4,
+        .files_per_chn = 2,
+        .file_seconds = 30,
+        .bitrate_kbps = 128,
+        .warmup = 2,
+        .duration = 10,
+        .relay = "./relay",
+    };
+    int opt;
+    while ((opt = getopt(argc, argv, "s:c:f:l:k:w:d:i:x:r:R:o:h")) != -1) {
+        switch (opt) {
+        case 's': o.server = optarg; break;
+        case 'c':
+            o.ncounts = 0;
+            for (char *tok = strtok(optarg, ","); tok && o.ncounts < BENCH_MAX_COUNTS;
+                 tok = strtok(NULL, ",")) {
+                int c = atoi(tok);
+                // 媒体库最多加载 MAXCHN_NR 个频道, 更多的频道不会有数据
+                if (c > MAXCHN_NR) {
+                    fprintf(stderr, "[BENCH] 频道数 %d 超过服务器上限, 按 %d 测量\n", c, MAXCHN_NR);
+                    c = MAXCHN_NR;
+                }
+                if (c > 0) o.counts[o.ncounts++] = c;
+            }
+            break;
+        case 'f': o.files_per_chn = atoi(optarg); break;
+        case 'l': o.file_seconds = atoi(optarg); break;
+        case 'k': o.bitrate_kbps = atoi(optarg); break;
+        case 'w': o.warmup = atoi(optarg); break;
+        case 'd': o.duration = atoi(optarg); break;
+        case 'i': o.ifaddr = optarg; break;
+        case 'x': o.extra_args = optarg; break;
+        case 'r': o.relay_args = optarg; break;
+        case 'R': o.relay = optarg; break;
+        case 'o': o.out_path = optarg; break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    bench_recv_t *rx = calloc(1, sizeof(*rx));
+    if (!rx) return 1;
+    rx->dev_us = malloc(sizeof(double) * BENCH_MAX_SAMPLES);
+    // 经中继时只收测试组, 中继在各轮测量中与服务器一起启停
+    rx->sockfd = o.relay_args ? open_receiver(o.ifaddr, RELAY_GROUP, RELAY_PORT)
+                              : open_receiver(o.ifaddr, GROUP_IP, RCV_PORT);
+    if (!rx->dev_us || rx->sockfd < 0) {
+        fprintf(stderr, "[BENCH] 初始化接收端失败: %s\n", strerror(errno));
+        return 1;
+    }
+    rx->running = 1;
+    pthread_t tid;
+    pthread_create(&tid, NULL, recv_thread, rx);
+
+    bench_result_t res[BENCH_MAX_COUNTS];
+    int nres = 0, failed = 0;
+    for (int i = 0; i < o.ncounts; i++) {
+        fprintf(stderr, "[BENCH] 频道数 %d ...\n", o.counts[i]);
+        if (run_one(&o, o.counts[i], rx, &res[nres]) != 0) {
+            failed++;
+            continue;
+        }
+        if (res[nres].channels_active != res[nres].channels) failed++;
+        nres++;
+    }
+
+    rx->running = 0;
+    pthread_join(tid, NULL);
+    close(rx->sockfd);
+
+    FILE *out = stdout;
+    if (o.out_path && !(out = fopen(o.out_path, "w"))) {
+        perror("[BENCH] 打开输出文件失败");
+        return 1;
+    }
+    print_json(out, &o, res, nres);
+    if (out != stdout) fclose(out);
+    free(rx->dev_us);
+    free(rx);
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,417 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <syslog.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/random.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "burst.h"
+#include "presence.h"
+#include "handoff.h"
+
+static burst_ring_t g_rings[BURST_MAX_CHN];
+static pthread_once_t g_rings_once = PTHREAD_ONCE_INIT;
+static int g_burst_sockfd = -1;
+static pthread_t g_burst_tid;
+static int g_notify_fd = -1;        // 有新包时通知单播事件循环
+
+// 请求验证与限速状态, 只由补发服务线程访问
+typedef struct burst_peer {
+    uint32_t ip;
+    uint16_t port;
+    uint16_t tokens;        // 剩余补发次数
+    int64_t refill_ms;      // 上次补充额度的时间, 0 表示空表项
+} burst_peer_t;
+
+static uint8_t g_cookie_key[16];
+static burst_peer_t g_peers[BURST_PEER_SLOTS];
+static int64_t g_window_start;
+static int g_window_count;
+static int g_window_dropped;
+
+static void burst_rings_init(void) {
+    for (int i = 0; i < BURST_MAX_CHN; i++) {
+        pthread_mutex_init(&g_rings[i].mutex, NULL);
+    }
+}
+
+static burst_ring_t *burst_ring(chnid_t chnid) {
+    pthread_once(&g_rings_once, burst_rings_init);
+    return &g_rings[chnid];
+}
+
+// 释放一个引用, 最后一个引用释放内存
+void burst_buf_put(burst_buf_t *buf) {
+    if (buf && __atomic_sub_fetch(&buf->refs, 1, __ATOMIC_ACQ_REL) == 0) {
+        free(buf);
+    }
+}
+
+void burst_set_notify(int efd) {
+    g_notify_fd = efd;
+}
+
+// 丢弃最旧的包 (调用者持有锁)
+static void burst_evict(burst_ring_t *ring) {
+    burst_pkt_t *old = &ring->slots[ring->tail % BURST_SLOTS];
+    ring->bytes -= old->buf->len;
+    burst_buf_put(old->buf);
+    old->buf = NULL;
+    ring->tail++;
+}
+
+// 丢弃频道缓冲中的全部数据包
+void burst_clear(chnid_t chnid) {
+    burst_ring_t *ring = burst_ring(chnid);
+    pthread_mutex_lock(&ring->mutex);
+    while (ring->tail < ring->head) burst_evict(ring);
+    pthread_mutex_unlock(&ring->mutex);
+}
+
+// 记录一个已发送的数据包
+void burst_push(chnid_t chnid, const void *pkt, size_t len, uint32_t seq, int sync_off) {
+    burst_ring_t *ring = burst_ring(chnid);
+    burst_buf_t *buf = malloc(sizeof(*buf) + len);
+    if (!buf) return;
+    buf->refs = 1;
+    buf->len = len;
+    memcpy(buf->data, pkt, len);
+
+    pthread_mutex_lock(&ring->mutex);
+    while (ring->head - ring->tail >= BURST_SLOTS ||
+           (ring->head > ring->tail && ring->bytes + len > BURST_MAX_BYTES)) {
+        burst_evict(ring);
+    }
+    burst_pkt_t *slot = &ring->slots[ring->head % BURST_SLOTS];
+    slot->seq = seq;
+    slot->sync_off = sync_off;
+    slot->buf = buf;
+    clock_gettime(CLOCK_MONOTONIC, &slot->ts);
+    ring->bytes += len;
+    ring->head++;
+    pthread_mutex_unlock(&ring->mutex);
+
+    if (g_notify_fd >= 0) {
+        uint64_t one = 1;
+        ssize_t ret = write(g_notify_fd, &one, sizeof(one));
+        (void)ret;
+    }
+}
+
+// 取出序号为 pos 的包并增加引用
+int burst_peek(chnid_t chnid, uint64_t pos, burst_pkt_t *out) {
+    burst_ring_t *ring = burst_ring(chnid);
+    int ret = 1;
+    pthread_mutex_lock(&ring->mutex);
+    if (pos < ring->tail) {
+        ret = -1;
+    } else if (pos >= ring->head) {
+        ret = 0;
+    } else {
+        *out = ring->slots[pos % BURST_SLOTS];
+        __atomic_add_fetch(&out->buf->refs, 1, __ATOMIC_RELAXED);
+    }
+    pthread_mutex_unlock(&ring->mutex);
+    return ret;
+}
+
+// 时间窗口内最旧的同步点 (调用者持有锁); 没有则返回 head
+static uint64_t burst_join_point_locked(burst_ring_t *ring) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    for (uint64_t i = ring->tail; i < ring->head; i++) {
+        burst_pkt_t *p = &ring->slots[i % BURST_SLOTS];
+        if (now.tv_sec - p->ts.tv_sec <= BURST_SECONDS && p->sync_off >= 0) {
+            return i;
+        }
+    }
+    return ring->head;
+}
+
+uint64_t burst_join_point(chnid_t chnid) {
+    burst_ring_t *ring = burst_ring(chnid);
+    pthread_mutex_lock(&ring->mutex);
+    uint64_t pos = burst_join_point_locked(ring);
+    pthread_mutex_unlock(&ring->mutex);
+    return pos;
+}
+
+// 最新的同步点; 没有则返回 head
+uint64_t burst_latest_sync(chnid_t chnid) {
+    burst_ring_t *ring = burst_ring(chnid);
+    pthread_mutex_lock(&ring->mutex);
+    uint64_t pos = ring->head;
+    for (uint64_t i = ring->head; i > ring->tail; i--) {
+        if (ring->slots[(i - 1) % BURST_SLOTS].sync_off >= 0) {
+            pos = i - 1;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&ring->mutex);
+    return pos;
+}
+
+uint64_t burst_head(chnid_t chnid) {
+    burst_ring_t *ring = burst_ring(chnid);
+    pthread_mutex_lock(&ring->mutex);
+    uint64_t head = ring->head;
+    pthread_mutex_unlock(&ring->mutex);
+    return head;
+}
+
+// 向请求者补发频道最近 BURST_SECONDS 秒的数据, 从帧同步点开始, 以空包结束
+static void burst_send(int sockfd, const struct sockaddr_in *peer, chnid_t chnid) {
+    burst_ring_t *ring = burst_ring(chnid);
+
+    // 在锁内只取引用, 避免阻塞频道发送任务
+    burst_pkt_t snap[BURST_SLOTS];
+    int count = 0;
+    pthread_mutex_lock(&ring->mutex);
+    for (uint64_t i = burst_join_point_locked(ring); i < ring->head; i++) {
+        snap[count] = ring->slots[i % BURST_SLOTS];
+        __atomic_add_fetch(&snap[count].buf->refs, 1, __ATOMIC_RELAXED);
+        count++;
+    }
+    pthread_mutex_unlock(&ring->mutex);
+
+    uint32_t last_seq = 0;
+    for (int i = 0; i < count; i++) {
+        const char *pkt = snap[i].buf->data;
+        size_t len = snap[i].buf->len;
+        struct iovec iov[2];
+        pkt_hdr_t header;
+        memcpy(&header, pkt, sizeof(header));
+        // 第一个包裁掉同步点之前的残帧
+        size_t skip = (i == 0 && snap[i].sync_off > 0) ? (size_t)snap[i].sync_off : 0;
+        if (skip > 0) {
+            header.data_len = htonl(ntohl(header.data_len) - skip);
+            header.flags |= PKT_F_SYNC;
+        }
+        iov[0].iov_base = &header;
+        iov[0].iov_len = sizeof(header);
+        iov[1].iov_base = (char *)pkt + sizeof(header) + skip;
+        iov[1].iov_len = len - sizeof(header) - skip;
+
+        struct msghdr msg = {0};
+        msg.msg_name = (void *)peer;
+        msg.msg_namelen = sizeof(*peer);
+        msg.msg_iov = iov;
+        msg.msg_iovlen = 2;
+        if (sendmsg(sockfd, &msg, 0) < 0) {
+            fprintf(stderr, "[Burst] 补发失败 频道%d: %s\n", chnid, strerror(errno));
+        }
+        last_seq = snap[i].seq;
+        burst_buf_put(snap[i].buf);
+    }
+
+    // 结束标记: data_len 为 0, seq 为补发的最后一个序列号
+    pkt_hdr_t end;
+    proto_hdr_fill(&end, chnid, last_seq, 0, 0, 0, 0, 0);
+    sendto(sockfd, &end, sizeof(end), 0, (const struct sockaddr *)peer, sizeof(*peer));
+    printf("[Burst] 频道%d 向 %s 补发 %d 个包\n", chnid, inet_ntoa(peer->sin_addr), count);
+}
+
+static int64_t mono_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// SipHash-2-4: 以进程启动时的随机密钥计算验证码, 旁路攻击者无法替别的地址算出
+#define SIP_ROTL(x, b) (uint64_t)(((x) << (b)) | ((x) >> (64 - (b))))
+#define SIP_ROUND(v0, v1, v2, v3)                                                         \
+    do {                                                                                  \
+        v0 += v1; v1 = SIP_ROTL(v1, 13); v1 ^= v0; v0 = SIP_ROTL(v0, 32);                 \
+        v2 += v3; v3 = SIP_ROTL(v3, 16); v3 ^= v2;                                        \
+        v0 += v3; v3 = SIP_ROTL(v3, 21); v3 ^= v0;                                        \
+        v2 += v1; v1 = SIP_ROTL(v1, 17); v1 ^= v2; v2 = SIP_ROTL(v2, 32);                 \
+    } while (0)
+
+static uint64_t siphash24(const uint8_t key[16], const uint64_t *in, int nwords) {
+    uint64_t k0, k1;
+    memcpy(&k0, key, 8);
+    memcpy(&k1, key + 8, 8);
+    uint64_t v0 = k0 ^ 0x736f6d6570736575ULL, v1 = k1 ^ 0x646f72616e646f6dULL;
+    uint64_t v2 = k0 ^ 0x6c7967656e657261ULL, v3 = k1 ^ 0x7465646279746573ULL;
+    for (int i = 0; i < nwords; i++) {
+        v3 ^= in[i];
+        SIP_ROUND(v0, v1, v2, v3);
+        SIP_ROUND(v0, v1, v2, v3);
+        v0 ^= in[i];
+    }
+    uint64_t b = (uint64_t)(nwords * 8) << 56;
+    v3 ^= b;
+    SIP_ROUND(v0, v1, v2, v3);
+    SIP_ROUND(v0, v1, v2, v3);
+    v0 ^= b;
+    v2 ^= 0xff;
+    for (int i = 0; i < 4; i++) SIP_ROUND(v0, v1, v2, v3);
+    return v0 ^ v1 ^ v2 ^ v3;
+}
+
+// 地址在某个时间段的验证码, 0 留作"没有验证码"
+static uint32_t burst_cookie(const struct sockaddr_in *peer, int64_t epoch) {
+    uint64_t in[2] = {(uint64_t)peer->sin_addr.s_addr << 16 | peer->sin_port, (uint64_t)epoch};
+    uint32_t cookie = (uint32_t)siphash24(g_cookie_key, in, 2);
+    return cookie ? cookie : 1;
+}
+
+static int burst_cookie_ok(const struct sockaddr_in *peer, uint32_t cookie, int64_t now_ms) {
+    int64_t epoch = now_ms / (BURST_COOKIE_SECS * 1000);
+    return cookie != 0 && (cookie == burst_cookie(peer, epoch) || cookie == burst_cookie(peer, epoch - 1));
+}
+
+// 回复验证码: 应答与请求同样大小, 伪造源地址也得不到放大
+static void burst_challenge(const struct sockaddr_in *peer, uint16_t chnid, int64_t now_ms) {
+    burst_req_t ch;
+    ch.magic = htonl(BURST_MAGIC);
+    ch.channel_id = htons(chnid);
+    ch.version = htons(PROTO_VERSION);
+    ch.cookie = burst_cookie(peer, now_ms / (BURST_COOKIE_SECS * 1000));
+    sendto(g_burst_sockfd, &ch, sizeof(ch), 0, (const struct sockaddr *)peer, sizeof(*peer));
+}
+
+// 限速: 全局窗口未满且该地址还有额度时放行
+static int burst_allow(const struct sockaddr_in *peer, int64_t now_ms) {
+    if (now_ms - g_window_start >= BURST_WINDOW_MS) {
+        if (g_window_dropped > 0) {
+            syslog(LOG_WARNING, "补发请求超出限速, 上一窗口丢弃 %d 个", g_window_dropped);
+        }
+        g_window_start = now_ms;
+        g_window_count = 0;
+        g_window_dropped = 0;
+    }
+    if (g_window_count >= BURST_WINDOW_MAX) {
+        g_window_dropped++;
+        return 0;
+    }
+
+    uint32_t ip = peer->sin_addr.s_addr;
+    uint32_t h = (ip ^ ((uint32_t)peer->sin_port << 16)) * 2654435761u;
+    burst_peer_t *p = &g_peers[h % BURST_PEER_SLOTS];
+    if (p->refill_ms == 0 || p->ip != ip || p->port != peer->sin_port) {
+        p->ip = ip;
+        p->port = peer->sin_port;
+        p->tokens = BURST_PEER_MAX;
+        p->refill_ms = now_ms;
+    } else {
+        int64_t add = (now_ms - p->refill_ms) / BURST_PEER_REFILL_MS;
+        if (add > 0) {
+            p->tokens = p->tokens + add >= BURST_PEER_MAX ? BURST_PEER_MAX : (uint16_t)(p->tokens + add);
+            p->refill_ms += add * BURST_PEER_REFILL_MS;
+        }
+    }
+    if (p->tokens == 0) {
+        g_window_dropped++;
+        return 0;
+    }
+    if (p->tokens == BURST_PEER_MAX) p->refill_ms = now_ms;  // 额度满时不累计空闲时间
+    p->tokens--;
+    g_window_count++;
+    return 1;
+}
+
+static void *burst_service(void *arg) {
+    (void)arg;
+    // 只在等待请求时允许取消, 补发途中被取消会泄漏缓冲引用
+    pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+    while (1) {
+        burst_req_t req;
+        struct sockaddr_in peer;
+        socklen_t peer_len = sizeof(peer);
+        pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
+        ssize_t n = recvfrom(g_burst_sockfd, &req, sizeof(req), 0,
+                             (struct sockaddr *)&peer, &peer_len);
+        pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        // 旧客户端的请求不含验证码字段, 按未验证处理
+        if (n < (ssize_t)offsetof(burst_req_t, cookie) || ntohl(req.magic) != BURST_MAGIC) continue;
+        if (n < (ssize_t)sizeof(req)) req.cookie = 0;
+        uint16_t chnid = ntohs(req.channel_id);
+        if (chnid >= BURST_MAX_CHN) continue;
+
+        int64_t now_ms = mono_ms();
+        if (!burst_cookie_ok(&peer, req.cookie, now_ms)) {
+            burst_challenge(&peer, chnid, now_ms);
+            continue;
+        }
+        if (!burst_allow(&peer, now_ms)) continue;
+        // 补发请求说明有人入台, 被暂停的频道立即恢复
+        presence_touch((chnid_t)chnid, PRESENCE_INTERVAL_MS * PRESENCE_EXPIRE_MULT);
+        burst_send(g_burst_sockfd, &peer, (chnid_t)chnid);
+    }
+    return NULL;
+}
+
+// 热升级: 交出套接字前停掉服务线程, 之后的请求只由新进程应答; 交接失败时重新启动
+static void burst_quiesce(int stop) {
+    if (stop) {
+        pthread_cancel(g_burst_tid);
+        pthread_join(g_burst_tid, NULL);
+    } else if (pthread_create(&g_burst_tid, NULL, burst_service, NULL) != 0) {
+        syslog(LOG_ERR, "热升级失败后无法恢复补发服务线程");
+    }
+}
+
+// 启动单播补发服务线程
+int burst_service_start(int port, struct in_addr ifaddr) {
+    if (getrandom(g_cookie_key, sizeof(g_cookie_key), 0) != (ssize_t)sizeof(g_cookie_key)) {
+        syslog(LOG_ERR, "生成补发验证密钥失败: %s", strerror(errno));
+        return -1;
+    }
+    // 热升级时沿用旧进程已绑定的套接字
+    g_burst_sockfd = handoff_inherit(HANDOFF_FD_BURST);
+    if (g_burst_sockfd < 0) {
+        g_burst_sockfd = socket(AF_INET, SOCK_DGRAM, 0);
+        if (g_burst_sockfd < 0) {
+            syslog(LOG_ERR, "创建补发套接字失败: %s", strerror(errno));
+            return -1;
+        }
+        int sndbuf = 4 * 1024 * 1024;
+        setsockopt(g_burst_sockfd, SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+
+        struct sockaddr_in addr = {0};
+        addr.sin_family = AF_INET;
+        addr.sin_addr = ifaddr;     // 只在组播出口上应答, 未指定出口时为 INADDR_ANY
+        addr.sin_port = htons(port);
+        if (bind(g_burst_sockfd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+            syslog(LOG_ERR, "绑定补发地址 %s:%d 失败: %s", inet_ntoa(ifaddr), port, strerror(errno));
+            close(g_burst_sockfd);
+            g_burst_sockfd = -1;
+            return -1;
+        }
+    }
+    if (pthread_create(&g_burst_tid, NULL, burst_service, NULL) != 0) {
+        close(g_burst_sockfd);
+        g_burst_sockfd = -1;
+        return -1;
+    }
+    handoff_export(HANDOFF_FD_BURST, g_burst_sockfd, burst_quiesce);
+    syslog(LOG_INFO, "入台补发服务监听 UDP %s:%d", inet_ntoa(ifaddr), port);
+    return 0;
+}
+
+// 停止补发服务并释放缓冲
+void burst_cleanup(void) {
+    if (g_burst_sockfd >= 0) {
+        // 不用 shutdown 唤醒服务线程: 热升级交接失败时套接字仍为旧进程所用
+        pthread_cancel(g_burst_tid);
+        pthread_join(g_burst_tid, NULL);
+        close(g_burst_sockfd);
+        g_burst_sockfd = -1;
+    }
+    pthread_once(&g_rings_once, burst_rings_init);
+    for (int i = 0; i < BURST_MAX_CHN; i++) {
+        pthread_mutex_lock(&g_rings[i].mutex);
+        while (g_rings[i].tail < g_rings[i].head) burst_evict(&g_rings[i]);
+        pthread_mutex_unlock(&g_rings[i].mutex);
+    }
+}
@@ -0,0 +1,62 @@
+#ifndef __BURST_H__
+#define __BURST_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+#include <netinet/in.h>
+#include "server.h"
+
+// 每频道突发缓冲: 保存最近几秒已发送的数据包, 新入台客户端可单播补发
+#define BURST_SECONDS   3                  // 补发的时间窗口(秒)
+#define BURST_SLOTS     256                // 每频道最多保存的包数
+#define BURST_MAX_BYTES (1024 * 1024)      // 每频道最多占用的内存
+#define BURST_MAX_CHN   256                // chnid_t 取值范围
+
+// 请求验证与限速: 验证码按时间段轮换, 当前与上一时间段的都有效;
+// 每个地址(IP+端口)按令牌桶限速, 另对所有地址合计的补发次数按时间窗口封顶
+#define BURST_COOKIE_SECS   10             // 验证码轮换周期(秒)
+#define BURST_PEER_SLOTS    1024           // 限速表大小, 哈希冲突时新地址顶替旧地址
+#define BURST_PEER_MAX      5              // 每个地址最多积攒的补发次数 (连续换台)
+#define BURST_PEER_REFILL_MS 1000          // 每个地址每隔多久补充一次补发额度
+#define BURST_WINDOW_MS     1000           // 全局限速窗口
+#define BURST_WINDOW_MAX    200            // 每个窗口内全部地址合计最多补发次数
+
+// 引用计数的数据报(包头 + 数据), 环形缓冲与各发送者共享同一份
+typedef struct burst_buf {
+    int refs;               // 引用计数(原子操作)
+    size_t len;             // 数据报长度
+    char data[];
+} burst_buf_t;
+
+// 缓冲中的一个数据包
+typedef struct burst_pkt {
+    uint32_t seq;           // 包序列号
+    int sync_off;           // 数据部分中第一个帧同步点的偏移, -1表示无
+    struct timespec ts;     // 入缓冲时间(CLOCK_MONOTONIC)
+    burst_buf_t *buf;
+} burst_pkt_t;
+
+// 单个频道的环形缓冲
+typedef struct burst_ring {
+    pthread_mutex_t mutex;
+    burst_pkt_t slots[BURST_SLOTS];
+    uint64_t head;          // 下一个写入序号(单调递增)
+    uint64_t tail;          // 最旧的有效包序号
+    size_t bytes;           // 当前占用字节数
+} burst_ring_t;
+
+// 函数声明
+void burst_push(chnid_t chnid, const void *pkt, size_t len, uint32_t seq, int sync_off);
+void burst_buf_put(burst_buf_t *buf);                      // 释放一个引用
+int burst_peek(chnid_t chnid, uint64_t pos, burst_pkt_t *out); // 1=取到(已加引用) 0=无新数据 -1=已被淘汰
+uint64_t burst_join_point(chnid_t chnid);                  // 时间窗口内最旧的同步点
+uint64_t burst_latest_sync(chnid_t chnid);                 // 最新的同步点
+uint64_t burst_head(chnid_t chnid);                        // 下一个写入序号
+void burst_set_notify(int efd);                            // 新包入缓冲时写该 eventfd
+void burst_clear(chnid_t chnid);                           // 丢弃频道缓冲(频道暂停后旧数据不再补发)
+int burst_service_start(int port, struct in_addr ifaddr);  // 启动单播补发服务线程, 绑定在组播出口地址上
+void burst_cleanup(void);
+
+#endif /* __BURST_H__ */
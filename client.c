@@ -9,10 +9,19 @@
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
+#include <netinet/tcp.h>
+#include <netdb.h>
 #include <fcntl.h>
-#include <sys/wait.h>
 #include <stdint.h>
 #include "client.h"
+#include "audio.h"
+#include "pktring.h"
+#include "tshift.h"
+#include "rxstats.h"
+#include "loadgen.h"
+#include "heartbeat.h"
+#include "lowlat.h"
+#include "shmring.h"
 
 channel_info_t channels[MAX_CHANNELS];
 int current_channel = -1;
@@ -20,9 +29,34 @@ volatile int ui_running = 1;
 int media_sockfd = -1;
 pthread_mutex_t audio_mutex = PTHREAD_MUTEX_INITIALIZER;
 
-// mpg123相关全局变量
-int mpg123_pipefd = -1;
-pid_t mpg123_pid = -1;
+// 换台后由接收线程清空解码器和设备缓冲
+volatile int audio_flush_pending = 0;
+
+// 接收线程与音频输出线程之间的包环; 换台代数变化时输出线程丢弃旧数据并清空解码器
+pktring_t *audio_ring = NULL;
+uint32_t audio_gen = 0;
+
+// 时移 (-T): UI线程提交请求, 输出线程执行
+int tshift_request = TS_REQ_NONE;
+int tshift_all = 0;                 // -A: 记录收到的所有频道, 否则只记录当前频道
+
+// 入台突发补发
+int burst_sockfd = -1;
+struct sockaddr_in server_addr;     // 从组播源地址得知的服务器地址
+int server_known = 0;
+uint32_t burst_cookie = 0;          // 补发服务下发的验证码, 0 表示还没有
+
+// 单播TCP接收模式 (-u), 否则接收组播
+int unicast_fd = -1;
+
+// 低时延接收 (-N/-P): 大接收缓冲, 忙轮询, 内核接收时间戳
+lowlat_conf_t lowlat = {0};
+int lowlat_on = 0;
+
+// 服务器在本机时直接读它的共享内存环, 服务器离开后退回组播
+shm_reader_t *shm_rx = NULL;
+const char *mcast_group = DEFAULT_MGROUP;
+int mcast_port = DEFAULT_PORT;
 
 void dump_hex(const char* data, size_t len) {
     printf("[HEX DUMP] ");
@@ -54,53 +88,6 @@ void parse_channel_list(char* data) {
     }
 }
 
-// 启动mpg123进程，只启动一次
-void start_mpg123_player() {
-    int pipefd[2];
-    if (pipe(pipefd)) {
-        perror("[ERROR] 创建管道失败");
-        exit(1);
-    }
-    pid_t pid = fork();
-    if (pid < 0) {
-        perror("[ERROR] fork失败");
-        exit(1);
-    }
-    if (pid == 0) { // 子进程
-        close(pipefd[1]);
-        dup2(pipefd[0], STDIN_FILENO);
-        close(pipefd[0]);
-        execl("/usr/bin/mpg123", "mpg123", "-q", "-", NULL);
-        perror("[ERROR] execl失败");
-        exit(1);
-    } else { // 父进程
-        close(pipefd[0]);
-        mpg123_pipefd = pipefd[1];
-        mpg123_pid = pid;
-        printf("[PLAYER] mpg123已启动，pid=%d\n", mpg123_pid);
-    }
-}
-
-// 停止mpg123进程
-void stop_mpg123_player() {
-    if (mpg123_pipefd >= 0) close(mpg123_pipefd);
-    if (mpg123_pid > 0) waitpid(mpg123_pid, NULL, 0);
-    mpg123_pipefd = -1;
-    mpg123_pid = -1;
-}
-
-// 写数据到mpg123
-void write_audio_to_mpg123(const char* audio_data, size_t data_len) {
-    if (mpg123_pipefd < 0) return;
-    printf("[DEBUG] 写入mpg123: %zu 字节\n", data_len);
-    size_t total_written = 0;
-    while (total_written < data_len) {
-        ssize_t written = write(mpg123_pipefd, audio_data + total_written, data_len - total_written);
-        if (written <= 0) break;
-        total_written += written;
-    }
-}
-
 void show_channel_list() {
     printf("\n=== 频道列表 ===\n");
     for (int i = 0; i < MAX_CHANNELS && channels[i].descr != NULL; i++) {
@@ -153,6 +140,99 @@ int init_multicast_socket(const char* mgroup, int port) {
     return sockfd;
 }
 
+// 连接服务器的单播TCP推流端口
+int init_unicast_socket(const char* host, int port) {
+    printf("[NET] 连接单播服务器 %s:%d\n", host, port);
+
+    struct addrinfo hints = {0}, *res = NULL;
+    char port_str[16];
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    snprintf(port_str, sizeof(port_str), "%d", port);
+    int err = getaddrinfo(host, port_str, &hints, &res);
+    if (err != 0) {
+        fprintf(stderr, "[ERROR] 解析地址失败: %s\n", gai_strerror(err));
+        return -1;
+    }
+
+    int sockfd = socket(AF_INET, SOCK_STREAM, 0);
+    if (sockfd < 0) {
+        perror("[ERROR] 创建socket失败");
+        freeaddrinfo(res);
+        return -1;
+    }
+    if (connect(sockfd, res->ai_addr, res->ai_addrlen) < 0) {
+        perror("[ERROR] 连接单播服务器失败");
+        freeaddrinfo(res);
+        close(sockfd);
+        return -1;
+    }
+    freeaddrinfo(res);
+
+    int one = 1;
+    setsockopt(sockfd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    struct timeval tv = {3, 0};
+    setsockopt(sockfd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    printf("[NET] 单播连接成功\n");
+    return sockfd;
+}
+
+// 订阅(或切换到)频道; 服务器从最近的帧同步点开始推送
+int send_unicast_subscribe(uint16_t chnid) {
+    unicast_req_t req;
+    req.magic = htonl(UNICAST_MAGIC);
+    req.channel_id = htons(chnid);
+    req.version = htons(PROTO_VERSION);
+    if (send(unicast_fd, &req, sizeof(req), MSG_NOSIGNAL) != sizeof(req)) {
+        perror("[ERROR] 发送订阅请求失败");
+        return -1;
+    }
+    return 0;
+}
+
+// 从TCP流中读满 len 字节; 返回 len, 0 表示超时且未读到任何数据, -1 表示连接断开
+static ssize_t recv_full(int fd, char* buf, size_t len) {
+    size_t got = 0;
+    while (got < len) {
+        ssize_t n = recv(fd, buf + got, len - got, 0);
+        if (n == 0) return -1;
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                if (got == 0) return 0;
+                if (!ui_running) return -1;
+                continue;  // 已读到半个包, 必须读完以保持包边界
+            }
+            return -1;
+        }
+        got += (size_t)n;
+    }
+    return (ssize_t)len;
+}
+
+// 从单播TCP流读取一个完整的包(包头 + 扩展包头 + 数据), 返回包长度
+ssize_t recv_unicast_packet(char* buf, size_t cap) {
+    ssize_t n = recv_full(unicast_fd, buf, sizeof(pkt_hdr_t));
+    if (n <= 0) return n;
+    // 先读固定部分, 再按 hdr_len 读完新版本追加的字段
+    pkt_hdr_t header;
+    memcpy(&header, buf, sizeof(header));
+    if (header.version != PROTO_VERSION) {
+        fprintf(stderr, "[ERROR] 单播协议版本不兼容: %u\n", header.version);
+        return -1;
+    }
+    size_t hdr_len = ntohs(header.hdr_len);
+    uint32_t data_len = ntohl(header.data_len);
+    if (hdr_len < sizeof(header) || hdr_len > cap || data_len > cap - hdr_len) {
+        fprintf(stderr, "[ERROR] 单播包过大: %zu+%u\n", hdr_len, data_len);
+        return -1;
+    }
+    size_t rest = hdr_len - sizeof(header) + data_len;
+    n = recv_full(unicast_fd, buf + sizeof(header), rest);
+    if (n < 0 || (n == 0 && rest > 0)) return -1;
+    return (ssize_t)(hdr_len + data_len);
+}
+
 void* ui_control_loop(void* arg) {
     printf("[UI] 控制线程启动\n");
     
@@ -165,6 +245,11 @@ void* ui_control_loop(void* arg) {
     printf("\n控制菜单:\n");
     printf("数字键1-%d - 选择频道\n", MAX_CHANNELS);
     printf("l - 显示频道列表\n");
+    printf("s - 显示接收统计\n");
+    if (tshift_enabled()) {
+        printf("p - 暂停/继续  r - 后退%d秒  f - 前进%d秒  g - 回到直播\n",
+               TSHIFT_STEP_MS / 1000, TSHIFT_STEP_MS / 1000);
+    }
     printf("q - 退出程序\n> ");
 
     while (ui_running) {
@@ -173,6 +258,15 @@ void* ui_control_loop(void* arg) {
             int ch = c - '0' - 1; // 转换为0-based索引
             pthread_mutex_lock(&audio_mutex);
             if (ch >= 0 && ch < MAX_CHANNELS && channels[ch].descr != NULL) {
+                if (ch != current_channel) {
+                    audio_flush_pending = 1;
+                    if (unicast_fd >= 0) send_unicast_subscribe(channels[ch].chnid);
+                    // 全部记录时所有频道都在听, 心跳不随换台变化
+                    if (!tshift_all) {
+                        if (current_channel >= 0) heartbeat_tune(channels[current_channel].chnid, -1);
+                        heartbeat_tune(channels[ch].chnid, 1);
+                    }
+                }
                 current_channel = ch;
                 printf("\n切换到频道: %s (ID: %hu)\n> ", 
                       channels[current_channel].descr, channels[current_channel].chnid);
@@ -183,6 +277,13 @@ void* ui_control_loop(void* arg) {
         } else if (tolower(c) == 'l') {
             show_channel_list();
             printf("> ");
+        } else if (tolower(c) == 's') {
+            rxstats_print(stdout, audio_ring);
+            printf("> ");
+        } else if (tshift_enabled() && strchr("prfg", tolower(c))) {
+            int req = tolower(c) == 'p' ? TS_REQ_PAUSE : tolower(c) == 'r' ? TS_REQ_BACK :
+                      tolower(c) == 'f' ? TS_REQ_FWD : TS_REQ_LIVE;
+            __atomic_store_n(&tshift_request, req, __ATOMIC_RELEASE);
         } else if (tolower(c) == 'q') {
             ui_running = 0;
             printf("\n正在退出...\n");
@@ -194,77 +295,553 @@ void* ui_control_loop(void* arg) {
     return NULL;
 }
 
+int init_burst_socket(void) {
+    int sockfd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (sockfd < 0) {
+        perror("[WARN] 创建补发socket失败");
+        return -1;
+    }
+    // 补发是几秒数据的瞬时突发, 接收缓冲要足够大
+    int rcvbuf = 4 * 1024 * 1024;
+    setsockopt(sockfd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    struct timeval tv = {0, BURST_TIMEOUT_MS * 1000};
+    setsockopt(sockfd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    return sockfd;
+}
+
+// 向服务器请求频道最近几秒的数据并立即送入包环
+// 返回补发的包数, *last_seq 为补发的最后一个序列号(用于与组播去重)
+int request_channel_burst(uint16_t chnid, char *buf, uint32_t *last_seq) {
+    *last_seq = 0;
+    if (burst_sockfd < 0 || !server_known) return 0;
+
+    struct sockaddr_in addr = server_addr;
+    addr.sin_port = htons(BURST_PORT);
+    burst_req_t req;
+    req.magic = htonl(BURST_MAGIC);
+    req.channel_id = htons(chnid);
+    req.version = htons(PROTO_VERSION);
+    req.cookie = burst_cookie;                            // 上次换台得到的验证码, 过期时服务器会下发新的
+    if (sendto(burst_sockfd, &req, sizeof(req), 0, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        perror("[WARN] 发送补发请求失败");
+        return 0;
+    }
+
+    int count = 0, echoed = 0;
+    while (ui_running) {
+        ssize_t n = recv(burst_sockfd, buf, CLIENT_PKT_MAX, 0);
+        if (n < 0) break;                                 // 超时: 放弃剩余补发
+
+        // 服务器要求回显验证码 (首次请求或验证码已过期), 带上后重发一次
+        const burst_req_t *ch = (const burst_req_t *)buf;
+        if (n == sizeof(*ch) && ntohl(ch->magic) == BURST_MAGIC) {
+            if (ntohs(ch->channel_id) != chnid || echoed++ > 0) continue;
+            burst_cookie = req.cookie = ch->cookie;
+            sendto(burst_sockfd, &req, sizeof(req), 0, (struct sockaddr*)&addr, sizeof(addr));
+            continue;
+        }
+
+        pkt_info_t info;
+        if (proto_hdr_parse(buf, (size_t)n, &info) != 0) continue;
+        if (info.channel_id != chnid) continue;           // 上一次换台的残留
+        *last_seq = info.seq_num;
+        if (info.data_len == 0) break;                    // 结束标记
+        if (info.data_len > (size_t)n - info.hdr_len) continue;
+
+        pktring_push(audio_ring, audio_gen, buf + info.hdr_len, info.data_len);
+        count++;
+    }
+    printf("[BURST] 频道%hu 补发 %d 个包, 截止序列%u\n", chnid, count, *last_seq);
+    return count;
+}
+
 void receive_and_play_audio() {
     printf("[AUDIO] 音频接收线程启动\n");
 
     struct sockaddr_in sender_addr;
     socklen_t sender_len = sizeof(sender_addr);
 
+    // 每个UDP数据报是一个完整的包: 包头 + 数据, 必须一次性收取
+    char *pkt_buf = malloc(CLIENT_PKT_MAX);
+    char *burst_buf = malloc(CLIENT_PKT_MAX);
+    if (!pkt_buf || !burst_buf) {
+        printf("[ERROR] 分配接收缓冲区失败\n");
+        free(pkt_buf);
+        free(burst_buf);
+        return;
+    }
+
+    // 补发已覆盖的序列号范围, 之后到达的同频道组播包按序列号去重
+    int burst_chnid = -1;
+    uint32_t burst_last_seq = 0;
+    int version_warned = 0;
+
     while (ui_running) {
-        packet_header_t header;
-        ssize_t n = recvfrom(media_sockfd, &header, sizeof(header), MSG_WAITALL, 
-                             (struct sockaddr*)&sender_addr, &sender_len);
-        if (n != sizeof(header)) {
-            printf("[ERROR] 接收包头失败\n");
+        pkt_info_t header;
+        lowlat_time_t rx_time;
+        int kernel_ts = 0;
+        ssize_t n;
+        if (unicast_fd >= 0) {
+            n = recv_unicast_packet(pkt_buf, CLIENT_PKT_MAX);
+            if (n < 0) {
+                printf("[ERROR] 单播连接断开\n");
+                ui_running = 0;
+                break;
+            }
+            if (n == 0) continue;
+        } else if (shm_rx) {
+            n = shmrx_recv(shm_rx, pkt_buf, CLIENT_PKT_MAX, SHM_WAIT_MS);
+            if (n < 0) {
+                printf("[SHM] 本机服务器已不在, 改为接收组播\n");
+                shmrx_close(shm_rx);
+                shm_rx = NULL;
+                media_sockfd = init_multicast_socket(mcast_group, mcast_port);
+                if (media_sockfd < 0) {
+                    ui_running = 0;
+                    break;
+                }
+                server_known = 0;
+            }
+            if (n <= 0) continue;
+        } else if (lowlat_on) {
+            n = lowlat_recv(media_sockfd, pkt_buf, CLIENT_PKT_MAX, &sender_addr, &rx_time);
+            kernel_ts = 1;
+        } else {
+            n = recvfrom(media_sockfd, pkt_buf, CLIENT_PKT_MAX, 0,
+                         (struct sockaddr*)&sender_addr, &sender_len);
+        }
+        if (n < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                printf("[ERROR] 接收数据失败: %s\n", strerror(errno));
+            }
+            continue;
+        }
+        int ret = proto_hdr_parse(pkt_buf, (size_t)n, &header);
+        if (ret == -2) {
+            if (!version_warned) {
+                printf("[WARN] 收到不兼容的协议版本 %u (本客户端为 %d), 已忽略\n",
+                       (unsigned char)pkt_buf[0], PROTO_VERSION);
+                version_warned = 1;
+            }
             continue;
         }
-        header.channel_id = ntohs(header.channel_id);
-        header.seq_num = ntohl(header.seq_num);
-        header.data_len = ntohl(header.data_len);
+        if (ret != 0) continue;
+        if (!server_known && unicast_fd < 0 && !shm_rx) {
+            server_addr = sender_addr;
+            server_known = 1;
+        }
 
         if (header.data_len == 0) continue;
-
-        // 动态分配数据缓冲区
-        char *data_buf = malloc(header.data_len);
-        if (!data_buf) {
-            printf("[ERROR] 分配数据缓冲区失败\n");
+        if (header.flags & (PKT_F_FEC | PKT_F_DIR)) continue;   // 非音频数据, 本客户端暂不处理
+        if (header.data_len > (size_t)n - header.hdr_len) {
+            printf("[ERROR] 数据包不完整: 声明%u 实际%zd\n",
+                   header.data_len, n - (ssize_t)header.hdr_len);
             continue;
         }
-        n = recvfrom(media_sockfd, data_buf, header.data_len, MSG_WAITALL, 
-                     (struct sockaddr*)&sender_addr, &sender_len);
-        if (n != header.data_len) {
-            printf("[ERROR] 接收数据失败\n");
-            free(data_buf);
-            continue;
+        const char *payload = pkt_buf + header.hdr_len;
+        if (kernel_ts) {
+            rxstats_packet_at(&header, rx_time.clock, rx_time.arrival_us, rx_time.wall_us);
+        } else {
+            rxstats_packet(&header);
         }
 
         pthread_mutex_lock(&audio_mutex);
         int should_play = (current_channel >= 0 && 
                           header.channel_id == channels[current_channel].chnid);
+        int flush = audio_flush_pending;
+        uint16_t want_chnid = current_channel >= 0 ? channels[current_channel].chnid : 0;
+        audio_flush_pending = 0;
         pthread_mutex_unlock(&audio_mutex);
 
+        if (flush) {
+            __atomic_add_fetch(&audio_gen, 1, __ATOMIC_RELEASE);
+            // 换台: 先用服务器缓存的最近数据立即起播, 再无缝接上组播
+            // 单播模式下由UI线程发送订阅, 服务器从缓存的同步点开始推送
+            burst_chnid = -1;
+            if (unicast_fd < 0 && current_channel >= 0 &&
+                request_channel_burst(want_chnid, burst_buf, &burst_last_seq) > 0) {
+                burst_chnid = want_chnid;
+            }
+        }
+        // 补发截止序列号之前的包已在补发中播放过; 组播追上截止序列号后不再需要,
+        // 跳变过大(服务器重启, 序列号从头开始)时也要放弃, 否则之后的包全被丢掉
+        if (should_play && header.channel_id == burst_chnid) {
+            int32_t delta = (int32_t)(header.seq_num - burst_last_seq);
+            if (delta > 0 || delta < -RXSTATS_MAX_DROPOUT) burst_chnid = -1;
+            else continue;
+        }
+        if (tshift_enabled() && (should_play || tshift_all)) {
+            tshift_record(header.channel_id, header.seq_num, payload, header.data_len);
+        }
         if (should_play) {
-            // 直接写入mpg123管道，不再每包重启播放器
-            write_audio_to_mpg123(data_buf, header.data_len);
+            // 只入环不解码, 音频设备再慢也不会让接收停顿
+            pktring_push(audio_ring, audio_gen, payload, header.data_len);
         }
-        free(data_buf);
     }
+    free(pkt_buf);
+    free(burst_buf);
     printf("[AUDIO] 音频接收线程退出\n");
 }
 
-int main() {
+static uint64_t wall_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+// 时移播放状态, 只在输出线程中访问
+typedef struct {
+    int shifted;            // 正在回放时移文件
+    int paused;
+    uint64_t pos;           // 回放位置(时移文件记录序号)
+    uint64_t last_ms;       // 最近回放包的接收时间
+} tshift_play_t;
+
+// 执行UI线程提交的时移请求
+static void tshift_control(int req, tshift_play_t *tp) {
+    switch (req) {
+    case TS_REQ_PAUSE:
+        if (!tp->shifted) {
+            tp->shifted = 1;
+            tp->paused = 1;
+            tp->pos = tshift_head();
+            tp->last_ms = wall_ms();
+            audio_flush();
+        } else {
+            tp->paused = !tp->paused;
+        }
+        printf("\n[TSHIFT] %s\n> ", tp->paused ? "已暂停" : "继续播放");
+        break;
+    case TS_REQ_BACK: {
+        uint64_t base = tp->shifted ? tp->last_ms : wall_ms();
+        tp->pos = (uint64_t)tshift_seek_time(base - TSHIFT_STEP_MS);
+        tp->shifted = 1;
+        tp->paused = 0;
+        audio_flush();
+        printf("\n[TSHIFT] 后退到直播前 %llu 秒\n> ",
+               (unsigned long long)((wall_ms() - base + TSHIFT_STEP_MS) / 1000));
+        break;
+    }
+    case TS_REQ_FWD:
+        if (!tp->shifted) break;
+        tp->pos = (uint64_t)tshift_seek_time(tp->last_ms + TSHIFT_STEP_MS);
+        tp->paused = 0;
+        audio_flush();
+        break;
+    case TS_REQ_LIVE:
+        if (!tp->shifted) break;
+        tp->shifted = 0;
+        tp->paused = 0;
+        audio_flush();
+        printf("\n[TSHIFT] 回到直播\n> ");
+        break;
+    }
+}
+
+// 音频输出线程: 从包环取数据解码播放, 允许在声卡写入上阻塞
+// 时移回放时改从时移文件读取, 播放速度由声卡阻塞自然限定
+void* audio_output_loop(void* arg) {
+    (void)arg;
+    uint32_t out_gen = __atomic_load_n(&audio_gen, __ATOMIC_ACQUIRE);
+    tshift_play_t tp = {0};
+    char* ts_buf = malloc(TSHIFT_REC_DATA);
+    // 欠载检测: 播放中包环空等的时间超过声卡缓冲时长, 声卡必然已放空
+    int playing = 0;
+    struct timespec last_feed = {0, 0};
+    while (ui_running) {
+        uint32_t gen = __atomic_load_n(&audio_gen, __ATOMIC_ACQUIRE);
+        if (gen != out_gen) {
+            audio_flush();
+            out_gen = gen;
+            tp.shifted = tp.paused = 0;     // 换台回到直播
+            playing = 0;
+        }
+        if (tshift_enabled() && ts_buf) {
+            int req = __atomic_exchange_n(&tshift_request, TS_REQ_NONE, __ATOMIC_ACQ_REL);
+            if (req != TS_REQ_NONE) tshift_control(req, &tp);
+        }
+
+        if (!tp.shifted) {
+            pktring_slot_t* slot = pktring_peek(audio_ring, 1);
+            if (!slot) {
+                struct timespec now;
+                clock_gettime(CLOCK_MONOTONIC, &now);
+                double idle = (now.tv_sec - last_feed.tv_sec) + (now.tv_nsec - last_feed.tv_nsec) / 1e9;
+                if (playing && idle > AUDIO_DEVICE_BUFFER) {
+                    pthread_mutex_lock(&audio_mutex);
+                    uint16_t chnid = current_channel >= 0 ? channels[current_channel].chnid : 0;
+                    pthread_mutex_unlock(&audio_mutex);
+                    rxstats_underrun(chnid);
+                    playing = 0;
+                }
+                continue;
+            }
+            if (slot->gen == out_gen) {
+                audio_feed(slot->data, slot->len);
+                clock_gettime(CLOCK_MONOTONIC, &last_feed);
+                playing = 1;
+            }
+            pktring_pop(audio_ring);    // 换台前的旧数据直接丢弃
+            continue;
+        }
+
+        // 时移中: 直播包已写入时移文件, 内存包环里的直接丢弃
+        while (pktring_peek(audio_ring, 0)) pktring_pop(audio_ring);
+        if (tp.paused) {
+            usleep(PKTRING_WAIT_MS * 1000);
+            continue;
+        }
+        pthread_mutex_lock(&audio_mutex);
+        uint16_t chnid = current_channel >= 0 ? channels[current_channel].chnid : 0;
+        pthread_mutex_unlock(&audio_mutex);
+        int n = tshift_read(&tp.pos, chnid, ts_buf, TSHIFT_REC_DATA, &tp.last_ms);
+        if (n > 0) {
+            audio_feed(ts_buf, (size_t)n);
+        } else if (n == 0) {
+            tp.shifted = 0;
+            printf("\n[TSHIFT] 已追上直播\n> ");
+        } else {
+            printf("\n[TSHIFT] 回放位置已被覆盖, 跳到最早的数据\n> ");
+        }
+    }
+    free(ts_buf);
+    printf("[AUDIO] 音频输出线程退出\n");
+    return NULL;
+}
+
+static void usage(const char* prog) {
+    fprintf(stderr, "用法: %s [-u 服务器[:端口]] [-g 组[:端口]] [-T 文件[:MB]] [-A] [-S 文件[:秒]]\n"
+                    "       %*s [-N sw|hw[:接口]] [-P 微秒] [-M]\n"
+                    "       %s -L 听众数[:线程数] [-Z 模式[:秒]] [-D 秒] [-B] [-u 服务器[:端口]] [-S 文件[:秒]]\n"
+                    "  -u  改用单播TCP接收 (默认端口 %d), 适用于屏蔽组播的网络\n"
+                    "  -g  从指定组播组接收 (默认 %s:%d), 如经损伤中继测试时用 %s:%d\n"
+                    "  -T  启用时移, 收到的数据写入环形文件 (默认 %d MB), 可暂停/回退直播\n"
+                    "  -A  时移记录收到的所有频道, 默认只记录当前频道\n"
+                    "  -S  定期把接收统计追加到文件 (默认每 %d 秒), .json 结尾写JSON行, 否则写CSV\n"
+                    "  -N  低时延接收: 按突发量加大接收缓冲, 用内核软件(sw)或网卡硬件(hw)接收时间戳计算抖动与延迟\n"
+                    "  -P  接收套接字忙轮询时长(微秒), 以CPU换取更低的唤醒延迟\n"
+                    "  -M  始终接收组播; 默认服务器在本机时直接读它的共享内存\n"
+                    "压测模式 (无音频输出与界面):\n"
+                    "  -L  模拟的虚拟听众数, 默认 %d 个接收线程\n"
+                    "  -Z  换台模式 none|random|cycle|herd, 可带间隔秒数 (默认 none, 间隔 10 秒)\n"
+                    "  -D  运行时长(秒), 默认直到 Ctrl-C\n"
+                    "  -B  组播模式下每次入台请求补发, 同时压测补发服务\n",
+            prog, (int)strlen(prog), "", prog, UNICAST_PORT, DEFAULT_MGROUP, DEFAULT_PORT, RELAY_GROUP, RELAY_PORT, TSHIFT_DEFAULT_MB, RXSTATS_INTERVAL, LOADGEN_DEFAULT_THREADS);
+}
+
+int main(int argc, char* argv[]) {
+    char* unicast_host = NULL;
+    int unicast_port = UNICAST_PORT;
+    char* mgroup = DEFAULT_MGROUP;
+    int mport = DEFAULT_PORT;
+    char* tshift_path = NULL;
+    size_t tshift_mb = TSHIFT_DEFAULT_MB;
+    char* stats_path = NULL;
+    int stats_interval = RXSTATS_INTERVAL;
+    int local_shm = 1;
+    loadgen_conf_t load = {0};
+    load.zap_interval_ms = 10000;
+    int opt;
+    while ((opt = getopt(argc, argv, "u:g:T:AS:L:Z:D:BN:P:Mh")) != -1) {
+        switch (opt) {
+        case 'u': {
+            unicast_host = optarg;
+            char* colon = strchr(optarg, ':');
+            if (colon) {
+                *colon = '\0';
+                unicast_port = atoi(colon + 1);
+            }
+            break;
+        }
+        case 'g': {
+            mgroup = optarg;
+            char* colon = strchr(optarg, ':');
+            if (colon) {
+                *colon = '\0';
+                mport = atoi(colon + 1);
+            }
+            break;
+        }
+        case 'T': {
+            tshift_path = optarg;
+            char* colon = strchr(optarg, ':');
+            if (colon) {
+                *colon = '\0';
+                tshift_mb = (size_t)atoi(colon + 1);
+            }
+            break;
+        }
+        case 'A':
+            tshift_all = 1;
+            break;
+        case 'S': {
+            stats_path = optarg;
+            char* colon = strrchr(optarg, ':');
+            if (colon) {
+                *colon = '\0';
+                stats_interval = atoi(colon + 1);
+            }
+            break;
+        }
+        case 'L': {
+            load.listeners = atoi(optarg);
+            char* colon = strchr(optarg, ':');
+            if (colon) load.threads = atoi(colon + 1);
+            break;
+        }
+        case 'Z':
+            if (loadgen_parse_zap(optarg, &load) != 0) {
+                fprintf(stderr, "无效的换台模式: %s\n", optarg);
+                return 1;
+            }
+            break;
+        case 'D':
+            load.duration_s = atoi(optarg);
+            break;
+        case 'B':
+            load.burst = 1;
+            break;
+        case 'N':
+            if (lowlat_parse(optarg, &lowlat) != 0) {
+                fprintf(stderr, "无效的低时延模式: %s\n", optarg);
+                return 1;
+            }
+            lowlat_on = 1;
+            break;
+        case 'P':
+            lowlat.busy_poll_us = atoi(optarg);
+            lowlat_on = 1;
+            break;
+        case 'M':
+            local_shm = 0;
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
     printf("=== 组播音频客户端 ===\n");
     
     // 初始化频道列表
     char server_data[] = "1,opear|2,traffic|3,children|4,pop";
     parse_channel_list(server_data);
+
+    // 压测模式: 不初始化音频与界面, 跑完输出汇总后退出
+    if (load.listeners > 0) {
+        uint16_t chnids[MAX_CHANNELS];
+        int nchn = 0;
+        while (nchn < MAX_CHANNELS && channels[nchn].descr != NULL) {
+            chnids[nchn] = channels[nchn].chnid;
+            nchn++;
+        }
+        load.chnids = chnids;
+        load.nchn = nchn;
+        load.unicast_host = unicast_host;
+        load.unicast_port = unicast_port;
+        load.mgroup = mgroup;
+        load.mport = mport;
+        load.report_path = stats_path;
+        load.report_interval = stats_interval;
+        int ret = loadgen_run(&load);
+        for (int i = 0; i < MAX_CHANNELS; i++) {
+            if (channels[i].descr) free(channels[i].descr);
+        }
+        return ret == 0 ? 0 : 1;
+    }
     
     // 初始化网络
-    media_sockfd = init_multicast_socket(DEFAULT_MGROUP, DEFAULT_PORT);
-    if (media_sockfd < 0) {
-        fprintf(stderr, "初始化网络失败\n");
+    if (unicast_host) {
+        unicast_fd = init_unicast_socket(unicast_host, unicast_port);
+        if (unicast_fd < 0) {
+            fprintf(stderr, "初始化网络失败\n");
+            return 1;
+        }
+    } else {
+        mcast_group = mgroup;
+        mcast_port = mport;
+        // 服务器在本机时读共享内存; 指定了其他组播组(如经损伤中继)时不走捷径
+        if (local_shm && !lowlat_on && strcmp(mgroup, DEFAULT_MGROUP) == 0 && mport == DEFAULT_PORT) {
+            shm_rx = shmrx_open();
+        }
+        if (shm_rx) {
+            printf("[NET] 服务器在本机, 从共享内存接收\n");
+            server_addr.sin_family = AF_INET;
+            server_addr.sin_addr.s_addr = shmrx_server_addr(shm_rx);
+            server_known = 1;
+        } else {
+            media_sockfd = init_multicast_socket(mgroup, mport);
+            if (media_sockfd < 0) {
+                fprintf(stderr, "初始化网络失败\n");
+                return 1;
+            }
+        }
+        // 入台补发通道 (可选)
+        burst_sockfd = init_burst_socket();
+        if (lowlat_on && media_sockfd >= 0) {
+            // 组播套接字收所有频道, 按每频道一次突发的量预留; 补发套接字一次只收一个频道
+            int nchn = 0;
+            while (nchn < MAX_CHANNELS && channels[nchn].descr != NULL) nchn++;
+            int rcvbuf = nchn * LOWLAT_BURST_BYTES;
+            if (rcvbuf < LOWLAT_MIN_RCVBUF) rcvbuf = LOWLAT_MIN_RCVBUF;
+            int actual = lowlat_set_rcvbuf(media_sockfd, rcvbuf);
+            lowlat_setup(media_sockfd, &lowlat);
+            if (burst_sockfd >= 0) {
+                lowlat_set_rcvbuf(burst_sockfd, LOWLAT_BURST_BYTES);
+                lowlat_conf_t poll_only = {LOWLAT_OFF, NULL, lowlat.busy_poll_us};
+                lowlat_setup(burst_sockfd, &poll_only);
+            }
+            printf("[NET] 低时延接收: 时间戳 %s, 接收缓冲 %d KB, 忙轮询 %d us\n",
+                   lowlat.mode == LOWLAT_HW ? "硬件" : lowlat.mode == LOWLAT_SW ? "软件" : "无",
+                   actual / 1024, lowlat.busy_poll_us);
+        }
+        // 收听心跳: 服务器开启 -I 时据此暂停无人收听的频道
+        if (heartbeat_start() != 0) {
+            fprintf(stderr, "[WARN] 收听心跳不可用\n");
+        }
+        for (int i = 0; tshift_all && i < MAX_CHANNELS && channels[i].descr; i++) {
+            heartbeat_tune(channels[i].chnid, 1);
+        }
+    }
+
+    // 初始化解码器与音频输出
+    if (audio_init() != 0) {
+        fprintf(stderr, "初始化音频失败\n");
+        close(media_sockfd);
         return 1;
     }
+
+    // 时移存储 (可选), 失败时照常直播
+    if (tshift_path && tshift_open(tshift_path, tshift_mb * 1024 * 1024) != 0) {
+        fprintf(stderr, "[WARN] 时移不可用\n");
+    }
     
-    // 启动mpg123播放器
-    start_mpg123_player();
-    
+    // 启动音频输出线程
+    audio_ring = pktring_create();
+    pthread_t output_thread;
+    if (!audio_ring || pthread_create(&output_thread, NULL, audio_output_loop, NULL)) {
+        fprintf(stderr, "创建音频输出线程失败\n");
+        close(media_sockfd);
+        audio_close();
+        pktring_destroy(audio_ring);
+        return 1;
+    }
+
+    // 接收统计报告 (可选)
+    if (stats_path && rxstats_report_start(stats_path, stats_interval, audio_ring) != 0) {
+        fprintf(stderr, "[WARN] 接收统计报告不可用\n");
+    }
+
     // 启动UI线程
     pthread_t ui_thread;
     if (pthread_create(&ui_thread, NULL, ui_control_loop, NULL)) {
         perror("创建UI线程失败");
+        ui_running = 0;
+        pktring_wake(audio_ring);
+        pthread_join(output_thread, NULL);
         close(media_sockfd);
-        stop_mpg123_player();
+        audio_close();
+        pktring_destroy(audio_ring);
         return 1;
     }
     
@@ -273,8 +850,29 @@ int main() {
     
     // 清理
     pthread_join(ui_thread, NULL);
-    close(media_sockfd);
-    stop_mpg123_player();
+    pktring_wake(audio_ring);
+    pthread_join(output_thread, NULL);
+    rxstats_report_stop();
+    heartbeat_stop();
+    pktring_stats_t rs;
+    pktring_get_stats(audio_ring, &rs);
+    printf("[AUDIO] 包环: 写入%llu 播放%llu 溢出丢弃%llu 超长丢弃%llu 占用峰值%u/%d\n",
+           (unsigned long long)rs.pushed, (unsigned long long)rs.popped,
+           (unsigned long long)rs.overflow, (unsigned long long)rs.oversize,
+           rs.high_water, PKTRING_SLOTS);
+    if (tshift_enabled()) {
+        tshift_stats_t ts;
+        tshift_get_stats(&ts);
+        printf("[TSHIFT] 已记录%llu 丢弃%llu 可回退%llu秒\n", (unsigned long long)ts.recorded,
+               (unsigned long long)ts.dropped, (unsigned long long)(ts.span_ms / 1000));
+        tshift_close();
+    }
+    if (media_sockfd >= 0) close(media_sockfd);
+    shmrx_close(shm_rx);
+    if (unicast_fd >= 0) close(unicast_fd);
+    if (burst_sockfd >= 0) close(burst_sockfd);
+    audio_close();
+    pktring_destroy(audio_ring);
     
     for (int i = 0; i < MAX_CHANNELS; i++) {
         if (channels[i].descr) free(channels[i].descr);
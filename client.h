@@ -2,31 +2,42 @@
 #define __CLIENT_H__
 
 #include "mtk.h"
+#include "proto.h"
 
 // 组播相关宏定义
 #define MAX_CHANNELS 20
-#define DEFAULT_MGROUP "226.5.2.1"
-#define DEFAULT_PORT 5210
+#define DEFAULT_MGROUP GROUP_IP
+#define DEFAULT_PORT RCV_PORT
+#define CLIENT_PKT_MAX 65536   // 单个UDP数据报最大长度
+#define BURST_TIMEOUT_MS 300   // 等待补发数据的超时(毫秒)
+#define TSHIFT_STEP_MS 30000   // 时移每次后退/前进的时长(毫秒)
+
+// 时移请求
+enum {
+    TS_REQ_NONE = 0,
+    TS_REQ_PAUSE,        // 暂停/继续
+    TS_REQ_BACK,         // 后退 TSHIFT_STEP_MS
+    TS_REQ_FWD,          // 前进 TSHIFT_STEP_MS
+    TS_REQ_LIVE,         // 回到直播
+};
 
 // 频道信息结构
 typedef struct {
     uint16_t chnid;      // 频道ID
     char *descr;         // 频道描述
 } channel_info_t;
-// 数据包头部结构
-typedef struct {
-    uint16_t channel_id;
-    uint32_t seq_num;
-    uint32_t data_len;
-} packet_header_t;
-
 // 函数声明
 void parse_channel_list( char* data);
-void play_audio_with_mpg123(const char* audio_data, size_t data_len);
 void show_channel_list(void);
 int init_multicast_socket(const char* mgroup, int port);
+int init_burst_socket(void);
+int init_unicast_socket(const char* host, int port);
+int send_unicast_subscribe(uint16_t chnid);
+ssize_t recv_unicast_packet(char* buf, size_t cap);
+int request_channel_burst(uint16_t chnid, char *buf, uint32_t *last_seq);
 void* ui_control_loop(void *arg);
 void receive_and_play_audio(void);
+void* audio_output_loop(void *arg);
 void stop_audio_player(void);
 void cleanup(void);
 
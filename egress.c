@@ -0,0 +1,304 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <syslog.h>
+#include <pthread.h>
+#include "egress.h"
+
+// 排队中的一个包
+typedef struct egress_pkt {
+    uint64_t depart_ns;
+    size_t len;
+    char data[EGRESS_PKT_MAX];
+} egress_pkt_t;
+
+// 单个频道的队列与 DRR 状态
+typedef struct egress_chn {
+    int active;                 // 已分配队列
+    egress_pkt_t *q;            // EGRESS_QUEUE_MAX 个槽位的环形队列
+    unsigned int head, tail;    // 出队/入队序号
+    int64_t deficit;            // DRR 差额计数(字节)
+    int64_t quantum;            // 每轮加的额度
+    egress_chn_stats_t st;
+} egress_chn_t;
+
+static egress_chn_t g_chn[EGRESS_MAX_CHN];
+static int g_weight[EGRESS_MAX_CHN];        // 0 表示未配置, 按 1 处理
+static int g_weight_max = 1;
+static pthread_mutex_t g_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_cond;
+static pthread_t g_tid;
+static volatile int g_running = 0;
+
+static int g_sockfd = -1;
+static struct sockaddr_in g_dst;
+static uint64_t g_rate;                     // 字节/秒
+static double g_tokens;
+static double g_bucket;
+static uint64_t g_refill_ns;
+static int g_cursor = 0;                    // DRR 轮询位置
+static uint64_t g_throttled;                // 因令牌不足等待的次数
+
+int egress_parse_weights(const char *spec) {
+    const char *p = spec;
+    while (*p) {
+        char *end;
+        long chnid = strtol(p, &end, 10);
+        if (end == p || *end != '=' || chnid < 0 || chnid >= EGRESS_MAX_CHN) return -1;
+        p = end + 1;
+        long w = strtol(p, &end, 10);
+        if (end == p || w <= 0 || w > 1000) return -1;
+        g_weight[chnid] = (int)w;
+        if (w > g_weight_max) g_weight_max = (int)w;
+        p = end;
+        if (*p == ',') p++;
+        else if (*p) return -1;
+    }
+    return 0;
+}
+
+int egress_enabled(void) {
+    return g_running;
+}
+
+static int chn_weight(int chnid) {
+    return g_weight[chnid] > 0 ? g_weight[chnid] : 1;
+}
+
+static unsigned int chn_backlog(const egress_chn_t *c) {
+    return c->tail - c->head;
+}
+
+static egress_pkt_t *chn_front(egress_chn_t *c) {
+    return &c->q[c->head % EGRESS_QUEUE_MAX];
+}
+
+int egress_submit(int chnid, const tx_pkt_t *pkts, int n) {
+    if (chnid < 0 || chnid >= EGRESS_MAX_CHN) return 0;
+    egress_chn_t *c = &g_chn[chnid];
+    pthread_mutex_lock(&g_mutex);
+    if (!c->active) {
+        c->q = malloc(sizeof(egress_pkt_t) * EGRESS_QUEUE_MAX);
+        if (!c->q) {
+            pthread_mutex_unlock(&g_mutex);
+            return 0;
+        }
+        c->active = 1;
+        c->st.weight = chn_weight(chnid);
+        // 权重最高的频道每轮一个 EGRESS_QUANTUM, 其余按比例缩小并跨轮累积,
+        // 一轮的总长度因此与频道数成正比而不随权重放大, 高权重频道的排队延迟保持在一轮以内
+        c->quantum = (int64_t)EGRESS_QUANTUM * c->st.weight / g_weight_max;
+        if (c->quantum < 1) c->quantum = 1;
+    }
+    int queued = 0;
+    for (int i = 0; i < n; i++) {
+        if (pkts[i].len > EGRESS_PKT_MAX) continue;
+        if (chn_backlog(c) == EGRESS_QUEUE_MAX) {
+            c->head++;              // 队列满: 丢弃最旧的包
+            c->st.dropped_full++;
+        }
+        egress_pkt_t *p = &c->q[c->tail % EGRESS_QUEUE_MAX];
+        p->depart_ns = pkts[i].depart_ns;
+        p->len = pkts[i].len;
+        memcpy(p->data, pkts[i].data, pkts[i].len);
+        c->tail++;
+        c->st.queued++;
+        queued++;
+    }
+    pthread_cond_signal(&g_cond);
+    pthread_mutex_unlock(&g_mutex);
+    return queued;
+}
+
+int egress_get_stats(int chnid, egress_chn_stats_t *stats) {
+    if (chnid < 0 || chnid >= EGRESS_MAX_CHN) return -1;
+    pthread_mutex_lock(&g_mutex);
+    egress_chn_t *c = &g_chn[chnid];
+    int ret = c->active ? 0 : -1;
+    if (c->active) {
+        *stats = c->st;
+        stats->backlog = chn_backlog(c);
+    }
+    pthread_mutex_unlock(&g_mutex);
+    return ret;
+}
+
+static void refill(uint64_t now) {
+    g_tokens += (double)(now - g_refill_ns) * (double)g_rate / 1e9;
+    if (g_tokens > g_bucket) g_tokens = g_bucket;
+    g_refill_ns = now;
+}
+
+// 丢弃已超时的队首包; 返回队首是否已到出发时间
+static int chn_eligible(egress_chn_t *c, uint64_t now) {
+    while (chn_backlog(c) > 0) {
+        egress_pkt_t *p = chn_front(c);
+        if (p->depart_ns + EGRESS_MAX_DELAY_NS >= now) return p->depart_ns <= now;
+        c->head++;
+        c->st.dropped_late++;
+    }
+    return 0;
+}
+
+// 发送一个包, 发送期间不持锁
+static void send_pkt(egress_chn_t *c, const egress_pkt_t *p) {
+    tx_pkt_t pkt;
+    pkt.data = (void *)p->data;
+    pkt.len = p->len;
+    pkt.depart_ns = 0;                  // 已到出发时间, 不再等待
+    pthread_mutex_unlock(&g_mutex);
+    int sent = tx_send_batch(g_sockfd, &g_dst, &pkt, 1);
+    pthread_mutex_lock(&g_mutex);
+    if (sent == 1) {
+        c->st.sent++;
+        c->st.sent_bytes += p->len;
+    }
+}
+
+// 有丢包时周期性汇总到日志
+static void report(void) {
+    static egress_chn_stats_t last[EGRESS_MAX_CHN];
+    static uint64_t last_throttled;
+    if (g_throttled != last_throttled) {
+        syslog(LOG_INFO, "出口预算: %d秒内令牌不足等待 %llu 次", EGRESS_REPORT_S,
+               (unsigned long long)(g_throttled - last_throttled));
+        last_throttled = g_throttled;
+    }
+    for (int i = 0; i < EGRESS_MAX_CHN; i++) {
+        egress_chn_t *c = &g_chn[i];
+        if (!c->active) continue;
+        uint64_t late = c->st.dropped_late - last[i].dropped_late;
+        uint64_t full = c->st.dropped_full - last[i].dropped_full;
+        if (late || full) {
+            syslog(LOG_WARNING, "出口超载: 频道%d(权重%d) %d秒内发送%llu 超时丢弃%llu 队满丢弃%llu",
+                   i, c->st.weight, EGRESS_REPORT_S,
+                   (unsigned long long)(c->st.sent - last[i].sent),
+                   (unsigned long long)late, (unsigned long long)full);
+        }
+        last[i] = c->st;
+    }
+}
+
+// 调度线程: 令牌桶限总速率, 到期的频道之间按权重 DRR
+static void *egress_loop(void *arg) {
+    (void)arg;
+    uint64_t next_report = tx_now_ns() + EGRESS_REPORT_S * 1000000000ULL;
+    pthread_mutex_lock(&g_mutex);
+    while (g_running) {
+        uint64_t now = tx_now_ns();
+        refill(now);
+        if (now >= next_report) {
+            report();
+            next_report = now + EGRESS_REPORT_S * 1000000000ULL;
+        }
+
+        // 一轮: 每个到期频道加一次额度, 额度内尽量发送
+        int any = 0;
+        uint64_t wait_ns = 0;
+        for (int k = 0; k < EGRESS_MAX_CHN && g_running; k++) {
+            int i = (g_cursor + k) % EGRESS_MAX_CHN;
+            egress_chn_t *c = &g_chn[i];
+            if (!c->active) continue;
+            if (!chn_eligible(c, tx_now_ns())) {
+                c->deficit = 0;         // 没有到期的包, 不积累额度
+                continue;
+            }
+            any = 1;
+            if (c->deficit < (int64_t)chn_front(c)->len) c->deficit += c->quantum;
+            while (chn_eligible(c, tx_now_ns()) && c->deficit >= (int64_t)chn_front(c)->len) {
+                egress_pkt_t *p = chn_front(c);
+                refill(tx_now_ns());
+                if (g_tokens < (double)p->len) {
+                    // 令牌不足: 停在本频道, 等够一个包的令牌再继续
+                    wait_ns = (uint64_t)(((double)p->len - g_tokens) * 1e9 / (double)g_rate) + 1;
+                    g_throttled++;
+                    break;
+                }
+                g_tokens -= (double)p->len;
+                c->deficit -= (int64_t)p->len;
+                // 发送期间不持锁, 队满时入队方可能覆盖该槽位, 先拷出再出队
+                egress_pkt_t pkt_copy;
+                pkt_copy.depart_ns = p->depart_ns;
+                pkt_copy.len = p->len;
+                memcpy(pkt_copy.data, p->data, p->len);
+                c->head++;
+                send_pkt(c, &pkt_copy);
+            }
+            if (wait_ns) {
+                g_cursor = i;
+                break;
+            }
+            if (chn_backlog(c) == 0) c->deficit = 0;
+        }
+        if (!wait_ns) g_cursor = (g_cursor + 1) % EGRESS_MAX_CHN;
+        if (any && !wait_ns) continue;
+
+        // 无到期的包: 睡到最早的出发时间或新包入队; 令牌不足: 睡到令牌够用
+        if (!wait_ns) {
+            uint64_t earliest = UINT64_MAX;
+            for (int i = 0; i < EGRESS_MAX_CHN; i++) {
+                egress_chn_t *c = &g_chn[i];
+                if (c->active && chn_backlog(c) > 0 && chn_front(c)->depart_ns < earliest) {
+                    earliest = chn_front(c)->depart_ns;
+                }
+            }
+            now = tx_now_ns();
+            wait_ns = earliest == UINT64_MAX ? 100000000ULL : (earliest > now ? earliest - now : 0);
+            if (wait_ns > 100000000ULL) wait_ns = 100000000ULL;
+            if (wait_ns == 0) continue;
+        }
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        uint64_t abs_ns = (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec + wait_ns;
+        ts.tv_sec = (time_t)(abs_ns / 1000000000ULL);
+        ts.tv_nsec = (long)(abs_ns % 1000000000ULL);
+        pthread_cond_timedwait(&g_cond, &g_mutex, &ts);
+    }
+    pthread_mutex_unlock(&g_mutex);
+    return NULL;
+}
+
+// 启动调度线程; budget_bps 为总预算(比特/秒)
+int egress_start(int sockfd, const struct sockaddr_in *dst, uint64_t budget_bps) {
+    if (budget_bps == 0) return -1;
+    g_sockfd = sockfd;
+    g_dst = *dst;
+    g_rate = budget_bps / 8;
+    g_bucket = (double)g_rate * EGRESS_BUCKET_MS / 1000.0;
+    if (g_bucket < 2.0 * EGRESS_PKT_MAX) g_bucket = 2.0 * EGRESS_PKT_MAX;
+    g_tokens = g_bucket;
+    g_refill_ns = tx_now_ns();
+
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&g_cond, &attr);
+    pthread_condattr_destroy(&attr);
+
+    g_running = 1;
+    if (pthread_create(&g_tid, NULL, egress_loop, NULL) != 0) {
+        g_running = 0;
+        pthread_cond_destroy(&g_cond);
+        return -1;
+    }
+    syslog(LOG_INFO, "出口带宽预算 %llu kbit/s, 令牌桶 %.0f 字节",
+           (unsigned long long)(budget_bps / 1000), g_bucket);
+    return 0;
+}
+
+void egress_stop(void) {
+    if (!g_running) return;
+    pthread_mutex_lock(&g_mutex);
+    g_running = 0;
+    pthread_cond_signal(&g_cond);
+    pthread_mutex_unlock(&g_mutex);
+    pthread_join(g_tid, NULL);
+    pthread_cond_destroy(&g_cond);
+    for (int i = 0; i < EGRESS_MAX_CHN; i++) {
+        free(g_chn[i].q);
+        g_chn[i].q = NULL;
+        g_chn[i].active = 0;
+    }
+}
@@ -0,0 +1,38 @@
+#ifndef __EGRESS_H__
+#define __EGRESS_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <netinet/in.h>
+#include "txtime.h"
+
+// 全局出口带宽预算: 各频道按出发时间把包交给调度线程, 调度线程用令牌桶限制总速率,
+// 在到期的频道之间按权重做差额轮询(DRR); 超载时权重低的频道先因排队超时被丢包, 丢包计入计数
+#define EGRESS_MAX_CHN     256          // chnid_t 取值范围
+#define EGRESS_QUEUE_MAX   64           // 每频道最多排队的包数 (约一个发送窗口的若干倍)
+#define EGRESS_PKT_MAX     1536         // 单个数据报上限
+#define EGRESS_QUANTUM     1500         // 权重最高的频道每轮获得的字节额度
+#define EGRESS_MAX_DELAY_NS (200 * 1000000ULL)  // 超过出发时间仍未发出的包丢弃
+#define EGRESS_BUCKET_MS   20           // 令牌桶深度(按预算速率折算的毫秒数)
+#define EGRESS_REPORT_S    10           // 有丢包时的汇总日志间隔(秒)
+
+// 单个频道的计数
+typedef struct egress_chn_stats {
+    int weight;
+    uint64_t queued;            // 交给调度器的包数
+    uint64_t sent;
+    uint64_t sent_bytes;
+    uint64_t dropped_late;      // 排队超过 EGRESS_MAX_DELAY_NS 被丢弃
+    uint64_t dropped_full;      // 队列满丢弃最旧的包
+    uint32_t backlog;           // 当前排队包数
+} egress_chn_stats_t;
+
+// 函数声明
+int egress_parse_weights(const char *spec);                 // "chnid=weight[,chnid=weight...]"
+int egress_start(int sockfd, const struct sockaddr_in *dst, uint64_t budget_bps);
+int egress_enabled(void);
+int egress_submit(int chnid, const tx_pkt_t *pkts, int n);  // 复制入队, 返回入队的包数
+int egress_get_stats(int chnid, egress_chn_stats_t *stats); // 该频道从未入队返回 -1
+void egress_stop(void);
+
+#endif /* __EGRESS_H__ */
@@ -0,0 +1,476 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <syslog.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "handoff.h"
+#include "txtime.h"
+
+#define HANDOFF_TABLE_CHN 256   // chnid_t 取值范围
+
+// 交接消息: 消息头 + nchn 个频道状态, 套接字随同一条消息以 SCM_RIGHTS 传递
+// 新旧进程在同一台主机上, 字段按主机字节序
+typedef struct handoff_msg_hdr {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t nchn;
+    uint32_t fd_mask;           // 第 i 位表示消息中带有标签为 i 的套接字, 按标签顺序排列
+    uint32_t reserved;
+    uint64_t mono_ns;           // 生成快照时的 CLOCK_MONOTONIC
+} handoff_msg_hdr_t;
+
+typedef struct handoff_chn {
+    char name[HANDOFF_NAME_MAX];        // 频道目录名
+    char file[HANDOFF_FILE_MAX];        // 当前文件名
+    int64_t offset;                     // 当前文件内的读取偏移(帧边界)
+    uint64_t pk_next;
+    uint64_t media_pos;
+    uint32_t seq;
+    uint32_t media_rate;
+    int64_t depart_in_ns;               // 下一个包的出发时间 - 快照时刻
+} handoff_chn_t;
+
+#define HANDOFF_MSG_MAX (sizeof(handoff_msg_hdr_t) + HANDOFF_TABLE_CHN * sizeof(handoff_chn_t))
+
+// 频道任务登记的状态
+typedef struct chn_slot {
+    int used;
+    int parked;                 // 已停在批次边界
+    int idle;                   // 无人收听暂停中
+    handoff_tx_t tx;
+} chn_slot_t;
+
+static pthread_mutex_t g_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_cond = PTHREAD_COND_INITIALIZER;
+static chn_slot_t g_chn[HANDOFF_TABLE_CHN];
+static int g_pending = 0;
+
+static int g_export[HANDOFF_FD_MAX] = {-1, -1, -1, -1, -1};
+static handoff_quiesce_fn g_quiesce[HANDOFF_FD_MAX];
+static int g_inherit[HANDOFF_FD_MAX] = {-1, -1, -1, -1, -1};
+
+// 新进程: 交接得到的发送状态, 出发时间按快照时刻的相对值保存, 任务启动时换算
+static int g_has_resume[HANDOFF_TABLE_CHN];
+static handoff_tx_t g_resume[HANDOFF_TABLE_CHN];
+static int64_t g_resume_depart_in[HANDOFF_TABLE_CHN];
+static uint64_t g_snapshot_mono;
+static int g_peer_fd = -1;
+
+static int g_listen_fd = -1;
+static pthread_t g_tid;
+static char g_path[sizeof(((struct sockaddr_un *)0)->sun_path)];
+
+static uint64_t mono_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static void deadline_after_ms(struct timespec *ts, int ms) {
+    clock_gettime(CLOCK_REALTIME, ts);
+    ts->tv_sec += ms / 1000;
+    ts->tv_nsec += (long)(ms % 1000) * 1000000L;
+    if (ts->tv_nsec >= 1000000000L) {
+        ts->tv_sec++;
+        ts->tv_nsec -= 1000000000L;
+    }
+}
+
+static void set_timeout_ms(int fd, int ms) {
+    struct timeval tv = {ms / 1000, (ms % 1000) * 1000};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+}
+
+int handoff_inherit(int tag) {
+    if (tag < 0 || tag >= HANDOFF_FD_MAX) return -1;
+    int fd = g_inherit[tag];
+    g_inherit[tag] = -1;
+    return fd;
+}
+
+void handoff_export(int tag, int fd, handoff_quiesce_fn quiesce) {
+    if (tag < 0 || tag >= HANDOFF_FD_MAX) return;
+    pthread_mutex_lock(&g_mutex);
+    g_export[tag] = fd;
+    g_quiesce[tag] = quiesce;
+    pthread_mutex_unlock(&g_mutex);
+}
+
+// 停止或恢复各交接套接字上的接收, 只由交接线程调用
+static void handoff_quiesce(uint32_t fd_mask, int stop) {
+    for (int i = 0; i < HANDOFF_FD_MAX; i++) {
+        if ((fd_mask & (1u << i)) && g_quiesce[i]) g_quiesce[i](stop);
+    }
+}
+
+int handoff_resume(chnid_t chnid, handoff_tx_t *tx) {
+    pthread_mutex_lock(&g_mutex);
+    int has = g_has_resume[chnid];
+    if (has) {
+        *tx = g_resume[chnid];
+        int64_t left = g_resume_depart_in[chnid] - (int64_t)(mono_ns() - g_snapshot_mono);
+        tx->next_depart = (uint64_t)((int64_t)tx_now_ns() + left);
+        g_has_resume[chnid] = 0;
+    }
+    pthread_mutex_unlock(&g_mutex);
+    return has;
+}
+
+// 交接进行中时停下, 交接失败则继续运行; 成功时进程在交接线程中退出, 不会返回
+static void park_locked(chn_slot_t *s) {
+    while (g_pending) {
+        s->parked = 1;
+        pthread_cond_broadcast(&g_cond);
+        pthread_cond_wait(&g_cond, &g_mutex);
+    }
+    s->parked = 0;
+}
+
+void handoff_checkpoint(chnid_t chnid, const handoff_tx_t *tx) {
+    chn_slot_t *s = &g_chn[chnid];
+    pthread_mutex_lock(&g_mutex);
+    s->used = 1;
+    s->tx = *tx;
+    if (g_pending) park_locked(s);
+    pthread_mutex_unlock(&g_mutex);
+}
+
+void handoff_idle(chnid_t chnid, int idle) {
+    chn_slot_t *s = &g_chn[chnid];
+    pthread_mutex_lock(&g_mutex);
+    s->idle = idle;
+    if (idle) pthread_cond_broadcast(&g_cond);
+    else if (g_pending) park_locked(s);     // 交接期间被唤醒: 快照里已是暂停前的状态
+    pthread_mutex_unlock(&g_mutex);
+}
+
+// 旧进程: 让所有频道停下并生成快照, 返回消息长度; 有频道超时未停下时返回 0,
+// 此时它登记的状态可能已落后于发出的包, 交接会造成序列号重复, 由调用者放弃交接并恢复
+static size_t handoff_freeze(char *msg, int64_t *max_depart_in) {
+    handoff_msg_hdr_t *hdr = (handoff_msg_hdr_t *)msg;
+    handoff_chn_t *out = (handoff_chn_t *)(msg + sizeof(*hdr));
+    handoff_tx_t tx[HANDOFF_TABLE_CHN];
+    int used[HANDOFF_TABLE_CHN];
+
+    struct timespec deadline;
+    deadline_after_ms(&deadline, HANDOFF_PARK_MS);
+    pthread_mutex_lock(&g_mutex);
+    g_pending = 1;
+    for (;;) {
+        int waiting = 0;
+        for (int i = 0; i < HANDOFF_TABLE_CHN; i++) {
+            if (g_chn[i].used && !g_chn[i].parked && !g_chn[i].idle) waiting++;
+        }
+        if (waiting == 0) break;
+        if (pthread_cond_timedwait(&g_cond, &g_mutex, &deadline) == ETIMEDOUT) {
+            syslog(LOG_WARNING, "热升级: %d 个频道未能在 %d ms 内停下, 放弃交接", waiting, HANDOFF_PARK_MS);
+            pthread_mutex_unlock(&g_mutex);
+            return 0;
+        }
+    }
+    for (int i = 0; i < HANDOFF_TABLE_CHN; i++) {
+        used[i] = g_chn[i].used;
+        tx[i] = g_chn[i].tx;
+    }
+    hdr->fd_mask = 0;
+    for (int i = 0; i < HANDOFF_FD_MAX; i++) {
+        if (g_export[i] >= 0) hdr->fd_mask |= 1u << i;
+    }
+    pthread_mutex_unlock(&g_mutex);
+
+    uint64_t now_tx = tx_now_ns();
+    hdr->magic = HANDOFF_MAGIC;
+    hdr->version = HANDOFF_VERSION;
+    hdr->reserved = 0;
+    hdr->mono_ns = mono_ns();
+    int n = 0;
+    *max_depart_in = 0;
+    for (int i = 0; i < HANDOFF_TABLE_CHN; i++) {
+        if (!used[i]) continue;
+        handoff_chn_t *c = &out[n];
+        memset(c, 0, sizeof(*c));
+        int file_index;
+        long offset;
+        char path[4096];
+        if (media_lib_get_name((chnid_t)i, c->name, sizeof(c->name)) != 0 ||
+            media_lib_get_position((chnid_t)i, &file_index, &offset) != 0 ||
+            media_lib_get_file((chnid_t)i, file_index, path, sizeof(path)) < 0) {
+            continue;
+        }
+        const char *base = strrchr(path, '/');
+        base = base ? base + 1 : path;
+        if (strlen(base) >= sizeof(c->file)) continue;  // 文件名过长, 该频道不交接
+        strcpy(c->file, base);
+        c->offset = offset;
+        c->pk_next = tx[i].pk_next;
+        c->media_pos = tx[i].media_pos;
+        c->seq = tx[i].seq;
+        c->media_rate = tx[i].media_rate;
+        c->depart_in_ns = (int64_t)(tx[i].next_depart - now_tx);
+        if (c->depart_in_ns > *max_depart_in) *max_depart_in = c->depart_in_ns;
+        n++;
+    }
+    hdr->nchn = (uint16_t)n;
+    return sizeof(*hdr) + (size_t)n * sizeof(handoff_chn_t);
+}
+
+static void handoff_thaw(void) {
+    pthread_mutex_lock(&g_mutex);
+    g_pending = 0;
+    pthread_cond_broadcast(&g_cond);
+    pthread_mutex_unlock(&g_mutex);
+}
+
+// 处理一个热升级请求; 成功时不返回
+static void handoff_serve(int fd) {
+    uint32_t hello[2];
+    set_timeout_ms(fd, HANDOFF_ACK_MS);
+    if (recv(fd, hello, sizeof(hello), 0) != sizeof(hello) ||
+        hello[0] != HANDOFF_MAGIC || hello[1] != HANDOFF_VERSION) {
+        syslog(LOG_WARNING, "热升级: 无效的请求");
+        return;
+    }
+    syslog(LOG_INFO, "热升级: 新进程请求接管, 各频道在批次边界停下");
+
+    char *msg = malloc(HANDOFF_MSG_MAX);
+    if (!msg) return;
+    int64_t max_depart_in;
+    size_t len = handoff_freeze(msg, &max_depart_in);
+    if (len == 0) {
+        handoff_thaw();
+        uint32_t busy = HANDOFF_BUSY;
+        send(fd, &busy, sizeof(busy), MSG_NOSIGNAL);
+        free(msg);
+        return;
+    }
+    const handoff_msg_hdr_t *hdr = (const handoff_msg_hdr_t *)msg;
+    uint32_t fd_mask = hdr->fd_mask;
+
+    int fds[HANDOFF_FD_MAX];
+    int nfd = 0;
+    for (int i = 0; i < HANDOFF_FD_MAX; i++) {
+        if (hdr->fd_mask & (1u << i)) fds[nfd++] = g_export[i];
+    }
+    union {
+        char buf[CMSG_SPACE(sizeof(fds))];
+        struct cmsghdr align;
+    } control;
+    memset(&control, 0, sizeof(control));
+    struct iovec iov = {msg, len};
+    struct msghdr mh = {0};
+    mh.msg_iov = &iov;
+    mh.msg_iovlen = 1;
+    if (nfd > 0) {
+        mh.msg_control = control.buf;
+        mh.msg_controllen = CMSG_SPACE(sizeof(int) * nfd);
+        struct cmsghdr *cm = CMSG_FIRSTHDR(&mh);
+        cm->cmsg_level = SOL_SOCKET;
+        cm->cmsg_type = SCM_RIGHTS;
+        cm->cmsg_len = CMSG_LEN(sizeof(int) * nfd);
+        memcpy(CMSG_DATA(cm), fds, sizeof(int) * nfd);
+    }
+    int nchn = hdr->nchn;
+    // 套接字交出后只能由新进程接收: 先停掉本进程的接收线程和监听
+    handoff_quiesce(fd_mask, 1);
+    ssize_t sent = sendmsg(fd, &mh, MSG_NOSIGNAL);
+    free(msg);
+    if (sent != (ssize_t)len) {
+        syslog(LOG_ERR, "热升级: 发送快照失败: %s, 继续运行", strerror(errno));
+        handoff_quiesce(fd_mask, 0);
+        handoff_thaw();
+        return;
+    }
+
+    // 新进程确认已开始发送后退出; 未确认则认为新进程失败, 恢复发送
+    uint32_t ack;
+    if (recv(fd, &ack, sizeof(ack), 0) != sizeof(ack) || ack != HANDOFF_MAGIC) {
+        syslog(LOG_ERR, "热升级: 新进程未确认接管, 继续运行");
+        handoff_quiesce(fd_mask, 0);
+        handoff_thaw();
+        return;
+    }
+
+    // 已交给内核或出口调度线程的包在出发时间之前不能退出
+    int64_t drain_ms = max_depart_in / 1000000 + 1;
+    if (drain_ms > HANDOFF_DRAIN_MS) drain_ms = HANDOFF_DRAIN_MS;
+    if (drain_ms > 0) usleep((useconds_t)drain_ms * 1000);
+    syslog(LOG_INFO, "热升级: %d 个频道与 %d 个套接字已交给新进程, 退出", nchn, nfd);
+    closelog();
+    // 不做常规清理: shutdown 会作用于新进程共用的套接字
+    _exit(0);
+}
+
+static void *handoff_thread(void *arg) {
+    (void)arg;
+    for (;;) {
+        int fd = accept4(g_listen_fd, NULL, NULL, SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            break;
+        }
+        handoff_serve(fd);
+        close(fd);
+    }
+    return NULL;
+}
+
+static int unix_addr(struct sockaddr_un *addr, const char *path) {
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr->sun_path)) {
+        syslog(LOG_ERR, "热升级套接字路径过长: %s", path);
+        return -1;
+    }
+    strcpy(addr->sun_path, path);
+    return 0;
+}
+
+int handoff_take_over(const char *path) {
+    struct sockaddr_un addr;
+    if (unix_addr(&addr, path) != 0) return -1;
+    int fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        // 没有正在运行的旧进程: 正常启动
+        close(fd);
+        return 0;
+    }
+    uint32_t hello[2] = {HANDOFF_MAGIC, HANDOFF_VERSION};
+    set_timeout_ms(fd, HANDOFF_PARK_MS + HANDOFF_ACK_MS);
+    if (send(fd, hello, sizeof(hello), MSG_NOSIGNAL) != sizeof(hello)) {
+        close(fd);
+        return -1;
+    }
+
+    char *msg = malloc(HANDOFF_MSG_MAX);
+    if (!msg) {
+        close(fd);
+        return -1;
+    }
+    union {
+        char buf[CMSG_SPACE(sizeof(int) * HANDOFF_FD_MAX)];
+        struct cmsghdr align;
+    } control;
+    struct iovec iov = {msg, HANDOFF_MSG_MAX};
+    struct msghdr mh = {0};
+    mh.msg_iov = &iov;
+    mh.msg_iovlen = 1;
+    mh.msg_control = control.buf;
+    mh.msg_controllen = sizeof(control.buf);
+    ssize_t n = recvmsg(fd, &mh, MSG_CMSG_CLOEXEC);
+
+    // 先收下套接字, 消息无效时也要关闭它们
+    int fds[HANDOFF_FD_MAX];
+    int nfd = 0;
+    for (struct cmsghdr *cm = CMSG_FIRSTHDR(&mh); n > 0 && cm; cm = CMSG_NXTHDR(&mh, cm)) {
+        if (cm->cmsg_level != SOL_SOCKET || cm->cmsg_type != SCM_RIGHTS) continue;
+        nfd = (int)((cm->cmsg_len - CMSG_LEN(0)) / sizeof(int));
+        if (nfd > HANDOFF_FD_MAX) nfd = HANDOFF_FD_MAX;
+        memcpy(fds, CMSG_DATA(cm), sizeof(int) * nfd);
+    }
+    const handoff_msg_hdr_t *hdr = (const handoff_msg_hdr_t *)msg;
+    if (n == sizeof(uint32_t) && nfd == 0 && hdr->magic == HANDOFF_BUSY) {
+        syslog(LOG_ERR, "热升级: 旧进程有频道未能停下, 拒绝交接并继续运行");
+        free(msg);
+        close(fd);
+        return -1;
+    }
+    if (n < (ssize_t)sizeof(*hdr) || hdr->magic != HANDOFF_MAGIC || hdr->version != HANDOFF_VERSION ||
+        (size_t)n != sizeof(*hdr) + (size_t)hdr->nchn * sizeof(handoff_chn_t) ||
+        (mh.msg_flags & (MSG_TRUNC | MSG_CTRUNC)) || __builtin_popcount(hdr->fd_mask) != nfd) {
+        syslog(LOG_ERR, "热升级: 旧进程的快照无效");
+        for (int i = 0; i < nfd; i++) close(fds[i]);
+        free(msg);
+        close(fd);
+        return -1;
+    }
+
+    for (int i = 0, k = 0; i < HANDOFF_FD_MAX; i++) {
+        if (hdr->fd_mask & (1u << i)) g_inherit[i] = fds[k++];
+    }
+
+    // 按频道目录名和文件名对应, 新进程的媒体库可能已有增删
+    const handoff_chn_t *chn = (const handoff_chn_t *)(msg + sizeof(*hdr));
+    int restored = 0;
+    pthread_mutex_lock(&g_mutex);
+    g_snapshot_mono = hdr->mono_ns;
+    for (int i = 0; i < hdr->nchn; i++) {
+        const handoff_chn_t *c = &chn[i];
+        char name[HANDOFF_NAME_MAX + 1], file[HANDOFF_FILE_MAX + 1];
+        snprintf(name, sizeof(name), "%.*s", (int)sizeof(c->name), c->name);
+        snprintf(file, sizeof(file), "%.*s", (int)sizeof(c->file), c->file);
+        int chnid = media_lib_restore_position(name, file, (long)c->offset);
+        if (chnid < 0) {
+            syslog(LOG_WARNING, "热升级: 频道 %s 已不存在", name);
+            continue;
+        }
+        handoff_tx_t *tx = &g_resume[chnid];
+        tx->seq = c->seq;
+        tx->media_rate = c->media_rate;
+        tx->media_pos = c->media_pos;
+        tx->pk_next = c->pk_next;
+        tx->next_depart = 0;
+        g_resume_depart_in[chnid] = c->depart_in_ns;
+        g_has_resume[chnid] = 1;
+        restored++;
+    }
+    pthread_mutex_unlock(&g_mutex);
+    free(msg);
+    g_peer_fd = fd;
+    syslog(LOG_INFO, "热升级: 接管 %d 个频道与 %d 个套接字", restored, nfd);
+    return restored;
+}
+
+void handoff_finish(void) {
+    if (g_peer_fd < 0) return;
+    uint32_t ack = HANDOFF_MAGIC;
+    if (send(g_peer_fd, &ack, sizeof(ack), MSG_NOSIGNAL) != sizeof(ack)) {
+        syslog(LOG_WARNING, "热升级: 通知旧进程退出失败: %s", strerror(errno));
+    }
+    close(g_peer_fd);
+    g_peer_fd = -1;
+}
+
+int handoff_listen(const char *path) {
+    struct sockaddr_un addr;
+    if (unix_addr(&addr, path) != 0) return -1;
+    g_listen_fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (g_listen_fd < 0) {
+        syslog(LOG_ERR, "创建热升级套接字失败: %s", strerror(errno));
+        return -1;
+    }
+    int sndbuf = (int)HANDOFF_MSG_MAX * 2;
+    setsockopt(g_listen_fd, SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+    // 旧进程已交出套接字, 它的路径由新进程接替
+    unlink(path);
+    if (bind(g_listen_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(g_listen_fd, 1) < 0) {
+        syslog(LOG_ERR, "热升级套接字 %s 监听失败: %s", path, strerror(errno));
+        close(g_listen_fd);
+        g_listen_fd = -1;
+        return -1;
+    }
+    snprintf(g_path, sizeof(g_path), "%s", path);
+    if (pthread_create(&g_tid, NULL, handoff_thread, NULL) != 0) {
+        close(g_listen_fd);
+        g_listen_fd = -1;
+        unlink(path);
+        return -1;
+    }
+    syslog(LOG_INFO, "热升级监听 %s", path);
+    return 0;
+}
+
+void handoff_stop(void) {
+    if (g_listen_fd < 0) return;
+    shutdown(g_listen_fd, SHUT_RDWR);
+    pthread_join(g_tid, NULL);
+    close(g_listen_fd);
+    g_listen_fd = -1;
+    unlink(g_path);
+}
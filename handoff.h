@@ -0,0 +1,53 @@
+#ifndef __HANDOFF_H__
+#define __HANDOFF_H__
+
+#include <stdint.h>
+#include "mtk.h"
+
+// 热升级: 新进程连接旧进程的 Unix 套接字, 旧进程让各频道在批次边界停下,
+// 把监听/发送套接字(SCM_RIGHTS)与各频道的位置、序列号、节拍一次交给新进程;
+// 新进程从交接点继续发送, 旧进程等已排队的包发完后退出
+#define HANDOFF_MAGIC      0x484F4646   // "HOFF"
+#define HANDOFF_BUSY       0x42555359   // "BUSY": 有频道未能按时停下, 旧进程拒绝交接并继续运行
+#define HANDOFF_VERSION    1
+#define HANDOFF_PARK_MS    1000         // 等待各频道停在批次边界的上限
+#define HANDOFF_ACK_MS     5000         // 等待新进程确认接管的上限
+#define HANDOFF_DRAIN_MS   500          // 旧进程退出前等待已排队包发出的上限
+#define HANDOFF_NAME_MAX   64
+#define HANDOFF_FILE_MAX   256
+
+// 交接的套接字
+enum {
+    HANDOFF_FD_MCAST = 0,   // 组播发送
+    HANDOFF_FD_BURST,       // 入台补发 UDP
+    HANDOFF_FD_UNICAST,     // 单播TCP监听
+    HANDOFF_FD_ICY,         // HTTP监听
+    HANDOFF_FD_PRESENCE,    // 收听心跳 UDP
+    HANDOFF_FD_MAX
+};
+
+// 交出套接字前停止 (stop=1) 或交接失败后恢复 (stop=0) 本进程在该套接字上的接收,
+// 否则旧进程的接收线程会与新进程争抢同一个套接字上的请求和连接
+typedef void (*handoff_quiesce_fn)(int stop);
+
+// 频道任务的发送状态, 每批开始前交给 handoff_checkpoint
+typedef struct handoff_tx {
+    uint32_t seq;               // 下一个序列号
+    uint32_t media_rate;
+    uint64_t media_pos;         // 下一个包的媒体时间戳
+    uint64_t next_depart;       // 下一个包的出发时间 (tx_now_ns 时钟)
+    uint64_t pk_next;           // 预打包频道的下一个数据报, 实时分包为 UINT64_MAX
+} handoff_tx_t;
+
+// 函数声明
+int handoff_take_over(const char *path);            // 新进程: 从旧进程取得套接字与频道状态, 返回交接的频道数, 无旧进程返回 0, 交接失败返回 -1
+int handoff_inherit(int tag);                       // 取出交接得到的套接字, 没有返回 -1 (只能取一次)
+void handoff_export(int tag, int fd, handoff_quiesce_fn quiesce);   // 登记可交接的套接字及其接收者的暂停函数
+int handoff_resume(chnid_t chnid, handoff_tx_t *tx);    // 频道任务启动时取回交接的发送状态, 有返回 1
+void handoff_checkpoint(chnid_t chnid, const handoff_tx_t *tx); // 登记发送状态; 交接进行中则永久停在这里
+void handoff_idle(chnid_t chnid, int idle);         // 频道暂停期间不必等它停下
+void handoff_finish(void);                          // 新进程: 各频道已开始发送, 通知旧进程退出
+int handoff_listen(const char *path);               // 监听热升级请求 (后台线程)
+void handoff_stop(void);
+
+#endif /* __HANDOFF_H__ */
@@ -0,0 +1,120 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "heartbeat.h"
+
+static int g_sockfd = -1;
+static struct sockaddr_in g_dst;
+static int g_counts[HEARTBEAT_MAX_CHN];     // 每频道收听者数
+static int g_urgent = 0;                    // 有频道刚开始收听, 发送线程应立即发送
+static volatile int g_running = 0;
+static pthread_t g_tid;
+static pthread_mutex_t g_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_cond;
+
+// 汇总当前在听的频道并发送 (调用者持有锁)
+static void heartbeat_send_locked(void) {
+    presence_req_t req;
+    req.magic = htonl(PRESENCE_MAGIC);
+    req.version = htons(PROTO_VERSION);
+    req.interval_ms = htons(PRESENCE_INTERVAL_MS);
+    int n = 0;
+    for (int c = 0; c < HEARTBEAT_MAX_CHN; c++) {
+        if (g_counts[c] > 0) req.chnid[n++] = htons((uint16_t)c);
+        if (n == PRESENCE_MAX_CHN || (n > 0 && c == HEARTBEAT_MAX_CHN - 1)) {
+            req.count = htons((uint16_t)n);
+            size_t len = offsetof(presence_req_t, chnid) + (size_t)n * sizeof(req.chnid[0]);
+            if (sendto(g_sockfd, &req, len, 0, (struct sockaddr *)&g_dst, sizeof(g_dst)) < 0) {
+                fprintf(stderr, "[HB] 发送心跳失败: %s\n", strerror(errno));
+            }
+            n = 0;
+        }
+    }
+}
+
+static void *heartbeat_loop(void *arg) {
+    (void)arg;
+    unsigned seed = (unsigned)getpid() ^ (unsigned)time(NULL);
+    pthread_mutex_lock(&g_mutex);
+    while (g_running) {
+        // 周期在 [0.75, 1.25) 倍之间随机, 大量客户端不会同时发送
+        long wait_ms = PRESENCE_INTERVAL_MS * 3 / 4 + rand_r(&seed) % (PRESENCE_INTERVAL_MS / 2);
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        ts.tv_sec += wait_ms / 1000;
+        ts.tv_nsec += (wait_ms % 1000) * 1000000L;
+        if (ts.tv_nsec >= 1000000000L) {
+            ts.tv_sec++;
+            ts.tv_nsec -= 1000000000L;
+        }
+        while (g_running && !g_urgent) {
+            if (pthread_cond_timedwait(&g_cond, &g_mutex, &ts) == ETIMEDOUT) break;
+        }
+        if (!g_running) break;
+        g_urgent = 0;
+        heartbeat_send_locked();
+    }
+    pthread_mutex_unlock(&g_mutex);
+    return NULL;
+}
+
+int heartbeat_start(void) {
+    g_sockfd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (g_sockfd < 0) {
+        perror("[HB] socket");
+        return -1;
+    }
+    int ttl = 1;
+    setsockopt(g_sockfd, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl));
+    memset(&g_dst, 0, sizeof(g_dst));
+    g_dst.sin_family = AF_INET;
+    g_dst.sin_port = htons(PRESENCE_PORT);
+    inet_pton(AF_INET, GROUP_IP, &g_dst.sin_addr);
+
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&g_cond, &attr);
+    pthread_condattr_destroy(&attr);
+
+    g_running = 1;
+    if (pthread_create(&g_tid, NULL, heartbeat_loop, NULL) != 0) {
+        g_running = 0;
+        close(g_sockfd);
+        g_sockfd = -1;
+        return -1;
+    }
+    return 0;
+}
+
+void heartbeat_tune(uint16_t chnid, int delta) {
+    if (chnid >= HEARTBEAT_MAX_CHN) return;
+    pthread_mutex_lock(&g_mutex);
+    g_counts[chnid] += delta;
+    if (g_counts[chnid] < 0) g_counts[chnid] = 0;
+    // 新频道立即通知, 被暂停的频道在一个节拍内恢复; 离开频道不发送, 由服务器按过期处理
+    if (delta > 0 && g_counts[chnid] == delta && g_running) {
+        g_urgent = 1;
+        pthread_cond_signal(&g_cond);
+    }
+    pthread_mutex_unlock(&g_mutex);
+}
+
+void heartbeat_stop(void) {
+    if (!g_running) return;
+    pthread_mutex_lock(&g_mutex);
+    g_running = 0;
+    pthread_cond_signal(&g_cond);
+    pthread_mutex_unlock(&g_mutex);
+    pthread_join(g_tid, NULL);
+    close(g_sockfd);
+    g_sockfd = -1;
+    pthread_cond_destroy(&g_cond);
+}
@@ -0,0 +1,16 @@
+#ifndef __HEARTBEAT_H__
+#define __HEARTBEAT_H__
+
+#include <stdint.h>
+#include "proto.h"
+
+// 收听心跳: 进程内按频道累计收听者, 由一个发送线程把所有在听的频道汇总成一个心跳数据报,
+// 每 PRESENCE_INTERVAL_MS ±25% 随机抖动发往组播组; 某频道从无人收听变为有人收听时立即补发一次
+#define HEARTBEAT_MAX_CHN 256           // 频道ID取值范围
+
+// 函数声明
+int heartbeat_start(void);                          // 创建套接字与发送线程
+void heartbeat_tune(uint16_t chnid, int delta);     // 收听者计数 +1/-1
+void heartbeat_stop(void);
+
+#endif /* __HEARTBEAT_H__ */
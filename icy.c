@@ -0,0 +1,526 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <syslog.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include "icy.h"
+#include "handoff.h"
+
+static int g_listen_fd = -1;
+static int g_epoll_fd = -1;
+static int g_timer_fd = -1;
+static volatile int g_running = 0;
+static pthread_t g_loop_tid;
+static icy_conn_t *g_conns;                             // 所有连接
+static icy_conn_t *g_dead_conns;                        // 本轮事件处理完后再释放
+static int g_file_fds[ICY_MAX_CHN][MAX_AUDIO_FILES];    // 共享文件描述符 (fd+1, 0表示未打开)
+
+// epoll 中区分监听套接字与定时器的标记
+static int g_listen_tag, g_timer_tag;
+static pthread_mutex_t g_accept_mutex = PTHREAD_MUTEX_INITIALIZER;
+static int g_accept_paused = 0;                         // 监听套接字已交给新进程
+
+static double ts_elapsed(const struct timespec *from, const struct timespec *to) {
+    return (to->tv_sec - from->tv_sec) + (to->tv_nsec - from->tv_nsec) / 1e9;
+}
+
+// 打开(或复用)频道文件; sendfile 使用显式偏移, 同一个 fd 可被所有听众共享
+static int icy_file_fd(chnid_t chnid, int index, const char *path) {
+    int fd = g_file_fds[chnid][index] - 1;
+    if (fd < 0) {
+        fd = open(path, O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            fprintf(stderr, "[ICY] 打开 %s 失败: %s\n", path, strerror(errno));
+            return -1;
+        }
+        g_file_fds[chnid][index] = fd + 1;
+    }
+    return fd;
+}
+
+// 定位到第 index 个文件的 off 处, 并对齐到帧同步点; 只发送标签之间的音频数据
+static int icy_open_file(icy_conn_t *c, int index, off_t off) {
+    media_track_t track;
+    if (media_lib_get_track(c->chnid, index, &track) < 0) return -1;
+    c->file_fd = icy_file_fd(c->chnid, index, track.path);
+    if (c->file_fd < 0) return -1;
+    c->file_index = index;
+    c->file_end = track.audio_end;
+    if (off < track.audio_start || off >= track.audio_end) off = track.audio_start;
+
+    uint8_t probe[4096];
+    ssize_t n = pread(c->file_fd, probe, sizeof(probe), off);
+    int sync = n > 0 ? mp3_find_sync(probe, (size_t)n) : -1;
+    if (sync > 0) off += sync;
+    c->file_off = off;
+    // 按平均码率限速, VBR 文件也不会整体偏快或偏慢
+    c->byte_rate = (track.bitrate > 0 ? track.bitrate : 128) * 1000.0 / 8;
+
+    // 曲目标题: 标签中的 "艺术家 - 标题", 无标签时为文件名
+    if (track.artist[0])
+        snprintf(c->title, sizeof(c->title), "%s - %s", track.artist, track.title);
+    else
+        snprintf(c->title, sizeof(c->title), "%s", track.title);
+    // StreamTitle 以单引号界定, 去掉标题中的单引号
+    for (char *q = c->title; *q; q++) {
+        if (*q == '\'') *q = '`';
+    }
+    c->title_dirty = 1;
+    return 0;
+}
+
+// 切到频道的下一个文件
+static int icy_next_file(icy_conn_t *c) {
+    char path[PATH_MAX];
+    int count = media_lib_get_file(c->chnid, 0, path, sizeof(path));
+    if (count <= 0) return -1;
+    return icy_open_file(c, (c->file_index + 1) % count, 0);
+}
+
+// 生成元数据块: 长度字节(16字节为单位) + StreamTitle; 标题未变时只有一个 0 字节
+static void icy_build_meta(icy_conn_t *c) {
+    c->out_sent = 0;
+    if (!c->title_dirty) {
+        c->out[0] = 0;
+        c->out_len = 1;
+        return;
+    }
+    char meta[16 * 255 + 1];
+    int len = snprintf(meta, sizeof(meta), "StreamTitle='%s';", c->title);
+    if (len < 0 || len >= (int)sizeof(meta)) len = sizeof(meta) - 1;
+    int blocks = (len + 15) / 16;
+    memset(c->out, 0, 1 + blocks * 16);
+    c->out[0] = (char)blocks;
+    memcpy(c->out + 1, meta, len);
+    c->out_len = 1 + blocks * 16;
+    c->title_dirty = 0;
+}
+
+static void conn_set_blocked(icy_conn_t *c, int blocked) {
+    if (c->blocked == blocked) return;
+    struct epoll_event ev;
+    ev.events = EPOLLIN | (blocked ? EPOLLOUT : 0);
+    ev.data.ptr = c;
+    epoll_ctl(g_epoll_fd, EPOLL_CTL_MOD, c->fd, &ev);
+    c->blocked = blocked;
+}
+
+// 关闭连接; 内存延后到 free_dead_conns 释放
+static void conn_close(icy_conn_t *c) {
+    if (c->fd < 0) return;
+    if (c->prev) c->prev->next = c->next;
+    else g_conns = c->next;
+    if (c->next) c->next->prev = c->prev;
+    epoll_ctl(g_epoll_fd, EPOLL_CTL_DEL, c->fd, NULL);
+    close(c->fd);
+    c->fd = -1;
+    c->next = g_dead_conns;
+    g_dead_conns = c;
+}
+
+static void free_dead_conns(void) {
+    while (g_dead_conns) {
+        icy_conn_t *next = g_dead_conns->next;
+        free(g_dead_conns);
+        g_dead_conns = next;
+    }
+}
+
+// 发送输出缓冲; 返回 1 已发完, 0 阻塞, -1 出错
+static int conn_flush_out(icy_conn_t *c) {
+    while (c->out_sent < c->out_len) {
+        ssize_t n = send(c->fd, c->out + c->out_sent, c->out_len - c->out_sent,
+                         MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                conn_set_blocked(c, 1);
+                return 0;
+            }
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        c->out_sent += (size_t)n;
+    }
+    c->out_len = c->out_sent = 0;
+    return 1;
+}
+
+// 补充令牌: 按码率累积, 上限为预缓冲时长
+static void conn_refill(icy_conn_t *c, const struct timespec *now) {
+    c->credit += c->byte_rate * ts_elapsed(&c->last, now);
+    double cap = c->byte_rate * ICY_PREBUFFER_SEC;
+    if (c->credit > cap) c->credit = cap;
+    c->last = *now;
+}
+
+// 推送: 响应头/元数据用 send, 音频用 sendfile; 返回 -1 表示连接应关闭
+static int conn_pump(icy_conn_t *c) {
+    while (!c->blocked) {
+        if (c->out_len > 0) {
+            int ret = conn_flush_out(c);
+            if (ret <= 0) return ret;
+            if (c->close_after) return -1;
+            if (c->state == ICY_SEND_HDR) c->state = ICY_STREAM;
+            continue;
+        }
+        if (c->state != ICY_STREAM || c->credit < 1) return 0;
+
+        if (c->file_off >= c->file_end && icy_next_file(c) < 0) return -1;
+
+        size_t n = ICY_SENDFILE_MAX;
+        if ((double)n > c->credit) n = (size_t)c->credit;
+        if ((off_t)n > c->file_end - c->file_off) n = (size_t)(c->file_end - c->file_off);
+        if (c->metaint && n > c->until_meta) n = c->until_meta;
+
+        ssize_t sent = sendfile(c->fd, c->file_fd, &c->file_off, n);
+        if (sent < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                conn_set_blocked(c, 1);
+                return 0;
+            }
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        if (sent == 0) {
+            c->file_off = c->file_end;    // 文件被截断, 切下一个
+            continue;
+        }
+        c->credit -= (double)sent;
+        if (c->metaint) {
+            c->until_meta -= (size_t)sent;
+            if (c->until_meta == 0) {
+                icy_build_meta(c);
+                c->until_meta = (size_t)c->metaint;
+            }
+        }
+    }
+    return 0;
+}
+
+// 频道列表: 每行 "频道ID 描述"
+static void icy_reply_list(icy_conn_t *c) {
+    mlib_list_entry *list = NULL;
+    int count = 0;
+    int len = snprintf(c->out, sizeof(c->out),
+                       "HTTP/1.0 200 OK\r\nContent-Type: text/plain; charset=utf-8\r\n"
+                       "Connection: close\r\n\r\n");
+    if (media_lib_get_chn_list(&list, &count) == 0) {
+        for (int i = 0; i < count; i++) {
+            if (len < (int)sizeof(c->out)) {
+                len += snprintf(c->out + len, sizeof(c->out) - len, "/%d %s\n",
+                                list[i].chnid, list[i].descr);
+            }
+            free(list[i].descr);
+        }
+        free(list);
+    }
+    c->out_len = len < (int)sizeof(c->out) ? (size_t)len : sizeof(c->out) - 1;
+    c->close_after = 1;
+}
+
+static void icy_reply_error(icy_conn_t *c, const char *status) {
+    c->out_len = (size_t)snprintf(c->out, sizeof(c->out),
+                                  "HTTP/1.0 %s\r\nConnection: close\r\n\r\n", status);
+    c->close_after = 1;
+}
+
+// 解析请求: GET / 返回频道列表, GET /<频道ID> 开始推流
+// 请求头中是否有 Icy-MetaData 且值非零; 头名不分大小写, 冒号两侧允许空白, 值按数字比较 ("01" 也算)
+static int icy_wants_meta(const char *req) {
+    static const char name[] = "Icy-MetaData";
+    const char *line = strchr(req, '\n');      // 跳过请求行
+    while (line) {
+        line++;
+        const char *colon = strchr(line, ':');
+        const char *eol = strchr(line, '\n');
+        if (!colon || (eol && colon > eol)) {
+            line = eol;
+            continue;
+        }
+        const char *name_end = colon;
+        while (name_end > line && (name_end[-1] == ' ' || name_end[-1] == '\t')) name_end--;
+        if ((size_t)(name_end - line) == sizeof(name) - 1 && strncasecmp(line, name, sizeof(name) - 1) == 0) {
+            const char *v = colon + 1;
+            while (*v == ' ' || *v == '\t') v++;
+            char *end;
+            long val = strtol(v, &end, 10);
+            return end != v && val > 0;
+        }
+        line = eol;
+    }
+    return 0;
+}
+
+static void icy_handle_request(icy_conn_t *c) {
+    char path[256];
+    if (sscanf(c->req, "GET %255s", path) != 1) {
+        icy_reply_error(c, "400 Bad Request");
+        return;
+    }
+    if (strcmp(path, "/") == 0) {
+        icy_reply_list(c);
+        return;
+    }
+
+    char *end = NULL;
+    long chnid = strtol(path + 1, &end, 10);
+    char descr[256];
+    if (end == path + 1 || (*end && strcasecmp(end, ".mp3") != 0) ||
+        chnid < 0 || chnid >= ICY_MAX_CHN ||
+        media_lib_get_descr((chnid_t)chnid, descr, sizeof(descr)) < 0) {
+        icy_reply_error(c, "404 Not Found");
+        return;
+    }
+
+    // 从频道当前的直播位置开始
+    c->chnid = (chnid_t)chnid;
+    int index;
+    long off;
+    if (media_lib_get_position(c->chnid, &index, &off) < 0 || icy_open_file(c, index, off) < 0) {
+        icy_reply_error(c, "503 Service Unavailable");
+        return;
+    }
+    c->metaint = icy_wants_meta(c->req) ? ICY_METAINT : 0;
+    c->until_meta = (size_t)c->metaint;
+    c->credit = c->byte_rate * ICY_PREBUFFER_SEC;
+    clock_gettime(CLOCK_MONOTONIC, &c->last);
+
+    int len = snprintf(c->out, sizeof(c->out),
+                       "HTTP/1.0 200 OK\r\n"
+                       "Content-Type: audio/mpeg\r\n"
+                       "icy-name: %s\r\n"
+                       "icy-br: %d\r\n"
+                       "Cache-Control: no-cache\r\n"
+                       "Connection: close\r\n",
+                       descr, (int)(c->byte_rate * 8 / 1000));
+    if (c->metaint) {
+        len += snprintf(c->out + len, sizeof(c->out) - len, "icy-metaint: %d\r\n", c->metaint);
+    }
+    len += snprintf(c->out + len, sizeof(c->out) - len, "\r\n");
+    c->out_len = (size_t)len;
+    c->state = ICY_SEND_HDR;
+}
+
+// 读取请求头; 推流阶段收到的数据直接丢弃
+static int conn_read(icy_conn_t *c) {
+    while (1) {
+        char discard[512];
+        char *dst = discard;
+        size_t room = sizeof(discard);
+        if (c->state == ICY_READ_REQ) {
+            dst = c->req + c->req_len;
+            room = sizeof(c->req) - 1 - c->req_len;
+            if (room == 0) return -1;   // 请求头过长
+        }
+        ssize_t n = recv(c->fd, dst, room, MSG_DONTWAIT);
+        if (n == 0) return -1;
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return 0;
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        if (c->state != ICY_READ_REQ) continue;
+        c->req_len += (size_t)n;
+        c->req[c->req_len] = '\0';
+        if (strstr(c->req, "\r\n\r\n")) {
+            icy_handle_request(c);
+            return conn_pump(c);
+        }
+    }
+}
+
+static void accept_conns_locked(void) {
+    while (1) {
+        int fd = accept4(g_listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                fprintf(stderr, "[ICY] accept失败: %s\n", strerror(errno));
+            }
+            return;
+        }
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+        icy_conn_t *c = calloc(1, sizeof(*c));
+        if (!c) {
+            close(fd);
+            continue;
+        }
+        c->fd = fd;
+        c->file_fd = -1;
+        struct epoll_event ev;
+        ev.events = EPOLLIN;
+        ev.data.ptr = c;
+        if (epoll_ctl(g_epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+            close(fd);
+            free(c);
+            continue;
+        }
+        c->next = g_conns;
+        if (g_conns) g_conns->prev = c;
+        g_conns = c;
+    }
+}
+
+static void accept_conns(void) {
+    pthread_mutex_lock(&g_accept_mutex);
+    if (!g_accept_paused) accept_conns_locked();
+    pthread_mutex_unlock(&g_accept_mutex);
+}
+
+// 热升级: 交出监听套接字前把它移出 epoll 并等进行中的 accept 结束, 交接失败时放回
+static void icy_quiesce(int stop) {
+    pthread_mutex_lock(&g_accept_mutex);
+    g_accept_paused = stop;
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.ptr = &g_listen_tag;
+    epoll_ctl(g_epoll_fd, stop ? EPOLL_CTL_DEL : EPOLL_CTL_ADD, g_listen_fd, &ev);
+    pthread_mutex_unlock(&g_accept_mutex);
+}
+
+// 节拍: 给所有推流中的连接补充令牌并发送
+static void icy_tick(void) {
+    uint64_t expirations;
+    ssize_t ret = read(g_timer_fd, &expirations, sizeof(expirations));
+    (void)ret;
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    for (icy_conn_t *c = g_conns, *next; c; c = next) {
+        next = c->next;
+        if (c->state != ICY_STREAM) continue;
+        conn_refill(c, &now);
+        if (!c->blocked && conn_pump(c) < 0) conn_close(c);
+    }
+}
+
+static void *icy_loop(void *arg) {
+    (void)arg;
+    struct epoll_event events[ICY_MAX_EVENTS];
+    while (g_running) {
+        int n = epoll_wait(g_epoll_fd, events, ICY_MAX_EVENTS, 1000);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        for (int i = 0; i < n; i++) {
+            void *ptr = events[i].data.ptr;
+            if (ptr == &g_listen_tag) {
+                accept_conns();
+                continue;
+            }
+            if (ptr == &g_timer_tag) {
+                icy_tick();
+                continue;
+            }
+            icy_conn_t *c = ptr;
+            uint32_t ev = events[i].events;
+            if (c->fd < 0) continue;
+            if (ev & (EPOLLERR | EPOLLHUP)) {
+                conn_close(c);
+                continue;
+            }
+            if (ev & EPOLLOUT) {
+                conn_set_blocked(c, 0);
+                if (conn_pump(c) < 0) {
+                    conn_close(c);
+                    continue;
+                }
+            }
+            if ((ev & EPOLLIN) && conn_read(c) < 0) {
+                conn_close(c);
+            }
+        }
+        free_dead_conns();
+    }
+
+    while (g_conns) conn_close(g_conns);
+    free_dead_conns();
+    return NULL;
+}
+
+// 启动HTTP监听与事件循环线程
+int icy_start(int port) {
+    g_listen_fd = handoff_inherit(HANDOFF_FD_ICY);
+    if (g_listen_fd < 0) {
+        g_listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (g_listen_fd < 0) {
+            syslog(LOG_ERR, "创建HTTP监听套接字失败: %s", strerror(errno));
+            return -1;
+        }
+        int reuse = 1;
+        setsockopt(g_listen_fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+        struct sockaddr_in addr = {0};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_ANY);
+        addr.sin_port = htons(port);
+        if (bind(g_listen_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+            listen(g_listen_fd, SOMAXCONN) < 0) {
+            syslog(LOG_ERR, "HTTP监听端口 %d 失败: %s", port, strerror(errno));
+            close(g_listen_fd);
+            g_listen_fd = -1;
+            return -1;
+        }
+    }
+    handoff_export(HANDOFF_FD_ICY, g_listen_fd, icy_quiesce);
+
+    g_epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    g_timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (g_epoll_fd < 0 || g_timer_fd < 0) {
+        syslog(LOG_ERR, "创建epoll/timerfd失败: %s", strerror(errno));
+        icy_stop();
+        return -1;
+    }
+    struct itimerspec its = {0};
+    its.it_interval.tv_nsec = ICY_TICK_MS * 1000000L;
+    its.it_value = its.it_interval;
+    timerfd_settime(g_timer_fd, 0, &its, NULL);
+
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.ptr = &g_listen_tag;
+    epoll_ctl(g_epoll_fd, EPOLL_CTL_ADD, g_listen_fd, &ev);
+    ev.events = EPOLLIN;
+    ev.data.ptr = &g_timer_tag;
+    epoll_ctl(g_epoll_fd, EPOLL_CTL_ADD, g_timer_fd, &ev);
+
+    g_running = 1;
+    if (pthread_create(&g_loop_tid, NULL, icy_loop, NULL) != 0) {
+        g_running = 0;
+        icy_stop();
+        return -1;
+    }
+    syslog(LOG_INFO, "HTTP/ICY推流监听 %d", port);
+    return 0;
+}
+
+void icy_stop(void) {
+    if (g_running) {
+        g_running = 0;
+        pthread_join(g_loop_tid, NULL);
+    }
+    if (g_listen_fd >= 0) close(g_listen_fd);
+    if (g_epoll_fd >= 0) close(g_epoll_fd);
+    if (g_timer_fd >= 0) close(g_timer_fd);
+    g_listen_fd = g_epoll_fd = g_timer_fd = -1;
+    for (int ch = 0; ch < ICY_MAX_CHN; ch++) {
+        for (int i = 0; i < MAX_AUDIO_FILES; i++) {
+            if (g_file_fds[ch][i] > 0) {
+                close(g_file_fds[ch][i] - 1);
+                g_file_fds[ch][i] = 0;
+            }
+        }
+    }
+}
@@ -0,0 +1,62 @@
+#ifndef __ICY_H__
+#define __ICY_H__
+
+#include <stdint.h>
+#include <time.h>
+#include <sys/types.h>
+#include "mtk.h"
+
+// HTTP/ICY (Shoutcast/Icecast兼容) 推流: 音频字节经 sendfile 从媒体文件直接进入套接字
+#define ICY_PORT          8000
+#define ICY_METAINT       16000            // 元数据间隔(字节)
+#define ICY_PREBUFFER_SEC 2                // 连接建立时允许超前发送的秒数
+#define ICY_TICK_MS       20               // 发送节拍
+#define ICY_REQ_MAX       4096             // 请求头最大长度
+#define ICY_OUT_MAX       4096             // 响应头/元数据块缓冲
+#define ICY_SENDFILE_MAX  (64 * 1024)      // 单次 sendfile 上限
+#define ICY_MAX_EVENTS    256
+#define ICY_MAX_CHN       256
+#define ICY_TITLE_MAX     (TAG_TEXT_MAX * 2 + 4)
+
+// 连接状态
+typedef enum {
+    ICY_READ_REQ = 0,       // 读取HTTP请求头
+    ICY_SEND_HDR,           // 发送响应头
+    ICY_STREAM,             // 推送音频
+} icy_state_t;
+
+// 一个HTTP听众
+typedef struct icy_conn {
+    int fd;
+    icy_state_t state;
+    int close_after;                // 输出缓冲发完后关闭(频道列表/错误响应)
+    int blocked;                    // 等待 EPOLLOUT
+    chnid_t chnid;
+
+    char req[ICY_REQ_MAX];
+    size_t req_len;
+    char out[ICY_OUT_MAX];          // 待发送的响应头或元数据块
+    size_t out_len, out_sent;
+
+    int file_index;                 // 当前文件
+    int file_fd;                    // 共享的文件描述符(不归连接所有)
+    off_t file_off;
+    off_t file_end;                 // 音频数据结束偏移(不含尾部标签)
+
+    int metaint;                    // 0 表示客户端未请求元数据
+    size_t until_meta;              // 距下一个元数据块的音频字节数
+    char title[ICY_TITLE_MAX];      // 当前曲目标题
+    int title_dirty;                // 标题变化后在下一个元数据块中发送
+
+    double byte_rate;               // 按当前文件码率计算的每秒字节数
+    double credit;                  // 令牌桶: 当前允许发送的音频字节数
+    struct timespec last;           // 上次补充令牌的时间
+
+    struct icy_conn *prev, *next;
+} icy_conn_t;
+
+// 函数声明
+int icy_start(int port);            // 启动HTTP监听与事件循环线程
+void icy_stop(void);
+
+#endif /* __ICY_H__ */
@@ -0,0 +1,889 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+#include <netdb.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include "loadgen.h"
+#include "heartbeat.h"
+
+// 听众状态
+enum {
+    LS_IDLE = 0,        // 尚未到首次入台时间
+    LS_JOINING,         // 已发起入台, 等待第一个同步包
+    LS_PLAYING,
+};
+
+// 虚拟听众; 只由所属线程访问
+typedef struct vlistener {
+    int id;
+    int state;
+    int chn_idx;                // 当前频道在 conf->chnids 中的下标
+    uint16_t chnid;
+    int64_t join_start_us;
+    int64_t next_zap_us;
+
+    // 序列号连续性: bit k 表示 next_seq-1-k 已收到
+    int have_seq;
+    uint32_t next_seq;
+    uint64_t recv_mask;
+
+    // 到达抖动 (RFC 3550)
+    int has_transit;
+    int64_t last_transit_us;
+    double jitter_ms;
+
+    // 组播补发: 补发进行中到达的组播包先暂存序列号与长度, 结束标记到达后再按序校验
+    int fd;                     // 补发UDP套接字(组播) 或 TCP连接(单播), -1 表示无
+    int burst_active;
+    int have_burst_last;        // 补发已结束, burst_last 之前的组播包已在补发中收过
+    uint32_t burst_last;
+    int64_t burst_start_us;
+    uint32_t burst_cookie;      // 补发服务下发的验证码, 换台时沿用
+    int burst_echoed;           // 本次请求已回显过验证码
+    struct { uint32_t seq; uint32_t data_len; uint8_t flags; } pend[LOADGEN_PEND_MAX];
+    int npend;
+
+    // 单播TCP接收缓冲
+    char *rbuf;
+    size_t rlen;
+
+    struct vlistener *next_on_chn;  // 组播: 同频道听众链表
+} vlistener_t;
+
+typedef struct lg_thread {
+    int idx;
+    pthread_t tid;
+    pthread_mutex_t mutex;      // 保护 stats 与听众的抖动值, 报告线程读取时加锁
+    loadgen_stats_t stats;
+    vlistener_t *ls;
+    int nls;
+    vlistener_t *chn_head[LOADGEN_MAX_CHN];
+    int epfd;
+    int mcast_fd;
+    unsigned int seed;
+    char *bufs;                 // LOADGEN_VLEN 个接收缓冲
+    struct mmsghdr msgs[LOADGEN_VLEN];
+    struct iovec iovs[LOADGEN_VLEN];
+    struct sockaddr_in addrs[LOADGEN_VLEN];
+} lg_thread_t;
+
+static const loadgen_conf_t *g_conf;
+static lg_thread_t *g_threads;
+static int g_nthreads;
+static volatile int g_running = 0;
+static int64_t g_start_us;
+
+// 组播模式下从第一个组播包得知服务器地址, 用于发送补发请求
+static pthread_mutex_t g_server_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct sockaddr_in g_server;
+static int g_server_known = 0;
+
+static int64_t now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static int64_t wall_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void on_signal(int sig) {
+    (void)sig;
+    g_running = 0;
+}
+
+const char *loadgen_zap_name(loadgen_zap_t zap) {
+    switch (zap) {
+    case LOADGEN_ZAP_RANDOM: return "random";
+    case LOADGEN_ZAP_CYCLE:  return "cycle";
+    case LOADGEN_ZAP_HERD:   return "herd";
+    default:                 return "none";
+    }
+}
+
+int loadgen_parse_zap(const char *spec, loadgen_conf_t *conf) {
+    static const loadgen_zap_t modes[] = {
+        LOADGEN_ZAP_NONE, LOADGEN_ZAP_RANDOM, LOADGEN_ZAP_CYCLE, LOADGEN_ZAP_HERD,
+    };
+    const char *colon = strchr(spec, ':');
+    size_t n = colon ? (size_t)(colon - spec) : strlen(spec);
+    for (size_t i = 0; i < sizeof(modes) / sizeof(modes[0]); i++) {
+        const char *name = loadgen_zap_name(modes[i]);
+        if (strlen(name) == n && strncmp(spec, name, n) == 0) {
+            conf->zap = modes[i];
+            if (colon) conf->zap_interval_ms = (int)(atof(colon + 1) * 1000);
+            return conf->zap_interval_ms > 0 || conf->zap == LOADGEN_ZAP_NONE ? 0 : -1;
+        }
+    }
+    return -1;
+}
+
+/* ---------- 序列号与抖动校验 ---------- */
+
+static void track_reset(vlistener_t *l, uint32_t seq) {
+    l->have_seq = 1;
+    l->next_seq = seq + 1;
+    l->recv_mask = 1;
+}
+
+static void track_seq(lg_thread_t *t, vlistener_t *l, uint32_t seq) {
+    if (!l->have_seq) {
+        track_reset(l, seq);
+        return;
+    }
+    int32_t delta = (int32_t)(seq - l->next_seq);
+    if (delta > LOADGEN_MAX_DROPOUT || delta < -LOADGEN_MAX_DROPOUT) {
+        t->stats.resyncs++;
+        track_reset(l, seq);
+    } else if (delta >= 0) {
+        uint32_t step = (uint32_t)delta + 1;
+        t->stats.lost += (uint64_t)delta;
+        l->recv_mask = (step >= 64 ? 0 : l->recv_mask << step) | 1;
+        l->next_seq = seq + 1;
+    } else {
+        uint32_t k = (uint32_t)(-delta) - 1;    // 相对 next_seq-1 的距离
+        if (k >= 64) {
+            t->stats.reordered++;               // 太晚, 无法判断是否重复
+        } else if (l->recv_mask & (1ULL << k)) {
+            t->stats.duplicates++;
+        } else {
+            l->recv_mask |= 1ULL << k;
+            t->stats.reordered++;
+            if (t->stats.lost > 0) t->stats.lost--;     // 之前按丢包计过
+        }
+    }
+}
+
+static void track_jitter(vlistener_t *l, const pkt_info_t *info, int64_t now) {
+    if (info->sample_rate == 0) return;
+    int64_t media_us = (int64_t)(info->media_ts * 1000000ULL / info->sample_rate);
+    int64_t transit = now - media_us;
+    if (l->has_transit) {
+        int64_t d = transit - l->last_transit_us;
+        if (d < 0) d = -d;
+        l->jitter_ms += ((double)d / 1000.0 - l->jitter_ms) / 16.0;
+    }
+    l->last_transit_us = transit;
+    l->has_transit = 1;
+}
+
+/* ---------- 入台与换台 ---------- */
+
+static void chn_unlink(lg_thread_t *t, vlistener_t *l) {
+    vlistener_t **pp = &t->chn_head[l->chnid];
+    while (*pp && *pp != l) pp = &(*pp)->next_on_chn;
+    if (*pp) *pp = l->next_on_chn;
+    l->next_on_chn = NULL;
+}
+
+static void send_burst_request(lg_thread_t *t, vlistener_t *l, int64_t now) {
+    pthread_mutex_lock(&g_server_mutex);
+    int known = g_server_known;
+    struct sockaddr_in addr = g_server;
+    pthread_mutex_unlock(&g_server_mutex);
+    if (!known || l->fd < 0) return;
+
+    addr.sin_port = htons(BURST_PORT);
+    burst_req_t req;
+    req.magic = htonl(BURST_MAGIC);
+    req.channel_id = htons(l->chnid);
+    req.version = htons(PROTO_VERSION);
+    req.cookie = l->burst_cookie;
+    if (sendto(l->fd, &req, sizeof(req), 0, (struct sockaddr *)&addr, sizeof(addr)) == sizeof(req)) {
+        l->burst_active = 1;
+        l->burst_echoed = 0;
+        l->burst_start_us = now;
+        l->npend = 0;
+        t->stats.burst_reqs++;
+    }
+}
+
+static int send_subscribe(vlistener_t *l) {
+    unicast_req_t req;
+    req.magic = htonl(UNICAST_MAGIC);
+    req.channel_id = htons(l->chnid);
+    req.version = htons(PROTO_VERSION);
+    return send(l->fd, &req, sizeof(req), MSG_NOSIGNAL) == sizeof(req) ? 0 : -1;
+}
+
+static int64_t next_zap_time(lg_thread_t *t, int64_t now) {
+    int64_t iv = (int64_t)g_conf->zap_interval_ms * 1000;
+    switch (g_conf->zap) {
+    case LOADGEN_ZAP_RANDOM:
+        return now + iv / 2 + (int64_t)((double)rand_r(&t->seed) / RAND_MAX * (double)iv);
+    case LOADGEN_ZAP_CYCLE:
+        return now + iv;
+    case LOADGEN_ZAP_HERD:
+        // 对齐到全局时间格, 所有听众在同一时刻换台
+        return g_start_us + ((now - g_start_us) / iv + 1) * iv;
+    default:
+        return INT64_MAX;
+    }
+}
+
+static void listener_join(lg_thread_t *t, vlistener_t *l, int chn_idx, int64_t now) {
+    if (l->state != LS_IDLE && !g_conf->unicast_host) {
+        chn_unlink(t, l);
+        heartbeat_tune(l->chnid, -1);
+    }
+    l->chn_idx = chn_idx;
+    l->chnid = g_conf->chnids[chn_idx];
+    l->state = LS_JOINING;
+    l->join_start_us = now;
+    l->have_seq = 0;
+    l->has_transit = 0;
+    l->jitter_ms = 0;
+    l->burst_active = 0;
+    l->have_burst_last = 0;
+    l->npend = 0;
+    t->stats.zaps++;
+
+    if (g_conf->unicast_host) {
+        if (l->fd >= 0 && send_subscribe(l) != 0) {
+            fprintf(stderr, "[LOAD] 听众%d 发送订阅失败: %s\n", l->id, strerror(errno));
+        }
+    } else {
+        l->next_on_chn = t->chn_head[l->chnid];
+        t->chn_head[l->chnid] = l;
+        heartbeat_tune(l->chnid, 1);    // 进程内所有听众汇总成一个心跳
+        if (g_conf->burst) send_burst_request(t, l, now);
+    }
+}
+
+static void listener_zap(lg_thread_t *t, vlistener_t *l, int64_t now) {
+    int n = g_conf->nchn;
+    int next = l->chn_idx;
+    if (g_conf->zap == LOADGEN_ZAP_CYCLE) {
+        next = (l->chn_idx + 1) % n;
+    } else if (n > 1) {
+        next = (l->chn_idx + 1 + rand_r(&t->seed) % (n - 1)) % n;    // 换到另一个频道
+    }
+    listener_join(t, l, next, now);
+}
+
+/* ---------- 包处理 ---------- */
+
+// 经过入台判断后计入一个可播放的包
+static void listener_accept(lg_thread_t *t, vlistener_t *l, const pkt_info_t *info, int live, int64_t now) {
+    if (l->state == LS_JOINING) {
+        if (!(info->flags & PKT_F_SYNC)) return;   // 入台后从第一个同步包起播
+        int64_t lat = now - l->join_start_us;
+        int64_t ms = lat / 1000;
+        t->stats.join_hist[ms > LOADGEN_HIST_MS ? LOADGEN_HIST_MS : ms]++;
+        t->stats.joins++;
+        t->stats.join_us_sum += (uint64_t)lat;
+        if ((uint64_t)lat > t->stats.join_us_max) t->stats.join_us_max = (uint64_t)lat;
+        l->state = LS_PLAYING;
+    }
+    track_seq(t, l, info->seq_num);
+    if (live) track_jitter(l, info, now);
+    t->stats.packets++;
+    t->stats.bytes += info->data_len;
+}
+
+// 补发结束(收到结束标记或超时): 按序补校验期间暂存的组播包, 已被补发覆盖的跳过
+static void burst_finish(lg_thread_t *t, vlistener_t *l, int have_last, uint32_t last, int64_t now) {
+    l->burst_active = 0;
+    l->have_burst_last = have_last;
+    l->burst_last = last;
+    for (int i = 0; i < l->npend; i++) {
+        if (have_last && (int32_t)(l->pend[i].seq - last) <= 0) continue;
+        pkt_info_t info = {0};
+        info.channel_id = l->chnid;
+        info.seq_num = l->pend[i].seq;
+        info.flags = l->pend[i].flags;
+        info.data_len = l->pend[i].data_len;
+        listener_accept(t, l, &info, 0, now);
+    }
+    l->npend = 0;
+}
+
+static void listener_packet(lg_thread_t *t, vlistener_t *l, const pkt_info_t *info, int from_burst,
+                            int64_t now) {
+    if (info->channel_id != l->chnid || l->state == LS_IDLE) return;   // 换台前的残留
+    if (from_burst) {
+        if (!l->burst_active) return;
+        if (info->data_len == 0) {
+            burst_finish(t, l, 1, info->seq_num, now);
+            return;
+        }
+        t->stats.burst_packets++;
+        listener_accept(t, l, info, 0, now);
+        return;
+    }
+    if (l->burst_active) {
+        if (l->npend < LOADGEN_PEND_MAX) {
+            l->pend[l->npend].seq = info->seq_num;
+            l->pend[l->npend].flags = info->flags;
+            l->pend[l->npend].data_len = info->data_len;
+            l->npend++;     // 收包与字节数在 burst_finish 补校验时计入
+            return;
+        }
+        t->stats.burst_timeouts++;
+        burst_finish(t, l, l->have_seq, l->next_seq - 1, now);
+    }
+    // 补发快照可能包含尚未从组播到达的包, 与客户端一样按补发截止序列号去重;
+    // 组播追上截止序列号后不再需要, 跳变过大(服务器重启, 序列号从头开始)时也要放弃, 否则之后的包全被丢掉
+    if (l->have_burst_last) {
+        int32_t delta = (int32_t)(info->seq_num - l->burst_last);
+        if (delta > 0 || delta < -LOADGEN_MAX_DROPOUT) l->have_burst_last = 0;
+        else return;
+    }
+    listener_accept(t, l, info, 1, now);
+}
+
+static int parse_audio(const char *buf, size_t len, pkt_info_t *info) {
+    if (proto_hdr_parse(buf, len, info) != 0) return -1;
+    if (info->flags & (PKT_F_FEC | PKT_F_DIR)) return -1;
+    if (info->data_len > len - info->hdr_len) return -1;
+    return 0;
+}
+
+// 补发服务要求回显验证码: 记下并带上它重发本次请求 (每次请求最多一次)
+static void burst_echo(vlistener_t *l, const burst_req_t *ch, const struct sockaddr_in *from) {
+    if (ntohl(ch->magic) != BURST_MAGIC || !l->burst_active || l->burst_echoed) return;
+    if (ntohs(ch->channel_id) != l->chnid) return;
+    l->burst_echoed = 1;
+    l->burst_cookie = ch->cookie;
+    burst_req_t req;
+    req.magic = htonl(BURST_MAGIC);
+    req.channel_id = htons(l->chnid);
+    req.version = htons(PROTO_VERSION);
+    req.cookie = l->burst_cookie;
+    sendto(l->fd, &req, sizeof(req), 0, (const struct sockaddr *)from, sizeof(*from));
+}
+
+// 收取一个UDP套接字上所有待处理的数据报; l 为 NULL 表示组播套接字
+static void drain_udp(lg_thread_t *t, int fd, vlistener_t *l) {
+    while (1) {
+        for (int i = 0; i < LOADGEN_VLEN; i++) {
+            t->msgs[i].msg_hdr.msg_namelen = sizeof(t->addrs[i]);
+            t->msgs[i].msg_hdr.msg_flags = 0;
+        }
+        int n = recvmmsg(fd, t->msgs, LOADGEN_VLEN, MSG_DONTWAIT, NULL);
+        if (n <= 0) {
+            if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                fprintf(stderr, "[LOAD] recvmmsg失败: %s\n", strerror(errno));
+            }
+            return;
+        }
+        int64_t now = now_us();
+        pthread_mutex_lock(&t->mutex);
+        t->stats.recv_calls++;
+        t->stats.datagrams += (uint64_t)n;
+        for (int i = 0; i < n; i++) {
+            if (t->msgs[i].msg_hdr.msg_flags & MSG_TRUNC) continue;
+            const char *buf = t->bufs + (size_t)i * LOADGEN_PKT_MAX;
+            if (l && t->msgs[i].msg_len == sizeof(burst_req_t)) {
+                burst_echo(l, (const burst_req_t *)buf, &t->addrs[i]);
+                continue;
+            }
+            pkt_info_t info;
+            if (proto_hdr_parse(buf, t->msgs[i].msg_len, &info) != 0) continue;
+            if (l) {
+                // 补发结束标记 data_len 为 0
+                if (info.data_len == 0 || parse_audio(buf, t->msgs[i].msg_len, &info) == 0) {
+                    listener_packet(t, l, &info, 1, now);
+                }
+                continue;
+            }
+            if (info.data_len == 0 || parse_audio(buf, t->msgs[i].msg_len, &info) != 0) continue;
+            if (info.channel_id >= LOADGEN_MAX_CHN) continue;
+            if (g_conf->burst && !__atomic_load_n(&g_server_known, __ATOMIC_ACQUIRE)) {
+                pthread_mutex_lock(&g_server_mutex);
+                if (!g_server_known) {
+                    g_server = t->addrs[i];
+                    __atomic_store_n(&g_server_known, 1, __ATOMIC_RELEASE);
+                }
+                pthread_mutex_unlock(&g_server_mutex);
+            }
+            for (vlistener_t *v = t->chn_head[info.channel_id]; v; v = v->next_on_chn) {
+                listener_packet(t, v, &info, 0, now);
+            }
+        }
+        pthread_mutex_unlock(&t->mutex);
+        if (n < LOADGEN_VLEN) return;
+    }
+}
+
+// 单播TCP: 读出所有可读数据并按包头切分
+static int drain_tcp(lg_thread_t *t, vlistener_t *l) {
+    while (1) {
+        ssize_t n = recv(l->fd, l->rbuf + l->rlen, LOADGEN_PKT_MAX * 2 - l->rlen, MSG_DONTWAIT);
+        if (n == 0) return -1;
+        if (n < 0) return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR ? 0 : -1;
+        l->rlen += (size_t)n;
+
+        int64_t now = now_us();
+        pthread_mutex_lock(&t->mutex);
+        t->stats.recv_calls++;
+        size_t off = 0;
+        while (l->rlen - off >= sizeof(pkt_hdr_t)) {
+            pkt_info_t info;
+            if (proto_hdr_parse(l->rbuf + off, l->rlen - off, &info) != 0) {
+                pthread_mutex_unlock(&t->mutex);
+                return -1;                      // 流已错位, 无法恢复
+            }
+            size_t need = (size_t)info.hdr_len + info.data_len;
+            if (need > LOADGEN_PKT_MAX * 2) {
+                pthread_mutex_unlock(&t->mutex);
+                return -1;
+            }
+            if (l->rlen - off < need) break;
+            t->stats.datagrams++;
+            if (info.data_len > 0 && !(info.flags & (PKT_F_FEC | PKT_F_DIR))) {
+                listener_packet(t, l, &info, 0, now);
+            }
+            off += need;
+        }
+        pthread_mutex_unlock(&t->mutex);
+        memmove(l->rbuf, l->rbuf + off, l->rlen - off);
+        l->rlen -= off;
+    }
+}
+
+/* ---------- 线程 ---------- */
+
+static int open_mcast(void) {
+    int fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+    if (fd < 0) return -1;
+    int reuse = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    int rcvbuf = 4 * 1024 * 1024;
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    struct sockaddr_in addr = {0};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(g_conf->mport > 0 ? g_conf->mport : RCV_PORT);
+    struct ip_mreq mreq;
+    mreq.imr_multiaddr.s_addr = inet_addr(g_conf->mgroup ? g_conf->mgroup : GROUP_IP);
+    mreq.imr_interface.s_addr = htonl(INADDR_ANY);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+        setsockopt(fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static int open_burst_fd(void) {
+    int fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+    if (fd < 0) return -1;
+    int rcvbuf = 256 * 1024;
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    return fd;
+}
+
+static int open_tcp(const struct sockaddr_in *addr) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    if (connect(fd, (const struct sockaddr *)addr, sizeof(*addr)) < 0) {
+        close(fd);
+        return -1;
+    }
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    return fd;
+}
+
+// 定时检查: 首次入台、换台、补发超时、入台超时
+static void check_timers(lg_thread_t *t, int64_t now) {
+    pthread_mutex_lock(&t->mutex);
+    for (int i = 0; i < t->nls; i++) {
+        vlistener_t *l = &t->ls[i];
+        if (now >= l->next_zap_us) {
+            if (l->state == LS_IDLE) {
+                listener_join(t, l, l->chn_idx, now);
+            } else {
+                listener_zap(t, l, now);
+            }
+            l->next_zap_us = next_zap_time(t, now);
+        }
+        if (l->burst_active && now - l->burst_start_us > LOADGEN_BURST_TIMEOUT_MS * 1000) {
+            t->stats.burst_timeouts++;
+            burst_finish(t, l, l->have_seq, l->next_seq - 1, now);
+        }
+        if (l->state == LS_JOINING && now - l->join_start_us > LOADGEN_JOIN_TIMEOUT_MS * 1000LL) {
+            t->stats.join_timeouts++;
+            l->join_start_us = now;         // 继续等待, 下一次超时再计
+        }
+    }
+    pthread_mutex_unlock(&t->mutex);
+}
+
+static void *loadgen_thread(void *arg) {
+    lg_thread_t *t = arg;
+    struct epoll_event evs[256];
+    int64_t next_check = 0;
+    while (g_running) {
+        int64_t now = now_us();
+        if (now >= next_check) {
+            check_timers(t, now);
+            next_check = now + 5000;
+        }
+        int n = epoll_wait(t->epfd, evs, 256, 5);
+        for (int i = 0; i < n; i++) {
+            vlistener_t *l = evs[i].data.ptr;
+            if (!l) {
+                drain_udp(t, t->mcast_fd, NULL);
+            } else if (g_conf->unicast_host) {
+                if (drain_tcp(t, l) != 0) {
+                    fprintf(stderr, "[LOAD] 听众%d 单播连接断开\n", l->id);
+                    epoll_ctl(t->epfd, EPOLL_CTL_DEL, l->fd, NULL);
+                    close(l->fd);
+                    l->fd = -1;
+                }
+            } else {
+                drain_udp(t, l->fd, l);
+            }
+        }
+    }
+    return NULL;
+}
+
+// 为一个线程创建套接字与听众
+static int thread_setup(lg_thread_t *t, int first_id, int count, const struct sockaddr_in *server) {
+    t->ls = calloc((size_t)count, sizeof(vlistener_t));
+    t->bufs = malloc((size_t)LOADGEN_VLEN * LOADGEN_PKT_MAX);
+    t->epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (!t->ls || !t->bufs || t->epfd < 0) return -1;
+    t->nls = count;
+    t->seed = (unsigned int)(time(NULL) ^ (t->idx * 2654435761u));
+    for (int i = 0; i < LOADGEN_VLEN; i++) {
+        t->iovs[i].iov_base = t->bufs + (size_t)i * LOADGEN_PKT_MAX;
+        t->iovs[i].iov_len = LOADGEN_PKT_MAX;
+        memset(&t->msgs[i], 0, sizeof(t->msgs[i]));
+        t->msgs[i].msg_hdr.msg_iov = &t->iovs[i];
+        t->msgs[i].msg_hdr.msg_iovlen = 1;
+        t->msgs[i].msg_hdr.msg_name = &t->addrs[i];
+    }
+
+    struct epoll_event ev = {0};
+    ev.events = EPOLLIN;
+    if (!g_conf->unicast_host) {
+        t->mcast_fd = open_mcast();
+        if (t->mcast_fd < 0) {
+            fprintf(stderr, "[LOAD] 加入组播组失败: %s\n", strerror(errno));
+            return -1;
+        }
+        ev.data.ptr = NULL;
+        epoll_ctl(t->epfd, EPOLL_CTL_ADD, t->mcast_fd, &ev);
+    }
+
+    for (int i = 0; i < count; i++) {
+        vlistener_t *l = &t->ls[i];
+        int id = first_id + i;
+        l->id = id;
+        l->fd = -1;
+        l->chn_idx = id % g_conf->nchn;
+        l->chnid = g_conf->chnids[l->chn_idx];
+        // 首次入台: herd 模式全部同时开始, 其余在 LOADGEN_RAMP_MS 内铺开
+        l->next_zap_us = g_start_us;
+        if (g_conf->zap != LOADGEN_ZAP_HERD) {
+            l->next_zap_us += (int64_t)id * LOADGEN_RAMP_MS * 1000 / g_conf->listeners;
+        }
+        if (g_conf->unicast_host) {
+            l->fd = open_tcp(server);
+            l->rbuf = malloc(LOADGEN_PKT_MAX * 2);
+            if (l->fd < 0 || !l->rbuf) {
+                fprintf(stderr, "[LOAD] 听众%d 连接服务器失败: %s\n", id, strerror(errno));
+                return -1;
+            }
+        } else if (g_conf->burst) {
+            l->fd = open_burst_fd();
+            if (l->fd < 0) {
+                fprintf(stderr, "[LOAD] 听众%d 创建补发套接字失败: %s\n", id, strerror(errno));
+                return -1;
+            }
+        }
+        if (l->fd >= 0) {
+            ev.data.ptr = l;
+            epoll_ctl(t->epfd, EPOLL_CTL_ADD, l->fd, &ev);
+        }
+    }
+    return 0;
+}
+
+static void thread_cleanup(lg_thread_t *t) {
+    for (int i = 0; t->ls && i < t->nls; i++) {
+        if (t->ls[i].fd >= 0) close(t->ls[i].fd);
+        free(t->ls[i].rbuf);
+    }
+    free(t->ls);
+    free(t->bufs);
+    if (t->mcast_fd >= 0) close(t->mcast_fd);
+    if (t->epfd >= 0) close(t->epfd);
+    pthread_mutex_destroy(&t->mutex);
+}
+
+/* ---------- 汇总与报告 ---------- */
+
+typedef struct lg_snapshot {
+    loadgen_stats_t s;
+    int playing;
+    double jitter_avg_ms;
+    double jitter_max_ms;
+} lg_snapshot_t;
+
+static void snapshot(lg_snapshot_t *out) {
+    memset(out, 0, sizeof(*out));
+    double jsum = 0;
+    for (int i = 0; i < g_nthreads; i++) {
+        lg_thread_t *t = &g_threads[i];
+        pthread_mutex_lock(&t->mutex);
+        const loadgen_stats_t *s = &t->stats;
+        out->s.packets += s->packets;
+        out->s.bytes += s->bytes;
+        out->s.lost += s->lost;
+        out->s.duplicates += s->duplicates;
+        out->s.reordered += s->reordered;
+        out->s.resyncs += s->resyncs;
+        out->s.zaps += s->zaps;
+        out->s.joins += s->joins;
+        out->s.join_timeouts += s->join_timeouts;
+        out->s.join_us_sum += s->join_us_sum;
+        if (s->join_us_max > out->s.join_us_max) out->s.join_us_max = s->join_us_max;
+        out->s.burst_reqs += s->burst_reqs;
+        out->s.burst_packets += s->burst_packets;
+        out->s.burst_timeouts += s->burst_timeouts;
+        out->s.recv_calls += s->recv_calls;
+        out->s.datagrams += s->datagrams;
+        for (int b = 0; b <= LOADGEN_HIST_MS; b++) out->s.join_hist[b] += s->join_hist[b];
+        for (int k = 0; k < t->nls; k++) {
+            const vlistener_t *l = &t->ls[k];
+            if (l->state != LS_PLAYING) continue;
+            out->playing++;
+            jsum += l->jitter_ms;
+            if (l->jitter_ms > out->jitter_max_ms) out->jitter_max_ms = l->jitter_ms;
+        }
+        pthread_mutex_unlock(&t->mutex);
+    }
+    out->jitter_avg_ms = out->playing ? jsum / out->playing : 0;
+}
+
+// 入台延迟百分位(毫秒), 来自 1ms 直方图
+static int join_pct(const loadgen_stats_t *s, double pct) {
+    if (s->joins == 0) return 0;
+    uint64_t want = (uint64_t)((double)s->joins * pct / 100.0 + 0.5);
+    if (want == 0) want = 1;
+    uint64_t acc = 0;
+    for (int b = 0; b <= LOADGEN_HIST_MS; b++) {
+        acc += s->join_hist[b];
+        if (acc >= want) return b;
+    }
+    return LOADGEN_HIST_MS;
+}
+
+static double loss_pct(const loadgen_stats_t *s) {
+    uint64_t expected = s->packets - s->duplicates + s->lost;
+    return expected ? 100.0 * (double)s->lost / (double)expected : 0.0;
+}
+
+static void write_report(FILE *fp, int json, const lg_snapshot_t *cur, const lg_snapshot_t *prev,
+                         double dt) {
+    const loadgen_stats_t *s = &cur->s;
+    double pps = dt > 0 ? (double)(s->packets - prev->s.packets) / dt : 0;
+    double mbps = dt > 0 ? (double)(s->bytes - prev->s.bytes) * 8 / dt / 1e6 : 0;
+    double elapsed = (double)(now_us() - g_start_us) / 1e6;
+    long long now = (long long)(wall_us() / 1000000);
+    if (json) {
+        fprintf(fp, "{\"time\": %lld, \"elapsed\": %.1f, \"playing\": %d, \"packets\": %llu, "
+                "\"bytes\": %llu, \"pps\": %.1f, \"mbps\": %.3f, \"lost\": %llu, \"loss_pct\": %.3f, "
+                "\"duplicates\": %llu, \"reordered\": %llu, \"joins\": %llu, \"join_timeouts\": %llu, "
+                "\"join_p50_ms\": %d, \"join_p90_ms\": %d, \"join_p99_ms\": %d, \"join_max_ms\": %.1f, "
+                "\"jitter_avg_ms\": %.3f, \"jitter_max_ms\": %.3f}\n",
+                now, elapsed, cur->playing, (unsigned long long)s->packets,
+                (unsigned long long)s->bytes, pps, mbps, (unsigned long long)s->lost, loss_pct(s),
+                (unsigned long long)s->duplicates, (unsigned long long)s->reordered,
+                (unsigned long long)s->joins, (unsigned long long)s->join_timeouts,
+                join_pct(s, 50), join_pct(s, 90), join_pct(s, 99), (double)s->join_us_max / 1000.0,
+                cur->jitter_avg_ms, cur->jitter_max_ms);
+    } else {
+        fprintf(fp, "%lld,%.1f,%d,%llu,%llu,%.1f,%.3f,%llu,%.3f,%llu,%llu,%llu,%llu,%d,%d,%d,%.1f,%.3f,%.3f\n",
+                now, elapsed, cur->playing, (unsigned long long)s->packets,
+                (unsigned long long)s->bytes, pps, mbps, (unsigned long long)s->lost, loss_pct(s),
+                (unsigned long long)s->duplicates, (unsigned long long)s->reordered,
+                (unsigned long long)s->joins, (unsigned long long)s->join_timeouts,
+                join_pct(s, 50), join_pct(s, 90), join_pct(s, 99), (double)s->join_us_max / 1000.0,
+                cur->jitter_avg_ms, cur->jitter_max_ms);
+    }
+    fflush(fp);
+}
+
+static void print_summary(const lg_snapshot_t *cur, double secs) {
+    const loadgen_stats_t *s = &cur->s;
+    printf("\n=== 压测结果 ===\n");
+    printf("虚拟听众 %d (线程 %d, %s%s), 换台 %s", g_conf->listeners, g_nthreads,
+           g_conf->unicast_host ? "单播TCP" : "组播", g_conf->burst && !g_conf->unicast_host ? "+补发" : "",
+           loadgen_zap_name(g_conf->zap));
+    if (g_conf->zap != LOADGEN_ZAP_NONE) printf(" 每%.1f秒", g_conf->zap_interval_ms / 1000.0);
+    printf(", 运行 %.1f 秒\n", secs);
+    printf("收包 %llu (%.0f 包/秒), 音频吞吐 %.3f Mbit/s, 每次接收调用平均 %.1f 个包\n",
+           (unsigned long long)s->packets, secs > 0 ? (double)s->packets / secs : 0,
+           secs > 0 ? (double)s->bytes * 8 / secs / 1e6 : 0,
+           s->recv_calls ? (double)s->datagrams / (double)s->recv_calls : 0);
+    printf("丢包 %llu (%.3f%%), 重复 %llu, 乱序 %llu, 重同步 %llu\n", (unsigned long long)s->lost,
+           loss_pct(s), (unsigned long long)s->duplicates, (unsigned long long)s->reordered,
+           (unsigned long long)s->resyncs);
+    printf("入台 %llu/%llu 次, 超时 %llu, 延迟 平均%.1f p50 %d p90 %d p99 %d 最大%.1f ms\n",
+           (unsigned long long)s->joins, (unsigned long long)s->zaps,
+           (unsigned long long)s->join_timeouts,
+           s->joins ? (double)s->join_us_sum / (double)s->joins / 1000.0 : 0,
+           join_pct(s, 50), join_pct(s, 90), join_pct(s, 99), (double)s->join_us_max / 1000.0);
+    if (g_conf->burst && !g_conf->unicast_host) {
+        printf("补发 请求%llu 收包%llu 超时%llu\n", (unsigned long long)s->burst_reqs,
+               (unsigned long long)s->burst_packets, (unsigned long long)s->burst_timeouts);
+    }
+    printf("到达抖动 平均%.3f 最大%.3f ms (%d 个听众在播)\n", cur->jitter_avg_ms,
+           cur->jitter_max_ms, cur->playing);
+    printf("================\n");
+}
+
+// 需要的文件描述符超过软限制时尝试提高到硬限制
+static void raise_nofile(int need) {
+    struct rlimit rl;
+    if (getrlimit(RLIMIT_NOFILE, &rl) != 0 || rl.rlim_cur >= (rlim_t)need) return;
+    rl.rlim_cur = rl.rlim_max == RLIM_INFINITY || rl.rlim_max >= (rlim_t)need ? (rlim_t)need : rl.rlim_max;
+    if (setrlimit(RLIMIT_NOFILE, &rl) != 0 || rl.rlim_cur < (rlim_t)need) {
+        fprintf(stderr, "[WARN] 文件描述符上限 %llu 小于所需的 %d\n",
+                (unsigned long long)rl.rlim_cur, need);
+    }
+}
+
+int loadgen_run(const loadgen_conf_t *conf) {
+    if (conf->listeners <= 0 || conf->nchn <= 0) return -1;
+    g_conf = conf;
+    g_nthreads = conf->threads > 0 ? conf->threads : LOADGEN_DEFAULT_THREADS;
+    if (g_nthreads > LOADGEN_MAX_THREADS) g_nthreads = LOADGEN_MAX_THREADS;
+    if (g_nthreads > conf->listeners) g_nthreads = conf->listeners;
+    for (int i = 0; i < conf->nchn; i++) {
+        if (conf->chnids[i] >= LOADGEN_MAX_CHN) return -1;
+    }
+
+    struct sockaddr_in server = {0};
+    if (conf->unicast_host) {
+        struct addrinfo hints = {0}, *res = NULL;
+        hints.ai_family = AF_INET;
+        hints.ai_socktype = SOCK_STREAM;
+        if (getaddrinfo(conf->unicast_host, NULL, &hints, &res) != 0 || !res) {
+            fprintf(stderr, "[LOAD] 无法解析服务器地址 %s\n", conf->unicast_host);
+            return -1;
+        }
+        server = *(struct sockaddr_in *)res->ai_addr;
+        server.sin_port = htons(conf->unicast_port);
+        freeaddrinfo(res);
+    }
+    if (conf->unicast_host || conf->burst) raise_nofile(conf->listeners + g_nthreads * 2 + 64);
+
+    g_threads = calloc((size_t)g_nthreads, sizeof(lg_thread_t));
+    if (!g_threads) return -1;
+    printf("[LOAD] %d 个虚拟听众, %d 个线程, %s, 换台模式 %s\n", conf->listeners, g_nthreads,
+           conf->unicast_host ? "单播TCP" : "组播", loadgen_zap_name(conf->zap));
+
+    // 组播听众通过心跳报告收听的频道; 单播订阅本身即表明在听
+    if (!conf->unicast_host && heartbeat_start() != 0) {
+        fprintf(stderr, "[LOAD] 收听心跳不可用\n");
+    }
+
+    g_start_us = now_us() + 100000;     // 留出建立连接的时间
+    g_running = 1;
+    int ret = 0, started = 0, first = 0;
+    for (int i = 0; i < g_nthreads; i++) {
+        g_threads[i].idx = i;
+        g_threads[i].epfd = -1;
+        g_threads[i].mcast_fd = -1;
+        pthread_mutex_init(&g_threads[i].mutex, NULL);
+    }
+    for (int i = 0; i < g_nthreads; i++) {
+        lg_thread_t *t = &g_threads[i];
+        int count = conf->listeners / g_nthreads + (i < conf->listeners % g_nthreads);
+        if (thread_setup(t, first, count, &server) != 0) {
+            ret = -1;
+            break;
+        }
+        first += count;
+    }
+    if (ret == 0) g_start_us = now_us();
+    for (int i = 0; ret == 0 && i < g_nthreads; i++) {
+        if (pthread_create(&g_threads[i].tid, NULL, loadgen_thread, &g_threads[i]) != 0) {
+            ret = -1;
+            break;
+        }
+        started++;
+    }
+
+    struct sigaction sa = {0}, old_int, old_term;
+    sa.sa_handler = on_signal;
+    sigaction(SIGINT, &sa, &old_int);
+    sigaction(SIGTERM, &sa, &old_term);
+
+    FILE *report = NULL;
+    int json = 0;
+    if (ret == 0 && conf->report_path) {
+        report = fopen(conf->report_path, "a");
+        if (!report) {
+            perror("[LOAD] 打开统计文件失败");
+        } else {
+            const char *ext = strrchr(conf->report_path, '.');
+            json = ext && strcmp(ext, ".json") == 0;
+            if (!json && ftell(report) == 0) {
+                fprintf(report, "time,elapsed,playing,packets,bytes,pps,mbps,lost,loss_pct,duplicates,"
+                                "reordered,joins,join_timeouts,join_p50_ms,join_p90_ms,join_p99_ms,"
+                                "join_max_ms,jitter_avg_ms,jitter_max_ms\n");
+            }
+        }
+    }
+
+    // 主线程: 计时并定期输出进度
+    int interval = conf->report_interval > 0 ? conf->report_interval : 5;
+    static lg_snapshot_t cur, prev;
+    memset(&prev, 0, sizeof(prev));
+    int64_t last_report = now_us();
+    while (ret == 0 && g_running) {
+        usleep(200000);
+        int64_t now = now_us();
+        if (conf->duration_s > 0 && now - g_start_us >= (int64_t)conf->duration_s * 1000000) break;
+        if (now - last_report < (int64_t)interval * 1000000) continue;
+        double dt = (double)(now - last_report) / 1e6;
+        snapshot(&cur);
+        printf("[LOAD] %.0fs 在播%d 收包%llu (%.0f/s) 丢包%llu 入台%llu p99 %dms\n",
+               (double)(now - g_start_us) / 1e6, cur.playing, (unsigned long long)cur.s.packets,
+               (double)(cur.s.packets - prev.s.packets) / dt, (unsigned long long)cur.s.lost,
+               (unsigned long long)cur.s.joins, join_pct(&cur.s, 99));
+        if (report) write_report(report, json, &cur, &prev, dt);
+        prev = cur;
+        last_report = now;
+    }
+    g_running = 0;
+    for (int i = 0; i < started; i++) pthread_join(g_threads[i].tid, NULL);
+    heartbeat_stop();
+    sigaction(SIGINT, &old_int, NULL);
+    sigaction(SIGTERM, &old_term, NULL);
+
+    if (ret == 0) {
+        int64_t now = now_us();
+        snapshot(&cur);
+        print_summary(&cur, (double)(now - g_start_us) / 1e6);
+        if (report) write_report(report, json, &cur, &prev, (double)(now - last_report) / 1e6);
+    }
+    if (report) fclose(report);
+    for (int i = 0; i < g_nthreads; i++) thread_cleanup(&g_threads[i]);
+    free(g_threads);
+    g_threads = NULL;
+    return ret;
+}
@@ -0,0 +1,73 @@
+#ifndef __LOADGEN_H__
+#define __LOADGEN_H__
+
+#include <stdint.h>
+#include <pthread.h>
+#include "proto.h"
+
+// 无界面压测模式: 一个进程内模拟成千上万个虚拟听众, 按设定的模式入台/换台,
+// 逐个听众校验序列号连续性与到达抖动, 统计总吞吐、丢包与入台延迟
+#define LOADGEN_MAX_THREADS     64
+#define LOADGEN_DEFAULT_THREADS 4
+#define LOADGEN_MAX_CHN         256         // 频道ID取值范围
+#define LOADGEN_VLEN            32          // recvmmsg 每次最多收取的数据报数
+#define LOADGEN_PKT_MAX         2048        // 单个数据报缓冲(包头 + 1400字节数据绰绰有余)
+#define LOADGEN_RAMP_MS         1000        // 首次入台在此时间内均匀铺开 (herd 模式除外)
+#define LOADGEN_JOIN_TIMEOUT_MS 5000        // 超过此时间仍未收到同步包记一次入台超时
+#define LOADGEN_HIST_MS         LOADGEN_JOIN_TIMEOUT_MS   // 入台延迟直方图, 1ms 一格
+#define LOADGEN_BURST_TIMEOUT_MS 300        // 等待补发结束标记的超时
+#define LOADGEN_PEND_MAX        32          // 等待补发结束期间暂存的组播序列号数
+#define LOADGEN_MAX_DROPOUT     3000        // 序列号跳变超过此值视为服务器重启
+
+// 换台模式
+typedef enum {
+    LOADGEN_ZAP_NONE = 0,       // 入台后不再换台
+    LOADGEN_ZAP_RANDOM,         // 每个听众独立地每隔 0.5~1.5 个间隔随机换到另一个频道
+    LOADGEN_ZAP_CYCLE,          // 每个听众每隔一个间隔换到下一个频道
+    LOADGEN_ZAP_HERD,           // 所有听众同时入台、同时随机换台 (惊群)
+} loadgen_zap_t;
+
+typedef struct loadgen_conf {
+    int listeners;              // 虚拟听众数
+    int threads;                // 接收线程数
+    int duration_s;             // 运行时长, 0 表示直到 Ctrl-C
+    loadgen_zap_t zap;
+    int zap_interval_ms;
+    int burst;                  // 组播模式下入台时向服务器请求补发
+    const char *mgroup;         // 接收的组播组, NULL 表示 GROUP_IP (经损伤中继测试时改为测试组)
+    int mport;                  // 组播端口, 0 表示 RCV_PORT
+    const char *unicast_host;   // 非 NULL 时每个听众一条单播TCP连接
+    int unicast_port;
+    const uint16_t *chnids;     // 可选的频道
+    int nchn;
+    const char *report_path;    // 定期追加汇总统计, .json 结尾写JSON行, 否则写CSV
+    int report_interval;        // 报告间隔(秒)
+} loadgen_conf_t;
+
+// 汇总统计 (各线程累加)
+typedef struct loadgen_stats {
+    uint64_t packets;           // 收到的音频包(含补发)
+    uint64_t bytes;             // 音频数据字节数
+    uint64_t lost;              // 按序列号推算的丢包
+    uint64_t duplicates;
+    uint64_t reordered;
+    uint64_t resyncs;
+    uint64_t zaps;              // 发起的入台/换台次数
+    uint64_t joins;             // 收到首个同步包的次数
+    uint64_t join_timeouts;
+    uint64_t join_us_sum;
+    uint64_t join_us_max;
+    uint64_t burst_reqs;
+    uint64_t burst_packets;
+    uint64_t burst_timeouts;
+    uint64_t recv_calls;        // recvmmsg/read 调用次数
+    uint64_t datagrams;         // 收到的数据报/包总数(含未被任何听众使用的)
+    uint32_t join_hist[LOADGEN_HIST_MS + 1];
+} loadgen_stats_t;
+
+// 函数声明
+int loadgen_parse_zap(const char *spec, loadgen_conf_t *conf);   // "none" | "random[:秒]" | "cycle[:秒]" | "herd[:秒]"
+const char *loadgen_zap_name(loadgen_zap_t zap);
+int loadgen_run(const loadgen_conf_t *conf);                    // 阻塞运行直到时长结束或 Ctrl-C
+
+#endif /* __LOADGEN_H__ */
@@ -0,0 +1,117 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <net/if.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <linux/net_tstamp.h>
+#include <linux/sockios.h>
+#include <linux/errqueue.h>
+#include "lowlat.h"
+
+static int64_t ts_us(const struct timespec *ts) {
+    return (int64_t)ts->tv_sec * 1000000 + ts->tv_nsec / 1000;
+}
+
+int lowlat_parse(const char *spec, lowlat_conf_t *conf) {
+    if (strcmp(spec, "sw") == 0) {
+        conf->mode = LOWLAT_SW;
+        return 0;
+    }
+    if (strncmp(spec, "hw", 2) == 0 && (spec[2] == '\0' || spec[2] == ':')) {
+        conf->mode = LOWLAT_HW;
+        conf->ifname = spec[2] == ':' ? spec + 3 : NULL;
+        return 0;
+    }
+    return -1;
+}
+
+// 先按普通上限设置, 有 CAP_NET_ADMIN 时再突破 rmem_max; 已经足够大时不缩小
+int lowlat_set_rcvbuf(int fd, int bytes) {
+    int actual = 0;
+    socklen_t len = sizeof(actual);
+    getsockopt(fd, SOL_SOCKET, SO_RCVBUF, &actual, &len);
+    if (actual >= bytes) return actual;
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &bytes, sizeof(bytes));
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUFFORCE, &bytes, sizeof(bytes));
+    len = sizeof(actual);
+    getsockopt(fd, SOL_SOCKET, SO_RCVBUF, &actual, &len);
+    if (actual < bytes) {
+        printf("[NET] 接收缓冲只有 %d KB (期望 %d KB), 可调大 net.core.rmem_max\n",
+               actual / 1024, bytes / 1024);
+    }
+    return actual;
+}
+
+// 在网卡上开启接收硬件时间戳
+static int lowlat_enable_hw(int fd, const char *ifname) {
+    struct hwtstamp_config cfg = {0};
+    cfg.tx_type = HWTSTAMP_TX_OFF;
+    cfg.rx_filter = HWTSTAMP_FILTER_ALL;
+    struct ifreq ifr;
+    memset(&ifr, 0, sizeof(ifr));
+    snprintf(ifr.ifr_name, sizeof(ifr.ifr_name), "%s", ifname);
+    ifr.ifr_data = (void *)&cfg;
+    if (ioctl(fd, SIOCSHWTSTAMP, &ifr) < 0) {
+        printf("[WARN] 接口 %s 开启硬件接收时间戳失败: %s, 使用软件时间戳\n", ifname, strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+int lowlat_setup(int fd, const lowlat_conf_t *conf) {
+    if (conf->busy_poll_us > 0 &&
+        setsockopt(fd, SOL_SOCKET, SO_BUSY_POLL, &conf->busy_poll_us, sizeof(conf->busy_poll_us)) < 0) {
+        printf("[WARN] SO_BUSY_POLL 设置失败: %s (超过 net.core.busy_read 需 CAP_NET_ADMIN)\n", strerror(errno));
+    }
+    if (conf->mode == LOWLAT_OFF) return 0;
+
+    int flags = SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE;
+    if (conf->mode == LOWLAT_HW) {
+        if (conf->ifname) lowlat_enable_hw(fd, conf->ifname);
+        flags |= SOF_TIMESTAMPING_RX_HARDWARE | SOF_TIMESTAMPING_RAW_HARDWARE;
+    }
+    if (setsockopt(fd, SOL_SOCKET, SO_TIMESTAMPING, &flags, sizeof(flags)) < 0) {
+        printf("[WARN] SO_TIMESTAMPING 设置失败: %s, 使用用户态时钟\n", strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+// 接收一个数据报并取出接收时间戳; 没有内核时间戳时读用户态时钟
+ssize_t lowlat_recv(int fd, void *buf, size_t cap, struct sockaddr_in *from, lowlat_time_t *t) {
+    char control[CMSG_SPACE(sizeof(struct scm_timestamping))];
+    struct iovec iov = {buf, cap};
+    struct msghdr msg = {0};
+    msg.msg_name = from;
+    msg.msg_namelen = from ? sizeof(*from) : 0;
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    ssize_t n = recvmsg(fd, &msg, 0);
+    if (n < 0) return n;
+
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    t->clock = RX_CLOCK_USER;
+    t->wall_us = ts_us(&now);
+    t->arrival_us = t->wall_us;
+    for (struct cmsghdr *cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm)) {
+        if (cm->cmsg_level != SOL_SOCKET || cm->cmsg_type != SO_TIMESTAMPING) continue;
+        const struct scm_timestamping *st = (const struct scm_timestamping *)CMSG_DATA(cm);
+        // ts[0] 软件时间戳(CLOCK_REALTIME), ts[2] 网卡原始硬件时间戳
+        if (st->ts[0].tv_sec || st->ts[0].tv_nsec) {
+            t->clock = RX_CLOCK_KERNEL_SW;
+            t->wall_us = t->arrival_us = ts_us(&st->ts[0]);
+        }
+        if (st->ts[2].tv_sec || st->ts[2].tv_nsec) {
+            t->clock = RX_CLOCK_KERNEL_HW;
+            t->arrival_us = ts_us(&st->ts[2]);
+        }
+    }
+    return n;
+}
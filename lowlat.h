@@ -0,0 +1,39 @@
+#ifndef __LOWLAT_H__
+#define __LOWLAT_H__
+
+#include <stdint.h>
+#include <sys/types.h>
+#include <netinet/in.h>
+#include "rxstats.h"
+
+// 低时延接收: 按预期突发量设置接收缓冲, 可选 SO_BUSY_POLL 忙轮询,
+// 用 SO_TIMESTAMPING 取每个数据报的内核(软件或网卡硬件)接收时间戳
+#define LOWLAT_BURST_BYTES  (3 * 320 * 1000 / 8 * 2)   // 一个频道的突发: 3秒 × 320kbit/s, 按 skb 开销计两倍
+#define LOWLAT_MIN_RCVBUF   (1024 * 1024)
+
+typedef enum {
+    LOWLAT_OFF = 0,
+    LOWLAT_SW,                  // 软件接收时间戳
+    LOWLAT_HW,                  // 网卡硬件接收时间戳, 取不到时退回软件时间戳
+} lowlat_mode_t;
+
+typedef struct lowlat_conf {
+    lowlat_mode_t mode;
+    const char *ifname;         // 硬件时间戳需要在该接口上开启 (SIOCSHWTSTAMP, 需 CAP_NET_ADMIN)
+    int busy_poll_us;           // 0 表示不忙轮询
+} lowlat_conf_t;
+
+// 一个数据报的到达时间
+typedef struct lowlat_time {
+    rx_clock_t clock;           // RX_CLOCK_USER 表示没有内核时间戳
+    int64_t arrival_us;         // 按 clock 计的到达时间
+    int64_t wall_us;            // 到达时的墙钟(软件时间戳或接收后读取), 用于单向延迟
+} lowlat_time_t;
+
+// 函数声明
+int lowlat_parse(const char *spec, lowlat_conf_t *conf);        // "sw" | "hw[:接口]"
+int lowlat_set_rcvbuf(int fd, int bytes);                       // 返回内核实际分配的大小
+int lowlat_setup(int fd, const lowlat_conf_t *conf);            // 忙轮询与接收时间戳
+ssize_t lowlat_recv(int fd, void *buf, size_t cap, struct sockaddr_in *from, lowlat_time_t *t);
+
+#endif /* __LOWLAT_H__ */
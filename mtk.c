@@ -11,7 +11,11 @@
 #include <stdint.h>
 #include <limits.h>
 #include <errno.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <syslog.h>
 #include "mtk.h"
+#include "probes.h"
 
 static pthread_mutex_t g_mutex = PTHREAD_MUTEX_INITIALIZER;
 
@@ -24,6 +28,11 @@ media_lib_t g_media_lib = {
 static int media_lib_load(const char *lib_path);
 static void media_lib_free(void);
 static char *media_lib_read_descr(const char *dir_path);
+static chn_info_t *media_lib_find_chn(chnid_t chnid);
+static mp3_index_t *mp3_index_file(const char *path);
+static void mp3_index_free(mp3_index_t *idx);
+static void media_lib_next_file(chn_info_t *chn);
+static void media_lib_set_gain(void);
 
 // 初始化媒体库
 int media_lib_init()
@@ -31,7 +40,11 @@ int media_lib_init()
     pthread_mutex_lock(&g_mutex);
     if (!g_media_lib.initialized)
     {
-        if (media_lib_load(MEDIA_LIB_PATH) == 0)
+        // 环境变量 MEDIA_LIB_PATH 可覆盖编译期路径(基准测试使用临时媒体库)
+        const char *lib_path = getenv("MEDIA_LIB_PATH");
+        if (!lib_path || !*lib_path)
+            lib_path = MEDIA_LIB_PATH;
+        if (media_lib_load(lib_path) == 0)
         {
             g_media_lib.initialized = 1;
         }
@@ -40,26 +53,35 @@ int media_lib_init()
     return g_media_lib.initialized ? 0 : -1;
 }
 
+// 目录项过滤: 跳过隐藏文件和目录
+static int media_lib_visible(const struct dirent *entry)
+{
+    return entry->d_name[0] != '.';
+}
+
+// 目录项按字节序排序, 使频道ID与节目顺序不随 readdir 顺序或 locale 变化
+static int media_lib_name_cmp(const struct dirent **a, const struct dirent **b)
+{
+    return strcmp((*a)->d_name, (*b)->d_name);
+}
+
 // 加载媒体库
 static int media_lib_load(const char *lib_path)
 {
-    DIR *dir = opendir(lib_path);
-    if (!dir)
+    struct dirent **entries;
+    int nentries = scandir(lib_path, &entries, media_lib_visible, media_lib_name_cmp);
+    if (nentries < 0)
     {
-        fprintf(stderr, "opendir(%s) 失败: %s\n", lib_path, strerror(errno));
+        fprintf(stderr, "scandir(%s) 失败: %s\n", lib_path, strerror(errno));
         return -1;
     }
 
     g_media_lib.chn_count = 0;
-    struct dirent *entry;
     chnid_t chnid = MIN_CHN_ID;
 
-    while ((entry = readdir(dir)) != NULL && chnid <= MAXCHN_NR)
+    for (int e = 0; e < nentries && g_media_lib.chn_count < MAXCHN_NR; e++)
     {
-        // 跳过隐藏文件和目录
-        if (entry->d_name[0] == '.' || g_media_lib.chn_count >= MAXCHN_NR)
-            continue;
-
+        struct dirent *entry = entries[e];
         char dir_path[PATH_MAX];
         snprintf(dir_path, sizeof(dir_path), "%s/%s", lib_path, entry->d_name);
 
@@ -85,68 +107,157 @@ static int media_lib_load(const char *lib_path)
         chn_info_t *chn = &g_media_lib.channels[g_media_lib.chn_count];
         chn->chnid = chnid++;
         chn->descr = descr;
+        chn->name = strdup(entry->d_name);
+        chn->file_start_us = NULL;
         chn->audio_count = 0;
         chn->current_file_index = 0;
         chn->current_file_offset = 0;
+        chn->current_seg = 0;
+        chn->frame_remain = 0;
+        chn->fd = -1;
 
-        // 扫描音频文件
-        DIR *audio_dir = opendir(dir_path);
-        if (audio_dir)
+        // 扫描音频文件 (按文件名排序, 状态恢复时按名字二分查找)
+        struct dirent **audio_entries;
+        int naudio = scandir(dir_path, &audio_entries, media_lib_visible, media_lib_name_cmp);
+        for (int a = 0; a < naudio; a++)
         {
-            struct dirent *audio_entry;
-            while ((audio_entry = readdir(audio_dir)) != NULL)
+            struct dirent *audio_entry = audio_entries[a];
+            char *dot = strrchr(audio_entry->d_name, '.');
+            if (chn->audio_count < MAX_AUDIO_FILES && dot && strcasecmp(dot, ".mp3") == 0)
             {
-                if (chn->audio_count >= MAX_AUDIO_FILES)
-                    break;
+                // 分配内存并存储完整路径
+                char *audio_path = malloc(PATH_MAX);
+                if (!audio_path)
+                {
+                    fprintf(stderr, "内存分配失败\n");
+                    free(audio_entry);
+                    continue;
+                }
+
+                // 构建完整路径
+                int n = snprintf(audio_path, PATH_MAX, "%s/%s", dir_path, audio_entry->d_name);
+                if (n < 0 || n >= PATH_MAX)
+                {
+                    free(audio_path);
+                    free(audio_entry);
+                    continue;
+                }
 
-                char *dot = strrchr(audio_entry->d_name, '.');
-                if (dot && strcasecmp(dot, ".mp3") == 0)
+                // 建立帧索引, 没有有效音频帧的文件不加入频道
+                mp3_index_t *idx = mp3_index_file(audio_path);
+                if (!idx)
                 {
-                    // 分配内存并存储完整路径
-                    char *audio_path = malloc(PATH_MAX);
-                    if (!audio_path)
-                    {
-                        fprintf(stderr, "内存分配失败\n");
-                        continue;
-                    }
-
-                    // 构建完整路径
-                    int n = snprintf(audio_path, PATH_MAX, "%s/%s", dir_path, audio_entry->d_name);
-                    if (n < 0 || n >= PATH_MAX)
-                    {
-                        free(audio_path);
-                        continue;
-                    }
-
-                    // 添加到音频文件列表
-                    chn->audio_files[chn->audio_count] = audio_path;
-                    chn->audio_count++;
-
-                    printf("添加音频文件: %s\n", audio_path);
+                    fprintf(stderr, "警告: %s 中没有有效的MPEG音频帧\n", audio_path);
+                    free(audio_path);
+                    free(audio_entry);
+                    continue;
                 }
+
+                // 添加到音频文件列表
+                chn->audio_files[chn->audio_count] = audio_path;
+                chn->audio_index[chn->audio_count] = idx;
+                chn->audio_count++;
+
+                printf("添加音频文件: %s\n", audio_path);
             }
-            closedir(audio_dir);
+            free(audio_entry);
         }
+        if (naudio >= 0)
+            free(audio_entries);
 
-        // 检查是否有音频文件
-        if (chn->audio_count > 0)
+        // 检查是否有音频文件, 并建立节目单时间表(各文件起始时间的前缀和)
+        if (chn->audio_count > 0 && chn->name &&
+            (chn->file_start_us = malloc(sizeof(uint64_t) * (chn->audio_count + 1))) != NULL)
         {
+            chn->file_start_us[0] = 0;
+            for (int i = 0; i < chn->audio_count; i++)
+                chn->file_start_us[i + 1] = chn->file_start_us[i] + chn->audio_index[i]->duration_us;
+            chn->current_file_offset = chn->audio_index[0]->audio_start;
             g_media_lib.chn_count++;
             printf("加载频道 %d: %s (%d 个音频文件)\n",
                    chn->chnid, chn->descr, chn->audio_count);
         }
         else
         {
+            for (int i = 0; i < chn->audio_count; i++)
+            {
+                free(chn->audio_files[i]);
+                mp3_index_free(chn->audio_index[i]);
+            }
+            free(chn->name);
             free(descr);
             fprintf(stderr, "警告: %s 中没有音频文件\n", dir_path);
         }
     }
 
-    closedir(dir);
+    for (int e = 0; e < nentries; e++)
+        free(entries[e]);
+    free(entries);
+    media_lib_set_gain();
     printf("总共加载 %d 个频道\n", g_media_lib.chn_count);
     return g_media_lib.chn_count > 0 ? 0 : -1;
 }
 
+// 响度归一: 以全库文件电平的中位数为目标(环境变量 MEDIA_GAIN 可指定目标电平, off 关闭),
+// 每个文件按与目标的差调整 global_gain, 提升幅度受限以免削波
+static void media_lib_set_gain(void)
+{
+    const char *env = getenv("MEDIA_GAIN");
+    if (env && strcmp(env, "off") == 0)
+        return;
+
+    uint32_t hist[256] = {0};
+    int nfiles = 0;
+    for (int c = 0; c < g_media_lib.chn_count; c++)
+    {
+        chn_info_t *chn = &g_media_lib.channels[c];
+        for (int i = 0; i < chn->audio_count; i++)
+        {
+            if (chn->audio_index[i]->gain_level >= 0)
+            {
+                hist[chn->audio_index[i]->gain_level]++;
+                nfiles++;
+            }
+        }
+    }
+    if (nfiles == 0)
+        return;
+
+    int target = -1;
+    if (env && *env)
+        target = atoi(env);
+    if (target < 0 || target > 255)
+    {
+        uint32_t acc = 0;
+        for (target = 0; target < 255; target++)
+        {
+            acc += hist[target];
+            if (acc * 2 >= (uint32_t)nfiles)
+                break;
+        }
+    }
+
+    for (int c = 0; c < g_media_lib.chn_count; c++)
+    {
+        chn_info_t *chn = &g_media_lib.channels[c];
+        for (int i = 0; i < chn->audio_count; i++)
+        {
+            mp3_index_t *idx = chn->audio_index[i];
+            if (idx->gain_level < 0)
+                continue;
+            int steps = target - idx->gain_level;
+            if (steps > GAIN_MAX_UP)
+                steps = GAIN_MAX_UP;
+            if (steps < -GAIN_MAX_DOWN)
+                steps = -GAIN_MAX_DOWN;
+            idx->gain_steps = steps;
+            if (steps != 0)
+                printf("响度归一: %s 电平%d 目标%d 调整%+d步(%+.1fdB)\n",
+                       chn->audio_files[i], idx->gain_level, target, steps, steps * 1.5);
+        }
+    }
+}
+
 // 读取描述文件
 static char *media_lib_read_descr(const char *dir_path)
 {
@@ -189,9 +300,17 @@ static void media_lib_free(void)
     {
         chn_info_t *chn = &g_media_lib.channels[i];
         free(chn->descr);
+        free(chn->name);
+        free(chn->file_start_us);
+        if (chn->fd >= 0)
+        {
+            close(chn->fd);
+            chn->fd = -1;
+        }
         for (int j = 0; j < chn->audio_count; j++)
         {
             free(chn->audio_files[j]);
+            mp3_index_free(chn->audio_index[j]);
         }
     }
     g_media_lib.chn_count = 0;
@@ -253,31 +372,407 @@ int media_lib_get_chn_list(struct mlib_list_entry **mlib, int *nmemb)
     return 0;
 }
 
+// 查找频道 (调用者持有锁)
+static chn_info_t *media_lib_find_chn(chnid_t chnid)
+{
+    for (int i = 0; i < g_media_lib.chn_count; i++)
+    {
+        if (g_media_lib.channels[i].chnid == chnid)
+            return &g_media_lib.channels[i];
+    }
+    return NULL;
+}
+
+// 获取频道当前播放位置(文件索引与文件内偏移)
+int media_lib_get_position(chnid_t chnid, int *file_index, long *offset)
+{
+    pthread_mutex_lock(&g_mutex);
+    chn_info_t *chn = media_lib_find_chn(chnid);
+    if (!chn)
+    {
+        pthread_mutex_unlock(&g_mutex);
+        return -1;
+    }
+    *file_index = chn->current_file_index;
+    *offset = chn->current_file_offset;
+    pthread_mutex_unlock(&g_mutex);
+    return 0;
+}
+
+// 获取频道第 index 个音频文件的路径, 返回该频道的文件数
+int media_lib_get_file(chnid_t chnid, int index, char *path, size_t len)
+{
+    pthread_mutex_lock(&g_mutex);
+    chn_info_t *chn = media_lib_find_chn(chnid);
+    if (!chn || index < 0 || index >= chn->audio_count)
+    {
+        pthread_mutex_unlock(&g_mutex);
+        return -1;
+    }
+    snprintf(path, len, "%s", chn->audio_files[index]);
+    int count = chn->audio_count;
+    pthread_mutex_unlock(&g_mutex);
+    return count;
+}
+
+// 获取频道描述
+int media_lib_get_descr(chnid_t chnid, char *descr, size_t len)
+{
+    pthread_mutex_lock(&g_mutex);
+    chn_info_t *chn = media_lib_find_chn(chnid);
+    if (!chn)
+    {
+        pthread_mutex_unlock(&g_mutex);
+        return -1;
+    }
+    snprintf(descr, len, "%s", chn->descr);
+    pthread_mutex_unlock(&g_mutex);
+    return 0;
+}
+
+// 获取频道目录名
+int media_lib_get_name(chnid_t chnid, char *name, size_t len)
+{
+    pthread_mutex_lock(&g_mutex);
+    chn_info_t *chn = media_lib_find_chn(chnid);
+    if (!chn)
+    {
+        pthread_mutex_unlock(&g_mutex);
+        return -1;
+    }
+    snprintf(name, len, "%s", chn->name);
+    pthread_mutex_unlock(&g_mutex);
+    return 0;
+}
+
 // 读取频道数据
 int media_lib_read_data(chnid_t chnid, void *buf, size_t size)
 {
-    if (!g_media_lib.initialized)
+    return media_lib_read_frames(chnid, buf, size, NULL);
+}
+
+// 切换到频道的下一个文件 (调用者持有锁)
+static void media_lib_next_file(chn_info_t *chn)
+{
+    if (chn->fd >= 0)
     {
-        if (media_lib_init() != 0)
+        close(chn->fd);
+        chn->fd = -1;
+    }
+    chn->current_file_index = (chn->current_file_index + 1) % chn->audio_count;
+    chn->current_seg = 0;
+    chn->frame_remain = 0;
+    chn->current_file_offset = chn->audio_index[chn->current_file_index]->audio_start;
+    PROBE2(mcast, media_file_switch, chn->chnid, chn->current_file_index);
+}
+
+// 文件内时间(微秒)所在的定位点: 返回该点的文件偏移, *at_us 为定位点的实际时间
+static long mp3_index_seek(const mp3_index_t *idx, uint64_t time_us, uint64_t *at_us)
+{
+    uint64_t target = time_us * (uint64_t)idx->samplerate / 1000000ULL;
+    int lo = 0, hi = idx->nseek - 1;
+    while (lo < hi)
+    {
+        int mid = (lo + hi + 1) / 2;
+        if (idx->seek[mid].samples <= target)
+            lo = mid;
+        else
+            hi = mid - 1;
+    }
+    if (at_us)
+        *at_us = idx->seek[lo].samples * 1000000ULL / (uint64_t)idx->samplerate;
+    return idx->seek[lo].offset;
+}
+
+// 文件偏移对应的文件内时间(微秒), 精度为一个定位点间隔
+static uint64_t mp3_index_time(const mp3_index_t *idx, long offset)
+{
+    int lo = 0, hi = idx->nseek - 1;
+    while (lo < hi)
+    {
+        int mid = (lo + hi + 1) / 2;
+        if (idx->seek[mid].offset <= offset)
+            lo = mid;
+        else
+            hi = mid - 1;
+    }
+    return idx->seek[lo].samples * 1000000ULL / (uint64_t)idx->samplerate;
+}
+
+// 偏移所在的数据段
+static int mp3_index_find_seg(const mp3_index_t *idx, long offset)
+{
+    int lo = 0, hi = idx->nsegments - 1;
+    while (lo < hi)
+    {
+        int mid = (lo + hi + 1) / 2;
+        if (idx->segments[mid].start <= offset)
+            lo = mid;
+        else
+            hi = mid - 1;
+    }
+    return lo;
+}
+
+// 把频道定位到第 file 个文件的 offset 处, offset 必须是帧开头 (调用者持有锁)
+static void media_lib_set_position(chn_info_t *chn, int file, long offset)
+{
+    if (file != chn->current_file_index && chn->fd >= 0)
+    {
+        close(chn->fd);
+        chn->fd = -1;
+    }
+    chn->current_file_index = file;
+    chn->current_seg = mp3_index_find_seg(chn->audio_index[file], offset);
+    chn->current_file_offset = offset;
+    chn->frame_remain = 0;
+}
+
+// 跳到频道节目单中的时间点: 先在文件起始时间表中二分找到文件, 再在文件的定位点中二分 (调用者持有锁)
+static void media_lib_seek_chn(chn_info_t *chn, uint64_t time_us)
+{
+    uint64_t total = chn->file_start_us[chn->audio_count];
+    if (total == 0)
+        return;
+    time_us %= total;
+
+    int lo = 0, hi = chn->audio_count - 1;
+    while (lo < hi)
+    {
+        int mid = (lo + hi + 1) / 2;
+        if (chn->file_start_us[mid] <= time_us)
+            lo = mid;
+        else
+            hi = mid - 1;
+    }
+    uint64_t at_us;
+    long offset = mp3_index_seek(chn->audio_index[lo], time_us - chn->file_start_us[lo], &at_us);
+    media_lib_set_position(chn, lo, offset);
+    syslog(LOG_DEBUG, "频道 %d 定位到 %s 第 %.1f 秒", chn->chnid, chn->audio_files[lo], at_us / 1e6);
+}
+
+// 文件路径中的文件名部分
+static const char *media_lib_basename(const char *path)
+{
+    const char *slash = strrchr(path, '/');
+    return slash ? slash + 1 : path;
+}
+
+// 按目录名查找频道: 频道按目录名排序加载, 二分查找 (调用者持有锁)
+static chn_info_t *media_lib_find_chn_by_name(const char *name)
+{
+    int lo = 0, hi = g_media_lib.chn_count - 1;
+    while (lo <= hi)
+    {
+        int mid = (lo + hi) / 2;
+        int cmp = strcmp(g_media_lib.channels[mid].name, name);
+        if (cmp == 0)
+            return &g_media_lib.channels[mid];
+        if (cmp < 0)
+            lo = mid + 1;
+        else
+            hi = mid - 1;
+    }
+    return NULL;
+}
+
+// 按文件名查找频道中的文件: 返回第一个文件名不小于 name 的索引, *exact 表示是否同名
+static int media_lib_find_file(const chn_info_t *chn, const char *name, int *exact)
+{
+    int lo = 0, hi = chn->audio_count;
+    while (lo < hi)
+    {
+        int mid = (lo + hi) / 2;
+        if (strcmp(media_lib_basename(chn->audio_files[mid]), name) < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    *exact = lo < chn->audio_count && strcmp(media_lib_basename(chn->audio_files[lo]), name) == 0;
+    return lo;
+}
+
+// 跳到频道节目单中的时间点(对节目总时长取模)
+int media_lib_seek(chnid_t chnid, uint64_t time_us)
+{
+    pthread_mutex_lock(&g_mutex);
+    chn_info_t *chn = media_lib_find_chn(chnid);
+    if (!chn)
+    {
+        pthread_mutex_unlock(&g_mutex);
+        return -1;
+    }
+    media_lib_seek_chn(chn, time_us);
+    pthread_mutex_unlock(&g_mutex);
+    return 0;
+}
+
+// 所有频道按墙钟对齐("永远在播"): 以 Unix 纪元为节目单零点循环播放,
+// 服务器何时重启、在哪台机器上启动, 同一时刻都播放同一位置
+int media_lib_seek_wallclock(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    uint64_t now_us = (uint64_t)ts.tv_sec * 1000000ULL + (uint64_t)ts.tv_nsec / 1000;
+
+    pthread_mutex_lock(&g_mutex);
+    for (int i = 0; i < g_media_lib.chn_count; i++)
+        media_lib_seek_chn(&g_media_lib.channels[i], now_us);
+    pthread_mutex_unlock(&g_mutex);
+    return 0;
+}
+
+// 保存各频道位置: 每行 "频道目录名<TAB>文件名<TAB>文件内毫秒"
+// 按名字而不是索引记录, 媒体库增删文件后仍能找回; 先写临时文件再改名, 中途崩溃不会留下半个文件
+int media_lib_state_save(const char *path)
+{
+    char *text = NULL;
+    size_t text_len = 0;
+    FILE *mem = open_memstream(&text, &text_len);
+    if (!mem)
+        return -1;
+
+    // 锁内只格式化到内存, 磁盘写入不阻塞各频道读取
+    pthread_mutex_lock(&g_mutex);
+    fprintf(mem, "# 频道目录\t文件名\t文件内毫秒\n");
+    for (int i = 0; i < g_media_lib.chn_count; i++)
+    {
+        chn_info_t *chn = &g_media_lib.channels[i];
+        int file = chn->current_file_index;
+        uint64_t us = mp3_index_time(chn->audio_index[file], chn->current_file_offset);
+        fprintf(mem, "%s\t%s\t%llu\n", chn->name, media_lib_basename(chn->audio_files[file]),
+                (unsigned long long)(us / 1000));
+    }
+    pthread_mutex_unlock(&g_mutex);
+    fclose(mem);
+
+    char tmp[PATH_MAX];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0)
+    {
+        fprintf(stderr, "无法写入状态文件 %s: %s\n", tmp, strerror(errno));
+        free(text);
+        return -1;
+    }
+    int ret = (write(fd, text, text_len) == (ssize_t)text_len && fsync(fd) == 0) ? 0 : -1;
+    close(fd);
+    free(text);
+    if (ret == 0 && rename(tmp, path) != 0)
+        ret = -1;
+    if (ret != 0)
+    {
+        fprintf(stderr, "保存状态文件 %s 失败: %s\n", path, strerror(errno));
+        unlink(tmp);
+    }
+    return ret;
+}
+
+// 从状态文件恢复各频道位置, 返回恢复的频道数
+// 频道与文件都按名字二分查找; 文件已被删除时从排在它后面的文件开头播放
+int media_lib_state_load(const char *path)
+{
+    FILE *fp = fopen(path, "r");
+    if (!fp)
+    {
+        if (errno != ENOENT)
+            fprintf(stderr, "无法读取状态文件 %s: %s\n", path, strerror(errno));
+        return errno == ENOENT ? 0 : -1;
+    }
+
+    char *line = NULL;
+    size_t cap = 0;
+    int restored = 0;
+    pthread_mutex_lock(&g_mutex);
+    while (getline(&line, &cap, fp) > 0)
+    {
+        if (line[0] == '#')
+            continue;
+        char *name = line;
+        char *file = strchr(name, '\t');
+        char *ms = file ? strchr(file + 1, '\t') : NULL;
+        if (!ms)
+            continue;
+        *file++ = '\0';
+        *ms++ = '\0';
+
+        chn_info_t *chn = media_lib_find_chn_by_name(name);
+        if (!chn)
         {
-            fprintf(stderr, "媒体库初始化失败\n");
-            return -1;
+            fprintf(stderr, "状态文件: 频道目录 %s 已不存在\n", name);
+            continue;
         }
+        int exact;
+        int index = media_lib_find_file(chn, file, &exact);
+        if (!exact)
+        {
+            fprintf(stderr, "状态文件: 频道 %s 中的 %s 已不存在, 从下一个文件开始\n", name, file);
+            index %= chn->audio_count;
+            media_lib_set_position(chn, index, chn->audio_index[index]->audio_start);
+        }
+        else
+        {
+            uint64_t at_us;
+            const mp3_index_t *idx = chn->audio_index[index];
+            uint64_t us = strtoull(ms, NULL, 10) * 1000ULL;
+            media_lib_set_position(chn, index, us < idx->duration_us ? mp3_index_seek(idx, us, &at_us)
+                                                                     : idx->audio_start);
+        }
+        printf("频道 %d 恢复到 %s\n", chn->chnid, chn->audio_files[chn->current_file_index]);
+        restored++;
     }
+    pthread_mutex_unlock(&g_mutex);
+    free(line);
+    fclose(fp);
+    return restored;
+}
 
+// 按频道目录名、文件名和帧边界偏移恢复位置 (热升级交接); 文件已不存在或偏移不在音频数据内时从下一个文件开始
+int media_lib_restore_position(const char *name, const char *file, long offset)
+{
     pthread_mutex_lock(&g_mutex);
+    chn_info_t *chn = media_lib_find_chn_by_name(name);
+    if (!chn || chn->audio_count == 0)
+    {
+        pthread_mutex_unlock(&g_mutex);
+        return -1;
+    }
+    int exact;
+    int index = media_lib_find_file(chn, file, &exact);
+    if (exact && offset >= chn->audio_index[index]->audio_start && offset < chn->audio_index[index]->audio_end)
+    {
+        media_lib_set_position(chn, index, offset);
+    }
+    else
+    {
+        fprintf(stderr, "频道 %s 中的 %s 已变化, 从下一个文件开始\n", name, file);
+        index = (index + (exact ? 1 : 0)) % chn->audio_count;
+        media_lib_set_position(chn, index, chn->audio_index[index]->audio_start);
+    }
+    int chnid = chn->chnid;
+    pthread_mutex_unlock(&g_mutex);
+    return chnid;
+}
 
-    // 查找频道
-    chn_info_t *chn = NULL;
-    for (int i = 0; i < g_media_lib.chn_count; i++)
+// 读取频道数据: 只输出帧索引中的有效MPEG帧, 且尽量以整帧为单位
+// 标签(ID3v2/ID3v1/APE)与帧间垃圾数据不会被发送; chunk 返回本次数据的采样数与播放时长
+static int media_lib_read_frames_impl(chnid_t chnid, void *buf, size_t size, media_chunk_t *chunk)
+{
+    if (!g_media_lib.initialized)
     {
-        if (g_media_lib.channels[i].chnid == chnid)
+        if (media_lib_init() != 0)
         {
-            chn = &g_media_lib.channels[i];
-            break;
+            fprintf(stderr, "媒体库初始化失败\n");
+            return -1;
         }
     }
+    if (chunk)
+        memset(chunk, 0, sizeof(*chunk));
+
+    pthread_mutex_lock(&g_mutex);
 
+    // 查找频道
+    chn_info_t *chn = media_lib_find_chn(chnid);
     if (!chn)
     {
         fprintf(stderr, "错误: 频道 %d 未找到\n", chnid);
@@ -292,49 +787,666 @@ int media_lib_read_data(chnid_t chnid, void *buf, size_t size)
         return -1;
     }
 
-    // 获取当前音频文件路径
+    // 当前文件保持打开, 用 pread 按偏移读取
     const char *current_file = chn->audio_files[chn->current_file_index];
-    printf("打开文件: %s (偏移量: %ld)\n", current_file, chn->current_file_offset);
+    if (chn->fd < 0)
+    {
+        chn->fd = open(current_file, O_RDONLY | O_CLOEXEC);
+        if (chn->fd < 0)
+        {
+            fprintf(stderr, "无法打开音频文件: %s (%s)\n", current_file, strerror(errno));
+            media_lib_next_file(chn);
+            pthread_mutex_unlock(&g_mutex);
+            return -1;
+        }
+    }
 
-    FILE *file = fopen(current_file, "rb");
-    if (!file)
+    mp3_index_t *idx = chn->audio_index[chn->current_file_index];
+    mp3_segment_t *seg = &idx->segments[chn->current_seg];
+    long pos = chn->current_file_offset;
+    size_t avail = (size_t)(seg->end - pos);
+    ssize_t n = pread(chn->fd, buf, size < avail ? size : avail, pos);
+    if (n <= 0)
     {
-        fprintf(stderr, "无法打开音频文件: %s (%s)\n", current_file, strerror(errno));
+        // 文件被截断或读取出错, 跳到下一个文件
+        fprintf(stderr, "文件读取错误: %s (%s)\n", current_file, n < 0 ? strerror(errno) : "EOF");
+        media_lib_next_file(chn);
         pthread_mutex_unlock(&g_mutex);
         return -1;
     }
 
-    if (fseek(file, chn->current_file_offset, SEEK_SET) != 0)
+    // 截取整帧; 上一帧未发完时先发剩余部分
+    const uint8_t *p = buf;
+    size_t emit = 0;
+    uint64_t samples = 0;
+    int sync = 0, raw = 0;
+    mp3_frame_t frame;
+    if (chn->frame_remain > 0)
+    {
+        emit = (size_t)chn->frame_remain < (size_t)n ? (size_t)chn->frame_remain : (size_t)n;
+        chn->frame_remain -= (int)emit;
+    }
+    else
+    {
+        sync = (n >= 4 && mp3_parse_header(p, &frame) == 0);
+        while (emit + 4 <= (size_t)n && mp3_parse_header(p + emit, &frame) == 0 &&
+               emit + frame.frame_len <= (size_t)n)
+        {
+            // 响度归一: 在读出的整帧上原地改写 global_gain
+            if (idx->gain_steps != 0)
+                mp3_apply_gain((uint8_t *)buf + emit, (size_t)frame.frame_len, &frame, idx->gain_steps);
+            emit += frame.frame_len;
+            samples += frame.samples;
+        }
+        if (emit == 0 && mp3_parse_header(p, &frame) == 0)
+        {
+            // 单帧大于读取上限: 先发前半部分 (侧信息在前半部分内)
+            emit = (size_t)n;
+            chn->frame_remain = frame.frame_len - (int)n;
+            samples = frame.samples;
+            if (idx->gain_steps != 0)
+                mp3_apply_gain((uint8_t *)buf, (size_t)n, &frame, idx->gain_steps);
+        }
+        else if (emit == 0)
+        {
+            emit = (size_t)n;   // 索引与文件不一致(文件被修改), 按原始数据发送
+            raw = 1;
+        }
+    }
+    if (chunk)
+    {
+        chunk->samples = (uint32_t)samples;
+        chunk->samplerate = (uint32_t)idx->samplerate;
+        chunk->sync = sync;
+        if (samples > 0)
+            chunk->duration_us = (uint32_t)(samples * 1000000ULL / idx->samplerate);
+        else if (raw && idx->bitrate > 0)
+            chunk->duration_us = (uint32_t)(emit * 8 * 1000ULL / idx->bitrate);   // 原始数据按平均码率估算
+    }
+
+    // 前进到下一个数据段或下一个文件
+    chn->current_file_offset = pos + (long)emit;
+    if (chn->current_file_offset >= seg->end && chn->frame_remain == 0)
+    {
+        if (++chn->current_seg < idx->nsegments)
+            chn->current_file_offset = idx->segments[chn->current_seg].start;
+        else
+            media_lib_next_file(chn);
+    }
+
+    pthread_mutex_unlock(&g_mutex);
+    return (int)emit;
+}
+
+int media_lib_read_frames(chnid_t chnid, void *buf, size_t size, media_chunk_t *chunk)
+{
+    // 入口/返回探针成对出现, 跟踪脚本按线程计算读取耗时
+    PROBE2(mcast, media_read_entry, chnid, size);
+    int ret = media_lib_read_frames_impl(chnid, buf, size, chunk);
+    PROBE3(mcast, media_read_return, chnid, ret, chunk ? chunk->duration_us : 0);
+    return ret;
+}
+
+// 获取频道第 index 个曲目的信息
+int media_lib_get_track(chnid_t chnid, int index, media_track_t *track)
+{
+    pthread_mutex_lock(&g_mutex);
+    chn_info_t *chn = media_lib_find_chn(chnid);
+    if (!chn || index < 0 || index >= chn->audio_count)
     {
-        fprintf(stderr, "文件定位失败: %s (%s)\n", current_file, strerror(errno));
-        fclose(file);
         pthread_mutex_unlock(&g_mutex);
         return -1;
     }
+    const mp3_index_t *idx = chn->audio_index[index];
+    snprintf(track->path, sizeof(track->path), "%s", chn->audio_files[index]);
+    track->audio_start = idx->audio_start;
+    track->audio_end = idx->audio_end;
+    track->bitrate = idx->bitrate;
+    track->duration_us = idx->duration_us;
+    if (idx->title)
+    {
+        snprintf(track->title, sizeof(track->title), "%s", idx->title);
+    }
+    else
+    {
+        // 无标签时用文件名(去掉目录与扩展名)
+        const char *name = strrchr(track->path, '/');
+        snprintf(track->title, sizeof(track->title), "%.*s", TAG_TEXT_MAX - 1,
+                 name ? name + 1 : track->path);
+        char *dot = strrchr(track->title, '.');
+        if (dot)
+            *dot = '\0';
+    }
+    snprintf(track->artist, sizeof(track->artist), "%s", idx->artist ? idx->artist : "");
+    pthread_mutex_unlock(&g_mutex);
+    return 0;
+}
 
-    // 只读取 size 字节
-    size_t bytes_read = fread(buf, 1, size, file);
+// MPEG音频码率表(kbps): [MPEG-1/MPEG-2(.5)][层-1][索引]
+static const int mp3_bitrates[2][3][16] = {
+    {{0, 32, 64, 96, 128, 160, 192, 224, 256, 288, 320, 352, 384, 416, 448, -1},
+     {0, 32, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 384, -1},
+     {0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, -1}},
+    {{0, 32, 48, 56, 64, 80, 96, 112, 128, 144, 160, 176, 192, 224, 256, -1},
+     {0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160, -1},
+     {0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160, -1}}};
 
-    if (ferror(file))
+// 采样率表(Hz): [MPEG-1/MPEG-2/MPEG-2.5][索引]
+static const int mp3_samplerates[3][3] = {
+    {44100, 48000, 32000},
+    {22050, 24000, 16000},
+    {11025, 12000, 8000}};
+
+// 解析4字节MPEG音频帧头
+int mp3_parse_header(const uint8_t *p, mp3_frame_t *frame)
+{
+    // 11位同步字
+    if (p[0] != 0xFF || (p[1] & 0xE0) != 0xE0)
+        return -1;
+
+    int ver_bits = (p[1] >> 3) & 0x03;
+    int layer_bits = (p[1] >> 1) & 0x03;
+    int br_idx = (p[2] >> 4) & 0x0F;
+    int sr_idx = (p[2] >> 2) & 0x03;
+    int padding = (p[2] >> 1) & 0x01;
+    int mode = (p[3] >> 6) & 0x03;
+
+    // 保留值及"free format"码率不支持
+    if (ver_bits == 1 || layer_bits == 0 || br_idx == 0 || br_idx == 15 || sr_idx == 3)
+        return -1;
+
+    int ver_row = (ver_bits == 3) ? 0 : (ver_bits == 2 ? 1 : 2);
+    frame->version = (ver_bits == 3) ? 1 : (ver_bits == 2 ? 2 : 25);
+    frame->layer = 4 - layer_bits;
+    frame->bitrate = mp3_bitrates[ver_row ? 1 : 0][frame->layer - 1][br_idx];
+    frame->samplerate = mp3_samplerates[ver_row][sr_idx];
+    frame->channels = (mode == 3) ? 1 : 2;
+    frame->protection = !(p[1] & 0x01);
+
+    if (frame->layer == 1)
     {
-        fprintf(stderr, "文件读取错误: %s (%s)\n", current_file, strerror(errno));
-        fclose(file);
-        pthread_mutex_unlock(&g_mutex);
+        frame->samples = 384;
+        frame->frame_len = (12 * frame->bitrate * 1000 / frame->samplerate + padding) * 4;
+    }
+    else if (frame->layer == 3 && frame->version != 1)
+    {
+        frame->samples = 576;
+        frame->frame_len = 72 * frame->bitrate * 1000 / frame->samplerate + padding;
+    }
+    else
+    {
+        frame->samples = 1152;
+        frame->frame_len = 144 * frame->bitrate * 1000 / frame->samplerate + padding;
+    }
+    return 0;
+}
+
+// 查找第一个可靠的帧同步点: 帧头合法且下一帧帧头同样合法(或超出缓冲区)
+int mp3_find_sync(const uint8_t *buf, size_t len)
+{
+    mp3_frame_t cur, next;
+    for (size_t i = 0; i + 4 <= len; i++)
+    {
+        if (buf[i] != 0xFF || mp3_parse_header(buf + i, &cur) != 0)
+            continue;
+        size_t next_off = i + cur.frame_len;
+        if (next_off + 4 > len)
+            return (int)i;
+        if (mp3_parse_header(buf + next_off, &next) == 0 &&
+            next.version == cur.version && next.layer == cur.layer &&
+            next.samplerate == cur.samplerate)
+            return (int)i;
+    }
+    return -1;
+}
+
+// ---------------- Layer III 侧信息: global_gain ----------------
+
+// 侧信息长度(字节)
+static size_t mp3_side_len(const mp3_frame_t *frame)
+{
+    if (frame->version == 1)
+        return (frame->channels == 1) ? 17 : 32;
+    return (frame->channels == 1) ? 9 : 17;
+}
+
+// 侧信息中 (颗粒,声道) 个数: MPEG-1 每帧两个颗粒, MPEG-2/2.5 一个
+static int mp3_granules(const mp3_frame_t *frame)
+{
+    return (frame->version == 1 ? 2 : 1) * frame->channels;
+}
+
+// 第 i 个 (颗粒,声道) 信息相对侧信息开头的位偏移, 依次为
+// part2_3_length(12) big_values(9) global_gain(8) ...; MPEG-1 每组59位, MPEG-2 每组63位
+static int mp3_granule_bit(const mp3_frame_t *frame, int i)
+{
+    if (frame->version == 1)
+        return 9 + (frame->channels == 1 ? 5 : 3) + 4 * frame->channels + i * 59;
+    return 8 + (frame->channels == 1 ? 1 : 2) + i * 63;
+}
+
+static unsigned int get_bits(const uint8_t *p, int bit, int n)
+{
+    unsigned int v = 0;
+    for (int i = 0; i < n; i++, bit++)
+        v = (v << 1) | ((p[bit >> 3] >> (7 - (bit & 7))) & 1);
+    return v;
+}
+
+static void put_bits(uint8_t *p, int bit, int n, unsigned int v)
+{
+    for (int i = n - 1; i >= 0; i--, bit++)
+    {
+        uint8_t mask = (uint8_t)(1 << (7 - (bit & 7)));
+        if ((v >> i) & 1)
+            p[bit >> 3] |= mask;
+        else
+            p[bit >> 3] &= (uint8_t)~mask;
+    }
+}
+
+// MPEG 音频 CRC-16 (多项式 0x8005, 初值 0xFFFF): 覆盖帧头后两字节与侧信息
+static uint16_t mp3_crc16(const uint8_t *p, size_t side_len)
+{
+    uint16_t crc = 0xFFFF;
+    for (size_t i = 0; i < 2 + side_len; i++)
+    {
+        // 跳过帧头前两字节与 CRC 本身
+        uint8_t byte = (i < 2) ? p[2 + i] : p[6 + i - 2];
+        crc ^= (uint16_t)(byte << 8);
+        for (int b = 0; b < 8; b++)
+            crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x8005) : (uint16_t)(crc << 1);
+    }
+    return crc;
+}
+
+// 原地给一帧的每个颗粒的 global_gain 加 steps (1.5dB/步), 与 mp3gain 相同的无损调整
+// 帧带 CRC 时重新计算; 原 CRC 本就不对的帧保持原样; 返回是否修改
+int mp3_apply_gain(uint8_t *p, size_t len, const mp3_frame_t *frame, int steps)
+{
+    size_t side_len = mp3_side_len(frame);
+    size_t side_off = 4 + (frame->protection ? 2 : 0);
+    if (frame->layer != 3 || steps == 0 || len < side_off + side_len)
+        return 0;
+    if (frame->protection && mp3_crc16(p, side_len) != (uint16_t)((p[4] << 8) | p[5]))
+        return 0;
+
+    uint8_t *side = p + side_off;
+    for (int i = 0; i < mp3_granules(frame); i++)
+    {
+        int bit = mp3_granule_bit(frame, i) + 21;
+        int gain = (int)get_bits(side, bit, 8) + steps;
+        put_bits(side, bit, 8, (unsigned int)(gain < 0 ? 0 : (gain > 255 ? 255 : gain)));
+    }
+    if (frame->protection)
+    {
+        uint16_t crc = mp3_crc16(p, side_len);
+        p[4] = (uint8_t)(crc >> 8);
+        p[5] = (uint8_t)crc;
+    }
+    return 1;
+}
+
+// 响度分析: 统计非静音颗粒(有量化数据)的 global_gain 分布
+// global_gain 是量化步长的对数(1.5dB/步), 响的曲目需要更大的步长, 其中位数可粗略代表整体电平;
+// 不解码即可得到, 建索引时顺带完成
+static void mp3_gain_collect(const uint8_t *p, size_t len, const mp3_frame_t *frame, uint32_t *hist)
+{
+    size_t side_off = 4 + (frame->protection ? 2 : 0);
+    if (frame->layer != 3 || len < side_off + mp3_side_len(frame))
+        return;
+    const uint8_t *side = p + side_off;
+    for (int i = 0; i < mp3_granules(frame); i++)
+    {
+        int bit = mp3_granule_bit(frame, i);
+        if (get_bits(side, bit, 12) == 0 || get_bits(side, bit + 12, 9) == 0)
+            continue;
+        hist[get_bits(side, bit + 21, 8)]++;
+    }
+}
+
+// ---------------- 帧索引: 去除标签与垃圾数据 ----------------
+
+// ID3v2 同步安全整数(每字节7位)
+static uint32_t id3_syncsafe(const uint8_t *p)
+{
+    return ((uint32_t)(p[0] & 0x7F) << 21) | ((uint32_t)(p[1] & 0x7F) << 14) |
+           ((uint32_t)(p[2] & 0x7F) << 7) | (uint32_t)(p[3] & 0x7F);
+}
+
+static uint32_t le32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// 把标签文本转换为UTF-8; enc: 0 Latin-1, 1 带BOM的UTF-16, 2 UTF-16BE, 3 UTF-8
+static char *id3_text(int enc, const uint8_t *p, size_t len)
+{
+    char *out = malloc(len * 3 + 1);
+    if (!out)
+        return NULL;
+    size_t o = 0;
+    if (enc == 0 || enc == 3)
+    {
+        for (size_t i = 0; i < len && p[i]; i++)
+        {
+            if (enc == 3 || p[i] < 0x80)
+            {
+                out[o++] = (char)p[i];
+            }
+            else
+            {
+                out[o++] = (char)(0xC0 | (p[i] >> 6));
+                out[o++] = (char)(0x80 | (p[i] & 0x3F));
+            }
+        }
+    }
+    else
+    {
+        int be = (enc == 2);
+        size_t i = 0;
+        if (enc == 1 && len >= 2)
+        {
+            be = (p[0] == 0xFE && p[1] == 0xFF);
+            i = 2;
+        }
+        for (; i + 1 < len; i += 2)
+        {
+            uint32_t c = be ? ((uint32_t)p[i] << 8 | p[i + 1]) : ((uint32_t)p[i + 1] << 8 | p[i]);
+            if (c == 0)
+                break;
+            if (c >= 0xD800 && c < 0xDC00 && i + 3 < len)
+            {
+                uint32_t lo = be ? ((uint32_t)p[i + 2] << 8 | p[i + 3]) : ((uint32_t)p[i + 3] << 8 | p[i + 2]);
+                c = 0x10000 + ((c - 0xD800) << 10) + (lo - 0xDC00);
+                i += 2;
+            }
+            if (c < 0x80)
+            {
+                out[o++] = (char)c;
+            }
+            else if (c < 0x800)
+            {
+                out[o++] = (char)(0xC0 | (c >> 6));
+                out[o++] = (char)(0x80 | (c & 0x3F));
+            }
+            else if (c < 0x10000)
+            {
+                out[o++] = (char)(0xE0 | (c >> 12));
+                out[o++] = (char)(0x80 | ((c >> 6) & 0x3F));
+                out[o++] = (char)(0x80 | (c & 0x3F));
+            }
+            else if (o + 4 <= len * 3)
+            {
+                out[o++] = (char)(0xF0 | (c >> 18));
+                out[o++] = (char)(0x80 | ((c >> 12) & 0x3F));
+                out[o++] = (char)(0x80 | ((c >> 6) & 0x3F));
+                out[o++] = (char)(0x80 | (c & 0x3F));
+            }
+        }
+    }
+    // 去掉末尾空格
+    while (o > 0 && out[o - 1] == ' ')
+        o--;
+    out[o] = '\0';
+    if (o == 0)
+    {
+        free(out);
+        return NULL;
+    }
+    return out;
+}
+
+// 从ID3v2标签中取标题和艺术家 (v2.2 TT2/TP1, v2.3/v2.4 TIT2/TPE1)
+static void id3v2_parse(const uint8_t *tag, size_t len, mp3_index_t *idx)
+{
+    int major = tag[3];
+    int flags = tag[5];
+    size_t pos = 10;
+    if (major < 2 || major > 4 || (flags & 0x80))   // 不处理整体非同步化的标签
+        return;
+    if ((flags & 0x40) && major >= 3 && pos + 4 <= len)
+    {
+        // 扩展头
+        uint32_t ext = (major == 4) ? id3_syncsafe(tag + pos)
+                                    : ((uint32_t)tag[pos] << 24 | (uint32_t)tag[pos + 1] << 16 |
+                                       (uint32_t)tag[pos + 2] << 8 | tag[pos + 3]) + 4;
+        pos += ext;
+    }
+
+    size_t hdr_len = (major == 2) ? 6 : 10;
+    while (pos + hdr_len <= len && tag[pos] != 0)
+    {
+        const uint8_t *f = tag + pos;
+        size_t fsize;
+        if (major == 2)
+            fsize = (size_t)f[3] << 16 | (size_t)f[4] << 8 | f[5];
+        else if (major == 4)
+            fsize = id3_syncsafe(f + 4);
+        else
+            fsize = (size_t)f[4] << 24 | (size_t)f[5] << 16 | (size_t)f[6] << 8 | f[7];
+        if (fsize == 0 || pos + hdr_len + fsize > len)
+            break;
+
+        const uint8_t *body = f + hdr_len;
+        int is_title = (major == 2) ? memcmp(f, "TT2", 3) == 0 : memcmp(f, "TIT2", 4) == 0;
+        int is_artist = (major == 2) ? memcmp(f, "TP1", 3) == 0 : memcmp(f, "TPE1", 4) == 0;
+        if ((is_title && !idx->title) || (is_artist && !idx->artist))
+        {
+            char *text = id3_text(body[0], body + 1, fsize - 1);
+            if (is_title)
+                idx->title = text;
+            else
+                idx->artist = text;
+        }
+        pos += hdr_len + fsize;
+    }
+}
+
+// Xing/Info/VBRI 信息帧不含音频, 解码器会把它当作一帧静音, 直接剔除
+static int mp3_is_info_frame(const uint8_t *p, size_t len, const mp3_frame_t *frame)
+{
+    size_t off = 4 + mp3_side_len(frame) + (frame->protection ? 2 : 0);
+    if (off + 4 <= len && (memcmp(p + off, "Xing", 4) == 0 || memcmp(p + off, "Info", 4) == 0))
+        return 1;
+    if (4 + 32 + 4 <= len && memcmp(p + 4 + 32, "VBRI", 4) == 0)
+        return 1;
+    return 0;
+}
+
+static void mp3_index_free(mp3_index_t *idx)
+{
+    if (!idx)
+        return;
+    free(idx->segments);
+    free(idx->seek);
+    free(idx->title);
+    free(idx->artist);
+    free(idx);
+}
+
+// 追加一个有效帧数据段
+static int mp3_index_add_segment(mp3_index_t *idx, long start, long end)
+{
+    if (idx->nsegments > 0 && idx->segments[idx->nsegments - 1].end == start)
+    {
+        idx->segments[idx->nsegments - 1].end = end;
+        return 0;
+    }
+    mp3_segment_t *segs = realloc(idx->segments, sizeof(*segs) * (idx->nsegments + 1));
+    if (!segs)
         return -1;
+    idx->segments = segs;
+    idx->segments[idx->nsegments].start = start;
+    idx->segments[idx->nsegments].end = end;
+    idx->nsegments++;
+    return 0;
+}
+
+// 追加一个时间定位点, 数组按2的幂扩容
+static int mp3_index_add_seek(mp3_index_t *idx, uint64_t samples, long offset)
+{
+    if ((idx->nseek & (idx->nseek - 1)) == 0)
+    {
+        int cap = idx->nseek ? idx->nseek * 2 : 1;
+        mp3_seek_t *seek = realloc(idx->seek, sizeof(*seek) * cap);
+        if (!seek)
+            return -1;
+        idx->seek = seek;
     }
+    idx->seek[idx->nseek].samples = samples;
+    idx->seek[idx->nseek].offset = offset;
+    idx->nseek++;
+    return 0;
+}
 
-    chn->current_file_offset = ftell(file);
+// 扫描音频文件, 建立有效MPEG帧的数据段索引并读取标签; 没有有效帧返回NULL
+static mp3_index_t *mp3_index_file(const char *path)
+{
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return NULL;
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size < 4)
+    {
+        close(fd);
+        return NULL;
+    }
+    size_t size = (size_t)st.st_size;
+    const uint8_t *data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+        return NULL;
 
-    if (bytes_read < size || feof(file))
+    mp3_index_t *idx = calloc(1, sizeof(*idx));
+    if (!idx)
     {
-        chn->current_file_index = (chn->current_file_index + 1) % chn->audio_count;
-        chn->current_file_offset = 0;
-        printf("切换到下一个文件: %s\n", chn->audio_files[chn->current_file_index]);
+        munmap((void *)data, size);
+        return NULL;
     }
 
-    fclose(file);
-    pthread_mutex_unlock(&g_mutex);
+    // 开头的ID3v2标签(可能有多个)
+    size_t start = 0;
+    while (start + 10 <= size && memcmp(data + start, "ID3", 3) == 0 &&
+           data[start + 3] < 0xFF && data[start + 4] < 0xFF)
+    {
+        size_t tag_len = 10 + id3_syncsafe(data + start + 6) + ((data[start + 5] & 0x10) ? 10 : 0);
+        if (start + tag_len > size)
+            break;
+        id3v2_parse(data + start, tag_len, idx);
+        start += tag_len;
+    }
+
+    // 结尾的ID3v1, Lyrics3v2 与 APEv2 标签
+    size_t end = size;
+    int changed = 1;
+    while (changed)
+    {
+        changed = 0;
+        if (end >= start + 128 && memcmp(data + end - 128, "TAG", 3) == 0)
+        {
+            const uint8_t *v1 = data + end - 128;
+            if (!idx->title)
+                idx->title = id3_text(0, v1 + 3, 30);
+            if (!idx->artist)
+                idx->artist = id3_text(0, v1 + 33, 30);
+            end -= 128;
+            changed = 1;
+        }
+        if (end >= start + 15 && memcmp(data + end - 9, "LYRICS200", 9) == 0)
+        {
+            char digits[7];
+            memcpy(digits, data + end - 15, 6);
+            digits[6] = '\0';
+            size_t lyr = (size_t)strtoul(digits, NULL, 10) + 15;
+            if (lyr <= end - start)
+            {
+                end -= lyr;
+                changed = 1;
+            }
+        }
+        if (end >= start + 32 && memcmp(data + end - 32, "APETAGEX", 8) == 0)
+        {
+            const uint8_t *footer = data + end - 32;
+            size_t ape = le32(footer + 12) + ((le32(footer + 20) & 0x80000000u) ? 32 : 0);
+            if (ape <= end - start)
+            {
+                end -= ape;
+                changed = 1;
+            }
+        }
+    }
 
-    printf("实际读取: %zu 字节 (请求: %zu 字节)\n", bytes_read, size);
-    return bytes_read;
+    // 逐帧扫描, 以第一个可靠同步点的版本/层/采样率为准, 遇到垃圾数据重新同步
+    int sync = mp3_find_sync(data + start, end - start);
+    mp3_frame_t ref, frame;
+    uint64_t samples = 0, bytes = 0;
+    uint32_t frames = 0;
+    uint32_t gain_hist[256] = {0};
+    if (sync >= 0)
+    {
+        size_t pos = start + (size_t)sync;
+        mp3_parse_header(data + pos, &ref);
+        if (mp3_is_info_frame(data + pos, end - pos, &ref))
+            pos += ref.frame_len;
+        size_t seg_start = pos;
+        while (pos + 4 <= end)
+        {
+            if (mp3_parse_header(data + pos, &frame) == 0 && frame.version == ref.version &&
+                frame.layer == ref.layer && frame.samplerate == ref.samplerate &&
+                pos + frame.frame_len <= end)
+            {
+                if (frames % MP3_SEEK_FRAMES == 0 && mp3_index_add_seek(idx, samples, (long)pos) != 0)
+                    break;
+                frames++;
+                samples += frame.samples;
+                bytes += frame.frame_len;
+                mp3_gain_collect(data + pos, (size_t)frame.frame_len, &frame, gain_hist);
+                pos += frame.frame_len;
+                continue;
+            }
+            // 结束当前数据段, 从下一个可靠同步点继续
+            if (pos > seg_start && mp3_index_add_segment(idx, (long)seg_start, (long)pos) != 0)
+                break;
+            int next = mp3_find_sync(data + pos + 1, end - pos - 1);
+            if (next < 0)
+            {
+                seg_start = pos = end;
+                break;
+            }
+            pos += 1 + (size_t)next;
+            seg_start = pos;
+        }
+        if (pos > seg_start)
+            mp3_index_add_segment(idx, (long)seg_start, (long)pos);
+    }
+    munmap((void *)data, size);
+
+    if (idx->nsegments == 0 || samples == 0)
+    {
+        mp3_index_free(idx);
+        return NULL;
+    }
+    idx->audio_start = idx->segments[0].start;
+    idx->audio_end = idx->segments[idx->nsegments - 1].end;
+    idx->frames = frames;
+    idx->samplerate = ref.samplerate;
+    idx->duration_us = samples * 1000000ULL / (uint64_t)ref.samplerate;
+    idx->bitrate = (int)((bytes * 8 * (uint64_t)ref.samplerate / samples + 500) / 1000);
+
+    // 非静音颗粒 global_gain 的中位数作为响度估计
+    uint64_t total = 0, acc = 0;
+    for (int g = 0; g < 256; g++)
+        total += gain_hist[g];
+    idx->gain_level = -1;
+    for (int g = 0; g < 256 && total > 0; g++)
+    {
+        acc += gain_hist[g];
+        if (acc * 2 >= total)
+        {
+            idx->gain_level = g;
+            break;
+        }
+    }
+    return idx;
 }
@@ -5,25 +5,84 @@
 #include <sys/types.h>  // 包含 size_t 定义
 
 // 媒体库路径和参数定义
-#define MEDIA_LIB_PATH  "/home/xyw/Linux_project/musical"       // 媒体库根路径
+#define MEDIA_LIB_PATH  "/home/xyw/Linux_project/musical"       // 媒体库根路径(可被同名环境变量覆盖)
 #define CHN_DESCR_NAME  "descr.txt"     // 频道描述文件名
 #define MIN_CHN_ID      1                // 最小频道ID
 #define MAXCHN_NR       200              // 最大频道数量
 #define MAX_AUDIO_FILES 1024             // 每个频道最大音频文件数
+#define TAG_TEXT_MAX    256              // 标签文本(标题/艺术家)最大长度
+#define GAIN_MAX_UP     4                // 响度归一最多提升的 global_gain 步数 (1.5dB/步)
+#define GAIN_MAX_DOWN   12               // 响度归一最多降低的步数
+#define MP3_SEEK_FRAMES 16               // 每隔多少帧记录一个时间定位点 (Layer III 44.1kHz 约0.4秒)
 
 // 频道ID类型定义
 typedef uint8_t chnid_t;
 
+// 音频数据段: 文件中一段连续的有效MPEG帧 [start, end)
+typedef struct mp3_segment {
+    long start;
+    long end;
+} mp3_segment_t;
+
+// 时间定位点: 某个帧开头之前的累计采样数与该帧的文件偏移, 按两者单调递增排列
+typedef struct mp3_seek {
+    uint64_t samples;
+    long offset;
+} mp3_seek_t;
+
+// 单个文件的帧索引, 加载时建立一次; 标签与垃圾数据不在任何数据段内
+typedef struct mp3_index {
+    long audio_start;               // 第一个有效帧偏移
+    long audio_end;                 // 最后一个有效帧结束偏移
+    int nsegments;                  // 数据段个数
+    mp3_segment_t *segments;        // 数据段数组
+    uint32_t frames;                // 有效帧数
+    uint64_t duration_us;           // 总时长(微秒)
+    int bitrate;                    // 平均码率(kbps)
+    int samplerate;                 // 采样率(Hz)
+    char *title;                    // 标签中的标题, 可能为NULL
+    char *artist;                   // 标签中的艺术家, 可能为NULL
+    int gain_level;                 // 响度估计: 非静音颗粒 global_gain 的中位数, -1 表示无法估计(非Layer III)
+    int gain_steps;                 // 播放时给每个颗粒 global_gain 加的步数, 0 表示不调整
+    int nseek;                      // 时间定位点个数
+    mp3_seek_t *seek;               // 每 MP3_SEEK_FRAMES 帧一个定位点, 时间与偏移互查均为二分查找
+} mp3_index_t;
+
 // 频道信息结构体
 typedef struct chn_info {
     chnid_t chnid;                  // 频道ID
     char *descr;                    // 频道描述
+    char *name;                     // 频道目录名 (状态文件按名字匹配频道)
     int audio_count;                // 音频文件数量
     int current_file_index;         // 当前播放文件索引
     long current_file_offset;       // 当前文件读取偏移量
+    int current_seg;                // 当前数据段索引
+    int frame_remain;               // 上一帧超过单次读取大小时剩余的字节数
+    int fd;                         // 当前文件描述符, -1 表示未打开
     char *audio_files[MAX_AUDIO_FILES]; // 音频文件路径数组
+    mp3_index_t *audio_index[MAX_AUDIO_FILES]; // 音频文件帧索引数组
+    uint64_t *file_start_us;        // 节目单时间表: 第i个文件的起始时间, 共 audio_count+1 项, 末项为总时长
 } chn_info_t;
 
+// 曲目信息 (供频道目录与HTTP元数据使用)
+typedef struct media_track {
+    char path[4096];                // 文件路径
+    long audio_start;               // 音频数据起始偏移
+    long audio_end;                 // 音频数据结束偏移
+    int bitrate;                    // 平均码率(kbps)
+    uint64_t duration_us;           // 总时长(微秒)
+    char title[TAG_TEXT_MAX];       // 标题, 无标签时为文件名
+    char artist[TAG_TEXT_MAX];      // 艺术家, 可能为空
+} media_track_t;
+
+// 一次 media_lib_read_frames 读出的数据信息
+typedef struct media_chunk {
+    uint32_t samples;               // 数据中各帧的采样数之和; 被拆开的大帧计入第一段
+    uint32_t samplerate;            // 采样率(Hz)
+    uint32_t duration_us;           // 播放时长(微秒)
+    int sync;                       // 数据以帧头开头
+} media_chunk_t;
+
 // 媒体库全局结构体
 typedef struct media_lib {
     int initialized;                // 库初始化标志
@@ -40,10 +99,39 @@ typedef struct mlib_list_entry {
     char *descr;        // 频道描述
 } mlib_list_entry;
 
+// MPEG音频帧头信息
+typedef struct mp3_frame {
+    int version;        // 1=MPEG-1, 2=MPEG-2, 25=MPEG-2.5
+    int layer;          // 1/2/3
+    int bitrate;        // 码率(kbps)
+    int samplerate;     // 采样率(Hz)
+    int channels;       // 声道数
+    int protection;     // 1=帧头后带CRC16
+    int samples;        // 每帧采样数
+    int frame_len;      // 帧总长(字节, 含帧头)
+} mp3_frame_t;
+
 // 功能接口声明
 int media_lib_init(void);                // 初始化媒体库
 void media_lib_deinit(void);            // 释放媒体库资源
 int media_lib_get_chn_list(struct mlib_list_entry **mlib, int *nmemb);  // 获取频道列表
 int media_lib_read_data(chnid_t chnid, void *buf, size_t size);         // 读取频道音频数据
+int media_lib_read_frames(chnid_t chnid, void *buf, size_t size, media_chunk_t *chunk); // 读取整帧音频数据及其时长
+int media_lib_get_track(chnid_t chnid, int index, media_track_t *track);        // 获取频道第index个曲目的信息
+int media_lib_get_position(chnid_t chnid, int *file_index, long *offset);       // 获取频道当前播放位置
+int media_lib_get_file(chnid_t chnid, int index, char *path, size_t len);       // 获取频道第index个文件路径, 返回文件数
+int media_lib_get_descr(chnid_t chnid, char *descr, size_t len);                // 获取频道描述
+int media_lib_get_name(chnid_t chnid, char *name, size_t len);                  // 获取频道目录名
+int media_lib_seek(chnid_t chnid, uint64_t time_us);    // 跳到频道节目单中的时间点(对总时长取模)
+int media_lib_seek_wallclock(void);                     // 所有频道按墙钟对齐: 位置 = Unix时间 mod 节目总时长
+int media_lib_state_save(const char *path);             // 保存各频道位置(频道目录名/文件名/文件内时间)
+int media_lib_state_load(const char *path);             // 从状态文件恢复各频道位置, 返回恢复的频道数
+int media_lib_restore_position(const char *name, const char *file, long offset); // 按目录名/文件名/字节偏移恢复位置, 返回频道ID
+
+
+// MP3帧解析
+int mp3_parse_header(const uint8_t *p, mp3_frame_t *frame);             // 解析4字节帧头, 成功返回0
+int mp3_find_sync(const uint8_t *buf, size_t len);                      // 查找帧同步点, 返回偏移或-1
+int mp3_apply_gain(uint8_t *p, size_t len, const mp3_frame_t *frame, int steps);   // 原地调整一帧的 global_gain
 
 #endif /* __MTK_H__ */
@@ -0,0 +1,181 @@
+// 离线打包工具: 按服务器的实时分包规则(整帧、不超过1400字节、剔除标签、响度归一),
+// 把媒体库中每个频道一整轮的节目预先切成数据报, 连同包头模板、出发时间与同步点索引
+// 写成 <输出目录>/<频道目录名>.pkt; 服务器以 -K 指定该目录后发送路径只剩复制与发送.
+// 可以在构建机上提前准备, 媒体库或 MEDIA_GAIN 变化后需重新打包.
+//
+// 编译: gcc -O2 -o packager packager.c mtk.c -lpthread
+// 示例: ./packager -m ./musical -o ./packed && ./main -K ./packed
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <limits.h>
+#include <sys/stat.h>
+#include "pkfile.h"
+
+#define PK_MAX_ERRORS 16        // 连续读取失败超过此数放弃该频道
+
+static void usage(const char *prog) {
+    fprintf(stderr, "用法: %s [-m 媒体库目录] -o 输出目录\n"
+                    "  -m  媒体库根目录 (默认取环境变量 MEDIA_LIB_PATH 或编译期路径)\n"
+                    "  -o  输出目录, 每个频道生成一个 <频道目录名>%s\n", prog, PK_SUFFIX);
+}
+
+// 打包一个频道: 从节目单开头读到回到开头为止, 返回数据报数, 失败返回 -1
+static long pack_channel(chnid_t chnid, const char *name, const char *out_dir) {
+    media_track_t first;
+    if (media_lib_get_track(chnid, 0, &first) != 0) return -1;
+
+    char path[PATH_MAX], tmp[PATH_MAX + 8];
+    snprintf(path, sizeof(path), "%s/%s%s", out_dir, name, PK_SUFFIX);
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    FILE *fp = fopen(tmp, "wb");
+    if (!fp) {
+        fprintf(stderr, "无法创建 %s: %s\n", tmp, strerror(errno));
+        return -1;
+    }
+
+    static uint8_t slot[PK_SLOT_SIZE];
+    pk_index_t *index = NULL;
+    uint64_t nindex = 0, count = 0;
+    uint64_t media_pos = 0, depart_us = 0;
+    uint32_t media_rate = 0;
+    int errors = 0, ok = 1;
+
+    memset(slot, 0, sizeof(slot));
+    fwrite(slot, 1, sizeof(slot), fp);      // 文件头占位, 最后回填
+    while (1) {
+        pk_rec_t *rec = (pk_rec_t *)slot;
+        pkt_hdr_t *hdr = (pkt_hdr_t *)(slot + sizeof(*rec));
+        uint8_t *data = (uint8_t *)(hdr + 1);
+        memset(slot, 0, sizeof(slot));
+
+        media_chunk_t chunk;
+        int n = media_lib_read_frames(chnid, data, PK_DATA_MAX, &chunk);
+        if (n <= 0) {
+            if (++errors > PK_MAX_ERRORS) {
+                ok = 0;
+                break;
+            }
+            continue;
+        }
+        errors = 0;
+
+        // 与服务器实时路径相同: 换采样率时换算采样位置
+        if (chunk.samplerate != media_rate) {
+            if (media_rate > 0) media_pos = media_pos * chunk.samplerate / media_rate;
+            media_rate = chunk.samplerate;
+        }
+        proto_hdr_fill(hdr, chnid, 0, (uint32_t)n, chunk.sync ? PKT_F_SYNC : 0, media_rate, media_pos, 0);
+        rec->len = (uint32_t)(sizeof(*hdr) + n);
+        rec->sync_off = chunk.sync ? 0 : mp3_find_sync(data, (size_t)n);
+        rec->samples = chunk.samples;
+        rec->duration_us = chunk.duration_us;
+        rec->depart_us = depart_us;
+
+        if (chunk.sync && (nindex == 0 || depart_us - index[nindex - 1].depart_us >= PK_INDEX_US)) {
+            if ((nindex & (nindex - 1)) == 0) {
+                pk_index_t *grown = realloc(index, sizeof(*index) * (nindex ? nindex * 2 : 1));
+                if (!grown) {
+                    ok = 0;
+                    break;
+                }
+                index = grown;
+            }
+            index[nindex].depart_us = depart_us;
+            index[nindex].slot = count + 1;
+            nindex++;
+        }
+        if (fwrite(slot, 1, sizeof(slot), fp) != sizeof(slot)) {
+            ok = 0;
+            break;
+        }
+        count++;
+        media_pos += chunk.samples;
+        depart_us += chunk.duration_us;
+
+        // 回到第一个文件开头即完成一整轮
+        int file_index;
+        long offset;
+        media_lib_get_position(chnid, &file_index, &offset);
+        if (file_index == 0 && offset == first.audio_start) break;
+    }
+
+    pk_file_hdr_t fh;
+    memset(&fh, 0, sizeof(fh));
+    fh.magic = PK_MAGIC;
+    fh.version = PK_VERSION;
+    fh.chnid = chnid;
+    fh.slot_size = PK_SLOT_SIZE;
+    fh.count = count;
+    fh.total_us = depart_us;
+    fh.index_off = (count + 1) * PK_SLOT_SIZE;
+    fh.index_count = nindex;
+    snprintf(fh.name, sizeof(fh.name), "%s", name);
+    if (ok && count > 0 && fwrite(index, sizeof(*index), nindex, fp) == nindex &&
+        fseek(fp, 0, SEEK_SET) == 0 && fwrite(&fh, sizeof(fh), 1, fp) == 1) {
+        ok = fflush(fp) == 0 && fsync(fileno(fp)) == 0;
+    } else {
+        ok = 0;
+    }
+    ok = (fclose(fp) == 0) && ok;
+    free(index);
+    if (!ok || rename(tmp, path) != 0) {
+        fprintf(stderr, "写入 %s 失败\n", path);
+        unlink(tmp);
+        return -1;
+    }
+    printf("频道 %d %s: %llu 包, %.1f 秒, %llu 个索引点 -> %s\n", chnid, name,
+           (unsigned long long)count, depart_us / 1e6, (unsigned long long)nindex, path);
+    return (long)count;
+}
+
+int main(int argc, char *argv[]) {
+    const char *out_dir = NULL;
+    int opt;
+    while ((opt = getopt(argc, argv, "m:o:h")) != -1) {
+        switch (opt) {
+        case 'm':
+            setenv("MEDIA_LIB_PATH", optarg, 1);
+            break;
+        case 'o':
+            out_dir = optarg;
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (!out_dir) {
+        usage(argv[0]);
+        return 1;
+    }
+    if (mkdir(out_dir, 0755) != 0 && errno != EEXIST) {
+        fprintf(stderr, "无法创建输出目录 %s: %s\n", out_dir, strerror(errno));
+        return 1;
+    }
+    if (media_lib_init() != 0) {
+        fprintf(stderr, "媒体库初始化失败\n");
+        return 1;
+    }
+
+    mlib_list_entry *list = NULL;
+    int nchn = 0, failed = 0;
+    if (media_lib_get_chn_list(&list, &nchn) != 0) {
+        media_lib_deinit();
+        return 1;
+    }
+    for (int i = 0; i < nchn; i++) {
+        char name[256];
+        if (media_lib_get_name(list[i].chnid, name, sizeof(name)) != 0 ||
+            pack_channel(list[i].chnid, name, out_dir) < 0) {
+            failed++;
+        }
+        free(list[i].descr);
+    }
+    free(list);
+    media_lib_deinit();
+    printf("打包完成: %d 个频道, 失败 %d\n", nchn, failed);
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,133 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <syslog.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "pkfile.h"
+
+static pk_chn_t *g_pk[256];             // chnid_t 取值范围
+
+// 映射并校验一个频道文件, 失败返回 NULL
+static pk_chn_t *pk_open_file(const char *path, const char *name, chnid_t chnid) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        if (errno != ENOENT) syslog(LOG_WARNING, "打开预打包文件 %s 失败: %s", path, strerror(errno));
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < PK_SLOT_SIZE) {
+        close(fd);
+        return NULL;
+    }
+    size_t len = (size_t)st.st_size;
+    void *map = mmap(NULL, len, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return NULL;
+
+    const pk_file_hdr_t *hdr = map;
+    const char *err = NULL;
+    if (hdr->magic != PK_MAGIC || hdr->version != PK_VERSION) err = "格式或字节序不符";
+    else if (hdr->slot_size != PK_SLOT_SIZE) err = "槽位大小不符";
+    else if (hdr->count == 0 || hdr->count >= len / PK_SLOT_SIZE) err = "数据报数与文件长度不符";   // 另有槽位0为文件头
+    else if (hdr->index_off % sizeof(pk_index_t) != 0) err = "索引未对齐";
+    else if (hdr->index_off > len || hdr->index_count > (len - hdr->index_off) / sizeof(pk_index_t)) err = "索引越界";
+    else if (strncmp(hdr->name, name, sizeof(hdr->name)) != 0) err = "频道目录名不符";
+    else if (hdr->chnid != chnid) err = "频道ID不符, 媒体库已变化, 需重新打包";
+    // 加载时逐个核对记录与索引, 发送热路径不再做边界检查
+    for (uint64_t i = 0; !err && i < hdr->count; i++) {
+        const pk_rec_t *rec = (const pk_rec_t *)((const uint8_t *)map + (i + 1) * PK_SLOT_SIZE);
+        if (rec->len < sizeof(pkt_hdr_t) || rec->len > PK_SLOT_SIZE - sizeof(pk_rec_t)) err = "记录长度越界";
+    }
+    const pk_index_t *index = (const pk_index_t *)((const uint8_t *)map + hdr->index_off);
+    for (uint64_t i = 0; !err && i < hdr->index_count; i++) {
+        if (index[i].slot == 0 || index[i].slot > hdr->count) err = "索引槽位越界";
+    }
+    if (err) {
+        syslog(LOG_WARNING, "预打包文件 %s 无效: %s", path, err);
+        munmap(map, len);
+        return NULL;
+    }
+
+    pk_chn_t *pk = calloc(1, sizeof(*pk));
+    if (!pk) {
+        munmap(map, len);
+        return NULL;
+    }
+    madvise(map, len, MADV_SEQUENTIAL);
+    pk->map = map;
+    pk->map_len = len;
+    pk->hdr = hdr;
+    pk->index = index;
+    pk->next = 0;
+    return pk;
+}
+
+int pk_open_dir(const char *dir) {
+    mlib_list_entry *list = NULL;
+    int count = 0, loaded = 0;
+    if (media_lib_get_chn_list(&list, &count) != 0) return -1;
+    for (int i = 0; i < count; i++) {
+        char name[256], path[PATH_MAX];
+        if (media_lib_get_name(list[i].chnid, name, sizeof(name)) == 0) {
+            snprintf(path, sizeof(path), "%s/%s%s", dir, name, PK_SUFFIX);
+            g_pk[list[i].chnid] = pk_open_file(path, name, list[i].chnid);
+            if (g_pk[list[i].chnid]) {
+                syslog(LOG_INFO, "频道%d 使用预打包文件 %s (%llu 包, %.1f 秒)", list[i].chnid, path,
+                       (unsigned long long)g_pk[list[i].chnid]->hdr->count,
+                       g_pk[list[i].chnid]->hdr->total_us / 1e6);
+                loaded++;
+            } else {
+                syslog(LOG_WARNING, "频道%d 没有可用的预打包文件, 实时分包", list[i].chnid);
+            }
+        }
+        free(list[i].descr);
+    }
+    free(list);
+    return loaded;
+}
+
+pk_chn_t *pk_channel(chnid_t chnid) {
+    return g_pk[chnid];
+}
+
+// 热路径: 一次复制整个数据报, 其余信息直接取自记录头
+int pk_read(pk_chn_t *pk, void *pkt, media_chunk_t *chunk, int *sync_off) {
+    const uint8_t *slot = pk->map + (pk->next + 1) * PK_SLOT_SIZE;
+    const pk_rec_t *rec = (const pk_rec_t *)slot;
+    const pkt_hdr_t *tmpl = (const pkt_hdr_t *)(slot + sizeof(*rec));
+    memcpy(pkt, tmpl, rec->len);
+    chunk->samples = rec->samples;
+    chunk->samplerate = ntohl(tmpl->sample_rate);
+    chunk->duration_us = rec->duration_us;
+    chunk->sync = (tmpl->flags & PKT_F_SYNC) != 0;
+    *sync_off = rec->sync_off;
+    if (++pk->next == pk->hdr->count) pk->next = 0;
+    return (int)(rec->len - sizeof(pkt_hdr_t));
+}
+
+// 在同步点索引中二分查找, 从不晚于目标时间的最近同步包开始
+void pk_seek(pk_chn_t *pk, uint64_t time_us) {
+    if (pk->hdr->total_us == 0 || pk->hdr->index_count == 0) return;
+    time_us %= pk->hdr->total_us;
+    uint64_t lo = 0, hi = pk->hdr->index_count - 1;
+    while (lo < hi) {
+        uint64_t mid = (lo + hi + 1) / 2;
+        if (pk->index[mid].depart_us <= time_us) lo = mid;
+        else hi = mid - 1;
+    }
+    pk->next = pk->index[lo].slot - 1;
+}
+
+void pk_close_all(void) {
+    for (int i = 0; i < 256; i++) {
+        if (!g_pk[i]) continue;
+        munmap((void *)g_pk[i]->map, g_pk[i]->map_len);
+        free(g_pk[i]);
+        g_pk[i] = NULL;
+    }
+}
@@ -0,0 +1,65 @@
+#ifndef __PKFILE_H__
+#define __PKFILE_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include "proto.h"
+#include "mtk.h"
+
+// 预打包频道文件: 由 packager 离线生成, 每个频道一个 <频道目录名>.pkt
+// 文件按固定大小的槽位排列: 槽位0为文件头, 之后每个槽位一个数据报(记录头 + 包头模板 + 整帧数据),
+// 文件末尾是同步点时间索引; 服务器映射文件后逐槽复制发送, 只补写序列号/媒体时间/发送时间
+// 文件为生成机器的字节序, 魔数不符(含字节序不同)时拒绝加载
+#define PK_MAGIC      0x544B504D        // "MPKT"
+#define PK_VERSION    1
+#define PK_SLOT_SIZE  1536              // 槽位大小, 容纳记录头 + 包头 + 1400 字节数据
+#define PK_DATA_MAX   1400              // 单包数据上限, 与服务器实时分包一致
+#define PK_INDEX_US   1000000ULL        // 索引点间隔: 每秒至少一个同步包
+#define PK_SUFFIX     ".pkt"
+
+// 文件头 (位于槽位0)
+typedef struct __attribute__((packed)) {
+    uint32_t magic;         // PK_MAGIC
+    uint16_t version;       // PK_VERSION
+    uint16_t chnid;         // 打包时的频道ID, 须与服务器媒体库中的一致
+    uint32_t slot_size;     // PK_SLOT_SIZE
+    uint32_t reserved;
+    uint64_t count;         // 数据报槽位数
+    uint64_t total_us;      // 节目单一轮的总时长
+    uint64_t index_off;     // 时间索引在文件中的偏移
+    uint64_t index_count;   // 时间索引项数
+    char name[256];         // 频道目录名
+} pk_file_hdr_t;
+
+// 槽位中的记录头, 其后紧跟完整数据报 (pkt_hdr_t 模板 + 数据)
+typedef struct __attribute__((packed)) {
+    uint32_t len;           // 数据报长度(含包头)
+    int32_t sync_off;       // 数据中第一个帧同步点的偏移, -1 表示无 (供突发缓冲)
+    uint32_t samples;       // 数据中各帧的采样数之和
+    uint32_t duration_us;   // 播放时长
+    uint64_t depart_us;     // 相对节目单起点的出发时间
+} pk_rec_t;
+
+// 时间索引项: 出发时间与槽位号, 只指向同步包, 按时间递增
+typedef struct __attribute__((packed)) {
+    uint64_t depart_us;
+    uint64_t slot;          // 从1开始(槽位0为文件头)
+} pk_index_t;
+
+// 已映射的频道文件
+typedef struct pk_chn {
+    const uint8_t *map;
+    size_t map_len;
+    const pk_file_hdr_t *hdr;
+    const pk_index_t *index;
+    uint64_t next;          // 下一个要发送的数据报序号 [0, count)
+} pk_chn_t;
+
+// 函数声明
+int pk_open_dir(const char *dir);           // 为媒体库中的各频道加载预打包文件, 返回加载的频道数
+pk_chn_t *pk_channel(chnid_t chnid);        // 频道没有预打包文件时返回 NULL
+int pk_read(pk_chn_t *pk, void *pkt, media_chunk_t *chunk, int *sync_off);   // 复制下一个数据报, 返回数据部分长度
+void pk_seek(pk_chn_t *pk, uint64_t time_us);   // 跳到节目单中的时间点(对总时长取模)所在的同步包
+void pk_close_all(void);
+
+#endif /* __PKFILE_H__ */
@@ -0,0 +1,99 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include "pktring.h"
+
+static void futex_wait(uint32_t *addr, uint32_t val, int ms) {
+    struct timespec ts = {ms / 1000, (ms % 1000) * 1000000L};
+    syscall(SYS_futex, addr, FUTEX_WAIT_PRIVATE, val, &ts, NULL, 0);
+}
+
+static void futex_wake(uint32_t *addr) {
+    syscall(SYS_futex, addr, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+}
+
+pktring_t *pktring_create(void) {
+    pktring_t *ring = NULL;
+    if (posix_memalign((void **)&ring, 64, sizeof(*ring)) != 0) return NULL;
+    memset(ring, 0, sizeof(*ring));
+    return ring;
+}
+
+void pktring_destroy(pktring_t *ring) {
+    free(ring);
+}
+
+// 生产者写入一个包; 环满或包过大时丢弃并计数, 从不阻塞
+int pktring_push(pktring_t *ring, uint32_t gen, const void *data, size_t len) {
+    if (len > PKTRING_SLOT_DATA) {
+        __atomic_add_fetch(&ring->stats.oversize, 1, __ATOMIC_RELAXED);
+        return -1;
+    }
+    uint32_t head = ring->head;
+    uint32_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+    uint32_t used = head - tail;
+    if (used >= PKTRING_SLOTS) {
+        __atomic_add_fetch(&ring->stats.overflow, 1, __ATOMIC_RELAXED);
+        return -1;
+    }
+
+    pktring_slot_t *slot = &ring->slots[head & (PKTRING_SLOTS - 1)];
+    slot->gen = gen;
+    slot->len = (uint32_t)len;
+    memcpy(slot->data, data, len);
+    // 槽位内容写完后再发布 head
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+
+    __atomic_store_n(&ring->stats.pushed, ring->stats.pushed + 1, __ATOMIC_RELAXED);
+    if (used + 1 > ring->stats.high_water) {
+        __atomic_store_n(&ring->stats.high_water, used + 1, __ATOMIC_RELAXED);
+    }
+    // Dekker 式配对: 发布 head 与读取 waiting 之间需要全屏障, 与消费者对称
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&ring->waiting, __ATOMIC_RELAXED)) futex_wake(&ring->head);
+    return 0;
+}
+
+// 消费者取最旧的槽位; 环空且 wait 非0时在 futex 上等待新包
+pktring_slot_t *pktring_peek(pktring_t *ring, int wait) {
+    uint32_t tail = ring->tail;
+    uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    if (head == tail && wait) {
+        __atomic_store_n(&ring->waiting, 1, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        if (head == tail) {
+            futex_wait(&ring->head, head, PKTRING_WAIT_MS);
+            head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        }
+        __atomic_store_n(&ring->waiting, 0, __ATOMIC_RELAXED);
+    }
+    if (head == tail) return NULL;
+    return &ring->slots[tail & (PKTRING_SLOTS - 1)];
+}
+
+// 消费者用完槽位后归还给生产者
+void pktring_pop(pktring_t *ring) {
+    __atomic_store_n(&ring->tail, ring->tail + 1, __ATOMIC_RELEASE);
+    __atomic_store_n(&ring->stats.popped, ring->stats.popped + 1, __ATOMIC_RELAXED);
+}
+
+void pktring_wake(pktring_t *ring) {
+    futex_wake(&ring->head);
+}
+
+// 计数器快照; 可在任意线程调用
+void pktring_get_stats(pktring_t *ring, pktring_stats_t *stats) {
+    uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    uint32_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+    stats->pushed = __atomic_load_n(&ring->stats.pushed, __ATOMIC_RELAXED);
+    stats->popped = __atomic_load_n(&ring->stats.popped, __ATOMIC_RELAXED);
+    stats->overflow = __atomic_load_n(&ring->stats.overflow, __ATOMIC_RELAXED);
+    stats->oversize = __atomic_load_n(&ring->stats.oversize, __ATOMIC_RELAXED);
+    stats->occupancy = head - tail;
+    stats->high_water = __atomic_load_n(&ring->stats.high_water, __ATOMIC_RELAXED);
+}
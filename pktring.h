@@ -0,0 +1,48 @@
+#ifndef __PKTRING_H__
+#define __PKTRING_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+// 单生产者/单消费者无锁包环: 接收线程写入, 音频输出线程读出
+// 写满时丢弃新包并计数, 接收线程永远不会因音频输出阻塞
+#define PKTRING_SLOTS     512              // 槽位数, 必须是2的幂
+#define PKTRING_SLOT_DATA 2048             // 每槽最大数据长度(服务器每包最多1400字节)
+#define PKTRING_WAIT_MS   100              // 消费者空等的最长时间, 便于检查退出标志
+
+// 一个槽位
+typedef struct pktring_slot {
+    uint32_t gen;               // 写入时的换台代数, 输出线程据此丢弃旧频道数据并清空解码器
+    uint32_t len;
+    char data[PKTRING_SLOT_DATA];
+} pktring_slot_t;
+
+// 计数器
+typedef struct pktring_stats {
+    uint64_t pushed;            // 写入的包数
+    uint64_t popped;            // 输出线程取走的包数
+    uint64_t overflow;          // 环满被丢弃的包数
+    uint64_t oversize;          // 超过槽位大小被丢弃的包数
+    uint32_t occupancy;         // 当前占用槽位数
+    uint32_t high_water;        // 占用峰值
+} pktring_stats_t;
+
+typedef struct pktring {
+    // 生产者与消费者各自修改的索引分开放在不同缓存行, 避免伪共享
+    uint32_t head __attribute__((aligned(64)));     // 下一个写入位置(只由生产者修改)
+    uint32_t tail __attribute__((aligned(64)));     // 下一个读取位置(只由消费者修改)
+    int waiting __attribute__((aligned(64)));       // 消费者正在 futex 上等待
+    pktring_stats_t stats;
+    pktring_slot_t slots[PKTRING_SLOTS];
+} pktring_t;
+
+// 函数声明
+pktring_t *pktring_create(void);
+void pktring_destroy(pktring_t *ring);
+int pktring_push(pktring_t *ring, uint32_t gen, const void *data, size_t len);  // 生产者: 成功0, 丢弃-1
+pktring_slot_t *pktring_peek(pktring_t *ring, int wait);    // 消费者: 取最旧槽位, 空则最多等待 PKTRING_WAIT_MS
+void pktring_pop(pktring_t *ring);                          // 消费者: 释放 pktring_peek 返回的槽位
+void pktring_wake(pktring_t *ring);                         // 唤醒等待中的消费者(退出时使用)
+void pktring_get_stats(pktring_t *ring, pktring_stats_t *stats);
+
+#endif /* __PKTRING_H__ */
@@ -0,0 +1,184 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <syslog.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include "presence.h"
+#include "proto.h"
+#include "handoff.h"
+
+static int g_sockfd = -1;
+static volatile int g_enabled = 0;
+static pthread_t g_tid;
+static pthread_mutex_t g_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_cond;                       // 有频道从无人收听变为有人收听
+static uint64_t g_expire_ns[PRESENCE_TABLE_CHN];    // 最近心跳的过期时间(CLOCK_MONOTONIC)
+static int g_holds[PRESENCE_TABLE_CHN];             // 单播订阅数
+
+static uint64_t mono_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+// 调用者持有锁
+static int presence_active_locked(chnid_t chnid, uint64_t now) {
+    return g_holds[chnid] > 0 || g_expire_ns[chnid] > now;
+}
+
+void presence_touch(chnid_t chnid, uint32_t ttl_ms) {
+    if (!g_enabled) return;
+    uint64_t now = mono_ns();
+    uint64_t expire = now + (uint64_t)ttl_ms * 1000000ULL;
+    pthread_mutex_lock(&g_mutex);
+    int was = presence_active_locked(chnid, now);
+    if (expire > g_expire_ns[chnid]) g_expire_ns[chnid] = expire;
+    if (!was) pthread_cond_broadcast(&g_cond);
+    pthread_mutex_unlock(&g_mutex);
+}
+
+void presence_hold(chnid_t chnid, int delta) {
+    if (!g_enabled) return;
+    pthread_mutex_lock(&g_mutex);
+    int was = presence_active_locked(chnid, mono_ns());
+    g_holds[chnid] += delta;
+    if (g_holds[chnid] < 0) g_holds[chnid] = 0;
+    if (!was && g_holds[chnid] > 0) pthread_cond_broadcast(&g_cond);
+    pthread_mutex_unlock(&g_mutex);
+}
+
+int presence_enabled(void) {
+    return g_enabled;
+}
+
+int presence_active(chnid_t chnid) {
+    if (!g_enabled) return 1;
+    pthread_mutex_lock(&g_mutex);
+    int active = presence_active_locked(chnid, mono_ns());
+    pthread_mutex_unlock(&g_mutex);
+    return active;
+}
+
+// 阻塞到频道有人收听; 返回 1 表示曾经暂停
+int presence_wait_active(chnid_t chnid) {
+    if (!g_enabled) return 0;
+    int waited = 0;
+    pthread_mutex_lock(&g_mutex);
+    while (g_enabled && !presence_active_locked(chnid, mono_ns())) {
+        waited = 1;
+        pthread_cond_wait(&g_cond, &g_mutex);
+    }
+    pthread_mutex_unlock(&g_mutex);
+    return waited;
+}
+
+static void *presence_loop(void *arg) {
+    (void)arg;
+    presence_req_t req;
+    // 只在等待心跳时允许取消, 持有 g_mutex 时被取消会让频道任务永远等下去
+    pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+    while (g_enabled) {
+        pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
+        ssize_t n = recv(g_sockfd, &req, sizeof(req), 0);
+        pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        if ((size_t)n < offsetof(presence_req_t, chnid) || ntohl(req.magic) != PRESENCE_MAGIC ||
+            ntohs(req.version) != PROTO_VERSION) {
+            continue;
+        }
+        int count = ntohs(req.count);
+        if ((size_t)n < offsetof(presence_req_t, chnid) + (size_t)count * sizeof(req.chnid[0])) continue;
+        // 过期时间按发送方周期计算, 周期取值限制在合理范围, 防止一个心跳让频道永远活跃
+        uint32_t interval = ntohs(req.interval_ms);
+        if (interval < 100) interval = 100;
+        if (interval > PRESENCE_INTERVAL_MS * 4) interval = PRESENCE_INTERVAL_MS * 4;
+        for (int i = 0; i < count; i++) {
+            uint16_t chnid = ntohs(req.chnid[i]);
+            if (chnid < PRESENCE_TABLE_CHN) presence_touch((chnid_t)chnid, interval * PRESENCE_EXPIRE_MULT);
+        }
+    }
+    return NULL;
+}
+
+// 热升级: 交出套接字前停掉接收线程, 交接失败时重新启动; 已登记的收听状态不变
+static void presence_quiesce(int stop) {
+    if (stop) {
+        pthread_cancel(g_tid);
+        pthread_join(g_tid, NULL);
+    } else if (pthread_create(&g_tid, NULL, presence_loop, NULL) != 0) {
+        syslog(LOG_ERR, "热升级失败后无法恢复收听心跳线程");
+    }
+}
+
+int presence_start(int port, struct in_addr ifaddr) {
+    // 热升级交接来的套接字已加入组播组
+    g_sockfd = handoff_inherit(HANDOFF_FD_PRESENCE);
+    if (g_sockfd < 0) {
+        g_sockfd = socket(AF_INET, SOCK_DGRAM, 0);
+        if (g_sockfd < 0) {
+            syslog(LOG_ERR, "创建心跳套接字失败: %s", strerror(errno));
+            return -1;
+        }
+        int on = 1;
+        setsockopt(g_sockfd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+        struct sockaddr_in addr = {0};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_ANY);
+        addr.sin_port = htons(port);
+        if (bind(g_sockfd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+            syslog(LOG_ERR, "绑定心跳端口 %d 失败: %s", port, strerror(errno));
+            close(g_sockfd);
+            g_sockfd = -1;
+            return -1;
+        }
+        // 客户端把心跳发往组播组, 也接受直接发到本机端口的单播心跳
+        struct ip_mreq mreq;
+        inet_pton(AF_INET, GROUP_IP, &mreq.imr_multiaddr);
+        mreq.imr_interface = ifaddr;
+        if (setsockopt(g_sockfd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) < 0) {
+            syslog(LOG_WARNING, "加入心跳组播组失败: %s", strerror(errno));
+        }
+    }
+    handoff_export(HANDOFF_FD_PRESENCE, g_sockfd, presence_quiesce);
+
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&g_cond, &attr);
+    pthread_condattr_destroy(&attr);
+
+    // 启动宽限期: 服务器重启后已有的客户端在一个心跳周期内才会报到
+    uint64_t grace = mono_ns() + (uint64_t)PRESENCE_GRACE_MS * 1000000ULL;
+    for (int i = 0; i < PRESENCE_TABLE_CHN; i++) g_expire_ns[i] = grace;
+
+    g_enabled = 1;
+    if (pthread_create(&g_tid, NULL, presence_loop, NULL) != 0) {
+        g_enabled = 0;
+        close(g_sockfd);
+        g_sockfd = -1;
+        return -1;
+    }
+    syslog(LOG_INFO, "收听心跳监听 UDP %d, 无人收听的频道将暂停", port);
+    return 0;
+}
+
+void presence_stop(void) {
+    if (!g_enabled) return;
+    pthread_mutex_lock(&g_mutex);
+    g_enabled = 0;
+    pthread_cond_broadcast(&g_cond);
+    pthread_mutex_unlock(&g_mutex);
+    // 不用 shutdown 唤醒接收线程: 热升级交接失败时套接字仍为旧进程所用
+    pthread_cancel(g_tid);
+    pthread_join(g_tid, NULL);
+    close(g_sockfd);
+    g_sockfd = -1;
+}
@@ -0,0 +1,23 @@
+#ifndef __PRESENCE_H__
+#define __PRESENCE_H__
+
+#include <stdint.h>
+#include <netinet/in.h>
+#include "server.h"
+
+// 收听者在场表: 接收客户端心跳, 每频道记录最近一次心跳的过期时间与单播订阅数;
+// 开启后无人收听的频道暂停读文件与发送, 收到心跳立即唤醒
+#define PRESENCE_TABLE_CHN  256         // chnid_t 取值范围
+#define PRESENCE_EXPIRE_MULT 3          // 心跳周期的倍数, 超过仍未收到心跳视为无人收听
+#define PRESENCE_GRACE_MS   10000       // 启动后所有频道保持活跃的时间, 等待已有客户端的心跳
+
+// 函数声明
+int presence_start(int port, struct in_addr ifaddr);    // 加入组播组接收心跳, 启动接收线程
+int presence_enabled(void);
+void presence_touch(chnid_t chnid, uint32_t ttl_ms);    // 记一次收听 (心跳或补发请求)
+void presence_hold(chnid_t chnid, int delta);           // 单播订阅数 +1/-1, 有订阅时频道保持活跃
+int presence_active(chnid_t chnid);
+int presence_wait_active(chnid_t chnid);                // 阻塞到频道有人收听, 返回 1 表示曾经暂停
+void presence_stop(void);
+
+#endif /* __PRESENCE_H__ */
@@ -0,0 +1,28 @@
+#ifndef __PROBES_H__
+#define __PROBES_H__
+
+// USDT 静态探针: 未挂载跟踪器时只是一条 nop 指令, 挂载后可用 bpftrace/perf 读取参数
+// 需要 systemtap-sdt-dev (sys/sdt.h); 没有该头文件或定义了 NO_USDT 时探针编译为空
+// 示例脚本见 bpftrace/ 目录, 列出探针: bpftrace -l 'usdt:./main:*'
+#if defined(__has_include) && !defined(NO_USDT)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define USDT_ENABLED 1
+#endif
+#endif
+
+#ifdef USDT_ENABLED
+#define PROBE0(provider, name)                   DTRACE_PROBE(provider, name)
+#define PROBE1(provider, name, a)                DTRACE_PROBE1(provider, name, a)
+#define PROBE2(provider, name, a, b)             DTRACE_PROBE2(provider, name, a, b)
+#define PROBE3(provider, name, a, b, c)          DTRACE_PROBE3(provider, name, a, b, c)
+#define PROBE4(provider, name, a, b, c, d)       DTRACE_PROBE4(provider, name, a, b, c, d)
+#else
+#define PROBE0(provider, name)                   do { } while (0)
+#define PROBE1(provider, name, a)                do { (void)(a); } while (0)
+#define PROBE2(provider, name, a, b)             do { (void)(a); (void)(b); } while (0)
+#define PROBE3(provider, name, a, b, c)          do { (void)(a); (void)(b); (void)(c); } while (0)
+#define PROBE4(provider, name, a, b, c, d)       do { (void)(a); (void)(b); (void)(c); (void)(d); } while (0)
+#endif
+
+#endif /* __PROBES_H__ */
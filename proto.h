@@ -0,0 +1,134 @@
+#ifndef __PROTO_H__
+#define __PROTO_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <endian.h>
+#include <arpa/inet.h>
+
+// 服务器与客户端共用的线路格式; 所有多字节字段为网络字节序, 结构体显式紧凑排列
+// 兼容约定: 新版本只在包头末尾追加字段并增大 hdr_len, 接收方按 hdr_len 跳过不认识的部分;
+// 主版本号 version 不同表示格式不兼容, 接收方应丢弃
+#define PROTO_VERSION 1
+
+// 包标志
+#define PKT_F_SYNC 0x01     // 数据以完整的MPEG帧开头, 可从此包起播
+#define PKT_F_FEC  0x02     // 前向纠错包, 数据不是音频
+#define PKT_F_DIR  0x04     // 频道目录包, 数据不是音频
+
+// 数据包头部 (36字节)
+typedef struct __attribute__((packed)) {
+    uint8_t  version;       // PROTO_VERSION
+    uint8_t  flags;         // PKT_F_*
+    uint16_t hdr_len;       // 包头长度, 数据从此偏移开始
+    uint16_t channel_id;    // 频道ID
+    uint16_t reserved;
+    uint32_t seq_num;       // 频道内序列号, 每个频道独立递增
+    uint32_t data_len;      // 数据长度; 0 表示补发结束标记
+    uint32_t sample_rate;   // media_ts 的单位(Hz)
+    uint64_t media_ts;      // 本包第一个完整帧在频道节目流中的采样位置
+    uint64_t send_time_us;  // 发送端墙钟(CLOCK_REALTIME, 微秒), 接收方可据此测单向延迟
+} pkt_hdr_t;
+
+// 组播相关
+#define GROUP_IP  "226.5.2.1"
+#define RCV_PORT  5210
+
+// 损伤中继(测试工具 relay)默认转发到的测试组, 端口与正式组不同, 两路数据不会串到同一个套接字
+#define RELAY_GROUP "226.5.2.2"
+#define RELAY_PORT  5220
+
+// 入台突发请求: 客户端经单播UDP发往 BURST_PORT
+// 补发数据远大于请求, 为防伪造源地址的反射放大, 服务器只对回显了验证码的请求补发:
+// 不带或带过期验证码的请求只得到一个同样格式的应答, cookie 字段为该地址的验证码,
+// 客户端原样填入后重发; 验证码不区分频道, 有效期内换台可直接使用
+#define BURST_PORT  5211
+#define BURST_MAGIC 0x42525354  // "BRST"
+typedef struct __attribute__((packed)) {
+    uint32_t magic;         // BURST_MAGIC
+    uint16_t channel_id;    // 请求的频道ID
+    uint16_t version;       // PROTO_VERSION (旧客户端此处为填充字节)
+    uint32_t cookie;        // 服务器下发的验证码, 没有时填0 (旧客户端的请求不含此字段)
+} burst_req_t;
+
+// 单播TCP订阅请求: 连接 UNICAST_PORT 后发送, 可随时重发以换台
+#define UNICAST_PORT  5212
+#define UNICAST_MAGIC 0x53554253  // "SUBS"
+typedef struct __attribute__((packed)) {
+    uint32_t magic;         // UNICAST_MAGIC
+    uint16_t channel_id;    // 订阅的频道ID
+    uint16_t version;       // PROTO_VERSION (旧客户端此处为填充字节)
+} unicast_req_t;
+
+// 收听心跳: 客户端周期性发往组播组的 PRESENCE_PORT (无需知道服务器地址),
+// 一个数据报汇总本进程正在收听的全部频道; 服务器据此暂停无人收听的频道
+#define PRESENCE_PORT        5213
+#define PRESENCE_MAGIC       0x48524254  // "HRBT"
+#define PRESENCE_INTERVAL_MS 2000        // 心跳周期, 发送方在 ±25% 内随机抖动
+#define PRESENCE_MAX_CHN     64          // 单个数据报最多列出的频道数, 更多时分多个数据报
+typedef struct __attribute__((packed)) {
+    uint32_t magic;         // PRESENCE_MAGIC
+    uint16_t version;       // PROTO_VERSION
+    uint16_t interval_ms;   // 发送方的心跳周期, 服务器按其数倍计算过期时间
+    uint16_t count;         // chnid 中有效的频道数
+    uint16_t chnid[PRESENCE_MAX_CHN];   // 实际只发送前 count 项
+} presence_req_t;
+
+// 解码后的包头 (主机字节序)
+typedef struct {
+    uint8_t flags;
+    uint16_t hdr_len;
+    uint16_t channel_id;
+    uint32_t seq_num;
+    uint32_t data_len;
+    uint32_t sample_rate;
+    uint64_t media_ts;
+    uint64_t send_time_us;
+} pkt_info_t;
+
+// 填写包头
+static inline void proto_hdr_fill(pkt_hdr_t *hdr, uint16_t chnid, uint32_t seq, uint32_t data_len,
+                                  uint8_t flags, uint32_t sample_rate, uint64_t media_ts,
+                                  uint64_t send_time_us) {
+    hdr->version = PROTO_VERSION;
+    hdr->flags = flags;
+    hdr->hdr_len = htons(sizeof(pkt_hdr_t));
+    hdr->channel_id = htons(chnid);
+    hdr->reserved = 0;
+    hdr->seq_num = htonl(seq);
+    hdr->data_len = htonl(data_len);
+    hdr->sample_rate = htonl(sample_rate);
+    hdr->media_ts = htobe64(media_ts);
+    hdr->send_time_us = htobe64(send_time_us);
+}
+
+// 在预先填好的包头模板上补写每包变化的字段; 频道ID也以当前媒体库为准, 不信任模板中的值
+static inline void proto_hdr_stamp(pkt_hdr_t *hdr, uint16_t chnid, uint32_t seq, uint64_t media_ts,
+                                   uint64_t send_time_us) {
+    hdr->channel_id = htons(chnid);
+    hdr->seq_num = htonl(seq);
+    hdr->media_ts = htobe64(media_ts);
+    hdr->send_time_us = htobe64(send_time_us);
+}
+
+// 解析包头; 成功返回 0, 长度不足返回 -1, 版本不兼容返回 -2
+// 只校验包头本身, data_len 与实际长度的一致性由调用者检查
+static inline int proto_hdr_parse(const void *buf, size_t len, pkt_info_t *info) {
+    pkt_hdr_t hdr;
+    if (len < sizeof(hdr)) return -1;
+    memcpy(&hdr, buf, sizeof(hdr));
+    if (hdr.version != PROTO_VERSION) return -2;
+    info->hdr_len = ntohs(hdr.hdr_len);
+    if (info->hdr_len < sizeof(hdr) || info->hdr_len > len) return -1;
+    info->flags = hdr.flags;
+    info->channel_id = ntohs(hdr.channel_id);
+    info->seq_num = ntohl(hdr.seq_num);
+    info->data_len = ntohl(hdr.data_len);
+    info->sample_rate = ntohl(hdr.sample_rate);
+    info->media_ts = be64toh(hdr.media_ts);
+    info->send_time_us = be64toh(hdr.send_time_us);
+    return 0;
+}
+
+#endif /* __PROTO_H__ */
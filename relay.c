@@ -0,0 +1,378 @@
+// 回环网络损伤中继: 加入服务器的组播组, 按设定的丢包(独立随机 / Gilbert-Elliott 突发)、
+// 时延、抖动、重复与乱序规则把数据包转发到测试组播组, 客户端或基准测试从测试组接收.
+// 所有随机数来自同一个带种子的生成器, 且每个包固定消耗相同个数的随机数,
+// 同一种子、同一输入得到同样的损伤序列; 只改一个参数时其余损伤的位置不变.
+//
+// 编译: gcc -O2 -o relay relay.c
+// 示例: ./relay -l 1 -G 1:25 -d 30 -j 10 -D 0.5 -r 1 -s 42 -o relay.json
+//       ./client -g 226.5.2.2:5220
+//       ./bench -c 4 -r "-G 1:25 -s 7"    基准测试经中继接收, 输出连续性统计
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <poll.h>
+#include <stdint.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "proto.h"
+
+#define RELAY_VLEN       32             // recvmmsg 每次最多收取的数据报数
+#define RELAY_PKT_MAX    2048
+#define RELAY_QUEUE_MAX  65536          // 延迟队列上限, 超出时丢弃新包并计数
+#define RELAY_REORDER_MS 20             // 乱序包默认额外延迟
+
+// 损伤参数 (概率为 0~1)
+typedef struct {
+    double loss;            // 独立随机丢包率
+    int ge;                 // 是否启用 Gilbert-Elliott
+    double ge_p;            // 好 -> 坏 状态转移概率
+    double ge_r;            // 坏 -> 好 状态转移概率
+    double ge_loss_good;    // 好状态下的丢包率
+    double ge_loss_bad;     // 坏状态下的丢包率
+    double delay_ms;        // 固定时延
+    double jitter_ms;       // 时延在 ±jitter 内均匀分布(可能因此乱序)
+    double dup;             // 重复概率
+    double reorder;         // 乱序概率: 包额外延迟 reorder_ms, 排到后续包之后
+    double reorder_ms;
+    uint64_t seed;
+} relay_conf_t;
+
+typedef struct {
+    uint64_t received;
+    uint64_t sent;
+    uint64_t lost_random;
+    uint64_t lost_ge;
+    uint64_t ge_bad;        // 处于坏状态时到达的包
+    uint64_t duplicated;
+    uint64_t reordered;
+    uint64_t queue_drops;
+    uint64_t max_queue;
+} relay_stats_t;
+
+// 延迟队列项, 按 (出发时间, 入队序号) 组成最小堆
+typedef struct {
+    uint64_t due_ns;
+    uint64_t order;
+    size_t len;
+    char *data;
+} relay_item_t;
+
+static volatile sig_atomic_t g_running = 1;
+static uint64_t g_rng;
+static relay_item_t *g_heap;
+static size_t g_heap_len;
+static uint64_t g_order;
+static relay_stats_t g_stats;
+
+static void on_signal(int sig) {
+    (void)sig;
+    g_running = 0;
+}
+
+static uint64_t mono_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+// splitmix64: 不依赖 libc 的 rand 实现, 不同机器上同一种子结果一致
+static double rng_uniform(void) {
+    uint64_t z = (g_rng += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    z ^= z >> 31;
+    return (double)(z >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static int item_before(const relay_item_t *a, const relay_item_t *b) {
+    return a->due_ns < b->due_ns || (a->due_ns == b->due_ns && a->order < b->order);
+}
+
+static int heap_push(const void *data, size_t len, uint64_t due_ns) {
+    if (g_heap_len >= RELAY_QUEUE_MAX) {
+        g_stats.queue_drops++;
+        return -1;
+    }
+    char *copy = malloc(len);
+    if (!copy) return -1;
+    memcpy(copy, data, len);
+    size_t i = g_heap_len++;
+    relay_item_t item = {due_ns, g_order++, len, copy};
+    while (i > 0 && item_before(&item, &g_heap[(i - 1) / 2])) {
+        g_heap[i] = g_heap[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    g_heap[i] = item;
+    if (g_heap_len > g_stats.max_queue) g_stats.max_queue = g_heap_len;
+    return 0;
+}
+
+static void heap_pop(void) {
+    free(g_heap[0].data);
+    relay_item_t last = g_heap[--g_heap_len];
+    size_t i = 0;
+    while (1) {
+        size_t c = 2 * i + 1;
+        if (c >= g_heap_len) break;
+        if (c + 1 < g_heap_len && item_before(&g_heap[c + 1], &g_heap[c])) c++;
+        if (!item_before(&g_heap[c], &last)) break;
+        g_heap[i] = g_heap[c];
+        i = c;
+    }
+    if (g_heap_len > 0) g_heap[i] = last;
+}
+
+// 对一个到达的包做损伤判定并入延迟队列; 每个包固定抽取 6 个随机数
+static void relay_packet(const relay_conf_t *c, const char *pkt, size_t len, uint64_t now, int *ge_bad) {
+    double u_trans = rng_uniform(), u_ge = rng_uniform(), u_loss = rng_uniform();
+    double u_jitter = rng_uniform(), u_dup = rng_uniform(), u_reorder = rng_uniform();
+    g_stats.received++;
+
+    if (c->ge) {
+        *ge_bad = *ge_bad ? !(u_trans < c->ge_r) : (u_trans < c->ge_p);
+        if (*ge_bad) g_stats.ge_bad++;
+        if (u_ge < (*ge_bad ? c->ge_loss_bad : c->ge_loss_good)) {
+            g_stats.lost_ge++;
+            return;
+        }
+    }
+    if (u_loss < c->loss) {
+        g_stats.lost_random++;
+        return;
+    }
+
+    double delay = c->delay_ms + (u_jitter * 2.0 - 1.0) * c->jitter_ms;
+    if (u_reorder < c->reorder) {
+        delay += c->reorder_ms;
+        g_stats.reordered++;
+    }
+    if (delay < 0) delay = 0;
+    uint64_t due = now + (uint64_t)(delay * 1e6);
+    heap_push(pkt, len, due);
+    if (u_dup < c->dup && heap_push(pkt, len, due) == 0) g_stats.duplicated++;
+}
+
+static int open_rx(const char *ifaddr) {
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0) return -1;
+    int on = 1, off = 0;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    // 只收自己加入的组, 不收本机其他套接字加入的测试组(否则会把转发出去的包再收回来)
+    setsockopt(fd, IPPROTO_IP, IP_MULTICAST_ALL, &off, sizeof(off));
+    int rcvbuf = 8 * 1024 * 1024;
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+
+    struct sockaddr_in addr = {0};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(RCV_PORT);
+    inet_pton(AF_INET, GROUP_IP, &addr.sin_addr);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        close(fd);
+        return -1;
+    }
+    struct ip_mreq mreq;
+    inet_pton(AF_INET, GROUP_IP, &mreq.imr_multiaddr);
+    inet_pton(AF_INET, ifaddr, &mreq.imr_interface);
+    if (setsockopt(fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static int open_tx(const char *ifaddr) {
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0) return -1;
+    int ttl = 1, loop = 1;
+    setsockopt(fd, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl));
+    setsockopt(fd, IPPROTO_IP, IP_MULTICAST_LOOP, &loop, sizeof(loop));
+    struct in_addr ifa;
+    inet_pton(AF_INET, ifaddr, &ifa);
+    setsockopt(fd, IPPROTO_IP, IP_MULTICAST_IF, &ifa, sizeof(ifa));
+    return fd;
+}
+
+static void print_stats(FILE *fp, const relay_conf_t *c, int json) {
+    const relay_stats_t *s = &g_stats;
+    uint64_t lost = s->lost_random + s->lost_ge;
+    if (!json) {
+        fprintf(fp, "[RELAY] 收%llu 发%llu 丢包%llu (随机%llu 突发%llu, %.3f%%) 坏状态%llu 重复%llu 乱序%llu "
+                    "队列满%llu 队列峰值%llu\n",
+                (unsigned long long)s->received, (unsigned long long)s->sent,
+                (unsigned long long)lost, (unsigned long long)s->lost_random,
+                (unsigned long long)s->lost_ge, s->received ? lost * 100.0 / s->received : 0.0,
+                (unsigned long long)s->ge_bad, (unsigned long long)s->duplicated,
+                (unsigned long long)s->reordered, (unsigned long long)s->queue_drops,
+                (unsigned long long)s->max_queue);
+        return;
+    }
+    fprintf(fp, "{\"relay\": {\"seed\": %llu, \"loss\": %.4f, \"ge\": %d, \"ge_p\": %.4f, \"ge_r\": %.4f, "
+                "\"ge_loss_good\": %.4f, \"ge_loss_bad\": %.4f, \"delay_ms\": %.1f, \"jitter_ms\": %.1f, "
+                "\"dup\": %.4f, \"reorder\": %.4f, \"reorder_ms\": %.1f}, "
+                "\"received\": %llu, \"sent\": %llu, \"lost_random\": %llu, \"lost_ge\": %llu, "
+                "\"ge_bad\": %llu, \"duplicated\": %llu, \"reordered\": %llu, \"queue_drops\": %llu, "
+                "\"max_queue\": %llu}\n",
+            (unsigned long long)c->seed, c->loss, c->ge, c->ge_p, c->ge_r, c->ge_loss_good,
+            c->ge_loss_bad, c->delay_ms, c->jitter_ms, c->dup, c->reorder, c->reorder_ms,
+            (unsigned long long)s->received, (unsigned long long)s->sent,
+            (unsigned long long)s->lost_random, (unsigned long long)s->lost_ge,
+            (unsigned long long)s->ge_bad, (unsigned long long)s->duplicated,
+            (unsigned long long)s->reordered, (unsigned long long)s->queue_drops,
+            (unsigned long long)s->max_queue);
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "用法: %s [选项]\n"
+            "  -i 地址       组播接口地址 (默认 127.0.0.1)\n"
+            "  -g 组[:端口]  转发到的测试组 (默认 %s:%d)\n"
+            "  -l 百分比     独立随机丢包率\n"
+            "  -G p:r[:g:b]  Gilbert-Elliott 突发丢包: 好->坏概率p%%, 坏->好概率r%%,\n"
+            "                好/坏状态下的丢包率 g%% (默认0) / b%% (默认100); 平均突发长度约 100/r 个包\n"
+            "  -d 毫秒       固定时延\n"
+            "  -j 毫秒       时延抖动 (±均匀分布, 可能造成乱序)\n"
+            "  -D 百分比     重复包概率\n"
+            "  -r 百分比     乱序概率, 被选中的包额外延迟 -R 毫秒 (默认 %d)\n"
+            "  -s 种子       随机数种子 (默认 1)\n"
+            "  -t 秒         运行时长, 0 表示直到 Ctrl-C (默认 0)\n"
+            "  -o 文件       退出时写入 JSON 统计\n",
+            prog, RELAY_GROUP, RELAY_PORT, RELAY_REORDER_MS);
+}
+
+int main(int argc, char *argv[]) {
+    relay_conf_t c = {0};
+    c.ge_loss_bad = 1.0;
+    c.reorder_ms = RELAY_REORDER_MS;
+    c.seed = 1;
+    const char *ifaddr = "127.0.0.1";
+    const char *out_path = NULL;
+    char group[64] = RELAY_GROUP;
+    int port = RELAY_PORT, duration = 0;
+    int opt;
+    while ((opt = getopt(argc, argv, "i:g:l:G:d:j:D:r:R:s:t:o:h")) != -1) {
+        switch (opt) {
+        case 'i': ifaddr = optarg; break;
+        case 'g': {
+            char *colon = strchr(optarg, ':');
+            if (colon) {
+                *colon = '\0';
+                port = atoi(colon + 1);
+            }
+            snprintf(group, sizeof(group), "%s", optarg);
+            break;
+        }
+        case 'l': c.loss = atof(optarg) / 100.0; break;
+        case 'G': {
+            double p = 0, r = 0, g = 0, b = 100;
+            if (sscanf(optarg, "%lf:%lf:%lf:%lf", &p, &r, &g, &b) < 2) {
+                usage(argv[0]);
+                return 1;
+            }
+            c.ge = 1;
+            c.ge_p = p / 100.0;
+            c.ge_r = r / 100.0;
+            c.ge_loss_good = g / 100.0;
+            c.ge_loss_bad = b / 100.0;
+            break;
+        }
+        case 'd': c.delay_ms = atof(optarg); break;
+        case 'j': c.jitter_ms = atof(optarg); break;
+        case 'D': c.dup = atof(optarg) / 100.0; break;
+        case 'r': c.reorder = atof(optarg) / 100.0; break;
+        case 'R': c.reorder_ms = atof(optarg); break;
+        case 's': c.seed = strtoull(optarg, NULL, 0); break;
+        case 't': duration = atoi(optarg); break;
+        case 'o': out_path = optarg; break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    g_rng = c.seed;
+    g_heap = malloc(sizeof(relay_item_t) * RELAY_QUEUE_MAX);
+    int rx = open_rx(ifaddr);
+    int tx = open_tx(ifaddr);
+    if (!g_heap || rx < 0 || tx < 0) {
+        fprintf(stderr, "[RELAY] 初始化失败: %s\n", strerror(errno));
+        return 1;
+    }
+    struct sockaddr_in dst = {0};
+    dst.sin_family = AF_INET;
+    dst.sin_port = htons(port);
+    if (inet_pton(AF_INET, group, &dst.sin_addr) != 1) {
+        fprintf(stderr, "[RELAY] 无效的测试组: %s\n", group);
+        return 1;
+    }
+    if (dst.sin_addr.s_addr == inet_addr(GROUP_IP) && port == RCV_PORT) {
+        fprintf(stderr, "[RELAY] 测试组不能与服务器组播组相同\n");
+        return 1;
+    }
+
+    struct sigaction sa = {0};
+    sa.sa_handler = on_signal;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    printf("[RELAY] %s:%d -> %s:%d, 种子 %llu\n", GROUP_IP, RCV_PORT, group, port,
+           (unsigned long long)c.seed);
+
+    static char bufs[RELAY_VLEN][RELAY_PKT_MAX];
+    struct mmsghdr msgs[RELAY_VLEN];
+    struct iovec iovs[RELAY_VLEN];
+    for (int i = 0; i < RELAY_VLEN; i++) {
+        iovs[i].iov_base = bufs[i];
+        iovs[i].iov_len = RELAY_PKT_MAX;
+        memset(&msgs[i], 0, sizeof(msgs[i]));
+        msgs[i].msg_hdr.msg_iov = &iovs[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    uint64_t end_ns = duration > 0 ? mono_ns() + (uint64_t)duration * 1000000000ULL : UINT64_MAX;
+    int ge_bad = 0;
+    while (g_running) {
+        uint64_t now = mono_ns();
+        if (now >= end_ns) break;
+
+        // 发出所有到期的包
+        while (g_heap_len > 0 && g_heap[0].due_ns <= now) {
+            if (sendto(tx, g_heap[0].data, g_heap[0].len, 0, (struct sockaddr *)&dst, sizeof(dst)) >= 0) {
+                g_stats.sent++;
+            }
+            heap_pop();
+        }
+
+        // 等到下一个包到期或有新包到达
+        uint64_t wait_ns = g_heap_len > 0 ? g_heap[0].due_ns - now : 100000000ULL;
+        struct timespec ts = {(time_t)(wait_ns / 1000000000ULL), (long)(wait_ns % 1000000000ULL)};
+        struct pollfd pfd = {rx, POLLIN, 0};
+        if (ppoll(&pfd, 1, &ts, NULL) <= 0) continue;
+
+        int n = recvmmsg(rx, msgs, RELAY_VLEN, MSG_DONTWAIT, NULL);
+        now = mono_ns();
+        for (int i = 0; i < n; i++) {
+            relay_packet(&c, bufs[i], msgs[i].msg_len, now, &ge_bad);
+        }
+    }
+
+    print_stats(stdout, &c, 0);
+    if (out_path) {
+        FILE *fp = fopen(out_path, "w");
+        if (fp) {
+            print_stats(fp, &c, 1);
+            fclose(fp);
+        } else {
+            perror("[RELAY] 打开统计文件失败");
+        }
+    }
+    while (g_heap_len > 0) heap_pop();
+    free(g_heap);
+    close(rx);
+    close(tx);
+    return 0;
+}
@@ -0,0 +1,249 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include "rxstats.h"
+
+static rxstats_chn_t g_chn[RXSTATS_MAX_CHN];
+static pthread_mutex_t g_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static FILE *g_report_fp = NULL;
+static int g_report_json = 0;
+static int g_report_interval = RXSTATS_INTERVAL;
+static pktring_t *g_report_ring = NULL;
+static pthread_t g_report_tid;
+static volatile int g_report_running = 0;
+
+static int64_t clock_us(clockid_t clk) {
+    struct timespec ts;
+    clock_gettime(clk, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static int window_test_set(rxstats_chn_t *c, uint64_t seq) {
+    uint64_t bit = seq % RXSTATS_WINDOW;
+    uint64_t mask = 1ULL << (bit % 64);
+    int was = (c->window[bit / 64] & mask) != 0;
+    c->window[bit / 64] |= mask;
+    return was;
+}
+
+// 窗口前移: 清掉 (old_max, new_max] 对应的位
+static void window_advance(rxstats_chn_t *c, uint64_t old_max, uint64_t new_max) {
+    if (new_max - old_max >= RXSTATS_WINDOW) {
+        memset(c->window, 0, sizeof(c->window));
+        return;
+    }
+    for (uint64_t s = old_max + 1; s <= new_max; s++) {
+        uint64_t bit = s % RXSTATS_WINDOW;
+        c->window[bit / 64] &= ~(1ULL << (bit % 64));
+    }
+}
+
+// 开始新的同步段 (首包或服务器重启)
+static void chn_sync(rxstats_chn_t *c, uint32_t seq) {
+    if (c->active) c->expected_prior += c->max_seq - c->base_seq + 1;
+    c->base_seq = c->max_seq = seq;
+    memset(c->window, 0, sizeof(c->window));
+    window_test_set(c, seq);
+    c->has_transit = 0;
+}
+
+static void chn_update_lost(rxstats_chn_t *c) {
+    uint64_t expected = c->expected_prior + (c->max_seq - c->base_seq + 1);
+    c->lost = expected > c->received ? expected - c->received : 0;
+}
+
+// RFC 3550 6.4.1: J += (|D| - J) / 16, D 为相邻两包 到达时间-媒体时间 之差
+// 到达时间由调用者给出: 内核时间戳不含接收线程的调度延迟
+static void chn_jitter(rxstats_chn_t *c, const pkt_info_t *hdr, rx_clock_t clock, int64_t arrival_us,
+                       int64_t wall_us) {
+    if (hdr->sample_rate == 0) return;
+    int64_t media_us = (int64_t)(hdr->media_ts * 1000000ULL / hdr->sample_rate);
+    int64_t transit = arrival_us - media_us;
+    if (c->has_transit && c->transit_clock == clock) {
+        int64_t d = transit - c->last_transit_us;
+        if (d < 0) d = -d;
+        c->jitter_ms += ((double)d / 1000.0 - c->jitter_ms) / 16.0;
+    }
+    c->last_transit_us = transit;
+    c->has_transit = 1;
+    c->transit_clock = clock;
+
+    if (hdr->send_time_us > 0) {
+        double lat = (double)((wall_us ? wall_us : clock_us(CLOCK_REALTIME)) - (int64_t)hdr->send_time_us) / 1000.0;
+        c->latency_ms = c->latency_ms == 0 ? lat : c->latency_ms + (lat - c->latency_ms) / 16.0;
+    }
+}
+
+void rxstats_packet(const pkt_info_t *hdr) {
+    rxstats_packet_at(hdr, RX_CLOCK_USER, clock_us(CLOCK_MONOTONIC), 0);
+}
+
+void rxstats_packet_at(const pkt_info_t *hdr, rx_clock_t clock, int64_t arrival_us, int64_t wall_us) {
+    if (hdr->channel_id >= RXSTATS_MAX_CHN) return;
+    pthread_mutex_lock(&g_mutex);
+    rxstats_chn_t *c = &g_chn[hdr->channel_id];
+    if (!c->active) {
+        chn_sync(c, hdr->seq_num);
+        c->active = 1;
+        c->chnid = hdr->channel_id;
+        c->received = 1;
+        chn_jitter(c, hdr, clock, arrival_us, wall_us);
+        pthread_mutex_unlock(&g_mutex);
+        return;
+    }
+
+    // 32位序列号扩展为64位
+    int32_t delta = (int32_t)(hdr->seq_num - (uint32_t)c->max_seq);
+    if (delta > RXSTATS_MAX_DROPOUT || delta < -RXSTATS_MAX_DROPOUT) {
+        chn_sync(c, hdr->seq_num);
+        c->resyncs++;
+        c->received++;
+        chn_jitter(c, hdr, clock, arrival_us, wall_us);
+    } else if (delta > 0) {
+        uint64_t seq = c->max_seq + (uint64_t)delta;
+        window_advance(c, c->max_seq, seq);
+        window_test_set(c, seq);
+        c->max_seq = seq;
+        c->received++;
+        chn_jitter(c, hdr, clock, arrival_us, wall_us);
+    } else {
+        uint64_t back = (uint64_t)(-(int64_t)delta);
+        if (back >= RXSTATS_WINDOW || back > c->max_seq - c->base_seq) {
+            c->reordered++;         // 太晚, 无法判断是否重复
+        } else if (window_test_set(c, c->max_seq - back)) {
+            c->duplicates++;
+        } else {
+            c->reordered++;
+            c->received++;
+        }
+    }
+    chn_update_lost(c);
+    pthread_mutex_unlock(&g_mutex);
+}
+
+void rxstats_underrun(uint16_t chnid) {
+    if (chnid >= RXSTATS_MAX_CHN) return;
+    pthread_mutex_lock(&g_mutex);
+    g_chn[chnid].underruns++;
+    pthread_mutex_unlock(&g_mutex);
+}
+
+int rxstats_snapshot(rxstats_chn_t *out, int max) {
+    int n = 0;
+    pthread_mutex_lock(&g_mutex);
+    for (int i = 0; i < RXSTATS_MAX_CHN && n < max; i++) {
+        if (g_chn[i].active) out[n++] = g_chn[i];
+    }
+    pthread_mutex_unlock(&g_mutex);
+    return n;
+}
+
+static double loss_pct(const rxstats_chn_t *c) {
+    uint64_t expected = c->received + c->lost;
+    return expected ? 100.0 * (double)c->lost / (double)expected : 0.0;
+}
+
+void rxstats_print(FILE *fp, pktring_t *ring) {
+    static rxstats_chn_t snap[RXSTATS_MAX_CHN];
+    int n = rxstats_snapshot(snap, RXSTATS_MAX_CHN);
+    fprintf(fp, "\n=== 接收统计 ===\n");
+    fprintf(fp, "%-5s %9s %7s %6s %6s %6s %6s %9s %9s %6s\n",
+            "频道", "收包", "丢包", "丢包%", "重复", "乱序", "重同步", "抖动ms", "延迟ms", "欠载");
+    for (int i = 0; i < n; i++) {
+        rxstats_chn_t *c = &snap[i];
+        fprintf(fp, "%-5u %9llu %7llu %6.2f %6llu %6llu %6llu %9.2f %9.1f %6llu\n", c->chnid,
+                (unsigned long long)c->received, (unsigned long long)c->lost, loss_pct(c),
+                (unsigned long long)c->duplicates, (unsigned long long)c->reordered,
+                (unsigned long long)c->resyncs, c->jitter_ms, c->latency_ms,
+                (unsigned long long)c->underruns);
+    }
+    if (ring) {
+        pktring_stats_t rs;
+        pktring_get_stats(ring, &rs);
+        fprintf(fp, "包环: 占用%u/%d 峰值%u 溢出丢弃%llu\n", rs.occupancy, PKTRING_SLOTS,
+                rs.high_water, (unsigned long long)rs.overflow);
+    }
+    fprintf(fp, "================\n");
+}
+
+// 写一次报告: CSV 每频道一行, JSON 每次一行
+static void rxstats_write_report(void) {
+    static rxstats_chn_t snap[RXSTATS_MAX_CHN];
+    int n = rxstats_snapshot(snap, RXSTATS_MAX_CHN);
+    pktring_stats_t rs = {0};
+    if (g_report_ring) pktring_get_stats(g_report_ring, &rs);
+    long long now = (long long)time(NULL);
+
+    if (g_report_json) {
+        fprintf(g_report_fp, "{\"time\": %lld, \"ring\": {\"occupancy\": %u, \"high_water\": %u, \"overflow\": %llu}, \"channels\": [",
+                now, rs.occupancy, rs.high_water, (unsigned long long)rs.overflow);
+        for (int i = 0; i < n; i++) {
+            rxstats_chn_t *c = &snap[i];
+            fprintf(g_report_fp, "%s{\"chnid\": %u, \"received\": %llu, \"lost\": %llu, \"loss_pct\": %.3f, "
+                    "\"duplicates\": %llu, \"reordered\": %llu, \"resyncs\": %llu, \"jitter_ms\": %.3f, "
+                    "\"latency_ms\": %.1f, \"underruns\": %llu}",
+                    i ? ", " : "", c->chnid, (unsigned long long)c->received,
+                    (unsigned long long)c->lost, loss_pct(c), (unsigned long long)c->duplicates,
+                    (unsigned long long)c->reordered, (unsigned long long)c->resyncs, c->jitter_ms,
+                    c->latency_ms, (unsigned long long)c->underruns);
+        }
+        fprintf(g_report_fp, "]}\n");
+    } else {
+        for (int i = 0; i < n; i++) {
+            rxstats_chn_t *c = &snap[i];
+            fprintf(g_report_fp, "%lld,%u,%llu,%llu,%.3f,%llu,%llu,%llu,%.3f,%.1f,%llu,%u,%u,%llu\n", now,
+                    c->chnid, (unsigned long long)c->received, (unsigned long long)c->lost,
+                    loss_pct(c), (unsigned long long)c->duplicates, (unsigned long long)c->reordered,
+                    (unsigned long long)c->resyncs, c->jitter_ms, c->latency_ms,
+                    (unsigned long long)c->underruns, rs.occupancy, rs.high_water,
+                    (unsigned long long)rs.overflow);
+        }
+    }
+    fflush(g_report_fp);
+}
+
+static void *rxstats_report_loop(void *arg) {
+    (void)arg;
+    while (g_report_running) {
+        // 每秒检查一次退出标志
+        for (int i = 0; i < g_report_interval && g_report_running; i++) sleep(1);
+        rxstats_write_report();
+    }
+    return NULL;
+}
+
+int rxstats_report_start(const char *path, int interval_s, pktring_t *ring) {
+    g_report_fp = fopen(path, "a");
+    if (!g_report_fp) {
+        perror("[STATS] 打开统计文件失败");
+        return -1;
+    }
+    const char *ext = strrchr(path, '.');
+    g_report_json = ext && strcmp(ext, ".json") == 0;
+    g_report_interval = interval_s > 0 ? interval_s : RXSTATS_INTERVAL;
+    g_report_ring = ring;
+    if (!g_report_json && ftell(g_report_fp) == 0) {
+        fprintf(g_report_fp, "time,chnid,received,lost,loss_pct,duplicates,reordered,resyncs,"
+                             "jitter_ms,latency_ms,underruns,ring_occupancy,ring_high_water,ring_overflow\n");
+    }
+    g_report_running = 1;
+    if (pthread_create(&g_report_tid, NULL, rxstats_report_loop, NULL) != 0) {
+        g_report_running = 0;
+        fclose(g_report_fp);
+        g_report_fp = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+void rxstats_report_stop(void) {
+    if (!g_report_fp) return;
+    g_report_running = 0;
+    pthread_join(g_report_tid, NULL);
+    fclose(g_report_fp);
+    g_report_fp = NULL;
+}
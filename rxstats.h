@@ -0,0 +1,55 @@
+#ifndef __RXSTATS_H__
+#define __RXSTATS_H__
+
+#include <stdio.h>
+#include <stdint.h>
+#include "proto.h"
+#include "pktring.h"
+
+// 客户端接收质量统计: 按频道统计丢包/重复/乱序, RFC 3550 到达抖动, 单向延迟与输出欠载
+#define RXSTATS_MAX_CHN     256
+#define RXSTATS_WINDOW      1024        // 判断重复包的序列号窗口(必须是64的倍数)
+#define RXSTATS_MAX_DROPOUT 3000        // 序列号跳变超过此值视为服务器重启, 重新同步
+#define RXSTATS_INTERVAL    5           // 默认报告间隔(秒)
+
+// 到达时间的来源; 抖动只在同一来源的到达时间之间计算, 来源变化时重新开始
+typedef enum {
+    RX_CLOCK_USER = 0,          // 接收线程被调度后读取的用户态时钟
+    RX_CLOCK_KERNEL_SW,         // 内核软件接收时间戳 (CLOCK_REALTIME)
+    RX_CLOCK_KERNEL_HW,         // 网卡硬件接收时间戳 (网卡时钟, 只用于抖动)
+} rx_clock_t;
+
+// 单个频道的统计
+typedef struct rxstats_chn {
+    int active;
+    uint16_t chnid;
+    uint64_t received;          // 收到的不重复包数
+    uint64_t lost;              // 按序列号推算的丢包数
+    uint64_t duplicates;        // 重复包
+    uint64_t reordered;         // 晚于更大序列号到达的包
+    uint64_t resyncs;           // 序列号跳变导致的重新同步次数
+    uint64_t underruns;         // 音频输出欠载次数(正在播放此频道时)
+    double jitter_ms;           // RFC 3550 到达抖动
+    double latency_ms;          // 单向延迟(发送端墙钟到接收时刻, 需两端时钟同步), 平滑值
+
+    // 内部状态
+    uint64_t base_seq;          // 当前同步段的起始序列号(扩展为64位)
+    uint64_t max_seq;           // 已收到的最大序列号(扩展为64位)
+    uint64_t expected_prior;    // 之前同步段应收的包数
+    uint64_t window[RXSTATS_WINDOW / 64];   // max_seq 之前的收包位图
+    int64_t last_transit_us;    // 上一个包的 到达时间 - 媒体时间
+    int has_transit;
+    rx_clock_t transit_clock;   // last_transit_us 的到达时间来源
+} rxstats_chn_t;
+
+// 函数声明
+void rxstats_packet(const pkt_info_t *hdr);                 // 接收线程: 记录一个直播包
+void rxstats_packet_at(const pkt_info_t *hdr, rx_clock_t clock, int64_t arrival_us, int64_t wall_us);
+                                                            // 同上, 使用给定的到达时间; wall_us 为 0 时读当前墙钟
+void rxstats_underrun(uint16_t chnid);                      // 输出线程: 记录一次欠载
+int rxstats_snapshot(rxstats_chn_t *out, int max);          // 复制所有活跃频道的统计, 返回频道数
+void rxstats_print(FILE *fp, pktring_t *ring);              // 打印可读的统计表
+int rxstats_report_start(const char *path, int interval_s, pktring_t *ring);   // 定期写入CSV(默认)或JSON行(.json)
+void rxstats_report_stop(void);
+
+#endif /* __RXSTATS_H__ */
@@ -0,0 +1,86 @@
+#!/bin/sh
+# 在一对 veth 上检查 AF_PACKET 发送环 (-P): 帧直接进网卡, 本机收不到, 对端在独立的网络命名空间里
+# 用客户端压测模式收听; 要求服务器启用发送环, 对端收到数据且不丢包, 发送环统计没有错误
+# 用法: sudo scripts/veth_afpacket.sh [秒数]    (在仓库根目录运行, 需先编译 main 与 client)
+# 环境变量: SERVER CLIENT (默认 ./main ./client), MEDIA_LIB_PATH
+
+DUR=${1:-12}
+SERVER=${SERVER:-./main}
+CLIENT=${CLIENT:-./client}
+NS=mcafp
+DEV=vafp0
+PEER=vafp1
+SRV_ADDR=10.78.0.1
+PEER_ADDR=10.78.0.2
+LOG=$(mktemp /tmp/veth_afpacket.XXXXXX)
+FAILED=0
+
+cleanup() {
+    [ -n "$SRV_PID" ] && kill "$SRV_PID" 2>/dev/null
+    ip link del $DEV 2>/dev/null
+    ip netns del $NS 2>/dev/null
+    rm -f "$LOG" "$LOG.rx"
+}
+trap cleanup EXIT INT TERM
+
+if [ "$(id -u)" != 0 ]; then
+    echo "需要 root 权限 (创建网络命名空间, AF_PACKET 需 CAP_NET_RAW)" >&2
+    exit 1
+fi
+for f in "$SERVER" "$CLIENT"; do
+    if [ ! -x "$f" ]; then
+        echo "找不到 $f" >&2
+        exit 1
+    fi
+done
+
+ip netns add $NS || exit 1
+ip link add $DEV type veth peer name $PEER netns $NS || exit 1
+ip addr add $SRV_ADDR/24 dev $DEV
+ip link set $DEV up
+ip -n $NS addr add $PEER_ADDR/24 dev $PEER
+ip -n $NS link set $PEER up
+ip -n $NS link set lo up
+ip -n $NS route add 224.0.0.0/4 dev $PEER
+
+# 运行时长需超过一个统计周期, 才能看到发送环的统计日志
+"$SERVER" -i $SRV_ADDR -P $DEV -M >"$LOG" 2>&1 &
+SRV_PID=$!
+sleep 1
+ip netns exec $NS "$CLIENT" -L 3 -D "$DUR" >"$LOG.rx" 2>&1
+kill $SRV_PID 2>/dev/null
+wait $SRV_PID 2>/dev/null
+SRV_PID=
+
+if grep -q "AF_PACKET 发送环" "$LOG"; then
+    echo "通过: 已启用 AF_PACKET 发送环"
+else
+    echo "失败: 没有启用 AF_PACKET 发送环"
+    FAILED=1
+fi
+
+packets=$(sed -n 's/.*收包 \([0-9]*\) .*/\1/p' "$LOG.rx")
+lost=$(sed -n 's/.*丢包 \([0-9]*\) .*/\1/p' "$LOG.rx")
+if [ -z "$packets" ] || [ "$packets" -eq 0 ]; then
+    echo "失败: 对端没有收到数据"
+    FAILED=1
+elif [ "$lost" != 0 ]; then
+    echo "失败: 对端收包 $packets, 丢包 $lost"
+    FAILED=1
+else
+    echo "通过: 对端收包 $packets, 无丢包"
+fi
+
+stats=$(grep "AF_PACKET 发送: " "$LOG" | tail -n 1)
+if [ -z "$stats" ]; then
+    echo "失败: 没有发送环统计 (运行时长需超过统计周期)"
+    FAILED=1
+elif echo "$stats" | grep -q "错误0$"; then
+    echo "通过: ${stats#*AF_PACKET 发送: }"
+else
+    echo "失败: ${stats#*AF_PACKET 发送: }"
+    FAILED=1
+fi
+
+[ $FAILED = 0 ] || sed 's/^/    /' "$LOG" "$LOG.rx"
+exit $FAILED
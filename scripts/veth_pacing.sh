@@ -0,0 +1,115 @@
+#!/bin/sh
+# 在一对 veth 上检查组播发送节拍 (-t):
+#   1. 出口没有 fq/etf 时, 服务器必须报告退回用户态定时器节拍
+#   2. 出口为 fq (及 etf, 内核支持时) 时, 服务器必须进入内核节拍发送, 且对端测得的到达抖动不超过上限
+# 对端在独立的网络命名空间里用客户端压测模式收听, 到达抖动按媒体时间戳计算, 直接反映包间距是否均匀
+# 用法: sudo scripts/veth_pacing.sh [秒数]      (在仓库根目录运行, 需先编译 main 与 client)
+# 环境变量: SERVER CLIENT (默认 ./main ./client), MEDIA_LIB_PATH, JITTER_MAX_MS (默认 2)
+
+DUR=${1:-10}
+SERVER=${SERVER:-./main}
+CLIENT=${CLIENT:-./client}
+JITTER_MAX_MS=${JITTER_MAX_MS:-2}
+NS=mcpace
+DEV=vpace0
+PEER=vpace1
+SRV_ADDR=10.77.0.1
+PEER_ADDR=10.77.0.2
+LOG=$(mktemp /tmp/veth_pacing.XXXXXX)
+FAILED=0
+
+cleanup() {
+    [ -n "$SRV_PID" ] && kill "$SRV_PID" 2>/dev/null
+    ip link del $DEV 2>/dev/null
+    ip netns del $NS 2>/dev/null
+    rm -f "$LOG" "$LOG.rx"
+}
+trap cleanup EXIT INT TERM
+
+if [ "$(id -u)" != 0 ]; then
+    echo "需要 root 权限 (创建网络命名空间与 qdisc)" >&2
+    exit 1
+fi
+for f in "$SERVER" "$CLIENT"; do
+    if [ ! -x "$f" ]; then
+        echo "找不到 $f" >&2
+        exit 1
+    fi
+done
+
+ip netns add $NS || exit 1
+ip link add $DEV type veth peer name $PEER netns $NS || exit 1
+ip addr add $SRV_ADDR/24 dev $DEV
+ip link set $DEV up
+ip -n $NS addr add $PEER_ADDR/24 dev $PEER
+ip -n $NS link set $PEER up
+ip -n $NS link set lo up
+ip -n $NS route add 224.0.0.0/4 dev $PEER
+
+# 以 -t 运行服务器 $DUR 秒, 对端同时收听; 日志写入 $LOG, 压测结果写入 $LOG.rx
+run_server() {
+    "$SERVER" -i $SRV_ADDR -t -M >"$LOG" 2>&1 &
+    SRV_PID=$!
+    sleep 1
+    ip netns exec $NS "$CLIENT" -L 3 -D "$DUR" >"$LOG.rx" 2>&1
+    kill $SRV_PID 2>/dev/null
+    wait $SRV_PID 2>/dev/null
+    SRV_PID=
+}
+
+# 压测结果中的 "到达抖动 平均X 最大Y ms" 取最大值
+rx_jitter_max() {
+    sed -n 's/.*到达抖动 平均[0-9.]* 最大\([0-9.]*\) ms.*/\1/p' "$LOG.rx"
+}
+
+rx_summary() {
+    grep -E "收包|丢包|到达抖动" "$LOG.rx" | sed 's/^/    /'
+}
+
+# 1. 回退: veth 默认没有 qdisc (noqueue)
+echo "== 出口无 fq/etf: 应回退到用户态定时器"
+tc qdisc del dev $DEV root 2>/dev/null
+run_server
+if grep -q "出口接口 $DEV 未配置 fq/etf qdisc, 退回用户态定时器节拍" "$LOG"; then
+    echo "   通过: 已报告回退"
+else
+    echo "   失败: 没有报告回退"
+    sed 's/^/    /' "$LOG"
+    FAILED=1
+fi
+rx_summary
+
+# 2. 内核节拍: fq 用 CLOCK_MONOTONIC, etf 用 CLOCK_TAI
+check_txtime() {
+    name=$1
+    shift
+    echo "== 出口 $name: 应进入内核节拍发送"
+    if ! tc qdisc replace dev $DEV root "$@" 2>/dev/null; then
+        echo "   跳过: 内核不支持 $name qdisc"
+        return
+    fi
+    run_server
+    if ! grep -q "内核节拍发送: 接口 $DEV" "$LOG"; then
+        echo "   失败: 没有进入内核节拍发送"
+        sed 's/^/    /' "$LOG"
+        FAILED=1
+        return
+    fi
+    jitter=$(rx_jitter_max)
+    if [ -z "$jitter" ]; then
+        echo "   失败: 对端没有收到数据"
+        sed 's/^/    /' "$LOG.rx"
+        FAILED=1
+    elif awk "BEGIN { exit !($jitter <= $JITTER_MAX_MS) }"; then
+        echo "   通过: 到达抖动最大 $jitter ms (上限 $JITTER_MAX_MS ms)"
+    else
+        echo "   失败: 到达抖动最大 $jitter ms, 超过 $JITTER_MAX_MS ms"
+        FAILED=1
+    fi
+    rx_summary
+}
+
+check_txtime fq fq
+check_txtime etf etf clockid CLOCK_TAI delta 500000
+
+exit $FAILED
@@ -13,74 +13,310 @@
 #include <net/if.h>
 #include "server.h"
 #include "mtk.h"
+#include "burst.h"
+#include "unicast.h"
+#include "icy.h"
+#include "txtime.h"
+#include "afpacket.h"
+#include "egress.h"
+#include "presence.h"
+#include "pkfile.h"
+#include "handoff.h"
+#include "shmring.h"
+#include "probes.h"
 #include <errno.h>
 
-#define PKT_DATA_MAX 60000  // 推荐1400字节，避免分片
+#define PKT_DATA_MAX 1400   // 推荐1400字节，避免分片
+#define PKT_BUF_SIZE (sizeof(pkt_hdr_t) + PKT_DATA_MAX)
+#define STATE_SAVE_S 10     // 状态文件保存间隔(秒)
+#define STATS_REPORT_S 10   // 发送后端统计的日志间隔(秒)
 
-// 全局序列号（带互斥锁）
-static pthread_mutex_t seq_mutex = PTHREAD_MUTEX_INITIALIZER;
-static uint32_t global_seq = 0;
+static int g_wallclock = 0;     // 各频道按墙钟对齐, 暂停后恢复时重新对齐
+
+static uint64_t wall_clock_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + (uint64_t)ts.tv_nsec / 1000;
+}
 
 void handleMulticastTask(void* arg) {
     MulticastTask* task = (MulticastTask*)arg;
-    packet_header_t header;
+    pkt_hdr_t header;
+    tx_pkt_t batch[TX_BATCH_MAX];
+    uint32_t seqs[TX_BATCH_MAX];
+    int sync_offs[TX_BATCH_MAX];
+
+    // 一批包的发送缓冲在任务内复用, 不再每包 malloc
+    char *bufs = malloc((size_t)TX_BATCH_MAX * PKT_BUF_SIZE);
+    if (!bufs) {
+        fprintf(stderr, "分配发送缓冲区失败\n");
+        return;
+    }
+    uint32_t seq = 0;                   // 频道内序列号
+    uint64_t media_pos = 0;             // 频道节目流的采样位置
+    uint32_t media_rate = 0;            // media_pos 的单位(Hz)
+    uint64_t next_depart = tx_now_ns(); // 下一个包的出发时间
+    pk_chn_t *pk = pk_channel(task->chnid);     // 预打包文件, NULL 表示实时分包
+    if (pk && g_wallclock) pk_seek(pk, wall_clock_us());
+
+    // 热升级: 从旧进程停下的地方接着发, 序列号、媒体时间戳与节拍都连续
+    handoff_tx_t tx;
+    if (handoff_resume(task->chnid, &tx)) {
+        seq = tx.seq;
+        media_pos = tx.media_pos;
+        media_rate = tx.media_rate;
+        next_depart = tx.next_depart;
+        if (pk && tx.pk_next < pk->hdr->count) pk->next = tx.pk_next;
+    }
 
     while (1) {
-        void *data_buf = malloc(PKT_DATA_MAX);
-        if (!data_buf) {
-            fprintf(stderr, "分配数据缓冲区失败\n");
-            return;
-        }
-        // 只读取最多 PKT_DATA_MAX 字节
-        int bytes_read = media_lib_read_data(task->chnid, data_buf, PKT_DATA_MAX);
-        if (bytes_read <= 0) {
-            free(data_buf);
-            usleep(20000);
-            continue;
+        // 批次边界: 登记发送状态, 热升级时在这里停下
+        tx.seq = seq;
+        tx.media_pos = media_pos;
+        tx.media_rate = media_rate;
+        tx.next_depart = next_depart;
+        tx.pk_next = pk ? pk->next : UINT64_MAX;
+        handoff_checkpoint(task->chnid, &tx);
+
+        // 无人收听时暂停读文件与发送; 有人入台时立即唤醒, 从当前时刻重新起算节拍
+        if (!presence_active(task->chnid)) {
+            syslog(LOG_INFO, "频道%d 无人收听, 暂停发送", task->chnid);
+            burst_clear(task->chnid);
+            handoff_idle(task->chnid, 1);
+            presence_wait_active(task->chnid);
+            handoff_idle(task->chnid, 0);
+            syslog(LOG_INFO, "频道%d 有人收听, 恢复发送", task->chnid);
+            if (g_wallclock && pk) pk_seek(pk, wall_clock_us());
+            else if (g_wallclock) media_lib_seek(task->chnid, wall_clock_us());
+            next_depart = tx_now_ns();
         }
-        if (bytes_read > PKT_DATA_MAX) {
-            fprintf(stderr, "读取数据超长，丢弃\n");
-            free(data_buf);
-            continue;
+
+        // 内核节拍与出口预算模式一次组一个调度窗口的包, 用户态定时器模式逐包发送
+        int windowed = (tx_mode() == TX_MODE_TXTIME || egress_enabled());
+        uint64_t now = tx_now_ns();
+        if (next_depart + TX_MAX_LATE_NS < now) {
+            next_depart = now;  // 读文件卡顿等导致落后太多, 重新对齐节拍
         }
+        uint64_t window_end = next_depart + (windowed ? TX_WINDOW_NS : 0);
+        // 发送时钟与墙钟的差, 用于把出发时间换算为墙钟写入包头
+        uint64_t wall_now = wall_clock_us();
 
-        pthread_mutex_lock(&seq_mutex);
-        header.channel_id = htons(task->chnid);
-        header.seq_num = htonl(global_seq++);
-        header.data_len = htonl(bytes_read);
-        pthread_mutex_unlock(&seq_mutex);
+        int n = 0;
+        do {
+            char *send_buf = bufs + (size_t)n * PKT_BUF_SIZE;
+            char *data_buf = send_buf + sizeof(header);
+            media_chunk_t chunk;
+            int bytes_read, sync_off;
+            if (pk) {
+                // 预打包: 整个数据报连同包头模板一次复制, 分帧与同步点都已离线算好
+                bytes_read = pk_read(pk, send_buf, &chunk, &sync_off);
+            } else {
+                // 只读取最多 PKT_DATA_MAX 字节的整帧, 标签和垃圾数据已被媒体库剔除
+                bytes_read = media_lib_read_frames(task->chnid, data_buf, PKT_DATA_MAX, &chunk);
+                if (bytes_read <= 0) break;
+                sync_off = chunk.sync ? 0 : mp3_find_sync((uint8_t *)data_buf, bytes_read);
+            }
 
-        size_t send_len = sizeof(header) + bytes_read;
-        if (send_len > 61000) { // 保险起见再检查一次
-            fprintf(stderr, "发送包过大，丢弃\n");
-            free(data_buf);
-            continue;
-        }
+            // 换到不同采样率的文件时按新采样率换算采样位置, 保持时间连续
+            if (chunk.samplerate != media_rate) {
+                if (media_rate > 0) media_pos = media_pos * chunk.samplerate / media_rate;
+                media_rate = chunk.samplerate;
+            }
+
+            seqs[n] = seq++;
+            uint64_t send_time = wall_now + (next_depart > now ? (next_depart - now) / 1000 : 0);
+            if (pk) {
+                proto_hdr_stamp((pkt_hdr_t *)send_buf, task->chnid, seqs[n], media_pos, send_time);
+            } else {
+                proto_hdr_fill(&header, task->chnid, seqs[n], bytes_read, chunk.sync ? PKT_F_SYNC : 0,
+                               media_rate, media_pos, send_time);
+                memcpy(send_buf, &header, sizeof(header));
+            }
+            media_pos += chunk.samples;
+
+            batch[n].data = send_buf;
+            batch[n].len = sizeof(header) + bytes_read;
+            batch[n].depart_ns = next_depart;
+            sync_offs[n] = sync_off;
+            PROBE4(mcast, pkt_build, task->chnid, seqs[n], batch[n].len, next_depart);
+            // 包的播放时长由媒体库按帧的采样数给出
+            next_depart += (uint64_t)chunk.duration_us * 1000ULL;
+            n++;
+        } while (n < TX_BATCH_MAX && next_depart < window_end);
 
-        void *send_buf = malloc(send_len);
-        if (!send_buf) {
-            fprintf(stderr, "分配发送缓冲区失败\n");
-            free(data_buf);
-            return;
+        if (n == 0) {
+            usleep(20000);
+            continue;
         }
-        memcpy(send_buf, &header, sizeof(header));
-        memcpy((char*)send_buf + sizeof(header), data_buf, bytes_read);
 
-        ssize_t sent = sendto(task->sockfd, send_buf, send_len, 0,
-                              (struct sockaddr*)&task->mcast_addr, sizeof(task->mcast_addr));
+        PROBE3(mcast, send_entry, task->chnid, seqs[0], n);
+        // 出口预算模式交给调度线程按出发时间发送
+        int sent = egress_enabled() ? egress_submit(task->chnid, batch, n)
+                                    : tx_send_batch(task->sockfd, &task->mcast_addr, batch, n);
+        PROBE3(mcast, send_return, task->chnid, seqs[0], sent);
         if (sent < 0) {
             fprintf(stderr, "[Server] 发送失败 频道%d: %s\n", task->chnid, strerror(errno));
-        } else {
-            printf("[Server] 发送成功 频道%d: 序列%u 大小%zu\n",
-                   task->chnid, ntohl(header.seq_num), sent);
         }
-        free(send_buf);
-        free(data_buf);
-        usleep(5000); // 控制发送速率
+        // 记入突发缓冲, 供新入台客户端补发
+        for (int i = 0; i < n; i++) {
+            burst_push(task->chnid, batch[i].data, batch[i].len, seqs[i], sync_offs[i]);
+        }
+        // 同机客户端直接从共享内存读取
+        for (int i = 0; i < n; i++) {
+            shmring_publish(task->chnid, seqs[i], batch[i].data, batch[i].len);
+        }
+        shmring_notify();
+
+        // 窗口已交给内核排队, 在下一窗口开始前稍早醒来
+        if (windowed && next_depart > TX_LEAD_NS) {
+            tx_sleep_until(next_depart - TX_LEAD_NS);
+        }
+    }
+    free(bufs);
+}
+
+// AF_PACKET 发送环的周期统计; 出现环满等待或错误时升为警告
+static void report_afp(void) {
+    static afp_stats_t last;
+    afp_stats_t st;
+    afp_get_stats(&st);
+    uint64_t frames = st.frames - last.frames;
+    uint64_t kicks = st.kicks - last.kicks;
+    uint64_t full = st.ring_full - last.ring_full;
+    uint64_t errors = st.errors - last.errors;
+    syslog(full || errors ? LOG_WARNING : LOG_INFO,
+           "AF_PACKET 发送: %d秒内入环%llu帧 触发%llu次(平均每次%.1f帧) 环满等待%llu次 错误%llu",
+           STATS_REPORT_S, (unsigned long long)frames, (unsigned long long)kicks,
+           kicks ? (double)frames / (double)kicks : 0.0, (unsigned long long)full,
+           (unsigned long long)errors);
+    last = st;
+}
+
+// 出口预算的周期统计: 汇总各频道计数; 逐频道的丢包由调度线程另行报告
+static void report_egress(const mlib_list_entry *chn_list, int chn_count) {
+    static egress_chn_stats_t last;
+    egress_chn_stats_t sum = {0}, st;
+    uint32_t backlog_max = 0;
+    int nchn = 0;
+    for (int i = 0; i < chn_count; i++) {
+        if (egress_get_stats(chn_list[i].chnid, &st) != 0) continue;
+        sum.queued += st.queued;
+        sum.sent += st.sent;
+        sum.sent_bytes += st.sent_bytes;
+        sum.dropped_late += st.dropped_late;
+        sum.dropped_full += st.dropped_full;
+        sum.backlog += st.backlog;
+        if (st.backlog > backlog_max) backlog_max = st.backlog;
+        nchn++;
     }
+    uint64_t late = sum.dropped_late - last.dropped_late;
+    uint64_t full = sum.dropped_full - last.dropped_full;
+    syslog(late || full ? LOG_WARNING : LOG_INFO,
+           "出口预算: %d个频道 %d秒内入队%llu 发送%llu包 %.1f kbit/s 超时丢弃%llu 队满丢弃%llu 排队%u(单频道最多%u)",
+           nchn, STATS_REPORT_S, (unsigned long long)(sum.queued - last.queued),
+           (unsigned long long)(sum.sent - last.sent),
+           (double)(sum.sent_bytes - last.sent_bytes) * 8 / 1000 / STATS_REPORT_S,
+           (unsigned long long)late, (unsigned long long)full, sum.backlog, backlog_max);
+    last = sum;
 }
 
-int main() {
+static void usage(const char *prog) {
+    fprintf(stderr, "用法: %s [-i 组播出口地址] [-u 单播TCP端口] [-s skip|drop] [-H HTTP端口] [-t] [-P 接口]\n"
+                    "          [-b 总带宽kbit/s] [-W 频道=权重,...] [-w | -S 状态文件] [-I] [-K 预打包目录]\n"
+                    "          [-U 热升级套接字] [-M]\n"
+                    "  -u  开启单播TCP推流 (默认端口 %d)\n"
+                    "  -s  单播慢读者策略: skip 跳到最新同步点(默认), drop 断开\n"
+                    "  -H  开启HTTP/ICY推流 (默认端口 %d)\n"
+                    "  -t  内核节拍发送 (SO_TXTIME, 需出口接口配置 fq 或 etf qdisc)\n"
+                    "  -P  组播经 AF_PACKET 发送环直接写入该接口, 绕过协议栈 (需 CAP_NET_RAW,\n"
+                    "      本机接收者收不到; 与 -t 互斥)\n"
+                    "  -b  全部组播频道的总出口带宽预算, 超载时按权重在频道间分配 (与 -t 互斥)\n"
+                    "  -W  频道权重 (默认 1), 如 1=4,3=1; 超载时权重低的频道先丢包\n"
+                    "  -w  各频道按墙钟对齐播放 (Unix时间 mod 节目总时长), 重启后仍在同一位置\n"
+                    "  -S  启动时从状态文件恢复各频道位置, 运行中每 %d 秒保存一次\n"
+                    "  -I  按客户端收听心跳 (UDP %d) 暂停无人收听的频道, 有人入台时立即恢复\n"
+                    "  -K  从 packager 生成的目录加载各频道的预打包文件, 没有文件的频道仍实时分包\n"
+                    "  -U  热升级: 该路径上已有服务器在运行时接管它的套接字与各频道播放位置,\n"
+                    "      之后在该路径上等待下一次升级; 旧进程交接完成后退出\n"
+                    "  -M  不向本机客户端提供共享内存分发 (默认提供, 同机客户端自动使用)\n",
+            prog, UNICAST_PORT, ICY_PORT, STATE_SAVE_S, PRESENCE_PORT);
+}
+
+int main(int argc, char *argv[]) {
+    const char *mcast_if = NULL;  // 组播出口接口地址, 默认由路由决定
+    ThreadPool* pool = NULL;
+    TaskArgPool* task_args = NULL;
+    mlib_list_entry *chn_list = NULL;
+    int unicast_port = 0;         // 0 表示不开启单播推流
+    unicast_slow_policy_t slow_policy = UNICAST_SLOW_SKIP;
+    int http_port = 0;            // 0 表示不开启HTTP推流
+    int want_txtime = 0;          // 请求内核节拍发送
+    const char *packet_if = NULL; // AF_PACKET 发送接口, NULL 表示走UDP套接字
+    uint64_t budget_kbps = 0;     // 0 表示不限总带宽
+    int idle_suspend = 0;         // 暂停无人收听的频道
+    const char *pk_dir = NULL;    // 预打包文件目录
+    const char *state_path = NULL; // 频道位置状态文件
+    const char *upgrade_path = NULL; // 热升级 Unix 套接字
+    int local_shm = 1;            // 本机共享内存分发
+    int opt;
+    while ((opt = getopt(argc, argv, "i:u:s:H:tP:b:W:wS:IK:U:Mh")) != -1) {
+        switch (opt) {
+        case 'i':
+            mcast_if = optarg;
+            break;
+        case 'u':
+            unicast_port = atoi(optarg);
+            break;
+        case 't':
+            want_txtime = 1;
+            break;
+        case 'P':
+            packet_if = optarg;
+            break;
+        case 'b':
+            budget_kbps = strtoull(optarg, NULL, 10);
+            break;
+        case 'W':
+            if (egress_parse_weights(optarg) != 0) {
+                fprintf(stderr, "无效的频道权重: %s\n", optarg);
+                return 1;
+            }
+            break;
+        case 'w':
+            g_wallclock = 1;
+            break;
+        case 'I':
+            idle_suspend = 1;
+            break;
+        case 'K':
+            pk_dir = optarg;
+            break;
+        case 'S':
+            state_path = optarg;
+            break;
+        case 'U':
+            upgrade_path = optarg;
+            break;
+        case 'M':
+            local_shm = 0;
+            break;
+        case 'H':
+            http_port = atoi(optarg);
+            break;
+        case 's':
+            if (strcmp(optarg, "drop") == 0) {
+                slow_policy = UNICAST_SLOW_DROP;
+            } else if (strcmp(optarg, "skip") != 0) {
+                usage(argv[0]);
+                return 1;
+            }
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
     // 让 syslog 输出到终端
     setlogmask(LOG_UPTO(LOG_DEBUG));
     openlog("multicast_server", LOG_PID|LOG_CONS | LOG_PERROR, LOG_DAEMON);
@@ -91,13 +327,41 @@ int main() {
         closelog();
         return -1;
     }
-    
+
+    // 预打包文件 (可选): 发送路径直接复制离线切好的数据报
+    if (pk_dir) {
+        int loaded = pk_open_dir(pk_dir);
+        if (loaded > 0 && state_path) syslog(LOG_WARNING, "预打包频道不从状态文件恢复位置");
+    }
+
+    // 频道起播位置: 墙钟对齐优先, 否则从状态文件恢复
+    if (g_wallclock) {
+        if (state_path) syslog(LOG_WARNING, "墙钟对齐模式下忽略状态文件 %s", state_path);
+        state_path = NULL;
+        media_lib_seek_wallclock();
+    } else if (state_path) {
+        int restored = media_lib_state_load(state_path);
+        if (restored >= 0) syslog(LOG_INFO, "从 %s 恢复了 %d 个频道的位置", state_path, restored);
+    }
+
+    // 热升级: 媒体库已就绪, 此时才让旧进程停下, 交接期间的空档只有余下的启动步骤
+    // 旧进程在交接失败时会恢复运行, 本进程不能再启动第二套发送
+    if (upgrade_path && handoff_take_over(upgrade_path) < 0) {
+        syslog(LOG_ERR, "热升级交接失败, 旧进程继续运行, 本进程退出");
+        pk_close_all();
+        media_lib_deinit();
+        closelog();
+        return -1;
+    }
+
     // 2. 创建组播套接字
-    int sockfd = socket(AF_INET, SOCK_DGRAM, 0);
+    int sockfd = handoff_inherit(HANDOFF_FD_MCAST);
+    if (sockfd < 0) sockfd = socket(AF_INET, SOCK_DGRAM, 0);
     if (sockfd < 0) {
         syslog(LOG_ERR, "创建套接字失败: %s", strerror(errno));
         goto cleanup;
     }
+    handoff_export(HANDOFF_FD_MCAST, sockfd, NULL);    // 发送套接字, 本进程不在上面接收
 
     // 设置套接字选项
     int ttl = 1;
@@ -109,35 +373,100 @@ int main() {
     // 设置网络接口
     struct in_addr local_interface;
     local_interface.s_addr = INADDR_ANY;
+    if (mcast_if && inet_pton(AF_INET, mcast_if, &local_interface) != 1) {
+        syslog(LOG_ERR, "无效的组播接口地址: %s", mcast_if);
+        goto cleanup;
+    }
     if (setsockopt(sockfd, IPPROTO_IP, IP_MULTICAST_IF, &local_interface, sizeof(local_interface)) < 0) {
         syslog(LOG_WARNING, "设置组播接口失败: %s", strerror(errno));
     }
 
-    // 3. 创建线程池
-    ThreadPool* pool = threadPoolCreate(5, 10, 20);
-    if (!pool) {
-        syslog(LOG_ERR, "创建线程池失败");
+    // 收听心跳 (可选): 在补发与单播服务之前启动, 它们的请求也计为有人收听
+    if (idle_suspend && presence_start(PRESENCE_PORT, local_interface) != 0) {
+        syslog(LOG_WARNING, "收听心跳不可用, 所有频道持续发送");
+    }
+
+    // 启动入台补发服务 (失败不影响组播)
+    if (burst_service_start(BURST_PORT, local_interface) != 0) {
+        syslog(LOG_WARNING, "入台补发服务未启动");
+    }
+
+    // 单播TCP推流 (可选), 与组播共享突发缓冲
+    if (unicast_port > 0 && unicast_start(unicast_port, slow_policy) != 0) {
+        syslog(LOG_ERR, "单播推流启动失败");
         goto cleanup;
     }
 
-    // 4. 获取频道列表
-    mlib_list_entry *chn_list = NULL;
+    // HTTP/ICY推流 (可选), 直接从媒体文件 sendfile
+    if (http_port > 0 && icy_start(http_port) != 0) {
+        syslog(LOG_ERR, "HTTP推流启动失败");
+        goto cleanup;
+    }
+
+    // 3. 获取频道列表
     int chn_count = 0;
     if (media_lib_get_chn_list(&chn_list, &chn_count) != 0) {
         syslog(LOG_ERR, "获取频道列表失败");
         goto cleanup;
     }
 
+    // 4. 创建线程池: 频道任务常驻不返回, 每个频道占一个线程, 按频道数一次建满
+    int pool_threads = chn_count > 0 ? chn_count : 1;
+    pool = threadPoolCreate(pool_threads, pool_threads, pool_threads);
+    if (!pool) {
+        syslog(LOG_ERR, "创建线程池失败");
+        goto cleanup;
+    }
+
+    // 本机共享内存分发 (可选), 每个频道ID一个环
+    if (local_shm) {
+        int max_chnid = 0;
+        for (int i = 0; i < chn_count; i++) {
+            if (chn_list[i].chnid > max_chnid) max_chnid = chn_list[i].chnid;
+        }
+        if (shmring_start(max_chnid + 1, local_interface.s_addr) != 0) syslog(LOG_WARNING, "本机共享内存分发不可用");
+    }
+
     // 5. 设置组播地址
     struct sockaddr_in mcast_addr = {0};
     mcast_addr.sin_family = AF_INET;
     mcast_addr.sin_port = htons(RCV_PORT);
     inet_pton(AF_INET, GROUP_IP, &mcast_addr.sin_addr);
 
-    // 6. 添加任务
+    // AF_PACKET 发送环 (可选), 失败时照常走UDP套接字
+    if (packet_if) {
+        if (want_txtime) syslog(LOG_WARNING, "AF_PACKET 发送绕过 qdisc, 忽略 -t");
+        want_txtime = 0;
+        if (afp_open(packet_if, local_interface.s_addr, &mcast_addr, ttl) != 0) {
+            syslog(LOG_WARNING, "AF_PACKET 发送不可用, 使用UDP套接字");
+        }
+    }
+
+    // 出口带宽预算 (可选): 调度线程按出发时间逐包发送, 不使用内核节拍
+    if (budget_kbps > 0) {
+        if (want_txtime) syslog(LOG_WARNING, "出口预算由调度线程节拍, 忽略 -t");
+        want_txtime = 0;
+    }
+
+    // 选择发送节拍: SO_TXTIME 或用户态定时器
+    tx_setup(sockfd, &mcast_addr, want_txtime);
+    if (budget_kbps > 0 && egress_start(sockfd, &mcast_addr, budget_kbps * 1000) != 0) {
+        syslog(LOG_ERR, "出口调度线程启动失败");
+        goto cleanup;
+    }
+
+    // 6. 添加任务: 参数从任务参数池分配, 所有频道一次入队
     syslog(LOG_INFO, "开始添加 %d 个频道任务", chn_count);
+    task_args = taskArgPoolCreate(sizeof(MulticastTask), chn_count);
+    Task *tasks = calloc(chn_count > 0 ? chn_count : 1, sizeof(Task));
+    if (!task_args || !tasks) {
+        syslog(LOG_ERR, "分配任务内存失败");
+        free(tasks);
+        goto cleanup;
+    }
+    int ntasks = 0;
     for (int i = 0; i < chn_count; i++) {
-        MulticastTask* task = malloc(sizeof(MulticastTask));
+        MulticastTask* task = taskArgAlloc(task_args);
         if (!task) {
             syslog(LOG_ERR, "分配任务内存失败");
             continue;
@@ -147,23 +476,51 @@ int main() {
         task->mcast_addr = mcast_addr;
         task->sockfd = sockfd;
         
-        threadPoolAdd(pool, handleMulticastTask, task);
-        usleep(10000); // 10ms间隔
+        tasks[ntasks].function = handleMulticastTask;
+        tasks[ntasks].arg = task;
+        tasks[ntasks].destroy = taskArgFree;
+        ntasks++;
+    }
+    int added = ntasks > 0 ? threadPoolAddBatch(pool, tasks, ntasks) : 0;
+    if (added < ntasks) {
+        syslog(LOG_ERR, "只添加了 %d/%d 个频道任务", added < 0 ? 0 : added, ntasks);
+        for (int i = added < 0 ? 0 : added; i < ntasks; i++) taskArgFree(tasks[i].arg);
+    }
+    free(tasks);
+
+    // 各频道已从交接点开始发送, 旧进程可以退出; 本进程接着等待下一次升级
+    handoff_finish();
+    if (upgrade_path && handoff_listen(upgrade_path) != 0) {
+        syslog(LOG_WARNING, "热升级监听不可用");
     }
 
     // 7. 主循环
     syslog(LOG_INFO, "服务器运行中...");
-    while(1) {
-    sleep(1);
-
-}
+    for (unsigned tick = 1; ; tick++) {
+        sleep(1);
+        if (state_path && tick % STATE_SAVE_S == 0) {
+            media_lib_state_save(state_path);
+        }
+        if (tick % STATS_REPORT_S == 0 && afp_enabled()) report_afp();
+        if (tick % STATS_REPORT_S == 0 && egress_enabled()) report_egress(chn_list, chn_count);
+    }
 
 cleanup:
     // 8. 清理资源
     syslog(LOG_INFO, "服务器关闭中...");
+    handoff_stop();
+    presence_stop();
     if (pool) threadPoolDestroy(pool);
+    taskArgPoolDestroy(task_args);
+    shmring_stop();
+    egress_stop();
+    afp_close();
+    icy_stop();
+    unicast_stop();
+    burst_cleanup();
     if (sockfd >= 0) close(sockfd);
     if (chn_list) free(chn_list);
+    pk_close_all();
     media_lib_deinit();
     closelog();
     return 0;
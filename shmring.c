@@ -0,0 +1,262 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <syslog.h>
+#include <limits.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/eventfd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include "shmring.h"
+
+// 旧版 glibc 头文件没有此常量 (Linux 5.1 起支持)
+#ifndef F_SEAL_FUTURE_WRITE
+#define F_SEAL_FUTURE_WRITE 0x0010
+#endif
+
+static int g_memfd = -1;            // 布局页 + 各频道的环, 对读者只读
+static uint8_t *g_map = NULL;
+static size_t g_map_len = 0;
+static shm_ctl_t *g_ctl = NULL;
+static int g_wait_fd = -1;          // 等待页, 读者可写
+static shm_wait_t *g_wait = NULL;
+static size_t g_wait_len = 0;
+
+static int g_listen_fd = -1;
+static int g_event_fd = -1;
+static pthread_t g_tid;
+static int g_running = 0;
+
+static void futex_wake_all(uint32_t *addr) {
+    // 读者在各自进程中映射同一页, 只能用共享 futex
+    syscall(SYS_futex, addr, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+}
+
+static shm_ring_t *ring_at(int chnid) {
+    return (shm_ring_t *)(g_map + g_ctl->data_offset + (size_t)chnid * g_ctl->ring_size);
+}
+
+static shm_slot_t *slot_at(shm_ring_t *ring, uint64_t pos) {
+    return (shm_slot_t *)((uint8_t *)ring + sizeof(*ring) + (pos & (SHM_SLOTS - 1)) * SHM_SLOT_SIZE);
+}
+
+// 单写者: 每个环只由对应频道的发送任务写入; 没有读者时也照常写, 读者(重新)连接后可从环中接续
+void shmring_publish(int chnid, uint32_t seq, const void *pkt, size_t len) {
+    if (!g_ctl) return;
+    if (chnid < 0 || (uint32_t)chnid >= g_ctl->nrings || len > SHM_DATA_MAX) return;
+
+    shm_ring_t *ring = ring_at(chnid);
+    uint64_t pos = ring->head;
+    shm_slot_t *slot = slot_at(ring, pos);
+    uint32_t lock = slot->lock;
+    __atomic_store_n(&slot->lock, lock + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    slot->len = (uint32_t)len;
+    slot->pos = pos;
+    slot->pkt_seq = seq;
+    memcpy(slot->data, pkt, len);
+    __atomic_store_n(&slot->lock, lock + 2, __ATOMIC_RELEASE);
+    __atomic_store_n(&ring->head, pos + 1, __ATOMIC_RELEASE);
+}
+
+void shmring_notify(void) {
+    if (!g_ctl) return;
+    __atomic_add_fetch(&g_wait->notify, 1, __ATOMIC_RELEASE);
+    // 与读者对称的全屏障: 发布 notify 与读取 waiters 之间不能重排
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&g_wait->waiters, __ATOMIC_RELAXED)) futex_wake_all(&g_wait->notify);
+}
+
+// 只接受与服务器同用户或同组的读者 (root 除外): 抽象套接字没有文件权限, 任何本机用户都能连接
+static int shm_peer_allowed(int fd) {
+    struct ucred cred;
+    socklen_t len = sizeof(cred);
+    if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) < 0) return 0;
+    if (cred.uid == 0 || cred.uid == geteuid() || cred.gid == getegid()) return 1;
+    syslog(LOG_WARNING, "拒绝共享内存读者: pid %d uid %u gid %u", (int)cred.pid, cred.uid, cred.gid);
+    return 0;
+}
+
+// 把两个 memfd 交给新连接的读者; 连接保持打开, 读者据此发现服务器退出
+static int shm_send_fd(int fd) {
+    uint32_t hello[4] = {SHM_MAGIC, SHM_VERSION, (uint32_t)g_map_len, (uint32_t)g_wait_len};
+    int fds[2] = {g_memfd, g_wait_fd};
+    union {
+        char buf[CMSG_SPACE(sizeof(fds))];
+        struct cmsghdr align;
+    } control;
+    memset(&control, 0, sizeof(control));
+    struct iovec iov = {hello, sizeof(hello)};
+    struct msghdr mh = {0};
+    mh.msg_iov = &iov;
+    mh.msg_iovlen = 1;
+    mh.msg_control = control.buf;
+    mh.msg_controllen = sizeof(control.buf);
+    struct cmsghdr *cm = CMSG_FIRSTHDR(&mh);
+    cm->cmsg_level = SOL_SOCKET;
+    cm->cmsg_type = SCM_RIGHTS;
+    cm->cmsg_len = CMSG_LEN(sizeof(fds));
+    memcpy(CMSG_DATA(cm), fds, sizeof(fds));
+    return sendmsg(fd, &mh, MSG_NOSIGNAL) == (ssize_t)sizeof(hello) ? 0 : -1;
+}
+
+// 绑定抽象套接字; 热升级时旧进程退出前名字仍被占用, 由监听线程重试
+static int shm_bind(void) {
+    int fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+    struct sockaddr_un addr = {0};
+    addr.sun_family = AF_UNIX;
+    memcpy(addr.sun_path + 1, SHM_SOCK_NAME, strlen(SHM_SOCK_NAME));
+    socklen_t len = (socklen_t)(offsetof(struct sockaddr_un, sun_path) + 1 + strlen(SHM_SOCK_NAME));
+    if (bind(fd, (struct sockaddr *)&addr, len) < 0 || listen(fd, SHM_MAX_CLIENTS) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static void *shm_listen_loop(void *arg) {
+    (void)arg;
+    struct pollfd pfd[2 + SHM_MAX_CLIENTS];
+    int conns[SHM_MAX_CLIENTS];
+    int nconn = 0;
+    int warned = 0;
+
+    while (g_running) {
+        if (g_listen_fd < 0) {
+            g_listen_fd = shm_bind();
+            if (g_listen_fd >= 0) {
+                syslog(LOG_INFO, "本机共享内存分发就绪 (@%s)", SHM_SOCK_NAME);
+            } else if (!warned) {
+                syslog(LOG_INFO, "共享内存套接字被占用, 等待旧进程退出");
+                warned = 1;
+            }
+        }
+        pfd[0].fd = g_event_fd;
+        pfd[0].events = POLLIN;
+        pfd[1].fd = g_listen_fd;        // -1 时 poll 忽略
+        pfd[1].events = POLLIN;
+        for (int i = 0; i < nconn; i++) {
+            pfd[2 + i].fd = conns[i];
+            pfd[2 + i].events = POLLIN;
+        }
+        if (poll(pfd, 2 + nconn, g_listen_fd < 0 ? 100 : -1) < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        if (pfd[0].revents) break;
+
+        // 读者断开: 连接上不会有数据, 可读即 EOF
+        for (int i = nconn - 1; i >= 0; i--) {
+            if (!pfd[2 + i].revents) continue;
+            close(conns[i]);
+            conns[i] = conns[--nconn];
+        }
+
+        if (g_listen_fd >= 0 && (pfd[1].revents & POLLIN)) {
+            int fd = accept4(g_listen_fd, NULL, NULL, SOCK_CLOEXEC);
+            if (fd < 0) continue;
+            if (nconn >= SHM_MAX_CLIENTS || !shm_peer_allowed(fd) || shm_send_fd(fd) != 0) {
+                close(fd);
+                continue;
+            }
+            conns[nconn++] = fd;
+        }
+    }
+    for (int i = 0; i < nconn; i++) close(conns[i]);
+    return NULL;
+}
+
+int shmring_start(int nrings, uint32_t server_addr) {
+    long page = sysconf(_SC_PAGESIZE);
+    size_t ring_size = sizeof(shm_ring_t) + (size_t)SHM_SLOTS * SHM_SLOT_SIZE;
+    size_t data_offset = ((sizeof(shm_ctl_t) + page - 1) / page) * page;
+    g_map_len = data_offset + ring_size * nrings;
+
+    g_memfd = memfd_create("mcast-shm", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (g_memfd < 0 || ftruncate(g_memfd, (off_t)g_map_len) < 0) {
+        syslog(LOG_ERR, "创建共享内存失败: %s", strerror(errno));
+        shmring_stop();
+        return -1;
+    }
+    g_map = mmap(NULL, g_map_len, PROT_READ | PROT_WRITE, MAP_SHARED, g_memfd, 0);
+    if (g_map == MAP_FAILED) {
+        g_map = NULL;
+        syslog(LOG_ERR, "映射共享内存失败: %s", strerror(errno));
+        shmring_stop();
+        return -1;
+    }
+    // 读者不能改变大小, 否则服务器写环时会收到 SIGBUS; 本进程已有的可写映射之外不再允许写入
+    if (fcntl(g_memfd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_FUTURE_WRITE | F_SEAL_SEAL) < 0) {
+        syslog(LOG_ERR, "共享内存无法设为只读 (需 Linux 5.1+): %s", strerror(errno));
+        shmring_stop();
+        return -1;
+    }
+
+    g_wait_len = (size_t)page;
+    g_wait_fd = memfd_create("mcast-shm-wait", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (g_wait_fd < 0 || ftruncate(g_wait_fd, (off_t)g_wait_len) < 0 ||
+        fcntl(g_wait_fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) < 0) {
+        syslog(LOG_ERR, "创建共享内存等待页失败: %s", strerror(errno));
+        shmring_stop();
+        return -1;
+    }
+    g_wait = mmap(NULL, g_wait_len, PROT_READ | PROT_WRITE, MAP_SHARED, g_wait_fd, 0);
+    if (g_wait == MAP_FAILED) {
+        g_wait = NULL;
+        syslog(LOG_ERR, "映射共享内存等待页失败: %s", strerror(errno));
+        shmring_stop();
+        return -1;
+    }
+    shm_ctl_t *ctl = (shm_ctl_t *)g_map;
+    ctl->magic = SHM_MAGIC;
+    ctl->version = SHM_VERSION;
+    ctl->nrings = (uint32_t)nrings;
+    ctl->slots = SHM_SLOTS;
+    ctl->slot_size = SHM_SLOT_SIZE;
+    ctl->ring_size = (uint32_t)ring_size;
+    ctl->data_offset = data_offset;
+    ctl->server_addr = server_addr;
+
+    g_event_fd = eventfd(0, EFD_CLOEXEC);
+    if (g_event_fd < 0) {
+        shmring_stop();
+        return -1;
+    }
+    g_ctl = ctl;
+    g_running = 1;
+    if (pthread_create(&g_tid, NULL, shm_listen_loop, NULL) != 0) {
+        g_running = 0;
+        shmring_stop();
+        return -1;
+    }
+    return 0;
+}
+
+void shmring_stop(void) {
+    if (g_running) {
+        g_running = 0;
+        uint64_t one = 1;
+        ssize_t ret = write(g_event_fd, &one, sizeof(one));
+        (void)ret;
+        pthread_join(g_tid, NULL);
+    }
+    g_ctl = NULL;
+    if (g_listen_fd >= 0) close(g_listen_fd);
+    if (g_event_fd >= 0) close(g_event_fd);
+    if (g_map) munmap(g_map, g_map_len);
+    if (g_memfd >= 0) close(g_memfd);
+    if (g_wait) munmap(g_wait, g_wait_len);
+    if (g_wait_fd >= 0) close(g_wait_fd);
+    g_listen_fd = g_event_fd = g_memfd = g_wait_fd = -1;
+    g_map = NULL;
+    g_wait = NULL;
+}
@@ -0,0 +1,69 @@
+#ifndef __SHMRING_H__
+#define __SHMRING_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+// 本机共享内存分发: 服务器把每个频道的数据报写入 memfd 中该频道的环, 同机客户端经
+// 抽象 Unix 套接字取得 memfd 后直接读环, 每包不再经过回环组播协议栈和一次 recvfrom;
+// 槽位用序号锁(seqlock)保护, 读者落后一整圈时跳到最新数据, 空闲时在共享 futex 上等待;
+// 环所在的 memfd 加 F_SEAL_FUTURE_WRITE, 读者只能只读映射, 读者需要写的等待计数放在另一个 memfd;
+// 双方用 SO_PEERCRED 核对对方身份: 服务器只接受同用户/同组的读者, 读者只信任 root 或自己启动的服务器
+#define SHM_SOCK_NAME     "mcast-audio-shm" // 抽象命名空间套接字名 (不在文件系统中)
+#define SHM_MAGIC         0x53484D52        // "SHMR"
+#define SHM_VERSION       3
+#define SHM_SLOTS         256               // 每频道槽位数, 必须是2的幂 (约9秒数据)
+#define SHM_SLOT_SIZE     1536              // 槽位大小(含槽位头)
+#define SHM_MAX_CLIENTS   64
+#define SHM_WAIT_MS       100               // 读者空等的最长时间, 之后检查服务器是否还在
+#define SHM_RECONNECT_MS  2000              // 服务器退出(如热升级)后重新连接的时限
+
+// 布局页: 位于环 memfd 开头, 之后是各频道的环
+typedef struct shm_ctl {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t nrings;                // 环个数 = 最大频道ID + 1
+    uint32_t slots;
+    uint32_t slot_size;
+    uint32_t ring_size;             // 每个环的字节数
+    uint64_t data_offset;           // 第一个环在 memfd 中的偏移 (页对齐)
+    uint32_t server_addr;           // 服务器组播出口地址(网络字节序), 补发请求发往此地址; INADDR_ANY 时用回环地址
+} shm_ctl_t;
+
+// 等待页: 单独的 memfd, 读者以读写方式映射; 读者篡改它最多造成多余或迟到的唤醒
+typedef struct shm_wait {
+    uint32_t notify __attribute__((aligned(64)));   // futex: 每发布一批加一
+    uint32_t waiters __attribute__((aligned(64)));  // 正在等待的读者数, 为0时发布者不唤醒
+} shm_wait_t;
+
+// 环头, 后接 slots 个槽位
+typedef struct shm_ring {
+    uint64_t head __attribute__((aligned(64)));     // 已发布的包数, 只由该频道的发送任务修改
+} shm_ring_t;
+
+typedef struct shm_slot {
+    uint32_t lock;                  // 序号锁: 奇数表示正在写
+    uint32_t len;
+    uint64_t pos;                   // 本槽位是环中第几个包, 读者据此判断是否已被覆盖
+    uint32_t pkt_seq;               // 数据报的频道内序列号
+    uint32_t reserved;
+    uint8_t data[];
+} shm_slot_t;
+
+#define SHM_DATA_MAX (SHM_SLOT_SIZE - sizeof(shm_slot_t))
+
+// 函数声明 (服务器)
+int shmring_start(int nrings, uint32_t server_addr);   // 创建 memfd 与监听线程
+void shmring_publish(int chnid, uint32_t seq, const void *pkt, size_t len); // 写入一个数据报
+void shmring_notify(void);                          // 一批写完后唤醒等待的读者
+void shmring_stop(void);
+
+// 函数声明 (客户端)
+typedef struct shm_reader shm_reader_t;
+shm_reader_t *shmrx_open(void);                     // 本机没有服务器时返回 NULL
+ssize_t shmrx_recv(shm_reader_t *r, void *buf, size_t cap, int wait_ms);    // 超时返回0, 服务器已不在返回-1
+uint32_t shmrx_server_addr(const shm_reader_t *r);  // 服务器的补发地址(网络字节序)
+void shmrx_close(shm_reader_t *r);
+
+#endif /* __SHMRING_H__ */
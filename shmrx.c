@@ -0,0 +1,249 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include "shmring.h"
+
+#define SHMRX_MAX_RINGS 256     // 频道ID取值范围
+
+struct shm_reader {
+    int conn;                   // 与服务器的连接, 服务器退出时挂断
+    const uint8_t *map;         // 布局页 + 各频道的环 (只读)
+    size_t map_len;
+    const shm_ctl_t *ctl;
+    const uint8_t *rings;
+    shm_wait_t *wait;           // 等待页 (读写)
+    size_t wait_len;
+    uint32_t nrings;
+    uint32_t server_addr;
+    uint32_t next;              // 轮询起点, 各频道轮流取包
+    uint64_t cursor[SHMRX_MAX_RINGS];   // 下一个要读的包
+    uint32_t last_seq[SHMRX_MAX_RINGS]; // 最近读到的序列号, 重新连接后据此接续
+    uint8_t seen[SHMRX_MAX_RINGS];
+};
+
+static uint64_t mono_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+static void futex_wait_shared(uint32_t *addr, uint32_t val, int ms) {
+    struct timespec ts = {ms / 1000, (ms % 1000) * 1000000L};
+    syscall(SYS_futex, addr, FUTEX_WAIT, val, &ts, NULL, 0);
+}
+
+static const shm_ring_t *ring_at(const shm_reader_t *r, uint32_t i) {
+    return (const shm_ring_t *)(r->rings + (size_t)i * r->ctl->ring_size);
+}
+
+static const shm_slot_t *slot_at(const shm_ring_t *ring, uint64_t pos) {
+    return (const shm_slot_t *)((const uint8_t *)ring + sizeof(*ring) + (pos & (SHM_SLOTS - 1)) * SHM_SLOT_SIZE);
+}
+
+static void shmrx_detach(shm_reader_t *r) {
+    if (r->map) munmap((void *)r->map, r->map_len);
+    if (r->wait) munmap(r->wait, r->wait_len);
+    if (r->conn >= 0) close(r->conn);
+    r->map = NULL;
+    r->ctl = NULL;
+    r->rings = NULL;
+    r->wait = NULL;
+    r->conn = -1;
+}
+
+// 抽象套接字名谁都能抢先绑定, 只信任 root 或与本进程同用户的服务器
+static int shmrx_server_trusted(int fd) {
+    struct ucred cred;
+    socklen_t len = sizeof(cred);
+    if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) < 0) return 0;
+    if (cred.uid == 0 || cred.uid == getuid()) return 1;
+    printf("[SHM] 共享内存服务器属于用户 %u, 不予信任\n", cred.uid);
+    return 0;
+}
+
+// 从服务器取得两个 memfd 并映射; 失败返回 -1
+static int shmrx_attach(shm_reader_t *r) {
+    r->conn = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (r->conn < 0) return -1;
+    struct sockaddr_un addr = {0};
+    addr.sun_family = AF_UNIX;
+    memcpy(addr.sun_path + 1, SHM_SOCK_NAME, strlen(SHM_SOCK_NAME));
+    socklen_t alen = (socklen_t)(offsetof(struct sockaddr_un, sun_path) + 1 + strlen(SHM_SOCK_NAME));
+    if (connect(r->conn, (struct sockaddr *)&addr, alen) < 0 || !shmrx_server_trusted(r->conn)) {
+        shmrx_detach(r);
+        return -1;
+    }
+    struct timeval tv = {1, 0};
+    setsockopt(r->conn, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    uint32_t hello[4];
+    int fds[2] = {-1, -1};
+    union {
+        char buf[CMSG_SPACE(sizeof(fds))];
+        struct cmsghdr align;
+    } control;
+    struct iovec iov = {hello, sizeof(hello)};
+    struct msghdr mh = {0};
+    mh.msg_iov = &iov;
+    mh.msg_iovlen = 1;
+    mh.msg_control = control.buf;
+    mh.msg_controllen = sizeof(control.buf);
+    ssize_t n = recvmsg(r->conn, &mh, MSG_CMSG_CLOEXEC);
+    struct cmsghdr *cm = n > 0 ? CMSG_FIRSTHDR(&mh) : NULL;
+    if (cm && cm->cmsg_level == SOL_SOCKET && cm->cmsg_type == SCM_RIGHTS) {
+        size_t nfd = (cm->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        memcpy(fds, CMSG_DATA(cm), (nfd < 2 ? nfd : 2) * sizeof(int));
+    }
+    struct stat st, wst;
+    if (n != (ssize_t)sizeof(hello) || fds[0] < 0 || fds[1] < 0 || hello[0] != SHM_MAGIC ||
+        hello[1] != SHM_VERSION || fstat(fds[0], &st) < 0 || (uint64_t)st.st_size != hello[2] ||
+        fstat(fds[1], &wst) < 0 || (uint64_t)wst.st_size != hello[3] || hello[3] < sizeof(shm_wait_t)) {
+        goto fail;
+    }
+
+    // 环只能只读映射 (服务器已加 F_SEAL_FUTURE_WRITE), 等待页读写映射
+    r->map_len = (size_t)st.st_size;
+    void *map = mmap(NULL, r->map_len, PROT_READ, MAP_SHARED, fds[0], 0);
+    if (map == MAP_FAILED) goto fail;
+    r->map = map;
+    r->wait_len = (size_t)wst.st_size;
+    void *wait = mmap(NULL, r->wait_len, PROT_READ | PROT_WRITE, MAP_SHARED, fds[1], 0);
+    if (wait == MAP_FAILED) goto fail;
+    r->wait = wait;
+    close(fds[0]);
+    close(fds[1]);
+    fds[0] = fds[1] = -1;
+
+    const shm_ctl_t *c = (const shm_ctl_t *)r->map;
+    if (r->map_len < sizeof(*c) || c->slots != SHM_SLOTS || c->slot_size != SHM_SLOT_SIZE ||
+        c->nrings > SHMRX_MAX_RINGS || c->data_offset < sizeof(*c) ||
+        c->data_offset + (uint64_t)c->nrings * c->ring_size != (uint64_t)st.st_size) {
+        goto fail;
+    }
+    r->ctl = c;
+    r->rings = r->map + c->data_offset;
+    r->nrings = c->nrings;
+    r->server_addr = c->server_addr ? c->server_addr : htonl(INADDR_LOOPBACK);
+    r->next = 0;
+
+    // 首次连接从最新数据开始; 重新连接(服务器热升级)时从上次读到的序列号之后接续
+    for (uint32_t i = 0; i < r->nrings; i++) {
+        const shm_ring_t *ring = ring_at(r, i);
+        uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        r->cursor[i] = head;
+        if (!r->seen[i]) continue;
+        uint64_t lo = head > SHM_SLOTS - 1 ? head - (SHM_SLOTS - 1) : 0;
+        for (uint64_t p = head; p > lo; p--) {
+            uint32_t seq = __atomic_load_n(&slot_at(ring, p - 1)->pkt_seq, __ATOMIC_RELAXED);
+            if ((int32_t)(seq - r->last_seq[i]) <= 0) break;
+            r->cursor[i] = p - 1;
+        }
+    }
+    return 0;
+
+fail:
+    if (fds[0] >= 0) close(fds[0]);
+    if (fds[1] >= 0) close(fds[1]);
+    shmrx_detach(r);
+    return -1;
+}
+
+shm_reader_t *shmrx_open(void) {
+    shm_reader_t *r = calloc(1, sizeof(*r));
+    if (!r) return NULL;
+    r->conn = -1;
+    if (shmrx_attach(r) != 0) {
+        free(r);
+        return NULL;
+    }
+    return r;
+}
+
+// 各频道轮流取一个包; 槽位在读取期间被覆盖(读者落后一整圈)时跳到最新数据, 丢失的包由序列号体现
+static ssize_t shmrx_take(shm_reader_t *r, void *buf, size_t cap) {
+    for (uint32_t k = 0; k < r->nrings; k++) {
+        uint32_t i = (r->next + k) % r->nrings;
+        const shm_ring_t *ring = ring_at(r, i);
+        uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        uint64_t c = r->cursor[i];
+        if (c == head) continue;
+        if (head - c >= SHM_SLOTS) c = head - 1;
+
+        const shm_slot_t *slot = slot_at(ring, c);
+        uint32_t lock = __atomic_load_n(&slot->lock, __ATOMIC_ACQUIRE);
+        uint32_t len = slot->len;
+        uint64_t pos = slot->pos;
+        uint32_t seq = slot->pkt_seq;
+        if ((lock & 1) || len > SHM_DATA_MAX || len > cap) {
+            r->cursor[i] = head;
+            continue;
+        }
+        memcpy(buf, slot->data, len);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&slot->lock, __ATOMIC_RELAXED) != lock || pos != c) {
+            r->cursor[i] = head;
+            continue;
+        }
+        r->cursor[i] = c + 1;
+        r->last_seq[i] = seq;
+        r->seen[i] = 1;
+        r->next = i + 1;
+        return len;
+    }
+    return 0;
+}
+
+static int shmrx_server_gone(shm_reader_t *r) {
+    struct pollfd pfd = {r->conn, POLLIN, 0};
+    return poll(&pfd, 1, 0) > 0;    // 服务器不会发送数据, 可读即挂断
+}
+
+ssize_t shmrx_recv(shm_reader_t *r, void *buf, size_t cap, int wait_ms) {
+    ssize_t n = shmrx_take(r, buf, cap);
+    if (n > 0) return n;
+
+    // Dekker 式配对: 登记等待者与检查环之间需要全屏障, 与发布者对称
+    uint32_t v = __atomic_load_n(&r->wait->notify, __ATOMIC_ACQUIRE);
+    __atomic_add_fetch(&r->wait->waiters, 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    n = shmrx_take(r, buf, cap);
+    if (n == 0) futex_wait_shared(&r->wait->notify, v, wait_ms);
+    __atomic_sub_fetch(&r->wait->waiters, 1, __ATOMIC_RELAXED);
+    if (n > 0) return n;
+    n = shmrx_take(r, buf, cap);
+    if (n > 0 || !shmrx_server_gone(r)) return n;
+
+    // 服务器退出: 热升级时新进程在旧进程退出后接管同一个名字
+    printf("[SHM] 服务器断开, 重新连接\n");
+    shmrx_detach(r);
+    uint64_t deadline = mono_ms() + SHM_RECONNECT_MS;
+    while (shmrx_attach(r) != 0) {
+        if (mono_ms() >= deadline) return -1;
+        usleep(100000);
+    }
+    printf("[SHM] 已重新连接\n");
+    return 0;
+}
+
+uint32_t shmrx_server_addr(const shm_reader_t *r) {
+    return r->server_addr;
+}
+
+void shmrx_close(shm_reader_t *r) {
+    if (!r) return;
+    shmrx_detach(r);
+    free(r);
+}
@@ -1,11 +1,13 @@
 #include <pthread.h>
 #include <time.h>
 #include "threadpool.h"
+#include "probes.h"
 #include <string.h>
 #include <stdlib.h>
 #include <unistd.h>
 #include <stdio.h>
 #include <errno.h>
+#include <stddef.h>
 
 #define NUMBER 2  // 每次增减线程数
 #define TASK_TIMEOUT 2  // 任务超时(秒)
@@ -96,36 +98,34 @@ void* worker(void* arg) {
         }
         
         // 取出任务
-        Task task;
-        task.function = pool->taskQ[pool->queueFront].function;
-        task.arg = pool->taskQ[pool->queueFront].arg;
+        Task task = pool->taskQ[pool->queueFront];
         
         // 更新队列
         pool->queueFront = (pool->queueFront + 1) % pool->queueCapacity;
         pool->queueSize--;
+        PROBE4(threadpool, task_dequeue, pool, task.function, task.arg, pool->queueSize);
         
         // 通知可以添加新任务
         pthread_cond_signal(&pool->notFull);
         pthread_mutex_unlock(&pool->mutexPool);
         
         // 执行任务
-        printf("[Thread %ld] start task\n", pthread_self());
         pthread_mutex_lock(&pool->mutexBusy);
         pool->busyNum++;
         pthread_mutex_unlock(&pool->mutexBusy);
         
+        PROBE2(threadpool, task_start, task.function, task.arg);
         task.function(task.arg);
+        PROBE2(threadpool, task_finish, task.function, task.arg);
         
         // 清理资源
-        if (task.arg) {
-            free(task.arg);
+        if (task.arg && task.destroy) {
+            task.destroy(task.arg);
         }
         
         pthread_mutex_lock(&pool->mutexBusy);
         pool->busyNum--;
         pthread_mutex_unlock(&pool->mutexBusy);
-        
-        printf("[Thread %ld] finish task\n", pthread_self());
     }
     return NULL;
 }
@@ -146,8 +146,7 @@ void* manager(void* arg) {
         int busyNum = pool->busyNum;
         pthread_mutex_unlock(&pool->mutexBusy);
         
-        printf("[Manager] status: %d/%d threads, %d tasks\n", 
-              busyNum, liveNum, queueSize);
+        PROBE3(threadpool, manager_status, busyNum, liveNum, queueSize);
         
         // 动态增加线程
         if (queueSize > liveNum && liveNum < pool->maxNum) {
@@ -161,6 +160,7 @@ void* manager(void* arg) {
                     printf("[Manager] add thread %ld\n", pool->threadIDs[i]);
                 }
             }
+            PROBE2(threadpool, manager_add, add, pool->liveNum);
             pthread_mutex_unlock(&pool->mutexPool);
         }
         
@@ -174,6 +174,7 @@ void* manager(void* arg) {
                 pthread_cond_signal(&pool->notEmpty);
             }
             printf("[Manager] remove %d threads\n", NUMBER);
+            PROBE2(threadpool, manager_remove, NUMBER, liveNum);
         }
     }
     return NULL;
@@ -191,37 +192,66 @@ void threadExit(ThreadPool* pool) {
     pthread_exit(NULL);
 }
 
-int threadPoolAdd(ThreadPool* pool, void(*func)(void*), void* arg) {
-    pthread_mutex_lock(&pool->mutexPool);
-    
-    // 带超时的等待
-    struct timespec ts;
-    clock_gettime(CLOCK_REALTIME, &ts);
-    ts.tv_sec += TASK_TIMEOUT;
-    
+// 等待队列有空位, 返回0表示可以入队; 调用时持有 mutexPool, 失败时已解锁
+static int waitNotFull(ThreadPool* pool, const struct timespec* ts, void(*func)(void*)) {
     while (pool->queueSize == pool->queueCapacity && !pool->shutdown) {
-        int err = pthread_cond_timedwait(&pool->notFull, &pool->mutexPool, &ts);
+        int err = pthread_cond_timedwait(&pool->notFull, &pool->mutexPool, ts);
         if (err == ETIMEDOUT) {
             pthread_mutex_unlock(&pool->mutexPool);
+            PROBE2(threadpool, task_add_timeout, pool, func);
             printf("[Pool] add task timeout\n");
             return -1;
         }
     }
-    
+
     if (pool->shutdown) {
         pthread_mutex_unlock(&pool->mutexPool);
         return -1;
     }
+    return 0;
+}
+
+int threadPoolAdd(ThreadPool* pool, void(*func)(void*), void* arg) {
+    return threadPoolAddEx(pool, func, arg, free);
+}
+
+int threadPoolAddEx(ThreadPool* pool, void(*func)(void*), void* arg, void(*destroy)(void*)) {
+    Task task = {func, arg, destroy};
+    return threadPoolAddBatch(pool, &task, 1) == 1 ? 0 : -1;
+}
+
+int threadPoolAddBatch(ThreadPool* pool, const Task* tasks, int n) {
+    pthread_mutex_lock(&pool->mutexPool);
     
-    // 添加任务
-    pool->taskQ[pool->queueRear].function = func;
-    pool->taskQ[pool->queueRear].arg = arg;
-    pool->queueRear = (pool->queueRear + 1) % pool->queueCapacity;
-    pool->queueSize++;
+    // 带超时的等待, 整批共用一个截止时间
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_sec += TASK_TIMEOUT;
+    
+    int added = 0;
+    while (added < n) {
+        if (waitNotFull(pool, &ts, tasks[added].function) != 0) {
+            return added > 0 ? added : -1;
+        }
+
+        // 有多少空位放多少, 只唤醒一次
+        int room = pool->queueCapacity - pool->queueSize;
+        int k = 0;
+        for (; k < room && added < n; k++, added++) {
+            pool->taskQ[pool->queueRear] = tasks[added];
+            pool->queueRear = (pool->queueRear + 1) % pool->queueCapacity;
+            pool->queueSize++;
+            PROBE4(threadpool, task_enqueue, pool, tasks[added].function, tasks[added].arg, pool->queueSize);
+        }
+        if (k == 1) {
+            pthread_cond_signal(&pool->notEmpty);
+        } else {
+            pthread_cond_broadcast(&pool->notEmpty);
+        }
+    }
     
-    pthread_cond_signal(&pool->notEmpty);
     pthread_mutex_unlock(&pool->mutexPool);
-    return 0;
+    return added;
 }
 
 int threadPoolDestroy(ThreadPool* pool) {
@@ -243,6 +273,14 @@ int threadPoolDestroy(ThreadPool* pool) {
         }
     }
     
+    // 未执行的任务只释放参数
+    while (pool->queueSize > 0) {
+        Task* t = &pool->taskQ[pool->queueFront];
+        if (t->arg && t->destroy) t->destroy(t->arg);
+        pool->queueFront = (pool->queueFront + 1) % pool->queueCapacity;
+        pool->queueSize--;
+    }
+
     // 释放资源
     free(pool->taskQ);
     free(pool->threadIDs);
@@ -271,3 +309,74 @@ int threadPoolAliveNum(ThreadPool* pool) {
     pthread_mutex_unlock(&pool->mutexPool);
     return aliveNum;
 }
+
+// 每个对象前有一个池头记录所属的池, taskArgFree 据此放回
+typedef union ArgHead {
+    TaskArgPool* owner;     // 已分配: 所属的池
+    union ArgHead* next;    // 空闲: 链表下一项
+    max_align_t align;
+} ArgHead;
+
+TaskArgPool* taskArgPoolCreate(size_t size, int chunkCount) {
+    TaskArgPool* ap = (TaskArgPool*)malloc(sizeof(TaskArgPool));
+    if (!ap) {
+        perror("malloc TaskArgPool failed");
+        return NULL;
+    }
+    size_t align = sizeof(ArgHead);
+    ap->objSize = sizeof(ArgHead) + (size + align - 1) / align * align;
+    ap->chunkCount = chunkCount > 0 ? chunkCount : 1;
+    ap->freeList = NULL;
+    ap->chunks = NULL;
+    pthread_mutex_init(&ap->mutex, NULL);
+    return ap;
+}
+
+// 追加一块对象到空闲链表; 块首的一个 ArgHead 用来串起所有块
+static int taskArgGrow(TaskArgPool* ap) {
+    char* chunk = (char*)malloc(sizeof(ArgHead) + ap->objSize * ap->chunkCount);
+    if (!chunk) return -1;
+    ((ArgHead*)chunk)->next = (ArgHead*)ap->chunks;
+    ap->chunks = chunk;
+    for (int i = ap->chunkCount - 1; i >= 0; i--) {
+        ArgHead* h = (ArgHead*)(chunk + sizeof(ArgHead) + ap->objSize * i);
+        h->next = (ArgHead*)ap->freeList;
+        ap->freeList = h;
+    }
+    return 0;
+}
+
+void* taskArgAlloc(TaskArgPool* ap) {
+    pthread_mutex_lock(&ap->mutex);
+    if (!ap->freeList && taskArgGrow(ap) != 0) {
+        pthread_mutex_unlock(&ap->mutex);
+        return NULL;
+    }
+    ArgHead* h = (ArgHead*)ap->freeList;
+    ap->freeList = h->next;
+    pthread_mutex_unlock(&ap->mutex);
+    h->owner = ap;
+    return h + 1;
+}
+
+void taskArgFree(void* arg) {
+    if (!arg) return;
+    ArgHead* h = (ArgHead*)arg - 1;
+    TaskArgPool* ap = h->owner;
+    pthread_mutex_lock(&ap->mutex);
+    h->next = (ArgHead*)ap->freeList;
+    ap->freeList = h;
+    pthread_mutex_unlock(&ap->mutex);
+}
+
+void taskArgPoolDestroy(TaskArgPool* ap) {
+    if (!ap) return;
+    ArgHead* c = (ArgHead*)ap->chunks;
+    while (c) {
+        ArgHead* next = c->next;
+        free(c);
+        c = next;
+    }
+    pthread_mutex_destroy(&ap->mutex);
+    free(ap);
+}
@@ -2,12 +2,23 @@
 #define __THREADPOOL_H__
 
 #include <pthread.h>
+#include <stddef.h>
 //任务结构体
 typedef struct Task{
 	void (*function)(void* arg);
 	void* arg;
+	void (*destroy)(void* arg);  //任务执行完后释放arg, NULL表示不释放
 }Task;
 
+//任务参数池: 固定大小的对象按块预分配, 用完放回空闲链表, 高频提交时不再逐个malloc/free
+typedef struct TaskArgPool{
+	size_t objSize;   //对象大小(含池头, 已按指针对齐)
+	int chunkCount;   //每块对象个数
+	void *freeList;   //空闲对象链表
+	void *chunks;     //已分配的块链表, 销毁时整体释放
+	pthread_mutex_t mutex;
+}TaskArgPool;
+
 
 //线程池结构体
 typedef struct ThreadPool{
@@ -37,13 +48,25 @@ typedef struct ThreadPool{
 ThreadPool *threadPoolCreate(int min,int max,int queueSize);
 //销毁线程池
 int threadPoolDestroy(ThreadPool* pool);
-//给线程池添加任务
+//给线程池添加任务, 执行完后free(arg)
 int threadPoolAdd(ThreadPool* pool,void(*func)(void*),void* arg);
+//添加任务并指定arg的析构函数, destroy为NULL时线程池不释放arg
+int threadPoolAddEx(ThreadPool* pool,void(*func)(void*),void* arg,void(*destroy)(void*));
+//一次加锁添加n个任务, 队列满时等待; 返回添加的任务数, 一个也没加上返回-1
+int threadPoolAddBatch(ThreadPool* pool,const Task* tasks,int n);
 //获取线程池中工作的线程的个数
 int threadPoolBusyNum(ThreadPool* pool);
 //获取线程池中活着的线程的个数
 int threadPoolAliveNum(ThreadPool* pool);
 void *worker(void *arg);
+//创建任务参数池, 每次按chunkCount个对象扩容
+TaskArgPool *taskArgPoolCreate(size_t size,int chunkCount);
+//从池中取一个对象(内容未清零), 失败返回NULL
+void *taskArgAlloc(TaskArgPool* ap);
+//把对象放回所属的池, 可直接作为任务的destroy
+void taskArgFree(void* arg);
+//销毁参数池及其全部对象
+void taskArgPoolDestroy(TaskArgPool* ap);
 //管理者监管增加或者销毁线程
 void *manager(void *arg);
 //r线程推出
@@ -0,0 +1,270 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "tshift.h"
+#include "pktring.h"
+
+static int g_fd = -1;
+static char *g_map = NULL;
+static size_t g_map_len = 0;
+static tshift_hdr_t *g_hdr;
+static tshift_tindex_t *g_tindex;
+static uint64_t *g_seqindex;        // 写入序号+1, 0 表示空
+static char *g_recs;
+static uint64_t g_nrecs;
+
+static pktring_t *g_ring;           // 接收线程 -> 写入线程
+static pthread_t g_writer_tid;
+static volatile int g_running = 0;
+static uint64_t g_recorded;
+
+static uint64_t now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+static tshift_rec_t *rec_at(uint64_t pos) {
+    return (tshift_rec_t *)(g_recs + (pos & (g_nrecs - 1)) * TSHIFT_REC_SIZE);
+}
+
+// 仍未被覆盖的最旧写入序号; 正在写的槽位(head % nrecs)不可读
+static uint64_t oldest_pos(uint64_t head) {
+    return head >= g_nrecs ? head - g_nrecs + 1 : 0;
+}
+
+// 序列号索引槽位: 各频道的序列号独立递增, 按 (频道, 序列号) 散列, 否则 -A 记录多个频道时互相覆盖
+static uint64_t seq_slot(uint16_t chnid, uint32_t seq) {
+    return ((uint64_t)seq + (uint64_t)chnid * 0x9E3779B1u) & (g_nrecs - 1);
+}
+
+// 写入一条记录并更新索引; 记录内容写完后才推进 head
+static void tshift_append(const tshift_rec_t *in) {
+    uint64_t pos = g_hdr->head;
+    tshift_rec_t *rec = rec_at(pos);
+    memcpy(rec, in, sizeof(*in) + in->len);
+    rec->pos = pos;
+
+    uint64_t sec = in->ts_ms / 1000;
+    tshift_tindex_t *t = &g_tindex[sec % TSHIFT_INDEX_SECS];
+    if (t->sec != sec || t->pos < oldest_pos(pos)) {
+        t->pos = pos;
+        __atomic_store_n(&t->sec, sec, __ATOMIC_RELEASE);
+    }
+    __atomic_store_n(&g_seqindex[seq_slot(in->chnid, in->seq)], pos + 1, __ATOMIC_RELEASE);
+    __atomic_store_n(&g_hdr->head, pos + 1, __ATOMIC_RELEASE);
+    __atomic_add_fetch(&g_recorded, 1, __ATOMIC_RELAXED);
+}
+
+// 写入线程: 每 TSHIFT_BATCH_MS 把积累的包一次写入映射区, 页面由内核异步回写
+static void *tshift_writer(void *arg) {
+    (void)arg;
+    while (g_running) {
+        usleep(TSHIFT_BATCH_MS * 1000);
+        uint64_t first = g_hdr->head;
+        pktring_slot_t *slot;
+        while ((slot = pktring_peek(g_ring, 0)) != NULL) {
+            tshift_append((const tshift_rec_t *)slot->data);
+            pktring_pop(g_ring);
+        }
+        if (g_hdr->head != first) {
+            msync(g_map, g_map_len, MS_ASYNC);
+        }
+    }
+    return NULL;
+}
+
+int tshift_enabled(void) {
+    return g_map != NULL;
+}
+
+// 接收线程调用: 只拷入内存包环, 写入线程来不及处理时丢弃
+void tshift_record(uint16_t chnid, uint32_t seq, const void *data, size_t len) {
+    if (!g_map || len > TSHIFT_REC_DATA) return;
+    char buf[TSHIFT_REC_SIZE];
+    tshift_rec_t *rec = (tshift_rec_t *)buf;
+    rec->pos = 0;
+    rec->ts_ms = now_ms();
+    rec->seq = seq;
+    rec->chnid = chnid;
+    rec->len = (uint16_t)len;
+    memcpy(rec->data, data, len);
+    pktring_push(g_ring, 0, buf, sizeof(*rec) + len);
+}
+
+// 打开或创建环形文件; bytes 为文件总大小
+int tshift_open(const char *path, size_t bytes) {
+    // 记录槽位数取2的幂, 序列号索引可直接取模
+    size_t meta = 4096 + TSHIFT_INDEX_SECS * sizeof(tshift_tindex_t);
+    uint64_t nrecs = 1;
+    while ((nrecs * 2) * (TSHIFT_REC_SIZE + sizeof(uint64_t)) + meta <= bytes) nrecs *= 2;
+    if (nrecs < 64) {
+        fprintf(stderr, "[TSHIFT] 时移文件太小: %zu 字节\n", bytes);
+        return -1;
+    }
+    size_t seq_off = meta;
+    size_t rec_off = seq_off + nrecs * sizeof(uint64_t);
+    size_t len = rec_off + nrecs * TSHIFT_REC_SIZE;
+
+    int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        fprintf(stderr, "[TSHIFT] 打开 %s 失败: %s\n", path, strerror(errno));
+        return -1;
+    }
+    struct stat st;
+    int reuse = 0;
+    if (fstat(fd, &st) == 0 && (size_t)st.st_size == len) {
+        tshift_hdr_t old;
+        if (pread(fd, &old, sizeof(old), 0) == (ssize_t)sizeof(old) && old.magic == TSHIFT_MAGIC &&
+            old.version == TSHIFT_VERSION && old.rec_size == TSHIFT_REC_SIZE && old.nrecs == nrecs) {
+            reuse = 1;
+        }
+    }
+    if (!reuse) {
+        // 预先分配磁盘空间, 避免写映射区时因空间不足收到 SIGBUS
+        if (ftruncate(fd, 0) < 0 || posix_fallocate(fd, 0, (off_t)len) != 0) {
+            fprintf(stderr, "[TSHIFT] 分配 %zu 字节失败\n", len);
+            close(fd);
+            return -1;
+        }
+    }
+    char *map = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        fprintf(stderr, "[TSHIFT] mmap 失败: %s\n", strerror(errno));
+        close(fd);
+        return -1;
+    }
+    g_ring = pktring_create();
+    if (!g_ring) {
+        munmap(map, len);
+        close(fd);
+        return -1;
+    }
+
+    g_fd = fd;
+    g_map = map;
+    g_map_len = len;
+    g_hdr = (tshift_hdr_t *)map;
+    g_tindex = (tshift_tindex_t *)(map + 4096);
+    g_seqindex = (uint64_t *)(map + seq_off);
+    g_recs = map + rec_off;
+    g_nrecs = nrecs;
+    if (!reuse) {
+        memset(map, 0, rec_off);
+        g_hdr->magic = TSHIFT_MAGIC;
+        g_hdr->version = TSHIFT_VERSION;
+        g_hdr->rec_size = TSHIFT_REC_SIZE;
+        g_hdr->nrecs = nrecs;
+        g_hdr->head = 0;
+    }
+
+    g_running = 1;
+    if (pthread_create(&g_writer_tid, NULL, tshift_writer, NULL) != 0) {
+        g_running = 0;
+        tshift_close();
+        return -1;
+    }
+    printf("[TSHIFT] 时移文件 %s: %llu 条记录%s\n", path, (unsigned long long)nrecs,
+           reuse ? ", 沿用已有内容" : "");
+    return 0;
+}
+
+void tshift_close(void) {
+    if (g_running) {
+        g_running = 0;
+        pthread_join(g_writer_tid, NULL);
+    }
+    if (g_map) {
+        msync(g_map, g_map_len, MS_SYNC);
+        munmap(g_map, g_map_len);
+        g_map = NULL;
+    }
+    if (g_fd >= 0) {
+        close(g_fd);
+        g_fd = -1;
+    }
+    pktring_destroy(g_ring);
+    g_ring = NULL;
+}
+
+uint64_t tshift_head(void) {
+    return g_map ? __atomic_load_n(&g_hdr->head, __ATOMIC_ACQUIRE) : 0;
+}
+
+// 时间点 -> 记录序号: 直接查该秒的索引项, 没有数据时向后找几秒
+int64_t tshift_seek_time(uint64_t ts_ms) {
+    if (!g_map) return -1;
+    uint64_t head = tshift_head();
+    uint64_t oldest = oldest_pos(head);
+    if (head == oldest) return (int64_t)head;
+    if (ts_ms <= rec_at(oldest)->ts_ms) return (int64_t)oldest;
+
+    uint64_t sec = ts_ms / 1000;
+    for (uint64_t s = sec; s <= sec + TSHIFT_SEEK_SCAN; s++) {
+        tshift_tindex_t *t = &g_tindex[s % TSHIFT_INDEX_SECS];
+        if (__atomic_load_n(&t->sec, __ATOMIC_ACQUIRE) != s) continue;
+        uint64_t pos = t->pos;
+        // 索引项可能指向已被覆盖的记录, 以记录自身的序号校验
+        if (pos >= oldest && pos < head && rec_at(pos)->pos == pos) return (int64_t)pos;
+    }
+    return (int64_t)head;
+}
+
+// (频道, 序列号) -> 记录序号
+int64_t tshift_seek_seq(uint16_t chnid, uint32_t seq) {
+    if (!g_map) return -1;
+    uint64_t head = tshift_head();
+    uint64_t v = __atomic_load_n(&g_seqindex[seq_slot(chnid, seq)], __ATOMIC_ACQUIRE);
+    if (v == 0) return -1;
+    uint64_t pos = v - 1;
+    if (pos < oldest_pos(head) || pos >= head) return -1;
+    tshift_rec_t *rec = rec_at(pos);
+    if (rec->pos != pos || rec->seq != seq || rec->chnid != chnid) return -1;
+    return (int64_t)pos;
+}
+
+// 从 *pos 起读取频道 chnid 的下一条记录并前移 *pos
+// 返回数据长度; 0 表示已追上直播; -1 表示 *pos 已被覆盖, *pos 被移到最旧记录
+int tshift_read(uint64_t *pos, uint16_t chnid, void *buf, size_t cap, uint64_t *ts_ms) {
+    if (!g_map) return 0;
+    while (1) {
+        uint64_t head = tshift_head();
+        if (*pos < oldest_pos(head)) {
+            *pos = oldest_pos(head);
+            return -1;
+        }
+        if (*pos >= head) return 0;
+
+        tshift_rec_t *rec = rec_at(*pos);
+        uint16_t rec_chnid = rec->chnid;
+        size_t len = rec->len;
+        uint64_t ts = rec->ts_ms;
+        if (rec_chnid == chnid && len <= cap) memcpy(buf, rec->data, len);
+        // 拷贝期间写入线程可能已绕回覆盖该槽位
+        if (*pos < oldest_pos(tshift_head())) continue;
+        (*pos)++;
+        if (rec_chnid != chnid || len > cap) continue;
+        if (ts_ms) *ts_ms = ts;
+        return (int)len;
+    }
+}
+
+void tshift_get_stats(tshift_stats_t *stats) {
+    memset(stats, 0, sizeof(*stats));
+    if (!g_map) return;
+    pktring_stats_t rs;
+    pktring_get_stats(g_ring, &rs);
+    stats->recorded = __atomic_load_n(&g_recorded, __ATOMIC_RELAXED);
+    stats->dropped = rs.overflow + rs.oversize;
+    uint64_t head = tshift_head();
+    if (head > 0) {
+        stats->span_ms = rec_at(head - 1)->ts_ms - rec_at(oldest_pos(head))->ts_ms;
+    }
+}
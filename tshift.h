@@ -0,0 +1,64 @@
+#ifndef __TSHIFT_H__
+#define __TSHIFT_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+// 客户端时移存储: 收到的包追加写入固定大小的 mmap 环形文件, 可暂停/回退直播
+// 文件布局: 文件头 | 时间索引(每秒一项) | 序列号索引(每记录一项, 按频道与序列号散列) | 定长记录
+// 接收线程只把包放入内存包环, 由写入线程批量落盘, 接收路径不会同步触碰磁盘
+#define TSHIFT_MAGIC      0x54534846        // "TSHF"
+#define TSHIFT_VERSION    2                 // 2: 序列号索引按 (频道, 序列号) 散列
+#define TSHIFT_DEFAULT_MB 64                // 默认文件大小(MB)
+#define TSHIFT_REC_SIZE   2048              // 每条记录占用字节数
+#define TSHIFT_INDEX_SECS 65536             // 时间索引项数(秒), 需大于文件能保存的时长
+#define TSHIFT_BATCH_MS   200               // 写入线程批量落盘间隔
+#define TSHIFT_SEEK_SCAN  10                // 某一秒没有数据时向后查找的秒数
+
+// 文件头
+typedef struct tshift_hdr {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t rec_size;
+    uint32_t reserved;
+    uint64_t nrecs;             // 记录槽位数(2的幂)
+    uint64_t head;              // 下一条记录的写入序号(单调递增)
+} tshift_hdr_t;
+
+// 时间索引项: 某一秒内的第一条记录
+typedef struct tshift_tindex {
+    uint64_t sec;
+    uint64_t pos;
+} tshift_tindex_t;
+
+// 一条记录: 写入序号 pos 对应槽位 pos % nrecs
+typedef struct tshift_rec {
+    uint64_t pos;               // 写入序号, 读取时据此判断是否已被覆盖
+    uint64_t ts_ms;             // 接收时间(CLOCK_REALTIME, 毫秒)
+    uint32_t seq;               // 包序列号
+    uint16_t chnid;             // 频道ID
+    uint16_t len;               // 数据长度
+    char data[];
+} tshift_rec_t;
+
+#define TSHIFT_REC_DATA (TSHIFT_REC_SIZE - sizeof(tshift_rec_t))
+
+// 计数器
+typedef struct tshift_stats {
+    uint64_t recorded;          // 已落盘的包数
+    uint64_t dropped;           // 写入线程来不及处理而丢弃的包数
+    uint64_t span_ms;           // 文件中最旧与最新记录的时间跨度
+} tshift_stats_t;
+
+// 函数声明
+int tshift_open(const char *path, size_t bytes);            // 打开或创建环形文件并启动写入线程; 同参数的旧文件继续沿用
+void tshift_close(void);
+int tshift_enabled(void);
+void tshift_record(uint16_t chnid, uint32_t seq, const void *data, size_t len);  // 接收线程调用, 从不阻塞
+uint64_t tshift_head(void);                                 // 最新写入序号(直播位置)
+int64_t tshift_seek_time(uint64_t ts_ms);                   // 时间点对应的记录序号, O(1); 超出范围返回最旧或直播位置
+int64_t tshift_seek_seq(uint16_t chnid, uint32_t seq);      // 频道内序列号对应的记录序号, O(1); 找不到返回-1
+int tshift_read(uint64_t *pos, uint16_t chnid, void *buf, size_t cap, uint64_t *ts_ms);  // 读取 *pos 起该频道的下一条记录
+void tshift_get_stats(tshift_stats_t *stats);
+
+#endif /* __TSHIFT_H__ */
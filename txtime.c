@@ -0,0 +1,267 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <syslog.h>
+#include <ifaddrs.h>
+#include <net/if.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <linux/net_tstamp.h>
+#include <linux/errqueue.h>
+#include <linux/rtnetlink.h>
+#include "txtime.h"
+#include "afpacket.h"
+#include "proto.h"
+#include "probes.h"
+
+static tx_mode_t g_mode = TX_MODE_TIMER;       // 各频道线程并发读取, 发送失败时可能被改写, 只做原子访问
+static clockid_t g_clockid = CLOCK_MONOTONIC;   // fq 使用 CLOCK_MONOTONIC, etf 通常配置为 CLOCK_TAI
+static tx_stats_t g_stats;
+
+tx_mode_t tx_mode(void) {
+    return __atomic_load_n(&g_mode, __ATOMIC_RELAXED);
+}
+
+uint64_t tx_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(g_clockid, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+void tx_sleep_until(uint64_t ns) {
+    struct timespec ts;
+    ts.tv_sec = (time_t)(ns / 1000000000ULL);
+    ts.tv_nsec = (long)(ns % 1000000000ULL);
+    while (clock_nanosleep(g_clockid, TIMER_ABSTIME, &ts, NULL) == EINTR) {
+    }
+}
+
+void tx_get_stats(tx_stats_t *stats) {
+    stats->sent = __atomic_load_n(&g_stats.sent, __ATOMIC_RELAXED);
+    stats->send_errors = __atomic_load_n(&g_stats.send_errors, __ATOMIC_RELAXED);
+    stats->txtime_missed = __atomic_load_n(&g_stats.txtime_missed, __ATOMIC_RELAXED);
+}
+
+// 查出组播实际走的出口接口: 用同样的组播接口设置 connect 一个UDP套接字, 看内核选的源地址
+static int tx_egress_ifindex(int sockfd, const struct sockaddr_in *dst) {
+    struct in_addr mif;
+    socklen_t len = sizeof(mif);
+    int probe = socket(AF_INET, SOCK_DGRAM, 0);
+    if (probe < 0) return 0;
+    if (getsockopt(sockfd, IPPROTO_IP, IP_MULTICAST_IF, &mif, &len) == 0) {
+        setsockopt(probe, IPPROTO_IP, IP_MULTICAST_IF, &mif, sizeof(mif));
+    }
+    struct sockaddr_in src;
+    len = sizeof(src);
+    if (connect(probe, (const struct sockaddr *)dst, sizeof(*dst)) < 0 ||
+        getsockname(probe, (struct sockaddr *)&src, &len) < 0) {
+        close(probe);
+        return 0;
+    }
+    close(probe);
+
+    struct ifaddrs *ifa_list, *ifa;
+    int ifindex = 0;
+    if (getifaddrs(&ifa_list) < 0) return 0;
+    for (ifa = ifa_list; ifa; ifa = ifa->ifa_next) {
+        if (ifa->ifa_addr && ifa->ifa_addr->sa_family == AF_INET &&
+            ((struct sockaddr_in *)ifa->ifa_addr)->sin_addr.s_addr == src.sin_addr.s_addr) {
+            ifindex = (int)if_nametoindex(ifa->ifa_name);
+            break;
+        }
+    }
+    freeifaddrs(ifa_list);
+    return ifindex;
+}
+
+// 通过 rtnetlink 查询接口上的 qdisc, 有 fq 或 etf 时内核才会按出发时间放包
+// 返回 0 并设置时钟; 没有合适的 qdisc 返回 -1
+static int tx_probe_qdisc(int ifindex, clockid_t *clockid) {
+    int fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+    if (fd < 0) return -1;
+
+    struct {
+        struct nlmsghdr nh;
+        struct tcmsg tc;
+    } req;
+    memset(&req, 0, sizeof(req));
+    req.nh.nlmsg_len = NLMSG_LENGTH(sizeof(struct tcmsg));
+    req.nh.nlmsg_type = RTM_GETQDISC;
+    req.nh.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+    req.tc.tcm_family = AF_UNSPEC;
+    if (send(fd, &req, req.nh.nlmsg_len, 0) < 0) {
+        close(fd);
+        return -1;
+    }
+
+    int found = -1, done = 0;
+    char buf[16384];
+    while (!done) {
+        ssize_t n = recv(fd, buf, sizeof(buf), 0);
+        if (n <= 0) break;
+        for (struct nlmsghdr *nh = (struct nlmsghdr *)buf; NLMSG_OK(nh, (size_t)n);
+             nh = NLMSG_NEXT(nh, n)) {
+            if (nh->nlmsg_type == NLMSG_DONE || nh->nlmsg_type == NLMSG_ERROR) {
+                done = 1;
+                break;
+            }
+            struct tcmsg *tc = NLMSG_DATA(nh);
+            if (tc->tcm_ifindex != ifindex) continue;
+            int alen = (int)TCA_PAYLOAD(nh);
+            for (struct rtattr *rta = TCA_RTA(tc); RTA_OK(rta, alen); rta = RTA_NEXT(rta, alen)) {
+                if (rta->rta_type != TCA_KIND) continue;
+                const char *kind = RTA_DATA(rta);
+                if (strcmp(kind, "fq") == 0) {
+                    *clockid = CLOCK_MONOTONIC;
+                    found = 0;
+                } else if (strcmp(kind, "etf") == 0) {
+                    *clockid = CLOCK_TAI;
+                    found = 0;
+                }
+            }
+        }
+    }
+    close(fd);
+    return found;
+}
+
+// 探测出口 qdisc 并设置 SO_TXTIME; 条件不满足时退回用户态定时器
+tx_mode_t tx_setup(int sockfd, const struct sockaddr_in *dst, int want_txtime) {
+    __atomic_store_n(&g_mode, TX_MODE_TIMER, __ATOMIC_RELAXED);
+    g_clockid = CLOCK_MONOTONIC;
+    if (!want_txtime) return TX_MODE_TIMER;
+
+    int ifindex = tx_egress_ifindex(sockfd, dst);
+    char ifname[IF_NAMESIZE] = "?";
+    if (ifindex > 0) if_indextoname(ifindex, ifname);
+
+    clockid_t clockid;
+    if (ifindex <= 0 || tx_probe_qdisc(ifindex, &clockid) != 0) {
+        syslog(LOG_WARNING, "出口接口 %s 未配置 fq/etf qdisc, 退回用户态定时器节拍", ifname);
+        return TX_MODE_TIMER;
+    }
+
+    struct sock_txtime cfg;
+    cfg.clockid = clockid;
+    cfg.flags = SOF_TXTIME_REPORT_ERRORS;
+    if (setsockopt(sockfd, SOL_SOCKET, SO_TXTIME, &cfg, sizeof(cfg)) < 0) {
+        syslog(LOG_WARNING, "设置SO_TXTIME失败: %s, 退回用户态定时器节拍", strerror(errno));
+        return TX_MODE_TIMER;
+    }
+    g_clockid = clockid;
+    __atomic_store_n(&g_mode, TX_MODE_TXTIME, __ATOMIC_RELAXED);
+    syslog(LOG_INFO, "内核节拍发送: 接口 %s, 时钟 %s", ifname,
+           clockid == CLOCK_TAI ? "CLOCK_TAI" : "CLOCK_MONOTONIC");
+    return TX_MODE_TXTIME;
+}
+
+// 读取错误队列中内核报告的 txtime 丢包
+static void tx_drain_errqueue(int sockfd) {
+    char data[64], control[256];
+    while (1) {
+        struct iovec iov = {data, sizeof(data)};
+        struct msghdr msg = {0};
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        if (recvmsg(sockfd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0) return;
+        for (struct cmsghdr *cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm)) {
+            struct sock_extended_err *ee = (struct sock_extended_err *)CMSG_DATA(cm);
+            if (ee->ee_origin == SO_EE_ORIGIN_TXTIME) {
+                __atomic_add_fetch(&g_stats.txtime_missed, 1, __ATOMIC_RELAXED);
+            }
+        }
+    }
+}
+
+// txtime 模式: 整批一次 sendmmsg, 每包带出发时间
+static int tx_send_txtime(int sockfd, const struct sockaddr_in *dst, const tx_pkt_t *pkts, int n) {
+    struct mmsghdr msgs[TX_BATCH_MAX];
+    struct iovec iovs[TX_BATCH_MAX];
+    char controls[TX_BATCH_MAX][CMSG_SPACE(sizeof(uint64_t))];
+    memset(msgs, 0, sizeof(msgs));
+    memset(controls, 0, sizeof(controls));
+
+    for (int i = 0; i < n; i++) {
+        iovs[i].iov_base = pkts[i].data;
+        iovs[i].iov_len = pkts[i].len;
+        struct msghdr *msg = &msgs[i].msg_hdr;
+        msg->msg_name = (void *)dst;
+        msg->msg_namelen = sizeof(*dst);
+        msg->msg_iov = &iovs[i];
+        msg->msg_iovlen = 1;
+        msg->msg_control = controls[i];
+        msg->msg_controllen = sizeof(controls[i]);
+        struct cmsghdr *cm = CMSG_FIRSTHDR(msg);
+        cm->cmsg_level = SOL_SOCKET;
+        cm->cmsg_type = SCM_TXTIME;
+        cm->cmsg_len = CMSG_LEN(sizeof(uint64_t));
+        memcpy(CMSG_DATA(cm), &pkts[i].depart_ns, sizeof(uint64_t));
+    }
+
+    int done = 0;
+    while (done < n) {
+        int ret = sendmmsg(sockfd, msgs + done, (unsigned int)(n - done), 0);
+        if (ret < 0) {
+            if (errno == EINTR) continue;
+            return done > 0 ? done : -1;
+        }
+        done += ret;
+    }
+    return done;
+}
+
+// 发送一批包; 返回成功交给内核的包数
+int tx_send_batch(int sockfd, const struct sockaddr_in *dst, const tx_pkt_t *pkts, int n) {
+    if (__atomic_load_n(&g_mode, __ATOMIC_RELAXED) == TX_MODE_TXTIME) {
+        tx_drain_errqueue(sockfd);
+        int sent = tx_send_txtime(sockfd, dst, pkts, n);
+        if (sent >= 0) {
+            __atomic_add_fetch(&g_stats.sent, (uint64_t)sent, __ATOMIC_RELAXED);
+            if (sent < n) {
+                __atomic_add_fetch(&g_stats.send_errors, (uint64_t)(n - sent), __ATOMIC_RELAXED);
+            }
+            return sent;
+        }
+        // 只有内核不再接受带出发时间的包(如qdisc被移除)才退回用户态定时器;
+        // 链路抖动等暂时性错误(ENOBUFS/ENETUNREACH/EAGAIN)只计数, 不影响其它频道
+        if (errno != EINVAL && errno != EOPNOTSUPP && errno != EPROTO) {
+            __atomic_add_fetch(&g_stats.send_errors, (uint64_t)n, __ATOMIC_RELAXED);
+            return -1;
+        }
+        // 多个频道线程可能同时失败, 只由第一个记日志
+        if (__atomic_exchange_n(&g_mode, TX_MODE_TIMER, __ATOMIC_RELAXED) == TX_MODE_TXTIME) {
+            syslog(LOG_WARNING, "SO_TXTIME发送失败: %s, 退回用户态定时器节拍", strerror(errno));
+        }
+    }
+
+    int sent = 0;
+    for (int i = 0; i < n; i++) {
+        tx_sleep_until(pkts[i].depart_ns);
+        if (afp_enabled()) {
+            // 帧入 AF_PACKET 发送环, 由批量触发交给驱动
+            if (afp_send(pkts[i].data, pkts[i].len) != 0) {
+                __atomic_add_fetch(&g_stats.send_errors, 1, __ATOMIC_RELAXED);
+                continue;
+            }
+        } else if (sendto(sockfd, pkts[i].data, pkts[i].len, 0,
+                   (const struct sockaddr *)dst, sizeof(*dst)) < 0) {
+            __atomic_add_fetch(&g_stats.send_errors, 1, __ATOMIC_RELAXED);
+            fprintf(stderr, "[Server] 发送失败: %s\n", strerror(errno));
+            continue;
+        }
+        __atomic_add_fetch(&g_stats.sent, 1, __ATOMIC_RELAXED);
+        sent++;
+#ifdef USDT_ENABLED
+        // 逐包: 交给内核(或发送环)的时刻与计划出发时间, 两者同一时钟, 差值即晚发量; 未启用探针时不多取一次时钟
+        const pkt_hdr_t *hdr = pkts[i].data;
+        PROBE4(mcast, pkt_sent, ntohs(hdr->channel_id), ntohl(hdr->seq_num), pkts[i].depart_ns, tx_now_ns());
+#endif
+    }
+    return sent;
+}
@@ -0,0 +1,42 @@
+#ifndef __TXTIME_H__
+#define __TXTIME_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <netinet/in.h>
+
+// 组播发送节拍: 内核按出发时间放包(SO_TXTIME + fq/etf qdisc), 或退回用户态定时器
+#define TX_WINDOW_NS   (200 * 1000000ULL)   // txtime 模式下一次交给内核的调度窗口
+#define TX_LEAD_NS     (20 * 1000000ULL)    // 窗口提前量: 首包出发前多久唤醒组下一批
+#define TX_MAX_LATE_NS (500 * 1000000ULL)   // 落后超过该值则重置节拍, 避免集中补发
+#define TX_BATCH_MAX   64                   // 一批最多的包数
+
+// 发送模式
+typedef enum {
+    TX_MODE_TIMER = 0,      // 用户态定时器: 每包 clock_nanosleep 到出发时间再 sendto
+    TX_MODE_TXTIME,         // 内核节拍: 整个窗口一次 sendmmsg, 每包携带 SCM_TXTIME
+} tx_mode_t;
+
+// 待发送的一个数据报
+typedef struct tx_pkt {
+    void *data;
+    size_t len;
+    uint64_t depart_ns;     // 出发时间(tx_now_ns 时钟)
+} tx_pkt_t;
+
+// 统计计数
+typedef struct tx_stats {
+    uint64_t sent;          // 交给内核的包数
+    uint64_t send_errors;   // 发送失败
+    uint64_t txtime_missed; // 内核报告错过出发时间而丢弃的包
+} tx_stats_t;
+
+// 函数声明
+tx_mode_t tx_setup(int sockfd, const struct sockaddr_in *dst, int want_txtime);  // 探测qdisc并选择模式
+tx_mode_t tx_mode(void);
+uint64_t tx_now_ns(void);                                                      // 当前模式所用时钟
+void tx_sleep_until(uint64_t ns);
+int tx_send_batch(int sockfd, const struct sockaddr_in *dst, const tx_pkt_t *pkts, int n);
+void tx_get_stats(tx_stats_t *stats);
+
+#endif /* __TXTIME_H__ */
@@ -0,0 +1,420 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <syslog.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include "unicast.h"
+#include "presence.h"
+#include "handoff.h"
+
+static int g_listen_fd = -1;
+static int g_epoll_fd = -1;
+static int g_event_fd = -1;                         // 新包通知
+static volatile int g_running = 0;
+static pthread_t g_loop_tid;
+static unicast_slow_policy_t g_policy = UNICAST_SLOW_SKIP;
+static unicast_conn_t *g_chn_conns[BURST_MAX_CHN];  // 每频道订阅连接链表
+static uint64_t g_seen_head[BURST_MAX_CHN];         // 事件循环上次处理到的缓冲位置
+static unicast_conn_t *g_dead_conns;               // 本轮事件处理完后再释放的连接
+static unicast_stats_t g_stats;
+static pthread_mutex_t g_stats_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// epoll 用于区分监听套接字与通知 eventfd 的标记
+static int g_listen_tag, g_event_tag;
+static pthread_mutex_t g_accept_mutex = PTHREAD_MUTEX_INITIALIZER;
+static int g_accept_paused = 0;                     // 监听套接字已交给新进程
+
+static void stats_add(uint64_t *counter) {
+    pthread_mutex_lock(&g_stats_mutex);
+    (*counter)++;
+    pthread_mutex_unlock(&g_stats_mutex);
+}
+
+void unicast_get_stats(unicast_stats_t *stats) {
+    pthread_mutex_lock(&g_stats_mutex);
+    *stats = g_stats;
+    pthread_mutex_unlock(&g_stats_mutex);
+}
+
+static void conn_unlink(unicast_conn_t *c) {
+    if (c->chnid < 0) return;
+    presence_hold((chnid_t)c->chnid, -1);
+    if (c->prev) c->prev->next = c->next;
+    else g_chn_conns[c->chnid] = c->next;
+    if (c->next) c->next->prev = c->prev;
+    c->prev = c->next = NULL;
+}
+
+static void conn_link(unicast_conn_t *c, int chnid) {
+    c->chnid = chnid;
+    presence_hold((chnid_t)chnid, 1);   // 有单播订阅的频道不会被暂停
+    c->prev = NULL;
+    c->next = g_chn_conns[chnid];
+    if (c->next) c->next->prev = c;
+    g_chn_conns[chnid] = c;
+}
+
+// 关闭连接; 同一批 epoll 事件中可能还引用它, 内存延后到 free_dead_conns 释放
+static void conn_close(unicast_conn_t *c) {
+    if (c->fd < 0) return;
+    conn_unlink(c);
+    epoll_ctl(g_epoll_fd, EPOLL_CTL_DEL, c->fd, NULL);
+    close(c->fd);
+    c->fd = -1;
+    burst_buf_put(c->cur.buf);
+    c->cur.buf = NULL;
+    c->next = g_dead_conns;
+    g_dead_conns = c;
+    stats_add(&g_stats.closed);
+}
+
+static void free_dead_conns(void) {
+    while (g_dead_conns) {
+        unicast_conn_t *next = g_dead_conns->next;
+        free(g_dead_conns);
+        g_dead_conns = next;
+    }
+}
+
+static void conn_set_blocked(unicast_conn_t *c, int blocked) {
+    if (c->blocked == blocked) return;
+    struct epoll_event ev;
+    ev.events = EPOLLIN | (blocked ? EPOLLOUT : 0);
+    ev.data.ptr = c;
+    epoll_ctl(g_epoll_fd, EPOLL_CTL_MOD, c->fd, &ev);
+    c->blocked = blocked;
+}
+
+// 切换订阅频道: 从时间窗口内最旧的同步点开始, 新客户端可立即起播
+static void conn_subscribe(unicast_conn_t *c, int chnid) {
+    conn_unlink(c);
+    conn_link(c, chnid);
+    c->cursor = burst_join_point((chnid_t)chnid);
+    c->pending_chnid = -1;
+    c->need_sync = 1;
+}
+
+// 取下一个要发送的包; 返回 0 无数据, 1 已装入, -1 需要断开
+static int conn_load_next(unicast_conn_t *c) {
+    chnid_t chnid = (chnid_t)c->chnid;
+    int sync_start = 0;
+
+    // 慢读者: 落后过多或数据已被淘汰
+    if (burst_head(chnid) - c->cursor > UNICAST_MAX_LAG) {
+        if (g_policy == UNICAST_SLOW_DROP) {
+            stats_add(&g_stats.slow_drops);
+            return -1;
+        }
+        c->cursor = burst_latest_sync(chnid);
+        sync_start = 1;
+        stats_add(&g_stats.slow_skips);
+    }
+
+    int ret = burst_peek(chnid, c->cursor, &c->cur);
+    if (ret < 0) {
+        if (g_policy == UNICAST_SLOW_DROP) {
+            stats_add(&g_stats.slow_drops);
+            return -1;
+        }
+        c->cursor = burst_latest_sync(chnid);
+        sync_start = 1;
+        stats_add(&g_stats.slow_skips);
+        ret = burst_peek(chnid, c->cursor, &c->cur);
+    }
+    if (ret <= 0) {
+        c->cur.buf = NULL;
+        return 0;
+    }
+
+    // 新订阅或跳帧后的第一个包从帧同步点开始
+    memcpy(&c->hdr, c->cur.buf->data, sizeof(c->hdr));
+    c->skip = 0;
+    if ((sync_start || c->need_sync) && c->cur.sync_off > 0) {
+        c->skip = (size_t)c->cur.sync_off;
+        c->hdr.data_len = htonl(ntohl(c->hdr.data_len) - c->skip);
+        c->hdr.flags |= PKT_F_SYNC;
+    }
+    c->sent = 0;
+    c->need_sync = 0;
+    c->cursor++;
+    return 1;
+}
+
+// 尽可能多地把缓冲中的包写入连接; 返回 -1 表示连接应关闭
+static int conn_pump(unicast_conn_t *c) {
+    while (!c->blocked && c->chnid >= 0) {
+        if (!c->cur.buf) {
+            int ret = conn_load_next(c);
+            if (ret <= 0) return ret;
+        }
+
+        size_t payload_len = c->cur.buf->len - sizeof(pkt_hdr_t) - c->skip;
+        size_t total = sizeof(c->hdr) + payload_len;
+        struct iovec iov[2];
+        int iovcnt = 0;
+        if (c->sent < sizeof(c->hdr)) {
+            iov[iovcnt].iov_base = (char *)&c->hdr + c->sent;
+            iov[iovcnt].iov_len = sizeof(c->hdr) - c->sent;
+            iovcnt++;
+            iov[iovcnt].iov_base = c->cur.buf->data + sizeof(pkt_hdr_t) + c->skip;
+            iov[iovcnt].iov_len = payload_len;
+            iovcnt++;
+        } else {
+            size_t off = c->sent - sizeof(c->hdr);
+            iov[iovcnt].iov_base = c->cur.buf->data + sizeof(pkt_hdr_t) + c->skip + off;
+            iov[iovcnt].iov_len = payload_len - off;
+            iovcnt++;
+        }
+
+        struct msghdr msg = {0};
+        msg.msg_iov = iov;
+        msg.msg_iovlen = iovcnt;
+        ssize_t n = sendmsg(c->fd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                conn_set_blocked(c, 1);
+                return 0;
+            }
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        c->sent += (size_t)n;
+        if (c->sent < total) continue;
+
+        // 整包发完, 此时才能安全地切换频道(保持TCP流中的包边界)
+        burst_buf_put(c->cur.buf);
+        c->cur.buf = NULL;
+        if (c->pending_chnid >= 0) {
+            conn_subscribe(c, c->pending_chnid);
+        }
+    }
+    return 0;
+}
+
+// 读取订阅请求
+static int conn_read(unicast_conn_t *c) {
+    while (1) {
+        ssize_t n = recv(c->fd, c->rbuf + c->rlen, sizeof(c->rbuf) - c->rlen, MSG_DONTWAIT);
+        if (n == 0) return -1;
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return 0;
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        c->rlen += (size_t)n;
+        if (c->rlen < sizeof(c->rbuf)) continue;
+
+        unicast_req_t req;
+        memcpy(&req, c->rbuf, sizeof(req));
+        c->rlen = 0;
+        uint16_t chnid = ntohs(req.channel_id);
+        if (ntohl(req.magic) != UNICAST_MAGIC || chnid >= BURST_MAX_CHN) return -1;
+
+        if (c->cur.buf) {
+            c->pending_chnid = chnid;
+        } else {
+            conn_subscribe(c, chnid);
+        }
+        if (conn_pump(c) < 0) return -1;
+    }
+}
+
+static void accept_conns_locked(void) {
+    while (1) {
+        struct sockaddr_in peer;
+        socklen_t len = sizeof(peer);
+        int fd = accept4(g_listen_fd, (struct sockaddr *)&peer, &len, SOCK_NONBLOCK);
+        if (fd < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                fprintf(stderr, "[Unicast] accept失败: %s\n", strerror(errno));
+            }
+            return;
+        }
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        int sndbuf = UNICAST_SNDBUF;
+        setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+
+        unicast_conn_t *c = calloc(1, sizeof(*c));
+        if (!c) {
+            close(fd);
+            continue;
+        }
+        c->fd = fd;
+        c->chnid = -1;
+        c->pending_chnid = -1;
+        struct epoll_event ev;
+        ev.events = EPOLLIN;
+        ev.data.ptr = c;
+        if (epoll_ctl(g_epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+            close(fd);
+            free(c);
+            continue;
+        }
+        stats_add(&g_stats.accepted);
+    }
+}
+
+static void accept_conns(void) {
+    pthread_mutex_lock(&g_accept_mutex);
+    if (!g_accept_paused) accept_conns_locked();
+    pthread_mutex_unlock(&g_accept_mutex);
+}
+
+// 热升级: 交出监听套接字前把它移出 epoll 并等进行中的 accept 结束, 交接失败时放回
+static void unicast_quiesce(int stop) {
+    pthread_mutex_lock(&g_accept_mutex);
+    g_accept_paused = stop;
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.ptr = &g_listen_tag;
+    epoll_ctl(g_epoll_fd, stop ? EPOLL_CTL_DEL : EPOLL_CTL_ADD, g_listen_fd, &ev);
+    pthread_mutex_unlock(&g_accept_mutex);
+}
+
+// 有新包进入突发缓冲: 唤醒对应频道上所有未阻塞的连接
+static void dispatch_new_packets(void) {
+    uint64_t cnt;
+    ssize_t ret = read(g_event_fd, &cnt, sizeof(cnt));
+    (void)ret;
+    for (int ch = 0; ch < BURST_MAX_CHN; ch++) {
+        if (!g_chn_conns[ch]) continue;
+        uint64_t head = burst_head((chnid_t)ch);
+        if (head == g_seen_head[ch]) continue;
+        g_seen_head[ch] = head;
+
+        unicast_conn_t *c = g_chn_conns[ch];
+        while (c) {
+            unicast_conn_t *next = c->next;
+            if (!c->blocked && conn_pump(c) < 0) conn_close(c);
+            c = next;
+        }
+    }
+}
+
+static void *unicast_loop(void *arg) {
+    (void)arg;
+    struct epoll_event events[UNICAST_MAX_EVENTS];
+    while (g_running) {
+        int n = epoll_wait(g_epoll_fd, events, UNICAST_MAX_EVENTS, 1000);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        for (int i = 0; i < n; i++) {
+            void *ptr = events[i].data.ptr;
+            if (ptr == &g_listen_tag) {
+                accept_conns();
+                continue;
+            }
+            if (ptr == &g_event_tag) {
+                dispatch_new_packets();
+                continue;
+            }
+            unicast_conn_t *c = ptr;
+            uint32_t ev = events[i].events;
+            if (c->fd < 0) continue;  // 本轮已关闭
+            if (ev & (EPOLLERR | EPOLLHUP)) {
+                conn_close(c);
+                continue;
+            }
+            if (ev & EPOLLOUT) {
+                conn_set_blocked(c, 0);
+                if (conn_pump(c) < 0) {
+                    conn_close(c);
+                    continue;
+                }
+            }
+            if ((ev & EPOLLIN) && conn_read(c) < 0) {
+                conn_close(c);
+            }
+        }
+        free_dead_conns();
+    }
+
+    for (int ch = 0; ch < BURST_MAX_CHN; ch++) {
+        while (g_chn_conns[ch]) conn_close(g_chn_conns[ch]);
+    }
+    free_dead_conns();
+    return NULL;
+}
+
+// 启动单播监听与事件循环线程
+int unicast_start(int port, unicast_slow_policy_t policy) {
+    g_policy = policy;
+    // 热升级时沿用旧进程的监听套接字, 排队中的连接不会丢失
+    g_listen_fd = handoff_inherit(HANDOFF_FD_UNICAST);
+    if (g_listen_fd < 0) {
+        g_listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+        if (g_listen_fd < 0) {
+            syslog(LOG_ERR, "创建单播监听套接字失败: %s", strerror(errno));
+            return -1;
+        }
+        int reuse = 1;
+        setsockopt(g_listen_fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+        struct sockaddr_in addr = {0};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_ANY);
+        addr.sin_port = htons(port);
+        if (bind(g_listen_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+            listen(g_listen_fd, SOMAXCONN) < 0) {
+            syslog(LOG_ERR, "单播监听端口 %d 失败: %s", port, strerror(errno));
+            close(g_listen_fd);
+            g_listen_fd = -1;
+            return -1;
+        }
+    }
+
+    g_epoll_fd = epoll_create1(0);
+    g_event_fd = eventfd(0, EFD_NONBLOCK);
+    if (g_epoll_fd < 0 || g_event_fd < 0) {
+        syslog(LOG_ERR, "创建epoll/eventfd失败: %s", strerror(errno));
+        unicast_stop();
+        return -1;
+    }
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.ptr = &g_listen_tag;
+    epoll_ctl(g_epoll_fd, EPOLL_CTL_ADD, g_listen_fd, &ev);
+    ev.events = EPOLLIN;
+    ev.data.ptr = &g_event_tag;
+    epoll_ctl(g_epoll_fd, EPOLL_CTL_ADD, g_event_fd, &ev);
+    burst_set_notify(g_event_fd);
+
+    g_running = 1;
+    if (pthread_create(&g_loop_tid, NULL, unicast_loop, NULL) != 0) {
+        g_running = 0;
+        unicast_stop();
+        return -1;
+    }
+    handoff_export(HANDOFF_FD_UNICAST, g_listen_fd, unicast_quiesce);
+    syslog(LOG_INFO, "单播TCP推流监听 %d (慢读者策略: %s)", port,
+           policy == UNICAST_SLOW_DROP ? "断开" : "跳帧");
+    return 0;
+}
+
+void unicast_stop(void) {
+    if (g_running) {
+        g_running = 0;
+        burst_set_notify(-1);
+        uint64_t one = 1;
+        ssize_t ret = write(g_event_fd, &one, sizeof(one));
+        (void)ret;
+        pthread_join(g_loop_tid, NULL);
+    }
+    if (g_listen_fd >= 0) close(g_listen_fd);
+    if (g_epoll_fd >= 0) close(g_epoll_fd);
+    if (g_event_fd >= 0) close(g_event_fd);
+    g_listen_fd = g_epoll_fd = g_event_fd = -1;
+}
@@ -0,0 +1,48 @@
+#ifndef __UNICAST_H__
+#define __UNICAST_H__
+
+#include <stdint.h>
+#include "burst.h"
+
+// 单播TCP推流: epoll事件循环, 所有连接共享每频道的突发缓冲, 不再逐客户端读文件
+#define UNICAST_MAX_EVENTS 256
+#define UNICAST_MAX_LAG    (BURST_SLOTS * 3 / 4)   // 落后超过该包数视为慢读者
+#define UNICAST_SNDBUF     (256 * 1024)
+
+// 慢读者处理策略
+typedef enum {
+    UNICAST_SLOW_SKIP = 0,      // 跳到最新的帧同步点继续发送
+    UNICAST_SLOW_DROP,          // 直接断开连接
+} unicast_slow_policy_t;
+
+// 一个订阅连接
+typedef struct unicast_conn {
+    int fd;
+    int chnid;                  // 当前订阅频道, -1 表示未订阅
+    int pending_chnid;          // 当前包发完后切换到的频道, -1 表示无
+    uint64_t cursor;            // 下一个要发送的缓冲序号
+    burst_pkt_t cur;            // 正在发送的包 (cur.buf 为 NULL 表示无)
+    pkt_hdr_t hdr;              // 正在发送的包头 (可能已按同步点改写 data_len)
+    size_t skip;                // 数据部分跳过的字节数(同步点裁剪)
+    size_t sent;                // 正在发送的包已发出的字节数
+    int need_sync;              // 下一个包需从帧同步点开始(新订阅/换台)
+    int blocked;                // 发送缓冲已满, 等待 EPOLLOUT
+    unsigned char rbuf[sizeof(unicast_req_t)];
+    size_t rlen;
+    struct unicast_conn *prev, *next;   // 同频道连接链表
+} unicast_conn_t;
+
+// 统计计数
+typedef struct unicast_stats {
+    uint64_t accepted;
+    uint64_t closed;
+    uint64_t slow_skips;        // 慢读者跳帧次数
+    uint64_t slow_drops;        // 慢读者断开次数
+} unicast_stats_t;
+
+// 函数声明
+int unicast_start(int port, unicast_slow_policy_t policy);   // 启动监听与事件循环线程
+void unicast_stop(void);
+void unicast_get_stats(unicast_stats_t *stats);
+
+#endif /* __UNICAST_H__ */